@@ -10,17 +10,30 @@
 #include "freertos/semphr.h"
 #include "freertos/task.h"
 #include "i2c_config.h"
+#include <inttypes.h>
+#include <math.h>
 #include <stdlib.h>
 #include <string.h>
 
 
 static const char *TAG = "BME680_APP";
 
+#define HEATER_TEMP 320
+#define HEATER_DUR_MS 150
+// Conditioning defaults: about 40 % heater duty instead of 1.5 % at the
+// normal 10 s interval
+#define CONDITION_INTERVAL_MS 200
+#define CONDITION_DRIFT_WINDOW 10
+#define CONDITION_MAX_DRIFT 0.02f
+#define CONDITION_TIMEOUT_MS (5 * 60 * 1000)
+#define CONDITION_MAX_WINDOW 32
+
 static struct bme68x_dev g_gas_sensor;
 static struct bme68x_conf g_conf;
 static struct bme68x_heatr_conf g_heatr_conf;
 static bme680_sensor_data_t g_sensor_data = {0};
 static SemaphoreHandle_t g_sensor_mutex = NULL;
+static StaticSemaphore_t g_sensor_mutex_buffer;
 static uint8_t g_dev_addr = BME680_I2C_ADDR;
 
 static BME68X_INTF_RET_TYPE bme68x_i2c_read(uint8_t reg_addr, uint8_t *reg_data,
@@ -43,9 +56,11 @@ static BME68X_INTF_RET_TYPE bme68x_i2c_write(uint8_t reg_addr,
                                              const uint8_t *reg_data,
                                              uint32_t len, void *intf_ptr) {
   uint8_t dev_addr = *(uint8_t *)intf_ptr;
-  uint8_t *write_buf = malloc(len + 1);
-  if (write_buf == NULL) {
-    ESP_LOGE(TAG, "Memory allocation failed");
+  // The driver interleaves register/value pairs into at most
+  // BME68X_LEN_INTERLEAVE_BUFF bytes, the register included
+  uint8_t write_buf[BME68X_LEN_INTERLEAVE_BUFF];
+  if (len + 1 > sizeof(write_buf)) {
+    ESP_LOGE(TAG, "I2C write of %" PRIu32 " bytes too long", len);
     return BME68X_E_COM_FAIL;
   }
 
@@ -54,7 +69,6 @@ static BME68X_INTF_RET_TYPE bme68x_i2c_write(uint8_t reg_addr,
 
   esp_err_t ret = i2c_master_write_to_device(
       i2c_get_port(), dev_addr, write_buf, len + 1, i2c_get_timeout_ticks());
-  free(write_buf);
 
   if (ret != ESP_OK) {
     ESP_LOGE(TAG, "I2C write failed: %s", esp_err_to_name(ret));
@@ -73,8 +87,22 @@ static void bme68x_delay_us(uint32_t period, void *intf_ptr) {
   }
 }
 
+static esp_err_t set_heater(uint16_t temp, uint16_t dur_ms) {
+  g_heatr_conf.enable = BME68X_ENABLE;
+  g_heatr_conf.heatr_temp = temp;
+  g_heatr_conf.heatr_dur = dur_ms;
+
+  int8_t rslt =
+      bme68x_set_heatr_conf(BME68X_FORCED_MODE, &g_heatr_conf, &g_gas_sensor);
+  if (rslt != BME68X_OK) {
+    ESP_LOGE(TAG, "Failed to set heater configuration: %d", rslt);
+    return ESP_FAIL;
+  }
+  return ESP_OK;
+}
+
 esp_err_t bme680_app_create_mutex(void) {
-  g_sensor_mutex = xSemaphoreCreateMutex();
+  g_sensor_mutex = xSemaphoreCreateMutexStatic(&g_sensor_mutex_buffer);
   if (g_sensor_mutex == NULL) {
     ESP_LOGE(TAG, "Failed to create sensor mutex");
     return ESP_FAIL;
@@ -121,14 +149,7 @@ esp_err_t bme680_app_init(void) {
     return ESP_FAIL;
   }
 
-  g_heatr_conf.enable = BME68X_ENABLE;
-  g_heatr_conf.heatr_temp = 320;
-  g_heatr_conf.heatr_dur = 150;
-
-  rslt =
-      bme68x_set_heatr_conf(BME68X_FORCED_MODE, &g_heatr_conf, &g_gas_sensor);
-  if (rslt != BME68X_OK) {
-    ESP_LOGE(TAG, "Failed to set heater configuration: %d", rslt);
+  if (set_heater(HEATER_TEMP, HEATER_DUR_MS) != ESP_OK) {
     return ESP_FAIL;
   }
 
@@ -136,7 +157,7 @@ esp_err_t bme680_app_init(void) {
   ESP_LOGI(TAG, "  - Temp Oversampling: x8");
   ESP_LOGI(TAG, "  - Pressure Oversampling: x4");
   ESP_LOGI(TAG, "  - Humidity Oversampling: x2");
-  ESP_LOGI(TAG, "  - Heater: 320C, 150ms");
+  ESP_LOGI(TAG, "  - Heater: %dC, %dms", HEATER_TEMP, HEATER_DUR_MS);
 
   return ESP_OK;
 }
@@ -171,6 +192,103 @@ esp_err_t bme680_app_read(struct bme68x_data *data) {
   return ESP_OK;
 }
 
+void bme680_app_get_default_condition_config(
+    bme680_condition_config_t *config) {
+  if (config == NULL)
+    return;
+
+  config->heater_temp = HEATER_TEMP;
+  config->heater_dur_ms = HEATER_DUR_MS;
+  config->interval_ms = CONDITION_INTERVAL_MS;
+  config->drift_window = CONDITION_DRIFT_WINDOW;
+  config->max_drift = CONDITION_MAX_DRIFT;
+  config->timeout_ms = CONDITION_TIMEOUT_MS;
+}
+
+esp_err_t bme680_app_condition(const bme680_condition_config_t *config,
+                               bme680_condition_report_t *report) {
+  bme680_condition_config_t cfg;
+  bme680_condition_report_t out = {0};
+
+  if (config != NULL) {
+    cfg = *config;
+  } else {
+    bme680_app_get_default_condition_config(&cfg);
+  }
+  if (cfg.drift_window < 2) {
+    cfg.drift_window = 2;
+  } else if (cfg.drift_window > CONDITION_MAX_WINDOW) {
+    cfg.drift_window = CONDITION_MAX_WINDOW;
+  }
+
+  if (set_heater(cfg.heater_temp, cfg.heater_dur_ms) != ESP_OK) {
+    return ESP_FAIL;
+  }
+
+  ESP_LOGI(TAG, "Conditioning gas sensor: %dC/%dms every %" PRIu32 " ms",
+           cfg.heater_temp, cfg.heater_dur_ms,
+           cfg.heater_dur_ms + cfg.interval_ms);
+
+  // Resistances of the most recent consecutive heat-stable cycles
+  float window[CONDITION_MAX_WINDOW];
+  uint32_t filled = 0;
+  TickType_t start = xTaskGetTickCount();
+  TickType_t timeout = pdMS_TO_TICKS(cfg.timeout_ms);
+
+  while (xTaskGetTickCount() - start < timeout) {
+    struct bme68x_data data;
+
+    out.cycles++;
+    if (bme680_app_read(&data) == ESP_OK) {
+      bool valid = (data.status & BME68X_GASM_VALID_MSK) &&
+                   (data.status & BME68X_HEAT_STAB_MSK) &&
+                   data.gas_resistance > 0.0f;
+      if (!valid) {
+        filled = 0;
+      } else {
+        float r = (float)data.gas_resistance;
+        window[filled % cfg.drift_window] = r;
+        filled++;
+        out.gas_resistance = r;
+
+        if (filled >= cfg.drift_window) {
+          // Slot of the oldest sample still in the window
+          float oldest = window[filled % cfg.drift_window];
+          out.drift = fabsf(r - oldest) / oldest;
+          if (out.drift <= cfg.max_drift) {
+            out.stable = true;
+            break;
+          }
+        }
+      }
+    }
+
+    vTaskDelay(pdMS_TO_TICKS(cfg.interval_ms));
+  }
+
+  out.duration_ms = pdTICKS_TO_MS(xTaskGetTickCount() - start);
+  if (report != NULL) {
+    *report = out;
+  }
+
+  if (set_heater(HEATER_TEMP, HEATER_DUR_MS) != ESP_OK) {
+    return ESP_FAIL;
+  }
+
+  if (!out.stable) {
+    ESP_LOGW(TAG,
+             "Conditioning timed out after %" PRIu32 " cycles (drift %.1f%%)",
+             out.cycles, out.drift * 100.0f);
+    return ESP_ERR_TIMEOUT;
+  }
+
+  ESP_LOGI(TAG,
+           "Gas sensor stable after %" PRIu32 " cycles, %" PRIu32
+           " ms (%.0f Ohms)",
+           out.cycles, out.duration_ms, out.gas_resistance);
+  return ESP_OK;
+}
+
 void bme680_app_update_data(const struct bme68x_data *raw_data) {
   if (g_sensor_mutex == NULL)
     return;
@@ -30,6 +30,33 @@ typedef struct {
   uint32_t read_count;
 } bme680_sensor_data_t;
 
+/**
+ * @brief Boot-time conditioning parameters
+ *
+ * The heater duty cycle is raised by shortening the pause between forced
+ * measurements rather than by changing the heater profile, so readings taken
+ * after conditioning are comparable with those of the normal schedule.
+ */
+typedef struct {
+  uint16_t heater_temp;   /**< Heater target, degC */
+  uint16_t heater_dur_ms; /**< Heater on-time per cycle, ms */
+  uint32_t interval_ms;   /**< Pause between cycles, ms */
+  uint8_t drift_window;   /**< Stable cycles the drift is measured over */
+  float max_drift;        /**< Max relative resistance change over the window */
+  uint32_t timeout_ms;    /**< Hand over unconditioned after this long */
+} bme680_condition_config_t;
+
+/**
+ * @brief Outcome of the conditioning phase
+ */
+typedef struct {
+  uint32_t cycles;
+  uint32_t duration_ms;
+  float drift;          /**< Relative change over the last full window */
+  float gas_resistance; /**< Last valid resistance, Ohms */
+  bool stable;          /**< Criteria met before the timeout */
+} bme680_condition_report_t;
+
 /**
  * @brief Initialize BME680 sensor
  * @return ESP_OK on success, error code otherwise
@@ -43,6 +70,28 @@ esp_err_t bme680_app_init(void);
  */
 esp_err_t bme680_app_read(struct bme68x_data *data);
 
+/**
+ * @brief Get default conditioning parameters
+ * @param config Pointer to store the parameters
+ */
+void bme680_app_get_default_condition_config(bme680_condition_config_t *config);
+
+/**
+ * @brief Condition a cold gas sensor at a fast cadence
+ *
+ * Runs back-to-back forced measurements until the heater reports a stable
+ * temperature (BME68X_HEAT_STAB_MSK) and the gas resistance has drifted by
+ * no more than max_drift over drift_window consecutive stable cycles. The
+ * normal heater profile is restored afterwards.
+ *
+ * @param config Conditioning parameters, or NULL for the defaults
+ * @param report Pointer to store the outcome, may be NULL
+ * @return ESP_OK once stable, ESP_ERR_TIMEOUT if the timeout expired first,
+ *         ESP_FAIL if the heater profile could not be set or restored
+ */
+esp_err_t bme680_app_condition(const bme680_condition_config_t *config,
+                               bme680_condition_report_t *report);
+
 /**
  * @brief Get last sensor reading (thread-safe)
  * @param data Pointer to bme680_sensor_data_t to store data
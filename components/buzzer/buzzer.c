@@ -9,7 +9,11 @@
 
 static const char *TAG = "BUZZER";
 
+#define BUZZER_TASK_STACK_SIZE 2048
+
 static volatile bool g_buzzer_active = false;
+static StaticTask_t g_buzzer_task;
+static StackType_t g_buzzer_stack[BUZZER_TASK_STACK_SIZE];
 
 esp_err_t buzzer_init(void) {
   gpio_config_t io_conf = {
@@ -62,6 +66,7 @@ static void buzzer_task(void *pvParameters) {
 }
 
 void buzzer_start_task(void) {
-  xTaskCreate(buzzer_task, "buzzer_task", 2048, NULL, 4, NULL);
+  xTaskCreateStatic(buzzer_task, "buzzer_task", BUZZER_TASK_STACK_SIZE, NULL,
+                    4, g_buzzer_stack, &g_buzzer_task);
   ESP_LOGI(TAG, "Buzzer alert task created");
 }
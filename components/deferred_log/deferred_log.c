@@ -0,0 +1,501 @@
+/**
+ * @file deferred_log.c
+ * @brief Binary logging with formatting deferred to a background task
+ */
+
+#include "deferred_log.h"
+#include "esp_cpu.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "spsc_ring.h"
+#include <inttypes.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+
+#define TAG "DLOG"
+
+#ifndef CONFIG_DEFERRED_LOG_RECORDS
+#define CONFIG_DEFERRED_LOG_RECORDS 64
+#endif
+
+#define FORMATTER_TASK_STACK 3072
+#define FORMATTER_TASK_PRIORITY 1
+// Records are printed in batches; a short delay keeps the console current
+#define FORMATTER_INTERVAL_MS 100
+// Longest conversion rebuilt for snprintf, with "*" values filled in
+#define SPEC_MAX 24
+
+typedef enum {
+  ARG_NONE = 0,
+  ARG_INT,
+  ARG_UINT,
+  ARG_FLOAT,
+  ARG_STRING,
+  ARG_POINTER,
+} arg_type_t;
+
+typedef enum {
+  LEN_NONE = 0, // Also h and hh, promoted to int
+  LEN_LONG,
+  LEN_LLONG,
+  LEN_SIZE,
+  LEN_PTRDIFF,
+  LEN_INTMAX,
+  LEN_LDOUBLE,
+} arg_length_t;
+
+/**
+ * @brief One conversion of a format string
+ */
+typedef struct {
+  arg_type_t type;
+  arg_length_t length;
+  uint8_t stars; /**< "*" widths and precisions, an int argument each */
+} spec_t;
+
+static dlog_record_t s_slots[CONFIG_DEFERRED_LOG_RECORDS];
+static spsc_ring_t s_ring;
+static bool s_ready;
+
+static StaticTask_t s_task_buffer;
+static StackType_t s_task_stack[FORMATTER_TASK_STACK];
+static bool s_started;
+
+/* Writer side */
+static uint64_t s_write_cycles;
+/* Formatter side */
+static uint32_t s_formatted;
+static uint64_t s_format_cycles;
+
+/**
+ * @brief Parse a conversion's flags, width, precision and length
+ * @param spec Just past the '%'
+ * @param out Output, what the conversion takes
+ * @return The conversion character, or the terminator
+ */
+static const char *parse_spec(const char *spec, spec_t *out) {
+  const char *p = spec;
+  out->stars = 0;
+  for (;; p++) {
+    if (*p == '*') {
+      out->stars++;
+    } else if (!((*p >= '0' && *p <= '9') || *p == '.' || *p == '-' ||
+                 *p == '+' || *p == ' ' || *p == '#')) {
+      break;
+    }
+  }
+
+  out->length = LEN_NONE;
+  switch (*p) {
+  case 'h':
+    while (*p == 'h') {
+      p++;
+    }
+    break;
+  case 'l':
+    out->length = p[1] == 'l' ? LEN_LLONG : LEN_LONG;
+    p += out->length == LEN_LLONG ? 2 : 1;
+    break;
+  case 'z':
+    out->length = LEN_SIZE;
+    p++;
+    break;
+  case 't':
+    out->length = LEN_PTRDIFF;
+    p++;
+    break;
+  case 'j':
+    out->length = LEN_INTMAX;
+    p++;
+    break;
+  case 'L':
+    out->length = LEN_LDOUBLE;
+    p++;
+    break;
+  default:
+    break;
+  }
+
+  switch (*p) {
+  case 'd':
+  case 'i':
+    out->type = ARG_INT;
+    break;
+  case 'u':
+  case 'x':
+  case 'X':
+  case 'o':
+    out->type = ARG_UINT;
+    break;
+  case 'c':
+    out->type = ARG_INT;
+    out->length = LEN_NONE;
+    break;
+  case 'f':
+  case 'F':
+  case 'e':
+  case 'E':
+  case 'g':
+  case 'G':
+  case 'a':
+  case 'A':
+    out->type = ARG_FLOAT;
+    break;
+  case 's':
+    out->type = ARG_STRING;
+    break;
+  case 'p':
+    out->type = ARG_POINTER;
+    break;
+  default:
+    // "%%", and anything unsupported, which is then printed as is
+    out->type = ARG_NONE;
+    break;
+  }
+  return p;
+}
+
+/**
+ * @brief Whether an integer conversion's argument is wider than a slot
+ */
+static bool spec_wide(const spec_t *spec) {
+  if (spec->type != ARG_INT && spec->type != ARG_UINT) {
+    return false;
+  }
+  switch (spec->length) {
+  case LEN_LONG:
+    return sizeof(long) > sizeof(uint32_t);
+  case LEN_LLONG:
+    return sizeof(long long) > sizeof(uint32_t);
+  case LEN_SIZE:
+    return sizeof(size_t) > sizeof(uint32_t);
+  case LEN_PTRDIFF:
+    return sizeof(ptrdiff_t) > sizeof(uint32_t);
+  case LEN_INTMAX:
+    return sizeof(intmax_t) > sizeof(uint32_t);
+  default:
+    return false;
+  }
+}
+
+/**
+ * @brief Argument slots a conversion takes, 0 for one without an argument
+ */
+static uint8_t spec_slots(const spec_t *spec) {
+  if (spec->type == ARG_NONE) {
+    return 0;
+  }
+  return spec->stars + (spec_wide(spec) ? 2 : 1);
+}
+
+/**
+ * @brief Take an integer argument of the conversion's length
+ *
+ * Signed arguments are read as their unsigned type, which keeps the bits;
+ * only as many as the slots hold are kept.
+ */
+static uint64_t take_integer(va_list *ap, arg_length_t length) {
+  switch (length) {
+  case LEN_LONG:
+    return va_arg(*ap, unsigned long);
+  case LEN_LLONG:
+    return va_arg(*ap, unsigned long long);
+  case LEN_SIZE:
+    return va_arg(*ap, size_t);
+  case LEN_PTRDIFF:
+    return (uint64_t)va_arg(*ap, ptrdiff_t);
+  case LEN_INTMAX:
+    return va_arg(*ap, uintmax_t);
+  default:
+    return va_arg(*ap, unsigned int);
+  }
+}
+
+/**
+ * @brief Rebuild a conversion for snprintf
+ *
+ * Drops the length, which the stored argument no longer has, or puts "ll"
+ * in its place for a 64-bit one, and writes each "*" as its value. A
+ * negative precision means none, as in printf.
+ *
+ * @param start The '%'
+ * @param conv The conversion character
+ * @param stars The "*" values, in order
+ * @return false if the result does not fit in SPEC_MAX
+ */
+static bool build_spec(const char *start, const char *conv,
+                       const spec_t *spec, const dlog_arg_t *stars,
+                       char out[SPEC_MAX]) {
+  size_t len = 0;
+  for (const char *s = start; s < conv; s++) {
+    if (*s == 'h' || *s == 'l' || *s == 'z' || *s == 't' || *s == 'j' ||
+        *s == 'L') {
+      continue;
+    }
+    if (*s == '.' && s[1] == '*' && stars[0].i < 0) {
+      stars++;
+      s++;
+      continue;
+    }
+    int written = *s == '*' ? snprintf(out + len, SPEC_MAX - len, "%" PRIi32,
+                                       (stars++)->i)
+                            : snprintf(out + len, SPEC_MAX - len, "%c", *s);
+    if (written < 0 || (size_t)written >= SPEC_MAX - len) {
+      return false;
+    }
+    len += (size_t)written;
+  }
+  const char *tail = spec_wide(spec) ? "ll" : "";
+  if (len + strlen(tail) + 2 > SPEC_MAX) {
+    return false;
+  }
+  strcpy(out + len, tail);
+  len += strlen(tail);
+  out[len++] = *conv;
+  out[len] = '\0';
+  return true;
+}
+
+static char level_letter(uint8_t level) {
+  switch (level) {
+  case ESP_LOG_ERROR:
+    return 'E';
+  case ESP_LOG_WARN:
+    return 'W';
+  case ESP_LOG_INFO:
+    return 'I';
+  case ESP_LOG_DEBUG:
+    return 'D';
+  default:
+    return 'V';
+  }
+}
+
+static void print_record(const dlog_record_t *record) {
+  char line[DLOG_LINE_MAX];
+  dlog_format(record, line, sizeof(line));
+  esp_log_write((esp_log_level_t)record->level, record->tag,
+                "%c (%" PRIu32 ") %s: %s\n", level_letter(record->level),
+                record->timestamp_ms, record->tag, line);
+}
+
+esp_err_t dlog_init(void) {
+  if (s_ready) {
+    return ESP_OK;
+  }
+  esp_err_t err =
+      spsc_ring_init(&s_ring, s_slots, sizeof(dlog_record_t),
+                     CONFIG_DEFERRED_LOG_RECORDS, SPSC_RING_DROP_NEWEST);
+  if (err != ESP_OK) {
+    return err;
+  }
+  __atomic_store_n(&s_ready, true, __ATOMIC_RELEASE);
+  return ESP_OK;
+}
+
+static void formatter_task(void *arg) {
+  (void)arg;
+  dlog_record_t record;
+  uint32_t reported_drops = 0;
+
+  while (1) {
+    while (spsc_ring_pop(&s_ring, &record)) {
+      esp_cpu_cycle_count_t start = esp_cpu_get_cycle_count();
+      print_record(&record);
+      s_format_cycles += (uint32_t)(esp_cpu_get_cycle_count() - start);
+      __atomic_store_n(&s_formatted, s_formatted + 1, __ATOMIC_RELAXED);
+    }
+
+    spsc_ring_stats_t ring;
+    spsc_ring_get_stats(&s_ring, &ring);
+    if (ring.dropped != reported_drops) {
+      ESP_LOGW(TAG, "%" PRIu32 " log records dropped",
+               ring.dropped - reported_drops);
+      reported_drops = ring.dropped;
+    }
+    vTaskDelay(pdMS_TO_TICKS(FORMATTER_INTERVAL_MS));
+  }
+}
+
+esp_err_t dlog_start(void) {
+  if (s_started) {
+    return ESP_OK;
+  }
+  esp_err_t err = dlog_init();
+  if (err != ESP_OK) {
+    return err;
+  }
+  if (xTaskCreateStatic(formatter_task, "dlog", FORMATTER_TASK_STACK, NULL,
+                        FORMATTER_TASK_PRIORITY, s_task_stack,
+                        &s_task_buffer) == NULL) {
+    ESP_LOGE(TAG, "Failed to create formatter task");
+    return ESP_FAIL;
+  }
+  s_started = true;
+  return ESP_OK;
+}
+
+void dlog_write(esp_log_level_t level, const char *tag, const char *format,
+                ...) {
+  // Filtered here, so a line nobody will see costs no slot or formatting
+  if (level > esp_log_level_get(tag)) {
+    return;
+  }
+
+  esp_cpu_cycle_count_t start = esp_cpu_get_cycle_count();
+  dlog_record_t record = {.tag = tag,
+                          .format = format,
+                          .timestamp_ms = esp_log_timestamp(),
+                          .level = (uint8_t)level};
+
+  va_list ap;
+  va_start(ap, format);
+  for (const char *p = strchr(format, '%'); p != NULL;
+       p = strchr(p + 1, '%')) {
+    spec_t spec;
+    p = parse_spec(p + 1, &spec);
+    if (*p == '\0') {
+      break;
+    }
+    uint8_t slots = spec_slots(&spec);
+    if (slots == 0) {
+      continue;
+    }
+    if (record.argc + slots > DLOG_MAX_ARGS) {
+      break; // The formatter prints the rest of the format as is
+    }
+    for (uint8_t i = 0; i < spec.stars; i++) {
+      record.args[record.argc++].i = va_arg(ap, int);
+    }
+
+    dlog_arg_t *arg = &record.args[record.argc];
+    switch (spec.type) {
+    case ARG_INT:
+    case ARG_UINT: {
+      uint64_t value = take_integer(&ap, spec.length);
+      arg[0].u = (uint32_t)value;
+      if (spec_wide(&spec)) {
+        arg[1].u = (uint32_t)(value >> 32);
+      }
+      break;
+    }
+    case ARG_FLOAT:
+      arg->f = spec.length == LEN_LDOUBLE ? (float)va_arg(ap, long double)
+                                          : (float)va_arg(ap, double);
+      break;
+    case ARG_STRING:
+      arg->s = va_arg(ap, const char *);
+      break;
+    case ARG_POINTER:
+      arg->p = va_arg(ap, const void *);
+      break;
+    default:
+      break;
+    }
+    record.argc += slots - spec.stars;
+  }
+  va_end(ap);
+
+  if (!__atomic_load_n(&s_ready, __ATOMIC_ACQUIRE)) {
+    print_record(&record);
+    return;
+  }
+  spsc_ring_push(&s_ring, &record);
+  s_write_cycles += (uint32_t)(esp_cpu_get_cycle_count() - start);
+}
+
+bool dlog_read(dlog_record_t *record) {
+  return s_ready && spsc_ring_pop(&s_ring, record);
+}
+
+size_t dlog_format(const dlog_record_t *record, char *out, size_t size) {
+  if (size == 0) {
+    return 0;
+  }
+
+  size_t n = 0;
+  uint8_t next = 0;
+  const char *p = record->format;
+  // n stays below size, so out always has room for the terminator
+  while (*p != '\0' && n + 1 < size) {
+    if (*p != '%') {
+      out[n++] = *p++;
+      continue;
+    }
+
+    spec_t spec;
+    const char *conv = parse_spec(p + 1, &spec);
+    if (*conv == '\0') {
+      break;
+    }
+    uint8_t slots = spec_slots(&spec);
+    bool stored = slots > 0 && next + slots <= record->argc;
+    char fmt[SPEC_MAX];
+    if (!stored || !build_spec(p, conv, &spec, &record->args[next], fmt)) {
+      // "%%" prints one '%'; anything else is copied verbatim, skipping
+      // its arguments if the writer stored them
+      next += stored ? slots : 0;
+      bool percent = *conv == '%' && conv == p + 1;
+      out[n++] = percent ? '%' : *p;
+      p = percent ? conv + 1 : p + 1;
+      continue;
+    }
+
+    const dlog_arg_t *arg = &record->args[next + spec.stars];
+    next += slots;
+    int written;
+    switch (spec.type) {
+    case ARG_INT:
+      written = spec_wide(&spec)
+                    ? snprintf(out + n, size - n, fmt,
+                               (long long)((uint64_t)arg[1].u << 32 |
+                                           arg[0].u))
+                    : snprintf(out + n, size - n, fmt, (int)arg->i);
+      break;
+    case ARG_UINT:
+      written = spec_wide(&spec)
+                    ? snprintf(out + n, size - n, fmt,
+                               (unsigned long long)((uint64_t)arg[1].u << 32 |
+                                                    arg[0].u))
+                    : snprintf(out + n, size - n, fmt, (unsigned int)arg->u);
+      break;
+    case ARG_FLOAT:
+      written = snprintf(out + n, size - n, fmt, (double)arg->f);
+      break;
+    case ARG_POINTER:
+      written = snprintf(out + n, size - n, fmt, arg->p);
+      break;
+    default:
+      written = snprintf(out + n, size - n, fmt,
+                         arg->s != NULL ? arg->s : "(null)");
+      break;
+    }
+    if (written > 0) {
+      n += (size_t)written < size - n ? (size_t)written : size - n - 1;
+    }
+    p = conv + 1;
+  }
+  out[n] = '\0';
+  return n;
+}
+
+void dlog_get_stats(dlog_stats_t *stats) {
+  spsc_ring_stats_t ring = {0};
+  if (s_ready) {
+    spsc_ring_get_stats(&s_ring, &ring);
+  }
+
+  memset(stats, 0, sizeof(*stats));
+  stats->written = ring.pushed;
+  stats->dropped = ring.dropped;
+  stats->formatted = __atomic_load_n(&s_formatted, __ATOMIC_RELAXED);
+  uint32_t writes = ring.pushed + ring.dropped;
+  if (writes > 0) {
+    stats->write_cycles = (float)s_write_cycles / (float)writes;
+  }
+  if (stats->formatted > 0) {
+    stats->format_cycles = (float)s_format_cycles / (float)stats->formatted;
+  }
+}
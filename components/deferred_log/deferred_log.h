@@ -0,0 +1,139 @@
+/**
+ * @file deferred_log.h
+ * @brief Binary logging with formatting deferred to a background task
+ *
+ * A DLOG_* call stores a compact record: the tag and format string
+ * addresses, which identify the line, and its arguments as raw 32-bit
+ * values. The formatter task turns records back into ESP_LOG lines at low
+ * priority, so the writer pays for neither printf nor the UART.
+ *
+ * Records hold pointers, so tags, formats and %s arguments must be static
+ * strings. A record has DLOG_MAX_ARGS 32-bit argument slots: an integer,
+ * float, string or pointer takes one, a 64-bit integer two and each "*"
+ * width or precision one more; the part of the format past the last slot
+ * is printed as is. %n is not supported. Lines above LOG_LOCAL_LEVEL are
+ * compiled out and lines above the tag's runtime level are not recorded.
+ * All DLOG_* calls must come from one task at a time, the ring's producer.
+ */
+
+#ifndef DEFERRED_LOG_H
+#define DEFERRED_LOG_H
+
+#include "esp_err.h"
+#include "esp_log.h"
+#include "sdkconfig.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define DLOG_MAX_ARGS 8
+#define DLOG_LINE_MAX 160
+
+/**
+ * @brief One argument, as passed
+ */
+typedef union {
+  int32_t i;
+  uint32_t u;
+  float f; /**< Narrowed from the promoted double */
+  const char *s;
+  const void *p;
+} dlog_arg_t;
+
+/**
+ * @brief One log line, unformatted
+ */
+typedef struct {
+  const char *tag;
+  const char *format; /**< Its address is the format ID */
+  uint32_t timestamp_ms;
+  uint8_t level; /**< esp_log_level_t */
+  uint8_t argc;
+  dlog_arg_t args[DLOG_MAX_ARGS];
+} dlog_record_t;
+
+/**
+ * @brief Cost and loss accounting
+ */
+typedef struct {
+  uint32_t written;    /**< Records queued */
+  uint32_t dropped;    /**< Records lost to a full ring */
+  uint32_t formatted;  /**< Records printed by the formatter */
+  float write_cycles;  /**< Mean CPU cycles per DLOG_* call */
+  float format_cycles; /**< Mean CPU cycles to format and print a record */
+} dlog_stats_t;
+
+/**
+ * @brief Set up the record ring; until then DLOG_* lines print at once
+ * @return ESP_OK, or ESP_ERR_INVALID_ARG if the capacity is not a power of
+ *         two
+ */
+esp_err_t dlog_init(void);
+
+/**
+ * @brief Set up the ring if needed and start the formatter task
+ * @return ESP_OK on success, error code otherwise
+ */
+esp_err_t dlog_start(void);
+
+/**
+ * @brief Queue a log line; use the DLOG_* macros
+ * @param level Log level, dropped if above the tag's runtime level
+ * @param tag Static tag
+ * @param format Static printf format
+ */
+void dlog_write(esp_log_level_t level, const char *tag, const char *format,
+                ...);
+
+/**
+ * @brief Take the oldest queued record, for a consumer other than the
+ *        formatter task
+ * @param record Output
+ * @return true if a record was taken
+ */
+bool dlog_read(dlog_record_t *record);
+
+/**
+ * @brief Format a record's message, without the level, time and tag prefix
+ * @param record Record
+ * @param out Output buffer
+ * @param size Buffer size, the text is truncated to fit
+ * @return Characters written, excluding the terminator
+ */
+size_t dlog_format(const dlog_record_t *record, char *out, size_t size);
+
+/**
+ * @brief Snapshot the counters; means are approximate while both the
+ *        writer and the formatter are running
+ * @param stats Output
+ */
+void dlog_get_stats(dlog_stats_t *stats);
+
+#if CONFIG_DEFERRED_LOG
+#define DLOG_LEVEL(level, tag, format, ...)                                    \
+  do {                                                                         \
+    if (LOG_LOCAL_LEVEL >= (level)) {                                          \
+      dlog_write(level, tag, format, ##__VA_ARGS__);                           \
+    }                                                                          \
+  } while (0)
+#define DLOG_E(tag, format, ...)                                               \
+  DLOG_LEVEL(ESP_LOG_ERROR, tag, format, ##__VA_ARGS__)
+#define DLOG_W(tag, format, ...)                                               \
+  DLOG_LEVEL(ESP_LOG_WARN, tag, format, ##__VA_ARGS__)
+#define DLOG_I(tag, format, ...)                                               \
+  DLOG_LEVEL(ESP_LOG_INFO, tag, format, ##__VA_ARGS__)
+#else
+#define DLOG_E(tag, format, ...) ESP_LOGE(tag, format, ##__VA_ARGS__)
+#define DLOG_W(tag, format, ...) ESP_LOGW(tag, format, ##__VA_ARGS__)
+#define DLOG_I(tag, format, ...) ESP_LOGI(tag, format, ##__VA_ARGS__)
+#endif
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // DEFERRED_LOG_H
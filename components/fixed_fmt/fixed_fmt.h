@@ -0,0 +1,77 @@
+/**
+ * @file fixed_fmt.h
+ * @brief Print fractional values without newlib's float formatting
+ *
+ * newlib converts floats for printf through dtoa, which may allocate on any
+ * call, long after a task's first one. Tasks under the heap audit split a
+ * value into a sign and two integers instead and print it with FIXED_FMT:
+ *
+ *   fixed_fmt_t t = fixed_split(temperature, 2);
+ *   printf("T " FIXED_FMT " C", FIXED_ARGS(t));
+ */
+
+#ifndef FIXED_FMT_H
+#define FIXED_FMT_H
+
+#include <inttypes.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Most decimals a value can be split to
+#define FIXED_FMT_MAX_DECIMALS 6
+
+/**
+ * @brief A value split for FIXED_FMT
+ */
+typedef struct {
+  const char *sign; /**< "-" or "" */
+  uint32_t whole;
+  int decimals;
+  uint32_t fraction; /**< Printed as decimals digits */
+} fixed_fmt_t;
+
+#define FIXED_FMT "%s%" PRIu32 ".%0*" PRIu32
+#define FIXED_ARGS(f) (f).sign, (f).whole, (f).decimals, (f).fraction
+
+/**
+ * @brief Round a value to decimals places for FIXED_FMT
+ *
+ * Magnitudes whose scaled value does not fit 32 bits saturate, and NaN
+ * prints as zero; callers with such values check isfinite() first.
+ *
+ * @param value Value to print
+ * @param decimals 1 to FIXED_FMT_MAX_DECIMALS
+ */
+static inline fixed_fmt_t fixed_split(float value, int decimals) {
+  if (decimals < 1) {
+    decimals = 1;
+  } else if (decimals > FIXED_FMT_MAX_DECIMALS) {
+    decimals = FIXED_FMT_MAX_DECIMALS;
+  }
+  uint32_t scale = 1;
+  for (int i = 0; i < decimals; i++) {
+    scale *= 10;
+  }
+  float magnitude = value < 0.0f ? -value : value;
+  float scaled_f = magnitude * (float)scale + 0.5f;
+  // The largest float below 2^32
+  uint32_t scaled = scaled_f >= 4294967040.0f ? UINT32_MAX
+                    : scaled_f >= 1.0f        ? (uint32_t)scaled_f
+                                              : 0;
+  fixed_fmt_t f = {
+      .sign = value < 0.0f && scaled > 0 ? "-" : "",
+      .whole = scaled / scale,
+      .decimals = decimals,
+      .fraction = scaled % scale,
+  };
+  return f;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // FIXED_FMT_H
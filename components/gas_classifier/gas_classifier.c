@@ -0,0 +1,257 @@
+/**
+ * @file gas_classifier.c
+ * @brief Int8 MLP classifier for gas heater-profile fingerprints
+ */
+
+#include "gas_classifier.h"
+#include "esp_cpu.h"
+#include "esp_rom_crc.h"
+#include <string.h>
+
+#define BENCH_FINGERPRINTS 16
+
+static size_t align4(size_t n) { return (n + 3u) & ~(size_t)3u; }
+
+/**
+ * @brief log2(x) in Q16 by repeated squaring of the normalized mantissa
+ */
+static int32_t log2_q16(uint32_t x) {
+  int msb = 31 - __builtin_clz(x);
+  uint32_t m = x << (31 - msb); // Q1.31 in [1, 2)
+  int32_t result = msb << 16;
+
+  for (int bit = 15; bit >= 0; bit--) {
+    uint64_t sq = ((uint64_t)m * m) >> 31;
+    if (sq >= (1ull << 32)) {
+      m = (uint32_t)(sq >> 1);
+      result |= 1 << bit;
+    } else {
+      m = (uint32_t)sq;
+    }
+  }
+  return result;
+}
+
+static inline int8_t saturate_int8(int64_t v) {
+  if (v > INT8_MAX) {
+    return INT8_MAX;
+  }
+  if (v < INT8_MIN) {
+    return INT8_MIN;
+  }
+  return (int8_t)v;
+}
+
+esp_err_t gas_classifier_load(gas_classifier_t *clf, const void *blob,
+                              size_t size) {
+  if (clf == NULL || blob == NULL || ((uintptr_t)blob & 3u) != 0) {
+    return ESP_ERR_INVALID_ARG;
+  }
+  const gas_classifier_header_t *header = blob;
+  if (size < sizeof(*header) || header->magic != GAS_CLASSIFIER_MAGIC ||
+      header->version != GAS_CLASSIFIER_VERSION) {
+    return ESP_ERR_INVALID_VERSION;
+  }
+  if (header->size > size || header->size < sizeof(*header) + 4u ||
+      (header->size & 3u) != 0 || header->inputs == 0 ||
+      header->inputs > GAS_CLASSIFIER_MAX_INPUTS || header->layers == 0 ||
+      header->layers > GAS_CLASSIFIER_MAX_LAYERS || header->classes < 2 ||
+      header->classes > GAS_CLASSIFIER_MAX_CLASSES) {
+    return ESP_ERR_INVALID_SIZE;
+  }
+
+  const uint8_t *base = blob;
+  size_t crc_at = header->size - sizeof(uint32_t);
+  uint32_t crc;
+  memcpy(&crc, base + crc_at, sizeof(crc));
+  if (crc != esp_rom_crc32_le(0, base, crc_at)) {
+    return ESP_ERR_INVALID_CRC;
+  }
+
+  // Walk the layers, checking every section lies inside the blob
+  memset(clf, 0, sizeof(*clf));
+  size_t at = sizeof(*header);
+  clf->input_offset = (const int32_t *)(base + at);
+  at += header->inputs * sizeof(int32_t);
+  clf->input_scale = (const int32_t *)(base + at);
+  at += header->inputs * sizeof(int32_t);
+
+  uint8_t width = header->inputs;
+  for (int l = 0; l < header->layers; l++) {
+    if (at + sizeof(gas_classifier_layer_t) > crc_at) {
+      return ESP_ERR_INVALID_SIZE;
+    }
+    const gas_classifier_layer_t *layer =
+        (const gas_classifier_layer_t *)(base + at);
+    at += sizeof(*layer);
+    if (layer->inputs != width || layer->outputs == 0 ||
+        layer->outputs > GAS_CLASSIFIER_MAX_WIDTH || layer->shift > 31 ||
+        layer->multiplier < (1 << 30)) {
+      return ESP_ERR_INVALID_SIZE;
+    }
+    clf->layer[l] = layer;
+    clf->weights[l] = (const int8_t *)(base + at);
+    at += align4((size_t)layer->inputs * layer->outputs);
+    clf->bias[l] = (const int32_t *)(base + at);
+    at += layer->outputs * sizeof(int32_t);
+    width = layer->outputs;
+  }
+  if (at != crc_at || width != header->classes ||
+      clf->layer[header->layers - 1]->relu) {
+    return ESP_ERR_INVALID_SIZE;
+  }
+  for (int k = 0; k < header->classes; k++) {
+    if (header->class_names[k][GAS_CLASSIFIER_NAME_LEN - 1] != '\0') {
+      return ESP_ERR_INVALID_SIZE;
+    }
+  }
+
+  clf->header = header;
+  return ESP_OK;
+}
+
+esp_err_t gas_classifier_features(const uint32_t *fingerprint, size_t steps,
+                                  int32_t *features) {
+  if (fingerprint == NULL || features == NULL || steps == 0 ||
+      steps > GAS_CLASSIFIER_MAX_INPUTS) {
+    return ESP_ERR_INVALID_ARG;
+  }
+
+  int32_t sum = 0;
+  for (size_t i = 0; i < steps; i++) {
+    if (fingerprint[i] == 0) {
+      return ESP_ERR_INVALID_ARG;
+    }
+    features[i] = log2_q16(fingerprint[i]);
+    sum += features[i];
+  }
+  int32_t mean = sum / (int32_t)steps;
+  for (size_t i = 0; i < steps; i++) {
+    features[i] -= mean;
+  }
+  return ESP_OK;
+}
+
+/**
+ * @brief One fully connected layer on int8 activations
+ */
+static void run_layer(const gas_classifier_t *clf, int l, const int8_t *in,
+                      int8_t *out) {
+  const gas_classifier_layer_t *layer = clf->layer[l];
+  const int8_t *w = clf->weights[l];
+  int64_t half = (int64_t)1 << (30 + layer->shift);
+
+  for (int o = 0; o < layer->outputs; o++) {
+    int32_t acc = clf->bias[l][o];
+    for (int i = 0; i < layer->inputs; i++) {
+      acc += (int32_t)w[i] * in[i];
+    }
+    w += layer->inputs;
+
+    int64_t v = ((int64_t)acc * layer->multiplier + half) >>
+                (31 + layer->shift);
+    if (layer->relu && v < 0) {
+      v = 0;
+    }
+    out[o] = saturate_int8(v);
+  }
+}
+
+esp_err_t gas_classifier_run(const gas_classifier_t *clf,
+                             const uint32_t *fingerprint, size_t steps,
+                             gas_classifier_result_t *result) {
+  if (clf == NULL || clf->header == NULL || result == NULL ||
+      steps != clf->header->inputs) {
+    return ESP_ERR_INVALID_ARG;
+  }
+
+  int32_t features[GAS_CLASSIFIER_MAX_INPUTS];
+  esp_err_t err = gas_classifier_features(fingerprint, steps, features);
+  if (err != ESP_OK) {
+    return err;
+  }
+
+  // Ping-pong between two activation buffers on the stack
+  int8_t act[2][GAS_CLASSIFIER_MAX_WIDTH];
+  for (size_t i = 0; i < steps; i++) {
+    int64_t q = ((int64_t)(features[i] - clf->input_offset[i]) *
+                     clf->input_scale[i] +
+                 ((int64_t)1 << 31)) >>
+                32;
+    act[0][i] = saturate_int8(q);
+  }
+  int cur = 0;
+  for (int l = 0; l < clf->header->layers; l++) {
+    run_layer(clf, l, act[cur], act[cur ^ 1]);
+    cur ^= 1;
+  }
+
+  const int8_t *logits = act[cur];
+  int best = 0;
+  int second = -1;
+  for (int c = 1; c < clf->header->classes; c++) {
+    if (logits[c] > logits[best]) {
+      second = best;
+      best = c;
+    } else if (second < 0 || logits[c] > logits[second]) {
+      second = c;
+    }
+  }
+
+  memset(result, 0, sizeof(*result));
+  memcpy(result->logits, logits, clf->header->classes);
+  result->class_id = (uint8_t)best;
+  result->margin = (int16_t)(logits[best] - logits[second]);
+  return ESP_OK;
+}
+
+const char *gas_classifier_class_name(const gas_classifier_t *clf,
+                                      uint8_t class_id) {
+  if (clf == NULL || clf->header == NULL ||
+      class_id >= clf->header->classes) {
+    return "";
+  }
+  return clf->header->class_names[class_id];
+}
+
+esp_err_t gas_classifier_benchmark(const gas_classifier_t *clf,
+                                   uint32_t inferences,
+                                   gas_classifier_benchmark_t *bench) {
+  if (clf == NULL || clf->header == NULL || inferences == 0 ||
+      bench == NULL) {
+    return ESP_ERR_INVALID_ARG;
+  }
+
+  // Resistances from 1 kOhm to 1 MOhm, independent of the model
+  uint32_t fingerprints[BENCH_FINGERPRINTS][GAS_CLASSIFIER_MAX_INPUTS];
+  uint32_t lcg = 12345;
+  for (int f = 0; f < BENCH_FINGERPRINTS; f++) {
+    for (int i = 0; i < GAS_CLASSIFIER_MAX_INPUTS; i++) {
+      lcg = lcg * 1664525u + 1013904223u;
+      fingerprints[f][i] = 1000u + (lcg >> 12) % 999000u;
+    }
+  }
+
+  size_t steps = clf->header->inputs;
+  gas_classifier_result_t result;
+  memset(bench, 0, sizeof(*bench));
+  bench->inferences = inferences;
+
+  // Checksum pass, then the timed pass without it
+  for (int f = 0; f < BENCH_FINGERPRINTS; f++) {
+    gas_classifier_run(clf, fingerprints[f], steps, &result);
+    bench->checksum = esp_rom_crc32_le(bench->checksum,
+                                       (const uint8_t *)&result,
+                                       sizeof(result));
+  }
+
+  esp_cpu_cycle_count_t start = esp_cpu_get_cycle_count();
+  for (uint32_t n = 0; n < inferences; n++) {
+    gas_classifier_run(clf, fingerprints[n % BENCH_FINGERPRINTS], steps,
+                       &result);
+  }
+  esp_cpu_cycle_count_t elapsed = esp_cpu_get_cycle_count() - start;
+  bench->cycles = (float)elapsed / (float)inferences;
+
+  return ESP_OK;
+}
@@ -0,0 +1,178 @@
+/**
+ * @file gas_classifier.h
+ * @brief Int8 MLP classifier for gas heater-profile fingerprints
+ *
+ * A fingerprint is the gas resistance read at each step of a heater
+ * temperature scan. Its shape across the steps depends on what the sensor
+ * is exposed to, while its overall level mostly tracks the concentration,
+ * so the classifier sees log2 resistances with their mean removed.
+ *
+ * Inference is integer-only: int8 weights and activations, int32
+ * accumulators and fixed-point requantization. Host and target builds
+ * therefore produce bit-identical outputs. The model is used in place from
+ * a read-only blob, typically memory-mapped flash; nothing is copied or
+ * allocated.
+ */
+
+#ifndef GAS_CLASSIFIER_H
+#define GAS_CLASSIFIER_H
+
+#include "esp_err.h"
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define GAS_CLASSIFIER_MAGIC 0x534C4347 // "GCLS" little-endian
+#define GAS_CLASSIFIER_VERSION 1
+#define GAS_CLASSIFIER_MAX_INPUTS 16 /**< Heater steps per fingerprint */
+#define GAS_CLASSIFIER_MAX_WIDTH 32  /**< Neurons per layer */
+#define GAS_CLASSIFIER_MAX_LAYERS 4
+#define GAS_CLASSIFIER_MAX_CLASSES 8
+#define GAS_CLASSIFIER_NAME_LEN 16
+
+/**
+ * @brief Model blob header
+ *
+ * The blob is little-endian and 4-byte aligned throughout:
+ * - this header
+ * - int32_t input_offset[inputs], feature offsets in Q16 log2 units
+ * - int32_t input_scale[inputs], int8 input steps per log2 unit, Q16
+ * - per layer: gas_classifier_layer_t, int8_t weights[outputs][inputs]
+ *   padded to 4 bytes, int32_t bias[outputs]
+ * - uint32_t CRC32 of all preceding bytes
+ */
+typedef struct {
+  uint32_t magic;   /**< GAS_CLASSIFIER_MAGIC */
+  uint16_t version; /**< GAS_CLASSIFIER_VERSION */
+  uint16_t reserved;
+  uint32_t size; /**< Blob size in bytes, CRC included */
+  uint8_t inputs;
+  uint8_t layers;
+  uint8_t classes;
+  uint8_t reserved2;
+  char class_names[GAS_CLASSIFIER_MAX_CLASSES][GAS_CLASSIFIER_NAME_LEN];
+} gas_classifier_header_t;
+
+/**
+ * @brief Fully connected layer header
+ *
+ * The int32 accumulator of each output is rescaled to int8 by
+ * multiplier * 2^-(31 + shift), rounded to nearest with halves up, and
+ * saturated.
+ */
+typedef struct {
+  uint8_t inputs;
+  uint8_t outputs;
+  uint8_t relu; /**< Apply ReLU to the outputs */
+  uint8_t shift;
+  int32_t multiplier; /**< Q31, in [2^30, 2^31) */
+} gas_classifier_layer_t;
+
+/**
+ * @brief Loaded model, pointing into the blob
+ */
+typedef struct {
+  const gas_classifier_header_t *header;
+  const int32_t *input_offset;
+  const int32_t *input_scale;
+  const gas_classifier_layer_t *layer[GAS_CLASSIFIER_MAX_LAYERS];
+  const int8_t *weights[GAS_CLASSIFIER_MAX_LAYERS];
+  const int32_t *bias[GAS_CLASSIFIER_MAX_LAYERS];
+} gas_classifier_t;
+
+/**
+ * @brief Classification of one fingerprint
+ */
+typedef struct {
+  uint8_t class_id;
+  int8_t logits[GAS_CLASSIFIER_MAX_CLASSES];
+  int16_t margin; /**< Top logit minus the runner-up, 0..255 */
+} gas_classifier_result_t;
+
+/**
+ * @brief Inference benchmark results
+ *
+ * The checksum covers every output and only depends on the model, so equal
+ * checksums from two builds show that they compute identical results.
+ */
+typedef struct {
+  uint32_t inferences;
+  float cycles; /**< CPU cycles per inference */
+  uint32_t checksum;
+} gas_classifier_benchmark_t;
+
+/**
+ * @brief Validate a model blob and point a classifier at it
+ *
+ * The blob must stay valid while the classifier is used.
+ *
+ * @param clf Classifier to set up
+ * @param blob Model blob, 4-byte aligned
+ * @param size Bytes available at blob; may exceed the model size
+ * @return ESP_OK on success, ESP_ERR_INVALID_ARG for a misaligned blob,
+ *         ESP_ERR_INVALID_VERSION for a foreign or newer blob,
+ *         ESP_ERR_INVALID_SIZE if it is truncated or exceeds the limits,
+ *         ESP_ERR_INVALID_CRC if it is corrupt
+ */
+esp_err_t gas_classifier_load(gas_classifier_t *clf, const void *blob,
+                              size_t size);
+
+/**
+ * @brief Load the model stored in the "gas_model" data partition
+ *
+ * The partition is memory-mapped and stays mapped. Target builds only.
+ *
+ * @param clf Classifier to set up
+ * @return ESP_OK on success, ESP_ERR_NOT_FOUND without the partition,
+ *         otherwise as gas_classifier_load()
+ */
+esp_err_t gas_classifier_load_partition(gas_classifier_t *clf);
+
+/**
+ * @brief Mean-free log2 resistances of a fingerprint, as classifier inputs
+ * @param fingerprint Gas resistance per heater step, Ohms
+ * @param steps Number of steps, at most GAS_CLASSIFIER_MAX_INPUTS
+ * @param features Output, Q16 log2 units
+ * @return ESP_OK, or ESP_ERR_INVALID_ARG for zero readings or step counts
+ */
+esp_err_t gas_classifier_features(const uint32_t *fingerprint, size_t steps,
+                                  int32_t *features);
+
+/**
+ * @brief Classify one fingerprint
+ * @param clf Loaded classifier
+ * @param fingerprint Gas resistance per heater step, Ohms
+ * @param steps Number of steps, must match the model
+ * @param result Output
+ * @return ESP_OK, or ESP_ERR_INVALID_ARG for a mismatched or invalid
+ *         fingerprint
+ */
+esp_err_t gas_classifier_run(const gas_classifier_t *clf,
+                             const uint32_t *fingerprint, size_t steps,
+                             gas_classifier_result_t *result);
+
+/**
+ * @brief Name of a class, "" if out of range
+ */
+const char *gas_classifier_class_name(const gas_classifier_t *clf,
+                                      uint8_t class_id);
+
+/**
+ * @brief Time inference on deterministic pseudo-random fingerprints
+ * @param clf Loaded classifier
+ * @param inferences Number of inferences to run
+ * @param bench Output
+ * @return ESP_OK on success
+ */
+esp_err_t gas_classifier_benchmark(const gas_classifier_t *clf,
+                                   uint32_t inferences,
+                                   gas_classifier_benchmark_t *bench);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // GAS_CLASSIFIER_H
@@ -0,0 +1,44 @@
+/**
+ * @file gas_classifier_partition.c
+ * @brief Loading the classifier model from its flash partition
+ *
+ * Kept apart from gas_classifier.c, which has no ESP-IDF dependencies
+ * beyond the error codes and also builds on the host.
+ */
+
+#include "esp_log.h"
+#include "esp_partition.h"
+#include "gas_classifier.h"
+#include <inttypes.h>
+
+static const char *TAG = "GAS_CLF";
+
+#define GAS_MODEL_PARTITION "gas_model"
+
+esp_err_t gas_classifier_load_partition(gas_classifier_t *clf) {
+  const esp_partition_t *part = esp_partition_find_first(
+      ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY, GAS_MODEL_PARTITION);
+  if (part == NULL) {
+    return ESP_ERR_NOT_FOUND;
+  }
+
+  // Mapped once for the lifetime of the firmware; the handle is not needed
+  const void *blob;
+  esp_partition_mmap_handle_t handle;
+  esp_err_t err = esp_partition_mmap(part, 0, part->size,
+                                     ESP_PARTITION_MMAP_DATA, &blob, &handle);
+  if (err != ESP_OK) {
+    ESP_LOGE(TAG, "Failed to map model partition: %s", esp_err_to_name(err));
+    return err;
+  }
+
+  err = gas_classifier_load(clf, blob, part->size);
+  if (err != ESP_OK) {
+    esp_partition_munmap(handle);
+    return err;
+  }
+  ESP_LOGI(TAG, "Model: %u inputs, %u layers, %u classes, %" PRIu32 " bytes",
+           clf->header->inputs, clf->header->layers, clf->header->classes,
+           clf->header->size);
+  return ESP_OK;
+}
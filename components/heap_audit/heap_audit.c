@@ -0,0 +1,141 @@
+/**
+ * @file heap_audit.c
+ * @brief Heap hooks counting operations by enrolled task
+ */
+
+#include "heap_audit.h"
+
+#if CONFIG_HEAP_AUDIT
+
+#include "esp_attr.h"
+#include "esp_heap_caps.h"
+#include "esp_log.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdlib.h>
+
+static const char *TAG = "HEAP_AUDIT";
+
+/**
+ * @brief One enrolled task
+ *
+ * The hooks only run in the context of the allocating task, so each
+ * counter has a single writer, the task itself.
+ */
+typedef struct {
+  TaskHandle_t task;
+  const char *name;
+  uint32_t cycles;
+  uint32_t allocs;
+  uint32_t frees;
+  uint32_t checked_ops; /**< allocs + frees when the last cycle ended */
+  uint32_t steady_ops;
+} audit_slot_t;
+
+static audit_slot_t s_slots[HEAP_AUDIT_MAX_TASKS];
+// Slots below it are fully written; the hooks scan without a lock
+static uint32_t s_count;
+static portMUX_TYPE s_enrol_lock = portMUX_INITIALIZER_UNLOCKED;
+static bool s_full_reported;
+
+static IRAM_ATTR audit_slot_t *current_slot(void) {
+  if (xPortInIsrContext()) {
+    return NULL;
+  }
+  TaskHandle_t task = xTaskGetCurrentTaskHandle();
+  uint32_t count = __atomic_load_n(&s_count, __ATOMIC_ACQUIRE);
+  for (uint32_t i = 0; i < count; i++) {
+    if (s_slots[i].task == task) {
+      return &s_slots[i];
+    }
+  }
+  return NULL;
+}
+
+void IRAM_ATTR esp_heap_trace_alloc_hook(void *ptr, size_t size,
+                                         uint32_t caps) {
+  (void)size;
+  (void)caps;
+  audit_slot_t *slot;
+  if (ptr != NULL && (slot = current_slot()) != NULL) {
+    __atomic_store_n(&slot->allocs, slot->allocs + 1, __ATOMIC_RELAXED);
+  }
+}
+
+void IRAM_ATTR esp_heap_trace_free_hook(void *ptr) {
+  audit_slot_t *slot;
+  if (ptr != NULL && (slot = current_slot()) != NULL) {
+    __atomic_store_n(&slot->frees, slot->frees + 1, __ATOMIC_RELAXED);
+  }
+}
+
+static void enrol(void) {
+  bool enrolled = false;
+
+  taskENTER_CRITICAL(&s_enrol_lock);
+  uint32_t count = s_count;
+  if (count < HEAP_AUDIT_MAX_TASKS) {
+    audit_slot_t *slot = &s_slots[count];
+    slot->task = xTaskGetCurrentTaskHandle();
+    slot->name = pcTaskGetName(NULL);
+    __atomic_store_n(&s_count, count + 1, __ATOMIC_RELEASE);
+    enrolled = true;
+  }
+  taskEXIT_CRITICAL(&s_enrol_lock);
+
+  if (enrolled) {
+    ESP_LOGI(TAG, "Auditing %s after %d cycles", pcTaskGetName(NULL),
+             CONFIG_HEAP_AUDIT_WARMUP_CYCLES);
+  } else if (!s_full_reported) {
+    s_full_reported = true;
+    ESP_LOGW(TAG, "More than %d tasks, %s not audited", HEAP_AUDIT_MAX_TASKS,
+             pcTaskGetName(NULL));
+  }
+}
+
+void heap_audit_cycle(void) {
+  audit_slot_t *slot = current_slot();
+  if (slot == NULL) {
+    enrol();
+    return;
+  }
+
+  uint32_t ops = slot->allocs + slot->frees;
+  uint32_t cycle_ops = ops - slot->checked_ops;
+  slot->checked_ops = ops;
+  uint32_t cycle = slot->cycles + 1;
+  __atomic_store_n(&slot->cycles, cycle, __ATOMIC_RELAXED);
+  if (cycle_ops == 0 || cycle <= CONFIG_HEAP_AUDIT_WARMUP_CYCLES) {
+    return;
+  }
+
+  __atomic_store_n(&slot->steady_ops, slot->steady_ops + cycle_ops,
+                   __ATOMIC_RELAXED);
+  ESP_LOGE(TAG, "%s made %" PRIu32 " heap operations in cycle %" PRIu32,
+           slot->name, cycle_ops, cycle);
+#if CONFIG_HEAP_AUDIT_ABORT
+  abort();
+#endif
+}
+
+size_t heap_audit_task_count(void) {
+  return __atomic_load_n(&s_count, __ATOMIC_ACQUIRE);
+}
+
+esp_err_t heap_audit_get_stats(size_t index, heap_audit_stats_t *stats) {
+  if (stats == NULL || index >= heap_audit_task_count()) {
+    return ESP_ERR_INVALID_ARG;
+  }
+
+  const audit_slot_t *slot = &s_slots[index];
+  stats->name = slot->name;
+  stats->cycles = __atomic_load_n(&slot->cycles, __ATOMIC_RELAXED);
+  stats->allocs = __atomic_load_n(&slot->allocs, __ATOMIC_RELAXED);
+  stats->frees = __atomic_load_n(&slot->frees, __ATOMIC_RELAXED);
+  stats->steady_ops = __atomic_load_n(&slot->steady_ops, __ATOMIC_RELAXED);
+  return ESP_OK;
+}
+
+#endif // CONFIG_HEAP_AUDIT
@@ -0,0 +1,81 @@
+/**
+ * @file heap_audit.h
+ * @brief Per-task heap operation counter for allocation-free loops
+ *
+ * With CONFIG_HEAP_AUDIT the heap hooks count every malloc and free by
+ * task. A periodic task calls heap_audit_cycle() at the end of each cycle;
+ * the first call enrols the task and every later one checks that the cycle
+ * made no heap operation. After CONFIG_HEAP_AUDIT_WARMUP_CYCLES cycles an
+ * operation is a failure: it is logged and counted, and aborts with
+ * CONFIG_HEAP_AUDIT_ABORT.
+ *
+ * Without CONFIG_HEAP_AUDIT the calls compile to nothing.
+ */
+
+#ifndef HEAP_AUDIT_H
+#define HEAP_AUDIT_H
+
+#include "esp_err.h"
+#include "sdkconfig.h"
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define HEAP_AUDIT_MAX_TASKS 8
+
+/**
+ * @brief Counters of one enrolled task
+ */
+typedef struct {
+  const char *name; /**< Task name */
+  uint32_t cycles;
+  uint32_t allocs; /**< Since enrolment */
+  uint32_t frees;
+  uint32_t steady_ops; /**< Heap operations after the warm-up */
+} heap_audit_stats_t;
+
+#if CONFIG_HEAP_AUDIT
+
+/**
+ * @brief End one cycle of the calling task, enrolling it on the first call
+ *
+ * Fails if the cycle made a heap operation after the warm-up.
+ */
+void heap_audit_cycle(void);
+
+/**
+ * @brief Number of enrolled tasks
+ */
+size_t heap_audit_task_count(void);
+
+/**
+ * @brief Snapshot the counters of one enrolled task; any task
+ * @param index 0..heap_audit_task_count() - 1
+ * @param stats Output
+ * @return ESP_OK, or ESP_ERR_INVALID_ARG for a bad index
+ */
+esp_err_t heap_audit_get_stats(size_t index, heap_audit_stats_t *stats);
+
+#else
+
+static inline void heap_audit_cycle(void) {}
+
+static inline size_t heap_audit_task_count(void) { return 0; }
+
+static inline esp_err_t heap_audit_get_stats(size_t index,
+                                             heap_audit_stats_t *stats) {
+  (void)index;
+  (void)stats;
+  return ESP_ERR_NOT_SUPPORTED;
+}
+
+#endif
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // HEAP_AUDIT_H
@@ -0,0 +1,68 @@
+/**
+ * @file iaq_ah_table.c
+ * @brief Absolute humidity per %RH versus temperature (Magnus relation)
+ *
+ * Generated by tools/gen_ah_table.py, do not edit.
+ */
+
+#include "iaq_humidity.h"
+
+// Sampled every degree from -40 to 85 degC, g/m3 per %RH
+const float iaq_ah_per_rh[] = {
+    1.7682415e-03f, 1.9523360e-03f, 2.1534656e-03f, 2.3730015e-03f,
+    2.6124079e-03f, 2.8732465e-03f, 3.1571825e-03f, 3.4659891e-03f,
+    3.8015538e-03f, 4.1658836e-03f, 4.5611113e-03f, 4.9895015e-03f,
+    5.4534570e-03f, 5.9555255e-03f, 6.4984060e-03f, 7.0849562e-03f,
+    7.7181992e-03f, 8.4013315e-03f, 9.1377300e-03f, 9.9309603e-03f,
+    1.0784784e-02f, 1.1703169e-02f, 1.2690293e-02f, 1.3750560e-02f,
+    1.4888601e-02f, 1.6109289e-02f, 1.7417745e-02f, 1.8819349e-02f,
+    2.0319748e-02f, 2.1924870e-02f, 2.3640929e-02f, 2.5474439e-02f,
+    2.7432221e-02f, 2.9521419e-02f, 3.1749505e-02f, 3.4124294e-02f,
+    3.6653956e-02f, 3.9347024e-02f, 4.2212406e-02f, 4.5259401e-02f,
+    4.8497707e-02f, 5.1937436e-02f, 5.5589122e-02f, 5.9463740e-02f,
+    6.3572712e-02f, 6.7927925e-02f, 7.2541742e-02f, 7.7427015e-02f,
+    8.2597098e-02f, 8.8065863e-02f, 9.3847709e-02f, 9.9957579e-02f,
+    1.0641097e-01f, 1.1322397e-01f, 1.2041322e-01f, 1.2799597e-01f,
+    1.3599011e-01f, 1.4441412e-01f, 1.5328716e-01f, 1.6262900e-01f,
+    1.7246013e-01f, 1.8280169e-01f, 1.9367554e-01f, 2.0510425e-01f,
+    2.1711112e-01f, 2.2972019e-01f, 2.4295626e-01f, 2.5684493e-01f,
+    2.7141255e-01f, 2.8668629e-01f, 3.0269415e-01f, 3.1946496e-01f,
+    3.3702838e-01f, 3.5541496e-01f, 3.7465611e-01f, 3.9478414e-01f,
+    4.1583226e-01f, 4.3783463e-01f, 4.6082630e-01f, 4.8484332e-01f,
+    5.0992268e-01f, 5.3610234e-01f, 5.6342128e-01f, 5.9191948e-01f,
+    6.2163793e-01f, 6.5261867e-01f, 6.8490479e-01f, 7.1854045e-01f,
+    7.5357086e-01f, 7.9004235e-01f, 8.2800235e-01f, 8.6749939e-01f,
+    9.0858315e-01f, 9.5130445e-01f, 9.9571526e-01f, 1.0418687e+00f,
+    1.0898191e+00f, 1.1396220e+00f, 1.1913341e+00f, 1.2450134e+00f,
+    1.3007189e+00f, 1.3585112e+00f, 1.4184518e+00f, 1.4806036e+00f,
+    1.5450309e+00f, 1.6117992e+00f, 1.6809751e+00f, 1.7526267e+00f,
+    1.8268234e+00f, 1.9036359e+00f, 1.9831363e+00f, 2.0653978e+00f,
+    2.1504952e+00f, 2.2385045e+00f, 2.3295033e+00f, 2.4235701e+00f,
+    2.5207854e+00f, 2.6212305e+00f, 2.7249886e+00f, 2.8321438e+00f,
+    2.9427820e+00f, 3.0569904e+00f, 3.1748576e+00f, 3.2964735e+00f,
+    3.4219297e+00f, 3.5513189e+00f,
+};
+_Static_assert(sizeof(iaq_ah_per_rh) == IAQ_AH_TABLE_LEN * sizeof(float),
+               "table does not match iaq_humidity.h");
+
+// Same table in Q20
+const int32_t iaq_ah_per_rh_q20[] = {
+    1854, 2047, 2258, 2488, 2739, 3013, 3311, 3634,
+    3986, 4368, 4783, 5232, 5718, 6245, 6814, 7429,
+    8093, 8809, 9582, 10413, 11309, 12272, 13307, 14419,
+    15612, 16892, 18264, 19734, 21307, 22990, 24789, 26712,
+    28765, 30955, 33292, 35782, 38434, 41258, 44263, 47458,
+    50854, 54460, 58289, 62352, 66661, 71228, 76066, 81188,
+    86609, 92344, 98406, 104813, 111580, 118724, 126262, 134214,
+    142596, 151429, 160733, 170529, 180838, 191681, 203084, 215067,
+    227658, 240879, 254758, 269321, 284597, 300612, 317398, 334983,
+    353400, 372680, 392855, 413961, 436032, 459103, 483211, 508395,
+    534693, 562144, 590790, 620673, 651835, 684320, 718175, 753444,
+    790176, 828419, 868223, 909639, 952718, 997515, 1044083, 1092479,
+    1142758, 1194980, 1249204, 1305491, 1363903, 1424502, 1487354, 1552525,
+    1620082, 1690094, 1762630, 1837762, 1915563, 1996107, 2079469, 2165727,
+    2254958, 2347242, 2442661, 2541297, 2643235, 2748559, 2857358, 2969718,
+    3085731, 3205487, 3329079, 3456603, 3588153, 3723828,
+};
+_Static_assert(sizeof(iaq_ah_per_rh_q20) == IAQ_AH_TABLE_LEN * sizeof(int32_t),
+               "table does not match iaq_humidity.h");
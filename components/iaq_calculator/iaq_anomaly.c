@@ -0,0 +1,65 @@
+/**
+ * @file iaq_anomaly.c
+ * @brief EWMA z-score anomaly detector implementation
+ */
+
+#include "iaq_anomaly.h"
+#include <math.h>
+
+void iaq_ewma_init(iaq_ewma_t *ewma, uint32_t window, float threshold,
+                   float min_std, float min_rel_std) {
+  ewma->mean = 0.0f;
+  ewma->var = 0.0f;
+  ewma->alpha = 2.0f / ((float)window + 1.0f);
+  ewma->steps = 1.0f;
+  ewma->step_alpha = ewma->alpha;
+  ewma->limit_sq = threshold * threshold;
+  ewma->min_var = min_std * min_std;
+  ewma->min_rel_sq = min_rel_std * min_rel_std;
+  ewma->dev = 0.0f;
+  ewma->dev_var = 1.0f;
+  ewma->count = 0;
+  ewma->warmup = (window > 1) ? window : 2;
+}
+
+bool iaq_ewma_update(iaq_ewma_t *ewma, float x, float steps) {
+  if (ewma->count == 0) {
+    ewma->mean = x;
+    ewma->count = 1;
+    return false;
+  }
+
+  float dev = x - ewma->mean;
+  float var = ewma->var + ewma->min_var +
+              ewma->min_rel_sq * ewma->mean * ewma->mean;
+  float dev_sq = dev * dev;
+  bool flagged = false;
+  ewma->dev = dev;
+  ewma->dev_var = var;
+
+  if (ewma->count >= ewma->warmup && dev_sq > ewma->limit_sq * var) {
+    // Clip to the threshold so one spike cannot drag the estimates along
+    float clip = sqrtf(ewma->limit_sq * var / dev_sq);
+    dev *= clip;
+    dev_sq = dev * dev;
+    flagged = true;
+  }
+
+  // West's incremental update of the weighted mean and variance, with the
+  // weight a run of steps evenly spaced samples would have had together
+  if (steps != ewma->steps) {
+    ewma->step_alpha = 1.0f - powf(1.0f - ewma->alpha, steps);
+    ewma->steps = steps;
+  }
+  float alpha = ewma->step_alpha;
+  ewma->mean += alpha * dev;
+  ewma->var = (1.0f - alpha) * (ewma->var + alpha * dev_sq);
+  if (ewma->count < ewma->warmup) {
+    ewma->count++;
+  }
+  return flagged;
+}
+
+float iaq_ewma_score(const iaq_ewma_t *ewma) {
+  return fabsf(ewma->dev) / sqrtf(ewma->dev_var);
+}
@@ -0,0 +1,79 @@
+/**
+ * @file iaq_anomaly.h
+ * @brief Streaming EWMA z-score anomaly detector for one sensor channel
+ */
+
+#ifndef IAQ_ANOMALY_H
+#define IAQ_ANOMALY_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Exponentially weighted mean and variance with a z-score test
+ *
+ * A sample is flagged when it lies more than threshold standard deviations
+ * from the mean of the samples before it. Flagged samples still update the
+ * estimates, clipped to the threshold, so a spike barely moves them while a
+ * genuine level change is absorbed within a few samples.
+ *
+ * Samples are tested against the variance plus min_std^2 +
+ * (min_rel_std * mean)^2, which keeps a channel that sits still, or reads
+ * in coarse steps, from flagging its own resolution. Fixed memory and a few
+ * multiply-adds per sample; only flagged samples take a square root.
+ */
+typedef struct {
+  float mean;
+  float var;
+  float alpha;      /**< Weight of the newest sample */
+  float steps;      /**< Steps of the last sample */
+  float step_alpha; /**< Weight for steps, cached since powf is slow */
+  float limit_sq;   /**< Squared threshold */
+  float min_var;    /**< Absolute variance floor */
+  float min_rel_sq; /**< Variance floor relative to mean^2 */
+  float dev;        /**< Deviation of the last sample from the prior mean */
+  float dev_var;    /**< Variance the last sample was tested against */
+  uint32_t count;   /**< Samples seen, saturating at warmup */
+  uint32_t warmup;  /**< Samples seen before flagging starts */
+} iaq_ewma_t;
+
+/**
+ * @brief Initialize a detector
+ * @param ewma Detector to initialize
+ * @param window EWMA length in nominal sample intervals, alpha = 2 /
+ *               (window + 1) per interval; also the warm-up, in samples,
+ *               before anything is flagged
+ * @param threshold Z-score beyond which a sample is flagged
+ * @param min_std Absolute floor of the standard deviation
+ * @param min_rel_std Floor of the standard deviation relative to the mean
+ */
+void iaq_ewma_init(iaq_ewma_t *ewma, uint32_t window, float threshold,
+                   float min_std, float min_rel_std);
+
+/**
+ * @brief Test one sample and add it to the estimates
+ * @param ewma Detector
+ * @param x Sample
+ * @param steps Time since the previous sample in nominal intervals, 1 for
+ *              evenly spaced samples; weights the sample by the time it
+ *              stands for, so the window spans the same time at any rate;
+ *              a run of equal steps reuses one cached weight
+ * @return true if x is an anomaly
+ */
+bool iaq_ewma_update(iaq_ewma_t *ewma, float x, float steps);
+
+/**
+ * @brief Absolute z-score of the last sample, 0 before the second sample
+ * @param ewma Detector
+ */
+float iaq_ewma_score(const iaq_ewma_t *ewma);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // IAQ_ANOMALY_H
@@ -4,179 +4,339 @@
  */
 
 #include "iaq_calculator.h"
+#include "iaq_anomaly.h"
+#include "esp_cpu.h"
 #include "esp_log.h"
+#include "esp_rom_crc.h"
+#include "esp_timer.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/semphr.h"
+#include "iaq_fixed.h"
+#include "iaq_humidity.h"
+#include "iaq_outlier.h"
+#include "iaq_params.h"
+#include "iaq_quantile.h"
+#include "iaq_rls.h"
+#include "iaq_trend.h"
+#include "iaq_window.h"
 #include "nvs.h"
 #include "nvs_flash.h"
+#include "sdkconfig.h"
 #include <inttypes.h>
 #include <math.h>
 #include <string.h>
+#include <time.h>
 
 static const char *TAG = "IAQ_CALC";
 
-#define GAS_BASELINE_DEFAULT 250000.0f
+_Static_assert(sizeof(iaq_ctx_t) <= IAQ_CTX_MAX_SIZE,
+               "iaq_ctx_t outgrew its size budget");
+
 #define GAS_EXCELLENT_THRESHOLD 500000.0f
 #define GAS_GOOD_THRESHOLD 200000.0f
 #define GAS_MODERATE_THRESHOLD 100000.0f
 #define GAS_POOR_THRESHOLD 50000.0f
 #define GAS_VERY_POOR_THRESHOLD 20000.0f
-#define TEMP_COMP_COEFF 0.003f
-#define HUM_COMP_COEFF 0.015f
-#define CO2_BASE 400.0f
-#define CO2_MAX 2000.0f
-#define CO2_SLOPE 5.0f
-#define VOC_BASE 0.0f
-#define VOC_MAX 10.0f
-#define VOC_SLOPE 0.015f
 #define DEFAULT_BURN_IN_SAMPLES 50
 #define CALIBRATION_RATE_DEFAULT 0.001f
-#define GAS_HISTORY_SIZE 10
+#define BASELINE_PERCENTILE_DEFAULT 0.90f
+#define BASELINE_HORIZON_DEFAULT (4 * 24 * 360) // 4 days at 10 s per sample
+#define BASELINE_SHORT_HORIZON_DEFAULT (6 * 360) // 6 hours
+// Relative gap between the baselines that accumulates no change evidence
+#define CHANGE_DRIFT 0.15f
+#define CHANGE_LIMIT_UP_DEFAULT 20.0f
+#define CHANGE_LIMIT_DOWN_DEFAULT 4000.0f
+// Longest gap between readings counted as observed time, in nominal
+// intervals; a device that read nothing for longer saw nothing meanwhile
+#define SAMPLE_STEPS_MAX 6
+#define IAQ_BATCH_CHUNK 32
+#define IAQ_BENCH_BLOCK 64
 #define NVS_NAMESPACE "iaq_state"
 #define NVS_KEY_BASELINE "gas_base"
 #define NVS_KEY_SAMPLES "samples"
+#define NVS_KEY_STATE "state"
+#define RESTORE_GRACE_DEFAULT (2 * 3600)
+#define RESTORE_DECAY_DEFAULT (24 * 3600)
+// Off-time assumed without a clock: past the grace period, but short
+// enough that the credit (about 0.6) still keeps the baseline tracker
+#define RESTORE_UNKNOWN_AGE_DEFAULT \
+  (RESTORE_GRACE_DEFAULT + RESTORE_DECAY_DEFAULT / 2)
+// Below this calibration credit the tracker's gas history is too stale
+#define RESTORE_TRACKER_MIN_CREDIT 0.5f
+// Wall-clock readings before 2024-01-01 mean the clock was never set
+#define CLOCK_VALID_AFTER 1704067200
+#define TREND_WINDOW_DEFAULT 600
+#define WINDOW_DEFAULT 600
+#define OUTLIER_WINDOW_DEFAULT 5
+#define OUTLIER_THRESHOLD_DEFAULT 3.0f
+#define ANOMALY_WINDOW_DEFAULT 60
+#define ANOMALY_THRESHOLD_DEFAULT 4.0f
+// Least spread the anomaly test assumes per channel, about the BME680's
+// resolution and noise: degC, %RH, Pa and a share of the gas resistance
+#define ANOMALY_MIN_STD_TEMP 0.05f
+#define ANOMALY_MIN_STD_HUMIDITY 0.25f
+#define ANOMALY_MIN_STD_PRESSURE 3.0f
+#define ANOMALY_MIN_REL_STD_GAS 0.01f
+// Effective samples a trend fit needs before it is reported
+#define TREND_MIN_WEIGHT 3.0f
+// Lowest score classified as IAQ_LEVEL_MODERATELY_POLLUTED
+#define IAQ_MODERATE_SCORE 150.0f
+// Compensation learning: a memory of about 20000 stable-air samples, and
+// prior standard deviations of 2 for ln(gas) and 0.01 and 0.03 for the
+// coefficients
+#define COMP_LEARN_LAMBDA 0.99995f
+#define COMP_LEARN_P0_LEVEL 4.0f
+#define COMP_LEARN_P0_TEMP 1e-4f
+#define COMP_LEARN_P0_AH 9e-4f
+// Samples within this share of the baseline count as stable clean air
+#define COMP_LEARN_MIN_RATIO 0.8f
+// Stable-air samples before learned coefficients replace the defaults
+#define COMP_LEARN_MIN_UPDATES 1024
+// Learned coefficients are applied in steps of this many updates, which
+// keeps the batch path from recompensating after every sample
+#define COMP_APPLY_INTERVAL 64
+// An imported calibration resumes at this share of burn-in and stands in
+// for this many of the baseline tracker's epochs
+#define CALIB_IMPORT_CREDIT 0.9f
+#define CALIB_SEED_EPOCHS 2
+
+static iaq_ctx_t s_default_ctx;
+
+/**
+ * @brief Clamp a value to [lo, hi]
+ *
+ * Written as selects rather than fminf/fmaxf so loops using it stay
+ * vectorizable without fast-math.
+ */
+static inline float clampf(float x, float lo, float hi) {
+  x = (x < lo) ? lo : x;
+  return (x > hi) ? hi : x;
+}
 
-static struct {
-  iaq_config_t config;
-  iaq_result_t last_result;
-  SemaphoreHandle_t mutex;
-  float gas_baseline;
-  float gas_history[GAS_HISTORY_SIZE];
-  uint8_t gas_history_idx;
-  uint32_t samples_count;
-  bool initialized;
-  float gas_sum;
-  float gas_min;
-  float gas_max;
-} g_iaq_state = {0};
+static inline float maxf(float a, float b) { return (a > b) ? a : b; }
 
 /**
  * @brief Apply temperature and humidity compensation to gas resistance
+ *
+ * The humidity term works on absolute humidity, which tracks the water
+ * content the sensor sees across temperature swings where relative humidity
+ * does not.
  */
-static float compensate_gas_resistance(float gas_resistance, float temperature,
-                                       float humidity) {
-  float temp_factor = 1.0f + TEMP_COMP_COEFF * (temperature - 25.0f);
-  float hum_factor = 1.0f + HUM_COMP_COEFF * (humidity - 40.0f);
+static inline float compensate_gas_resistance(float gas_resistance,
+                                              float temperature,
+                                              float humidity, float temp_coeff,
+                                              float ah_coeff) {
+  float abs_humidity = iaq_absolute_humidity(temperature, humidity);
+  float temp_factor = 1.0f + temp_coeff * (temperature - TEMP_COMP_REF);
+  float hum_factor = 1.0f + ah_coeff * (abs_humidity - AH_COMP_REF);
   float comp_resistance = gas_resistance * temp_factor / hum_factor;
   return comp_resistance;
 }
 
+static void baselines_init(iaq_ctx_t *ctx) {
+  iaq_baseline_tracker_init(&ctx->baseline_tracker,
+                            ctx->config.baseline_percentile,
+                            ctx->config.baseline_horizon_samples);
+  iaq_baseline_tracker_init(&ctx->short_tracker,
+                            ctx->config.baseline_percentile,
+                            ctx->config.baseline_short_horizon_samples);
+  iaq_cusum_init(&ctx->change, CHANGE_DRIFT, ctx->config.change_limit_up,
+                 ctx->config.change_limit_down);
+}
+
 /**
- * @brief Update gas baseline using exponential moving average
+ * @brief Update gas baseline from the horizon-limited gas quantiles
+ *
+ * During burn-in the baseline follows the long quantile estimate directly,
+ * after that it is smoothed towards it at the recalibration rate. A change
+ * of environment, detected from the gap to the short quantile, restarts
+ * the long horizon from the short one instead.
  */
-static void update_gas_baseline(float gas_resistance) {
-  g_iaq_state.gas_history[g_iaq_state.gas_history_idx] = gas_resistance;
-  g_iaq_state.gas_history_idx =
-      (g_iaq_state.gas_history_idx + 1) % GAS_HISTORY_SIZE;
-  g_iaq_state.gas_sum += gas_resistance;
-  if (gas_resistance > g_iaq_state.gas_max) {
-    g_iaq_state.gas_max = gas_resistance;
+static void update_gas_baseline(iaq_ctx_t *ctx, float gas_resistance) {
+  ctx->samples_count++;
+
+  iaq_baseline_tracker_add(&ctx->baseline_tracker, gas_resistance);
+  iaq_baseline_tracker_add(&ctx->short_tracker, gas_resistance);
+  float target = iaq_baseline_tracker_get(&ctx->baseline_tracker);
+
+  if (ctx->samples_count <= ctx->config.burn_in_samples) {
+    ctx->gas_baseline = target;
+    return;
+  }
+
+  // The short quantile is too noisy to compare until half its horizon
+  float recent = iaq_baseline_tracker_get(&ctx->short_tracker);
+  int change = 0;
+  if (ctx->short_tracker.epoch_count >= IAQ_BASELINE_EPOCHS / 2) {
+    change = iaq_cusum_add(&ctx->change, (recent - target) / target);
   }
-  if (gas_resistance < g_iaq_state.gas_min || g_iaq_state.gas_min == 0) {
-    g_iaq_state.gas_min = gas_resistance;
+  if (change != 0) {
+    iaq_baseline_tracker_init(&ctx->baseline_tracker,
+                              ctx->config.baseline_percentile,
+                              ctx->config.baseline_horizon_samples);
+    iaq_baseline_tracker_seed(&ctx->baseline_tracker, recent, 1);
+    ctx->gas_baseline = recent;
+    ctx->baseline_changes++;
+    return;
   }
-  g_iaq_state.samples_count++;
 
-  if (g_iaq_state.samples_count <= DEFAULT_BURN_IN_SAMPLES) {
-    g_iaq_state.gas_baseline = g_iaq_state.gas_sum / g_iaq_state.samples_count;
-  } else {
-    if (gas_resistance > g_iaq_state.gas_baseline) {
-      float rate = g_iaq_state.config.gas_recalibration_rate;
-      g_iaq_state.gas_baseline =
-          g_iaq_state.gas_baseline * (1.0f - rate) + gas_resistance * rate;
-    }
+  // Hold still while the air may be polluted rather than the room changed
+  float rate = ctx->config.gas_recalibration_rate;
+  if (target < ctx->gas_baseline && ctx->change.down > 0.0f) {
+    rate = 0.0f;
   }
+  ctx->gas_baseline = ctx->gas_baseline * (1.0f - rate) + target * rate;
 }
 
 /**
- * @brief Calculate IAQ score from compensated gas resistance
+ * @brief Advance the sample clock to a valid reading
+ *
+ * The baseline and the anomaly detectors count time in nominal intervals
+ * rather than readings, so their horizons span the same time at any read
+ * cadence: a burst reading stands for a tenth of an interval, a slow one
+ * for three.
+ *
+ * @return Time since the previous valid reading, in nominal intervals
  */
-static float calculate_iaq_from_gas(float comp_gas_resistance) {
-  float baseline = g_iaq_state.gas_baseline;
+static float advance_sample_clock(iaq_ctx_t *ctx, uint32_t now_ms) {
+  uint32_t elapsed = IAQ_NOMINAL_INTERVAL_MS;
+  if (ctx->sample_ms != 0) {
+    elapsed = now_ms - ctx->sample_ms;
+  }
+  ctx->sample_ms = now_ms;
+  // Also catches a clock that stepped back, which wraps to a long gap
+  if (elapsed > SAMPLE_STEPS_MAX * IAQ_NOMINAL_INTERVAL_MS) {
+    elapsed = SAMPLE_STEPS_MAX * IAQ_NOMINAL_INTERVAL_MS;
+  }
+  ctx->baseline_due_ms += (int32_t)elapsed;
+  return (float)elapsed / (float)IAQ_NOMINAL_INTERVAL_MS;
+}
 
-  if (baseline <= 0) {
-    baseline = GAS_BASELINE_DEFAULT;
+/**
+ * @brief Step the baseline once per nominal interval the clock advanced
+ *
+ * Rounds to the nearest interval and carries the rest, so jittery readings
+ * at the nominal cadence step once each, burst readings about one in ten
+ * and slow ones three times. Burst readings therefore cannot shorten the
+ * horizons or the burn-in and get a polluted room taken for a new baseline.
+ */
+static void step_gas_baseline(iaq_ctx_t *ctx, float gas_resistance) {
+  while (ctx->baseline_due_ms >= IAQ_NOMINAL_INTERVAL_MS / 2) {
+    ctx->baseline_due_ms -= IAQ_NOMINAL_INTERVAL_MS;
+    update_gas_baseline(ctx, gas_resistance);
   }
+}
+
+/**
+ * @brief Calculate IAQ score from compensated gas resistance
+ *
+ * Piecewise-linear in the gas/baseline ratio. The segment is picked with
+ * selects so the same code serves the scalar and the batch path.
+ */
+static inline float calculate_iaq_from_gas(float comp_gas_resistance,
+                                           float baseline) {
+  baseline = (baseline > 0) ? baseline : GAS_BASELINE_DEFAULT;
 
   float gas_ratio = comp_gas_resistance / baseline;
-  float iaq;
-
-  if (gas_ratio >= 1.0f) {
-    iaq = 50.0f * (2.0f - fminf(gas_ratio, 2.0f));
-  } else if (gas_ratio >= 0.5f) {
-    iaq = 50.0f + 100.0f * (1.0f - gas_ratio) * 2.0f;
-  } else if (gas_ratio >= 0.2f) {
-    iaq = 150.0f + 100.0f * ((0.5f - gas_ratio) / 0.3f);
-  } else if (gas_ratio >= 0.1f) {
-    iaq = 250.0f + 100.0f * ((0.2f - gas_ratio) / 0.1f);
-  } else {
-    iaq = 350.0f + 150.0f * fminf((0.1f - gas_ratio) / 0.1f, 1.0f);
-  }
+  float r = (gas_ratio < 2.0f) ? gas_ratio : 2.0f;
 
-  if (iaq < 0)
-    iaq = 0;
-  if (iaq > 500)
-    iaq = 500;
+  // iaq = base + slope * (knot - r) on the segment containing r
+  float knot = 2.0f;
+  float base = 0.0f;
+  float slope = 50.0f;
+  knot = (r < 1.0f) ? 1.0f : knot;
+  base = (r < 1.0f) ? 50.0f : base;
+  slope = (r < 1.0f) ? 200.0f : slope;
+  knot = (r < 0.5f) ? 0.5f : knot;
+  base = (r < 0.5f) ? 150.0f : base;
+  slope = (r < 0.5f) ? (100.0f / 0.3f) : slope;
+  knot = (r < 0.2f) ? 0.2f : knot;
+  base = (r < 0.2f) ? 250.0f : base;
+  slope = (r < 0.2f) ? 1000.0f : slope;
+  knot = (r < 0.1f) ? 0.1f : knot;
+  base = (r < 0.1f) ? 350.0f : base;
+  slope = (r < 0.1f) ? 1500.0f : slope;
 
-  return iaq;
+  return clampf(base + slope * (knot - r), 0.0f, 500.0f);
 }
 
 /**
  * @brief Estimate CO2 equivalent from IAQ score
  */
-static float estimate_co2(float iaq_score) {
-  float co2 = CO2_BASE + (iaq_score * CO2_SLOPE);
-
-  if (co2 < CO2_BASE)
-    co2 = CO2_BASE;
-  if (co2 > CO2_MAX)
-    co2 = CO2_MAX;
-
-  return co2;
+static inline float estimate_co2(float iaq_score) {
+  return clampf(CO2_BASE + (iaq_score * CO2_SLOPE), CO2_BASE, CO2_MAX);
 }
 
 /**
  * @brief Estimate VOC equivalent from gas resistance
  */
-static float estimate_voc(float gas_resistance, float baseline) {
-  if (gas_resistance <= 0 || baseline <= 0) {
-    return 0;
-  }
-
+static inline float estimate_voc(float gas_resistance, float baseline) {
   float ratio = baseline / gas_resistance;
-  float voc = VOC_BASE + (ratio - 1.0f) * VOC_SLOPE * 100.0f;
+  float voc = clampf(VOC_BASE + (ratio - 1.0f) * VOC_SLOPE * 100.0f, VOC_BASE,
+                     VOC_MAX);
+  return (gas_resistance > 0 && baseline > 0) ? voc : 0.0f;
+}
 
-  if (voc < VOC_BASE)
-    voc = VOC_BASE;
-  if (voc > VOC_MAX)
-    voc = VOC_MAX;
+/**
+ * @brief Resistance in Ohms to the Q24.8 the fixed-point pipeline takes
+ */
+static inline uint32_t to_gas_q8(float ohms) {
+  return (ohms < (float)(UINT32_MAX >> 8)) ? (uint32_t)(ohms * 256.0f + 0.5f)
+                                           : UINT32_MAX;
+}
+
+/*
+ * Pipeline steps used by the calculation paths. With CONFIG_IAQ_FIXED_POINT
+ * they run the Q-format implementation from iaq_fixed.c and the float
+ * helpers above only serve as its reference.
+ */
+#ifdef CONFIG_IAQ_FIXED_POINT
+static inline float pipeline_compensate(float gas_resistance,
+                                        float temperature, float humidity,
+                                        float temp_coeff, float ah_coeff) {
+  return (float)iaq_fixed_compensate(gas_resistance, temperature, humidity,
+                                     IAQ_FIXED_COEFF_Q24(temp_coeff),
+                                     IAQ_FIXED_COEFF_Q24(ah_coeff)) *
+         (1.0f / 256.0f);
+}
+
+static inline float pipeline_iaq(float comp_gas, float baseline) {
+  return (float)iaq_fixed_iaq(to_gas_q8(comp_gas), to_gas_q8(baseline)) *
+         (1.0f / 256.0f);
+}
 
-  return voc;
+static inline float pipeline_co2(float iaq_score) {
+  // Scores from pipeline_iaq() are exact multiples of 1/256
+  return (float)iaq_fixed_co2((int32_t)(iaq_score * 256.0f)) *
+         (1.0f / 256.0f);
 }
 
+static inline float pipeline_voc(float comp_gas, float baseline) {
+  return (float)iaq_fixed_voc(to_gas_q8(comp_gas), to_gas_q8(baseline)) *
+         (1.0f / 65536.0f);
+}
+#else
+#define pipeline_compensate compensate_gas_resistance
+#define pipeline_iaq calculate_iaq_from_gas
+#define pipeline_co2 estimate_co2
+#define pipeline_voc estimate_voc
+#endif
+
 /**
  * @brief Classify IAQ score into level
  */
-static iaq_level_t classify_iaq(float iaq_score) {
-  if (iaq_score <= 50)
-    return IAQ_LEVEL_EXCELLENT;
-  if (iaq_score <= 100)
-    return IAQ_LEVEL_GOOD;
-  if (iaq_score <= 150)
-    return IAQ_LEVEL_LIGHTLY_POLLUTED;
-  if (iaq_score <= 200)
-    return IAQ_LEVEL_MODERATELY_POLLUTED;
-  if (iaq_score <= 300)
-    return IAQ_LEVEL_HEAVILY_POLLUTED;
-  return IAQ_LEVEL_SEVERELY_POLLUTED;
+static inline iaq_level_t classify_iaq(float iaq_score) {
+  return (iaq_level_t)((iaq_score > 50) + (iaq_score > 100) +
+                       (iaq_score > 150) + (iaq_score > 200) +
+                       (iaq_score > 300));
 }
 
 /**
  * @brief Determine accuracy based on calibration progress
  */
-static iaq_accuracy_t determine_accuracy(void) {
-  uint32_t samples = g_iaq_state.samples_count;
-  uint32_t burn_in = g_iaq_state.config.burn_in_samples;
+static iaq_accuracy_t determine_accuracy(const iaq_ctx_t *ctx) {
+  uint32_t samples = ctx->samples_count;
+  uint32_t burn_in = ctx->config.burn_in_samples;
 
   if (samples < burn_in / 4) {
     return IAQ_ACCURACY_UNRELIABLE;
@@ -188,59 +348,316 @@ static iaq_accuracy_t determine_accuracy(void) {
   return IAQ_ACCURACY_HIGH;
 }
 
-esp_err_t iaq_init(void) {
-  iaq_config_t default_config = {.temp_offset = 0.0f,
-                                 .humidity_offset = 0.0f,
-                                 .burn_in_samples = DEFAULT_BURN_IN_SAMPLES,
-                                 .gas_recalibration_rate =
-                                     CALIBRATION_RATE_DEFAULT};
-  return iaq_init_with_config(&default_config);
+/**
+ * @brief Publish a result to lock-free readers
+ *
+ * Double-buffered seqlock: while the sequence is odd the writer fills the
+ * slot readers are not using. The writer never waits for readers; a reader
+ * retries its copy if two publications complete during it, so under a
+ * fast enough writer it can retry more than once.
+ */
+static void publish_result(iaq_ctx_t *ctx, const iaq_result_t *result) {
+  uint32_t seq = __atomic_load_n(&ctx->result_seq, __ATOMIC_RELAXED);
+
+  __atomic_store_n(&ctx->result_seq, seq + 1, __ATOMIC_RELAXED);
+  __atomic_thread_fence(__ATOMIC_RELEASE);
+  memcpy(&ctx->result_slots[((seq >> 1) + 1) & 1], result,
+         sizeof(iaq_result_t));
+  __atomic_store_n(&ctx->result_seq, seq + 2, __ATOMIC_RELEASE);
 }
 
-esp_err_t iaq_init_with_config(const iaq_config_t *config) {
+static void anomaly_init(iaq_ctx_t *ctx) {
+  static const float min_std[IAQ_CHANNEL_COUNT] = {
+      [IAQ_CHANNEL_TEMPERATURE] = ANOMALY_MIN_STD_TEMP,
+      [IAQ_CHANNEL_HUMIDITY] = ANOMALY_MIN_STD_HUMIDITY,
+      [IAQ_CHANNEL_PRESSURE] = ANOMALY_MIN_STD_PRESSURE,
+  };
+  static const float min_rel_std[IAQ_CHANNEL_COUNT] = {
+      [IAQ_CHANNEL_GAS] = ANOMALY_MIN_REL_STD_GAS,
+  };
+
+  for (int i = 0; i < IAQ_CHANNEL_COUNT; i++) {
+    iaq_ewma_init(&ctx->anomaly[i], ctx->config.anomaly_window_samples,
+                  ctx->config.anomaly_threshold, min_std[i], min_rel_std[i]);
+  }
+}
+
+/**
+ * @brief Run every channel's anomaly test on one reading
+ *
+ * The gas channel sees the compensated resistance before the outlier
+ * filter, so spikes show up here as well.
+ *
+ * @param pressure NULL to skip the pressure channel
+ * @param steps Time since the previous reading, in nominal intervals
+ * @return Bit per iaq_channel_t flagged
+ */
+static uint8_t detect_anomalies(iaq_ctx_t *ctx, float temperature,
+                                float humidity, const float *pressure,
+                                float comp_gas, float steps) {
+  uint8_t flags = 0;
+  if (iaq_ewma_update(&ctx->anomaly[IAQ_CHANNEL_TEMPERATURE], temperature,
+                      steps)) {
+    flags |= 1u << IAQ_CHANNEL_TEMPERATURE;
+  }
+  if (iaq_ewma_update(&ctx->anomaly[IAQ_CHANNEL_HUMIDITY], humidity,
+                      steps)) {
+    flags |= 1u << IAQ_CHANNEL_HUMIDITY;
+  }
+  if (pressure != NULL &&
+      iaq_ewma_update(&ctx->anomaly[IAQ_CHANNEL_PRESSURE], *pressure,
+                      steps)) {
+    flags |= 1u << IAQ_CHANNEL_PRESSURE;
+  }
+  if (iaq_ewma_update(&ctx->anomaly[IAQ_CHANNEL_GAS], comp_gas, steps)) {
+    flags |= 1u << IAQ_CHANNEL_GAS;
+  }
+  if (flags != 0) {
+    ctx->anomalies++;
+  }
+  return flags;
+}
+
+static void windows_init(iaq_ctx_t *ctx) {
+  for (int i = 0; i < IAQ_CHANNEL_COUNT; i++) {
+    iaq_window_init(&ctx->window[i], ctx->config.window_s * 1000u);
+  }
+}
+
+/**
+ * @brief Add one raw reading to the sliding windows
+ * @param pressure NULL to skip the pressure channel
+ */
+static void update_windows(iaq_ctx_t *ctx, uint32_t now_ms, float temperature,
+                           float humidity, const float *pressure,
+                           float gas_resistance) {
+  iaq_window_add(&ctx->window[IAQ_CHANNEL_TEMPERATURE], now_ms, temperature);
+  iaq_window_add(&ctx->window[IAQ_CHANNEL_HUMIDITY], now_ms, humidity);
+  if (pressure != NULL) {
+    iaq_window_add(&ctx->window[IAQ_CHANNEL_PRESSURE], now_ms, *pressure);
+  }
+  iaq_window_add(&ctx->window[IAQ_CHANNEL_GAS], now_ms, gas_resistance);
+}
+
+/**
+ * @brief Fill a complete result from the current estimator state
+ */
+static void fill_result(const iaq_ctx_t *ctx, iaq_result_t *result,
+                        float comp_gas, float iaq_score, float temperature,
+                        float humidity, bool outlier, uint8_t anomaly_flags) {
+  result->iaq_score = iaq_score;
+  result->iaq_level = classify_iaq(iaq_score);
+  result->accuracy = determine_accuracy(ctx);
+  result->co2_equivalent = pipeline_co2(iaq_score);
+  result->voc_equivalent = pipeline_voc(comp_gas, ctx->gas_baseline);
+  result->static_iaq = iaq_score;
+  result->comp_temperature = temperature + ctx->config.temp_offset;
+  result->comp_humidity = humidity + ctx->config.humidity_offset;
+  result->gas_baseline = ctx->gas_baseline;
+  result->samples_count = ctx->samples_count;
+  result->is_calibrated =
+      (ctx->samples_count >= ctx->config.burn_in_samples);
+  result->outliers_rejected = ctx->outlier_filter.flagged;
+  result->gas_outlier = outlier;
+  for (int i = 0; i < IAQ_CHANNEL_COUNT; i++) {
+    result->anomaly_score[i] = iaq_ewma_score(&ctx->anomaly[i]);
+  }
+  result->anomalies = ctx->anomalies;
+  result->anomaly_flags = anomaly_flags;
+  for (int i = 0; i < IAQ_CHANNEL_COUNT; i++) {
+    iaq_window_get(&ctx->window[i], &result->window[i]);
+  }
+}
+
+/**
+ * @brief Start the compensation fit from prior coefficients
+ * @param level Expected gas resistance at the reference conditions
+ */
+static void comp_fit_init(iaq_ctx_t *ctx, float level, float temp_coeff,
+                          float ah_coeff) {
+  const float theta[IAQ_RLS_PARAMS] = {logf(level), -temp_coeff, ah_coeff};
+  const float p0[IAQ_RLS_PARAMS] = {COMP_LEARN_P0_LEVEL, COMP_LEARN_P0_TEMP,
+                                    COMP_LEARN_P0_AH};
+  iaq_rls_init(&ctx->comp_fit, theta, p0, COMP_LEARN_LAMBDA);
+  ctx->comp_temp_coeff = TEMP_COMP_COEFF;
+  ctx->comp_ah_coeff = AH_COMP_COEFF;
+}
+
+/**
+ * @brief Switch to the fitted coefficients once the fit has enough data
+ * @return true if the applied coefficients changed
+ */
+static bool apply_compensation(iaq_ctx_t *ctx) {
+  float temp_coeff = TEMP_COMP_COEFF;
+  float ah_coeff = AH_COMP_COEFF;
+  if (ctx->comp_fit.updates >= COMP_LEARN_MIN_UPDATES) {
+    // ln(gas) = level - temp_coeff * dT + ah_coeff * dAH undoes exactly
+    // what compensate_gas_resistance() applies, to first order
+    temp_coeff = clampf(-ctx->comp_fit.theta[1], 0.0f, TEMP_COMP_COEFF_MAX);
+    ah_coeff = clampf(ctx->comp_fit.theta[2], 0.0f, AH_COMP_COEFF_MAX);
+  }
+
+  bool changed = temp_coeff != ctx->comp_temp_coeff ||
+                 ah_coeff != ctx->comp_ah_coeff;
+  ctx->comp_temp_coeff = temp_coeff;
+  ctx->comp_ah_coeff = ah_coeff;
+  return changed;
+}
+
+/**
+ * @brief Feed one sample to the compensation fit if it is stable clean air
+ *
+ * Only calibrated, non-outlier samples close to the baseline are used, so
+ * the fit sees the sensor's response to temperature and humidity rather
+ * than to pollution events.
+ *
+ * @return true if the applied coefficients changed
+ */
+static bool learn_compensation(iaq_ctx_t *ctx, float gas_resistance,
+                               float temperature, float humidity,
+                               float comp_gas, bool outlier) {
+  if (!ctx->config.learn_compensation || outlier ||
+      ctx->samples_count < ctx->config.burn_in_samples ||
+      comp_gas < COMP_LEARN_MIN_RATIO * ctx->gas_baseline) {
+    return false;
+  }
+
+  float abs_humidity = iaq_absolute_humidity(temperature, humidity);
+  const float x[IAQ_RLS_PARAMS] = {1.0f, temperature - TEMP_COMP_REF,
+                                   abs_humidity - AH_COMP_REF};
+  iaq_rls_update(&ctx->comp_fit, x, logf(gas_resistance));
+
+  if (ctx->comp_fit.updates % COMP_APPLY_INTERVAL != 0) {
+    return false;
+  }
+  return apply_compensation(ctx);
+}
+
+void iaq_get_default_config(iaq_config_t *config) {
   if (config == NULL) {
+    return;
+  }
+  *config = (iaq_config_t){.temp_offset = 0.0f,
+                           .humidity_offset = 0.0f,
+                           .burn_in_samples = DEFAULT_BURN_IN_SAMPLES,
+                           .gas_recalibration_rate = CALIBRATION_RATE_DEFAULT,
+                           .baseline_percentile = BASELINE_PERCENTILE_DEFAULT,
+                           .baseline_horizon_samples =
+                               BASELINE_HORIZON_DEFAULT,
+                           .restore_grace_s = RESTORE_GRACE_DEFAULT,
+                           .restore_decay_s = RESTORE_DECAY_DEFAULT,
+                           .restore_unknown_age_s =
+                               RESTORE_UNKNOWN_AGE_DEFAULT,
+                           .trend_window_s = TREND_WINDOW_DEFAULT,
+                           .outlier_window = OUTLIER_WINDOW_DEFAULT,
+                           .outlier_threshold = OUTLIER_THRESHOLD_DEFAULT,
+                           .learn_compensation = true,
+                           .baseline_short_horizon_samples =
+                               BASELINE_SHORT_HORIZON_DEFAULT,
+                           .change_limit_up = CHANGE_LIMIT_UP_DEFAULT,
+                           .change_limit_down = CHANGE_LIMIT_DOWN_DEFAULT,
+                           .anomaly_window_samples = ANOMALY_WINDOW_DEFAULT,
+                           .anomaly_threshold = ANOMALY_THRESHOLD_DEFAULT,
+                           .window_s = WINDOW_DEFAULT};
+}
+
+esp_err_t iaq_ctx_init(iaq_ctx_t *ctx, const iaq_config_t *config,
+                       const char *nvs_namespace) {
+  if (ctx == NULL || config == NULL ||
+      (nvs_namespace != NULL &&
+       strlen(nvs_namespace) >= sizeof(ctx->nvs_namespace))) {
     return ESP_ERR_INVALID_ARG;
   }
 
-  // Create mutex
-  g_iaq_state.mutex = xSemaphoreCreateMutex();
-  if (g_iaq_state.mutex == NULL) {
+  memset(ctx, 0, sizeof(*ctx));
+
+  // Create mutex in the context itself so contexts need no heap
+  ctx->mutex = xSemaphoreCreateMutexStatic(&ctx->mutex_buffer);
+  if (ctx->mutex == NULL) {
     ESP_LOGE(TAG, "Failed to create IAQ mutex");
     return ESP_FAIL;
   }
 
   // Copy configuration
-  memcpy(&g_iaq_state.config, config, sizeof(iaq_config_t));
+  memcpy(&ctx->config, config, sizeof(iaq_config_t));
+  if (ctx->config.baseline_percentile <= 0.0f ||
+      ctx->config.baseline_percentile >= 1.0f) {
+    ctx->config.baseline_percentile = BASELINE_PERCENTILE_DEFAULT;
+  }
+  if (ctx->config.baseline_horizon_samples == 0) {
+    ctx->config.baseline_horizon_samples = BASELINE_HORIZON_DEFAULT;
+  }
+  if (ctx->config.baseline_short_horizon_samples == 0) {
+    ctx->config.baseline_short_horizon_samples =
+        BASELINE_SHORT_HORIZON_DEFAULT;
+  }
+  if (ctx->config.change_limit_up <= 0.0f) {
+    ctx->config.change_limit_up = CHANGE_LIMIT_UP_DEFAULT;
+  }
+  if (ctx->config.change_limit_down <= 0.0f) {
+    ctx->config.change_limit_down = CHANGE_LIMIT_DOWN_DEFAULT;
+  }
+  if (ctx->config.restore_decay_s == 0) {
+    ctx->config.restore_decay_s = RESTORE_DECAY_DEFAULT;
+  }
+  if (ctx->config.trend_window_s == 0) {
+    ctx->config.trend_window_s = TREND_WINDOW_DEFAULT;
+  }
+  if (ctx->config.outlier_window == 0) {
+    ctx->config.outlier_window = OUTLIER_WINDOW_DEFAULT;
+  }
+  if (ctx->config.outlier_threshold <= 0.0f) {
+    ctx->config.outlier_threshold = OUTLIER_THRESHOLD_DEFAULT;
+  }
+  if (ctx->config.anomaly_window_samples == 0) {
+    ctx->config.anomaly_window_samples = ANOMALY_WINDOW_DEFAULT;
+  }
+  if (ctx->config.anomaly_threshold <= 0.0f) {
+    ctx->config.anomaly_threshold = ANOMALY_THRESHOLD_DEFAULT;
+  }
+  if (ctx->config.window_s == 0) {
+    ctx->config.window_s = WINDOW_DEFAULT;
+  }
+  if (nvs_namespace != NULL) {
+    strcpy(ctx->nvs_namespace, nvs_namespace);
+  }
 
   // Initialize state
-  g_iaq_state.gas_baseline = GAS_BASELINE_DEFAULT;
-  g_iaq_state.gas_history_idx = 0;
-  g_iaq_state.samples_count = 0;
-  g_iaq_state.gas_sum = 0;
-  g_iaq_state.gas_min = 0;
-  g_iaq_state.gas_max = 0;
-  g_iaq_state.initialized = true;
-
-  memset(g_iaq_state.gas_history, 0, sizeof(g_iaq_state.gas_history));
-  memset(&g_iaq_state.last_result, 0, sizeof(iaq_result_t));
-
-  if (iaq_load_state() == ESP_OK) {
-    ESP_LOGI(TAG, "Loaded previous calibration state");
-    ESP_LOGI(TAG, "  - Gas Baseline: %.0f Ohms", g_iaq_state.gas_baseline);
-    ESP_LOGI(TAG, "  - Samples: %" PRIu32, g_iaq_state.samples_count);
+  ctx->gas_baseline = GAS_BASELINE_DEFAULT;
+  ctx->samples_count = 0;
+  ctx->initialized = true;
+
+  baselines_init(ctx);
+  iaq_trend_init(&ctx->trend, (float)ctx->config.trend_window_s);
+  iaq_hampel_init(&ctx->outlier_filter, ctx->config.outlier_window,
+                  ctx->config.outlier_threshold);
+  anomaly_init(ctx);
+  windows_init(ctx);
+  comp_fit_init(ctx, GAS_BASELINE_DEFAULT, TEMP_COMP_COEFF, AH_COMP_COEFF);
+
+  const char *name = nvs_namespace ? nvs_namespace : "(volatile)";
+  if (iaq_ctx_load_state(ctx) == ESP_OK) {
+    ESP_LOGI(TAG, "[%s] Loaded previous calibration state", name);
+    ESP_LOGI(TAG, "  - Gas Baseline: %.0f Ohms", ctx->gas_baseline);
+    ESP_LOGI(TAG, "  - Samples: %" PRIu32 " (%s)", ctx->samples_count,
+             iaq_accuracy_to_string(determine_accuracy(ctx)));
   } else {
-    ESP_LOGI(TAG, "Starting fresh calibration");
+    ESP_LOGI(TAG, "[%s] Starting fresh calibration", name);
   }
 
-  ESP_LOGI(TAG, "IAQ Calculator initialized");
+  ESP_LOGI(TAG, "[%s] IAQ Calculator initialized", name);
   ESP_LOGI(TAG, "  - Burn-in samples: %" PRIu32, config->burn_in_samples);
   ESP_LOGI(TAG, "  - Recalibration rate: %.4f", config->gas_recalibration_rate);
+  ESP_LOGI(TAG, "  - Baseline: P%.0f over %" PRIu32 " samples",
+           ctx->config.baseline_percentile * 100.0f,
+           ctx->config.baseline_horizon_samples);
 
   return ESP_OK;
 }
 
-esp_err_t iaq_calculate(const iaq_raw_data_t *raw_data, iaq_result_t *result) {
-  if (!g_iaq_state.initialized) {
+esp_err_t iaq_ctx_calculate(iaq_ctx_t *ctx, const iaq_raw_data_t *raw_data,
+                            iaq_result_t *result) {
+  if (ctx == NULL || !ctx->initialized) {
     ESP_LOGE(TAG, "IAQ not initialized");
     return ESP_ERR_INVALID_STATE;
   }
@@ -257,66 +674,229 @@ esp_err_t iaq_calculate(const iaq_raw_data_t *raw_data, iaq_result_t *result) {
     return ESP_ERR_INVALID_ARG;
   }
 
-  if (xSemaphoreTake(g_iaq_state.mutex, pdMS_TO_TICKS(100)) != pdTRUE) {
+  if (xSemaphoreTake(ctx->mutex, pdMS_TO_TICKS(100)) != pdTRUE) {
     return ESP_ERR_TIMEOUT;
   }
 
-  float comp_gas = compensate_gas_resistance(
-      raw_data->gas_resistance, raw_data->temperature, raw_data->humidity);
-  update_gas_baseline(comp_gas);
-  float iaq_score = calculate_iaq_from_gas(comp_gas);
+  uint32_t now_ms = raw_data->timestamp_ms;
+  if (now_ms == 0) {
+    now_ms = (uint32_t)(esp_timer_get_time() / 1000);
+  }
+  float steps = advance_sample_clock(ctx, now_ms);
 
-  result->iaq_score = iaq_score;
-  result->iaq_level = classify_iaq(iaq_score);
-  result->accuracy = determine_accuracy();
-  result->co2_equivalent = estimate_co2(iaq_score);
-  result->voc_equivalent = estimate_voc(comp_gas, g_iaq_state.gas_baseline);
-  result->static_iaq = iaq_score;
-  result->comp_temperature =
-      raw_data->temperature + g_iaq_state.config.temp_offset;
-  result->comp_humidity =
-      raw_data->humidity + g_iaq_state.config.humidity_offset;
-  result->gas_baseline = g_iaq_state.gas_baseline;
-  result->samples_count = g_iaq_state.samples_count;
-  result->is_calibrated =
-      (g_iaq_state.samples_count >= g_iaq_state.config.burn_in_samples);
-  memcpy(&g_iaq_state.last_result, result, sizeof(iaq_result_t));
+  float comp_gas = pipeline_compensate(
+      raw_data->gas_resistance, raw_data->temperature, raw_data->humidity,
+      ctx->comp_temp_coeff, ctx->comp_ah_coeff);
+  uint8_t anomaly_flags =
+      detect_anomalies(ctx, raw_data->temperature, raw_data->humidity,
+                       &raw_data->pressure, comp_gas, steps);
+  // Spikes are replaced before they reach the baseline or the mapping
+  bool outlier = iaq_hampel_filter(&ctx->outlier_filter, comp_gas, &comp_gas);
+  step_gas_baseline(ctx, comp_gas);
+  learn_compensation(ctx, raw_data->gas_resistance, raw_data->temperature,
+                     raw_data->humidity, comp_gas, outlier);
+  float iaq_score = pipeline_iaq(comp_gas, ctx->gas_baseline);
+
+  iaq_trend_add(&ctx->trend, now_ms, iaq_score, comp_gas);
+  update_windows(ctx, now_ms, raw_data->temperature, raw_data->humidity,
+                 &raw_data->pressure, raw_data->gas_resistance);
 
-  xSemaphoreGive(g_iaq_state.mutex);
+  fill_result(ctx, result, comp_gas, iaq_score, raw_data->temperature,
+              raw_data->humidity, outlier, anomaly_flags);
+  publish_result(ctx, result);
+
+  xSemaphoreGive(ctx->mutex);
 
   return ESP_OK;
 }
 
-esp_err_t iaq_get_result(iaq_result_t *result) {
-  if (result == NULL || !g_iaq_state.initialized) {
+esp_err_t iaq_ctx_calculate_batch(iaq_ctx_t *ctx, const iaq_raw_block_t *raw,
+                                  const iaq_result_block_t *results,
+                                  size_t count) {
+  if (ctx == NULL || !ctx->initialized) {
+    ESP_LOGE(TAG, "IAQ not initialized");
+    return ESP_ERR_INVALID_STATE;
+  }
+
+  if (raw == NULL || results == NULL || raw->temperature == NULL ||
+      raw->humidity == NULL || raw->gas_resistance == NULL ||
+      results->iaq_score == NULL) {
     return ESP_ERR_INVALID_ARG;
   }
 
-  if (xSemaphoreTake(g_iaq_state.mutex, pdMS_TO_TICKS(100)) == pdTRUE) {
-    memcpy(result, &g_iaq_state.last_result, sizeof(iaq_result_t));
-    xSemaphoreGive(g_iaq_state.mutex);
-    return ESP_OK;
+  if (xSemaphoreTake(ctx->mutex, pdMS_TO_TICKS(100)) != pdTRUE) {
+    return ESP_ERR_TIMEOUT;
   }
-  return ESP_ERR_TIMEOUT;
+
+  const float *restrict temperature = raw->temperature;
+  const float *restrict humidity = raw->humidity;
+  const float *restrict gas = raw->gas_resistance;
+  float comp[IAQ_BATCH_CHUNK];
+  float baseline[IAQ_BATCH_CHUNK];
+  float score[IAQ_BATCH_CHUNK];
+  uint8_t anomaly[IAQ_BATCH_CHUNK];
+  uint32_t when[IAQ_BATCH_CHUNK];
+  size_t last_valid = count;
+  float last_comp = 0.0f;
+  bool last_outlier = false;
+  uint8_t last_anomaly = 0;
+  uint32_t clock_ms = ctx->sample_ms;
+
+  for (size_t start = 0; start < count; start += IAQ_BATCH_CHUNK) {
+    size_t n = count - start;
+    if (n > IAQ_BATCH_CHUNK) {
+      n = IAQ_BATCH_CHUNK;
+    }
+
+    // Stage 1: compensation, independent per sample
+    float temp_coeff = ctx->comp_temp_coeff;
+    float ah_coeff = ctx->comp_ah_coeff;
+    for (size_t i = 0; i < n; i++) {
+      comp[i] = pipeline_compensate(gas[start + i], temperature[start + i],
+                                    humidity[start + i], temp_coeff, ah_coeff);
+    }
+
+    // Stage 2: the clock, anomaly tests, outlier filter, baseline and
+    // compensation fit are recurrences, run in order
+    for (size_t i = 0; i < n; i++) {
+      clock_ms = raw->timestamp_ms ? raw->timestamp_ms[start + i]
+                                   : clock_ms + IAQ_NOMINAL_INTERVAL_MS;
+      when[i] = clock_ms;
+      anomaly[i] = 0;
+      if (gas[start + i] > 0) {
+        float steps = advance_sample_clock(ctx, clock_ms);
+        anomaly[i] = detect_anomalies(
+            ctx, temperature[start + i], humidity[start + i],
+            raw->pressure ? &raw->pressure[start + i] : NULL, comp[i],
+            steps);
+        last_outlier =
+            iaq_hampel_filter(&ctx->outlier_filter, comp[i], &comp[i]);
+        step_gas_baseline(ctx, comp[i]);
+        last_valid = start + i;
+        last_comp = comp[i];
+        last_anomaly = anomaly[i];
+        if (learn_compensation(ctx, gas[start + i], temperature[start + i],
+                               humidity[start + i], comp[i], last_outlier)) {
+          // Rare: redo the rest of the chunk with the new coefficients
+          for (size_t j = i + 1; j < n; j++) {
+            comp[j] = pipeline_compensate(
+                gas[start + j], temperature[start + j], humidity[start + j],
+                ctx->comp_temp_coeff, ctx->comp_ah_coeff);
+          }
+        }
+      }
+      baseline[i] = ctx->gas_baseline;
+    }
+
+    // Stage 3: mapping, independent per sample
+    for (size_t i = 0; i < n; i++) {
+      float iaq = pipeline_iaq(comp[i], baseline[i]);
+      score[i] = (gas[start + i] > 0) ? iaq : 0.0f;
+    }
+
+    // Stage 4: the trend fit and the windows are recurrences as well
+    for (size_t i = 0; i < n; i++) {
+      if (gas[start + i] > 0) {
+        iaq_trend_add(&ctx->trend, when[i], score[i], comp[i]);
+        update_windows(ctx, when[i], temperature[start + i],
+                       humidity[start + i],
+                       raw->pressure ? &raw->pressure[start + i] : NULL,
+                       gas[start + i]);
+      }
+    }
+
+    float *restrict out_score = &results->iaq_score[start];
+    for (size_t i = 0; i < n; i++) {
+      out_score[i] = score[i];
+    }
+    if (results->iaq_level != NULL) {
+      iaq_level_t *restrict out_level = &results->iaq_level[start];
+      for (size_t i = 0; i < n; i++) {
+        iaq_level_t level = classify_iaq(score[i]);
+        out_level[i] = (gas[start + i] > 0) ? level : IAQ_LEVEL_UNKNOWN;
+      }
+    }
+    if (results->co2_equivalent != NULL) {
+      float *restrict out_co2 = &results->co2_equivalent[start];
+      for (size_t i = 0; i < n; i++) {
+        out_co2[i] = pipeline_co2(score[i]);
+      }
+    }
+    if (results->voc_equivalent != NULL) {
+      float *restrict out_voc = &results->voc_equivalent[start];
+      for (size_t i = 0; i < n; i++) {
+        float voc = pipeline_voc(comp[i], baseline[i]);
+        out_voc[i] = (gas[start + i] > 0) ? voc : 0.0f;
+      }
+    }
+    if (results->gas_baseline != NULL) {
+      float *restrict out_baseline = &results->gas_baseline[start];
+      for (size_t i = 0; i < n; i++) {
+        out_baseline[i] = baseline[i];
+      }
+    }
+    if (results->anomaly_flags != NULL) {
+      memcpy(&results->anomaly_flags[start], anomaly, n);
+    }
+  }
+
+  if (last_valid < count) {
+    iaq_result_t result;
+    fill_result(ctx, &result, last_comp, results->iaq_score[last_valid],
+                temperature[last_valid], humidity[last_valid], last_outlier,
+                last_anomaly);
+    publish_result(ctx, &result);
+  }
+
+  xSemaphoreGive(ctx->mutex);
+
+  return ESP_OK;
+}
+
+esp_err_t iaq_ctx_get_result(const iaq_ctx_t *ctx, iaq_result_t *result) {
+  if (ctx == NULL || result == NULL || !ctx->initialized) {
+    return ESP_ERR_INVALID_ARG;
+  }
+
+  uint32_t begin;
+  uint32_t end;
+  do {
+    begin = __atomic_load_n(&ctx->result_seq, __ATOMIC_ACQUIRE);
+    memcpy(result, &ctx->result_slots[(begin >> 1) & 1],
+           sizeof(iaq_result_t));
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    end = __atomic_load_n(&ctx->result_seq, __ATOMIC_RELAXED);
+    // The slot read is only rewritten by the second publication after begin
+  } while (end - (begin & ~1u) >= 3);
+
+  return ESP_OK;
 }
 
-void iaq_reset(void) {
-  if (!g_iaq_state.initialized)
+void iaq_ctx_reset(iaq_ctx_t *ctx) {
+  if (ctx == NULL || !ctx->initialized)
     return;
 
-  if (xSemaphoreTake(g_iaq_state.mutex, pdMS_TO_TICKS(100)) == pdTRUE) {
-    g_iaq_state.gas_baseline = GAS_BASELINE_DEFAULT;
-    g_iaq_state.gas_history_idx = 0;
-    g_iaq_state.samples_count = 0;
-    g_iaq_state.gas_sum = 0;
-    g_iaq_state.gas_min = 0;
-    g_iaq_state.gas_max = 0;
-    memset(g_iaq_state.gas_history, 0, sizeof(g_iaq_state.gas_history));
-    xSemaphoreGive(g_iaq_state.mutex);
+  if (xSemaphoreTake(ctx->mutex, pdMS_TO_TICKS(100)) == pdTRUE) {
+    ctx->gas_baseline = GAS_BASELINE_DEFAULT;
+    ctx->samples_count = 0;
+    baselines_init(ctx);
+    ctx->baseline_changes = 0;
+    iaq_trend_init(&ctx->trend, (float)ctx->config.trend_window_s);
+    iaq_hampel_init(&ctx->outlier_filter, ctx->config.outlier_window,
+                    ctx->config.outlier_threshold);
+    anomaly_init(ctx);
+    ctx->anomalies = 0;
+    windows_init(ctx);
+    comp_fit_init(ctx, GAS_BASELINE_DEFAULT, TEMP_COMP_COEFF, AH_COMP_COEFF);
+    xSemaphoreGive(ctx->mutex);
     ESP_LOGI(TAG, "IAQ algorithm reset");
   }
 }
 
+iaq_level_t iaq_score_to_level(float iaq_score) {
+  return classify_iaq(iaq_score);
+}
+
 const char *iaq_level_to_string(iaq_level_t level) {
   switch (level) {
   case IAQ_LEVEL_EXCELLENT:
@@ -370,42 +950,144 @@ uint32_t iaq_level_to_color(iaq_level_t level) {
   }
 }
 
-bool iaq_is_calibrated(void) {
-  return g_iaq_state.samples_count >= g_iaq_state.config.burn_in_samples;
+bool iaq_ctx_is_calibrated(const iaq_ctx_t *ctx) {
+  return ctx->samples_count >= ctx->config.burn_in_samples;
 }
 
-uint8_t iaq_get_calibration_progress(void) {
-  if (g_iaq_state.config.burn_in_samples == 0)
+uint8_t iaq_ctx_get_calibration_progress(const iaq_ctx_t *ctx) {
+  if (ctx->config.burn_in_samples == 0)
     return 100;
 
   uint32_t progress =
-      (g_iaq_state.samples_count * 100) / g_iaq_state.config.burn_in_samples;
+      (ctx->samples_count * 100) / ctx->config.burn_in_samples;
   if (progress > 100)
     progress = 100;
   return (uint8_t)progress;
 }
 
-esp_err_t iaq_save_state(void) {
+esp_err_t iaq_ctx_get_trend(iaq_ctx_t *ctx, iaq_trend_t *trend) {
+  if (ctx == NULL || trend == NULL || !ctx->initialized) {
+    return ESP_ERR_INVALID_ARG;
+  }
+
+  if (xSemaphoreTake(ctx->mutex, pdMS_TO_TICKS(100)) != pdTRUE) {
+    return ESP_ERR_TIMEOUT;
+  }
+
+  const iaq_trend_tracker_t *tracker = &ctx->trend;
+  trend->iaq_slope = iaq_trend_slope(tracker, &tracker->iaq) * 60.0f;
+  trend->iaq_confidence = iaq_trend_r2(tracker, &tracker->iaq);
+  trend->gas_slope = iaq_trend_slope(tracker, &tracker->gas) * 60.0f;
+  trend->gas_confidence = iaq_trend_r2(tracker, &tracker->gas);
+  trend->time_to_moderate_s = iaq_trend_time_to(
+      tracker, &tracker->iaq, IAQ_MODERATE_SCORE, tracker->window_s);
+  // During burn-in the IAQ trend mostly follows the moving baseline
+  trend->valid = iaq_ctx_is_calibrated(ctx) &&
+                 tracker->weight >= TREND_MIN_WEIGHT;
+
+  xSemaphoreGive(ctx->mutex);
+
+  return ESP_OK;
+}
+
+esp_err_t iaq_ctx_get_baselines(iaq_ctx_t *ctx, iaq_baselines_t *baselines) {
+  if (ctx == NULL || baselines == NULL || !ctx->initialized) {
+    return ESP_ERR_INVALID_ARG;
+  }
+
+  if (xSemaphoreTake(ctx->mutex, pdMS_TO_TICKS(100)) != pdTRUE) {
+    return ESP_ERR_TIMEOUT;
+  }
+
+  baselines->gas_baseline = ctx->gas_baseline;
+  baselines->short_baseline = iaq_baseline_tracker_get(&ctx->short_tracker);
+  baselines->long_baseline = iaq_baseline_tracker_get(&ctx->baseline_tracker);
+  baselines->evidence_up = ctx->change.up / ctx->change.limit_up;
+  baselines->evidence_down = ctx->change.down / ctx->change.limit_down;
+  baselines->changes = ctx->baseline_changes;
+
+  xSemaphoreGive(ctx->mutex);
+
+  return ESP_OK;
+}
+
+esp_err_t iaq_ctx_get_compensation(iaq_ctx_t *ctx, iaq_compensation_t *comp) {
+  if (ctx == NULL || comp == NULL || !ctx->initialized) {
+    return ESP_ERR_INVALID_ARG;
+  }
+
+  if (xSemaphoreTake(ctx->mutex, pdMS_TO_TICKS(100)) != pdTRUE) {
+    return ESP_ERR_TIMEOUT;
+  }
+
+  comp->temp_coeff = ctx->comp_temp_coeff;
+  comp->ah_coeff = ctx->comp_ah_coeff;
+  comp->updates = ctx->comp_fit.updates;
+  comp->learned = ctx->comp_fit.updates >= COMP_LEARN_MIN_UPDATES;
+
+  xSemaphoreGive(ctx->mutex);
+
+  return ESP_OK;
+}
+
+static uint32_t state_crc(const iaq_state_blob_t *state) {
+  return esp_rom_crc32_le(0, (const uint8_t *)state,
+                          offsetof(iaq_state_blob_t, crc));
+}
+
+esp_err_t iaq_ctx_get_state(iaq_ctx_t *ctx, iaq_state_blob_t *state) {
+  if (ctx == NULL || !ctx->initialized) {
+    return ESP_ERR_INVALID_STATE;
+  }
+  if (state == NULL) {
+    return ESP_ERR_INVALID_ARG;
+  }
+
+  if (xSemaphoreTake(ctx->mutex, pdMS_TO_TICKS(100)) != pdTRUE) {
+    return ESP_ERR_TIMEOUT;
+  }
+  memset(state, 0, sizeof(*state));
+  state->version = IAQ_STATE_VERSION;
+  state->size = sizeof(iaq_state_blob_t);
+  state->gas_baseline = ctx->gas_baseline;
+  state->samples_count = ctx->samples_count;
+  iaq_window_stats_t gas_window;
+  iaq_window_get(&ctx->window[IAQ_CHANNEL_GAS], &gas_window);
+  state->gas_min = gas_window.min;
+  state->gas_max = gas_window.max;
+  state->baseline_tracker = ctx->baseline_tracker;
+  state->comp_fit = ctx->comp_fit;
+  xSemaphoreGive(ctx->mutex);
+
+  iaq_ctx_get_result(ctx, &state->last_result);
+  time_t now = time(NULL);
+  state->saved_at = (now > CLOCK_VALID_AFTER) ? (uint32_t)now : 0;
+
+  state->crc = state_crc(state);
+  return ESP_OK;
+}
+
+esp_err_t iaq_ctx_write_state(const iaq_ctx_t *ctx,
+                              const iaq_state_blob_t *state) {
   nvs_handle_t nvs_handle;
   esp_err_t err;
 
-  err = nvs_open(NVS_NAMESPACE, NVS_READWRITE, &nvs_handle);
-  if (err != ESP_OK) {
-    ESP_LOGE(TAG, "Failed to open NVS: %s", esp_err_to_name(err));
-    return err;
+  if (ctx == NULL || !ctx->initialized) {
+    return ESP_ERR_INVALID_STATE;
+  }
+  if (ctx->nvs_namespace[0] == '\0') {
+    return ESP_ERR_NOT_SUPPORTED;
   }
 
-  uint32_t baseline_int = (uint32_t)(g_iaq_state.gas_baseline);
-  err = nvs_set_u32(nvs_handle, NVS_KEY_BASELINE, baseline_int);
+  err = nvs_open(ctx->nvs_namespace, NVS_READWRITE, &nvs_handle);
   if (err != ESP_OK) {
-    ESP_LOGE(TAG, "Failed to save baseline: %s", esp_err_to_name(err));
-    nvs_close(nvs_handle);
+    ESP_LOGE(TAG, "Failed to open NVS: %s", esp_err_to_name(err));
     return err;
   }
 
-  err = nvs_set_u32(nvs_handle, NVS_KEY_SAMPLES, g_iaq_state.samples_count);
+  err = nvs_set_blob(nvs_handle, NVS_KEY_STATE, state, sizeof(*state));
   if (err != ESP_OK) {
-    ESP_LOGE(TAG, "Failed to save samples count: %s", esp_err_to_name(err));
+    ESP_LOGE(TAG, "Failed to save state: %s", esp_err_to_name(err));
     nvs_close(nvs_handle);
     return err;
   }
@@ -414,31 +1096,435 @@ esp_err_t iaq_save_state(void) {
   nvs_close(nvs_handle);
 
   if (err == ESP_OK) {
-    ESP_LOGI(TAG, "IAQ state saved (baseline: %.0f, samples: %" PRIu32 ")",
-             g_iaq_state.gas_baseline, g_iaq_state.samples_count);
+    ESP_LOGD(TAG, "IAQ state saved (baseline: %.0f, samples: %" PRIu32 ")",
+             state->gas_baseline, state->samples_count);
   }
 
   return err;
 }
 
-esp_err_t iaq_load_state(void) {
-  nvs_handle_t nvs_handle;
-  esp_err_t err;
-
-  err = nvs_open(NVS_NAMESPACE, NVS_READONLY, &nvs_handle);
+esp_err_t iaq_ctx_save_state(iaq_ctx_t *ctx) {
+  iaq_state_blob_t state;
+  esp_err_t err = iaq_ctx_get_state(ctx, &state);
   if (err != ESP_OK) {
     return err;
   }
+  return iaq_ctx_write_state(ctx, &state);
+}
 
+/**
+ * @brief Read state saved by firmware that stored separate u32 keys
+ */
+static esp_err_t load_legacy_state(iaq_ctx_t *ctx, nvs_handle_t nvs_handle) {
   uint32_t baseline_int = 0;
-  err = nvs_get_u32(nvs_handle, NVS_KEY_BASELINE, &baseline_int);
+  uint32_t samples = 0;
+  esp_err_t err = nvs_get_u32(nvs_handle, NVS_KEY_BASELINE, &baseline_int);
   if (err == ESP_OK) {
-    g_iaq_state.gas_baseline = (float)baseline_int;
+    err = nvs_get_u32(nvs_handle, NVS_KEY_SAMPLES, &samples);
+  }
+  if (err != ESP_OK) {
+    return err;
   }
 
-  err = nvs_get_u32(nvs_handle, NVS_KEY_SAMPLES, &g_iaq_state.samples_count);
+  ctx->gas_baseline = (float)baseline_int;
+  ctx->samples_count = samples;
+  return ESP_OK;
+}
 
+/**
+ * @brief Seconds since saved_at, or the configured guess without a clock
+ */
+static uint32_t saved_age(const iaq_ctx_t *ctx, uint32_t saved_at) {
+  time_t now = time(NULL);
+  if (saved_at == 0 || now <= CLOCK_VALID_AFTER || now < (time_t)saved_at) {
+    return ctx->config.restore_unknown_age_s;
+  }
+  return (uint32_t)(now - (time_t)saved_at);
+}
+
+/**
+ * @brief Share of a calibration still trusted after age seconds
+ */
+static float age_credit(const iaq_ctx_t *ctx, uint32_t age) {
+  if (age <= ctx->config.restore_grace_s) {
+    return 1.0f;
+  }
+  return expf(-(float)(age - ctx->config.restore_grace_s) /
+              (float)ctx->config.restore_decay_s);
+}
+
+/**
+ * @brief Restore a full snapshot, trusting it according to its age
+ */
+static void restore_state(iaq_ctx_t *ctx, const iaq_state_blob_t *state) {
+  uint32_t age = saved_age(ctx, state->saved_at);
+  float credit = age_credit(ctx, age);
+
+  ctx->gas_baseline = state->gas_baseline;
+  ctx->samples_count = state->samples_count;
+  if (credit < 1.0f) {
+    // Partial burn-in: the baseline re-converges at the burn-in pace
+    uint32_t burn_in = ctx->config.burn_in_samples;
+    uint32_t samples = (state->samples_count < burn_in)
+                           ? state->samples_count
+                           : burn_in;
+    ctx->samples_count = (uint32_t)((float)samples * credit);
+  }
+
+  // The tracker is only reusable with the same percentile and epochs
+  const iaq_baseline_tracker_t *tracker = &state->baseline_tracker;
+  if (credit >= RESTORE_TRACKER_MIN_CREDIT &&
+      tracker->current.p == ctx->config.baseline_percentile &&
+      tracker->epoch_len == ctx->baseline_tracker.epoch_len) {
+    ctx->baseline_tracker = *tracker;
+  }
+
+  // The fit describes the sensor, so it is kept regardless of the off-time
+  const iaq_rls_t *fit = &state->comp_fit;
+  if (ctx->config.learn_compensation && fit->updates > 0 &&
+      isfinite(fit->theta[0]) && isfinite(fit->theta[1]) &&
+      isfinite(fit->theta[2])) {
+    ctx->comp_fit = *fit;
+    apply_compensation(ctx);
+  }
+
+  iaq_result_t result = state->last_result;
+  memset(result.window, 0, sizeof(result.window)); // The windows restart
+  result.accuracy = determine_accuracy(ctx);
+  result.samples_count = ctx->samples_count;
+  result.is_calibrated = (ctx->samples_count >= ctx->config.burn_in_samples);
+  publish_result(ctx, &result);
+
+  ESP_LOGI(TAG, "[%s] State saved %" PRIu32 " s ago%s, confidence %.0f%%",
+           ctx->nvs_namespace, age, state->saved_at ? "" : " (no clock)",
+           credit * 100.0f);
+}
+
+esp_err_t iaq_ctx_load_state(iaq_ctx_t *ctx) {
+  nvs_handle_t nvs_handle;
+  esp_err_t err;
+
+  if (ctx == NULL) {
+    return ESP_ERR_INVALID_ARG;
+  }
+  if (ctx->nvs_namespace[0] == '\0') {
+    return ESP_ERR_NOT_FOUND;
+  }
+
+  err = nvs_open(ctx->nvs_namespace, NVS_READONLY, &nvs_handle);
+  if (err != ESP_OK) {
+    return err;
+  }
+
+  iaq_state_blob_t state;
+  size_t length = sizeof(state);
+  err = nvs_get_blob(nvs_handle, NVS_KEY_STATE, &state, &length);
+  if (err == ESP_ERR_NVS_NOT_FOUND) {
+    err = load_legacy_state(ctx, nvs_handle);
+    nvs_close(nvs_handle);
+    return err;
+  }
   nvs_close(nvs_handle);
+  if (err == ESP_ERR_NVS_INVALID_LENGTH) {
+    ESP_LOGW(TAG, "[%s] Discarding oversized saved state", ctx->nvs_namespace);
+    return ESP_ERR_INVALID_SIZE;
+  }
+  if (err != ESP_OK) {
+    return err;
+  }
 
-  return err;
+  if (length != sizeof(state) || state.size != sizeof(state) ||
+      state.version != IAQ_STATE_VERSION || state.crc != state_crc(&state)) {
+    ESP_LOGW(TAG, "[%s] Discarding invalid saved state", ctx->nvs_namespace);
+    return ESP_ERR_INVALID_CRC;
+  }
+
+  restore_state(ctx, &state);
+  ctx->persist_written.gas_baseline = state.gas_baseline;
+  ctx->persist_written.samples_count = state.samples_count;
+  return ESP_OK;
+}
+
+// The record is sent between devices as is
+_Static_assert(sizeof(iaq_calib_record_t) == 44,
+               "iaq_calib_record_t must not contain padding");
+
+esp_err_t iaq_ctx_export_calibration(
+    iaq_ctx_t *ctx, const uint8_t sensor_id[IAQ_CALIB_SENSOR_ID_LEN],
+    iaq_calib_record_t *record) {
+  if (ctx == NULL || !ctx->initialized) {
+    return ESP_ERR_INVALID_STATE;
+  }
+  if (sensor_id == NULL || record == NULL) {
+    return ESP_ERR_INVALID_ARG;
+  }
+
+  if (xSemaphoreTake(ctx->mutex, pdMS_TO_TICKS(100)) != pdTRUE) {
+    return ESP_ERR_TIMEOUT;
+  }
+  if (!iaq_ctx_is_calibrated(ctx)) {
+    xSemaphoreGive(ctx->mutex);
+    return ESP_ERR_INVALID_STATE;
+  }
+  memset(record, 0, sizeof(*record));
+  record->magic = IAQ_CALIB_MAGIC;
+  record->version = IAQ_CALIB_VERSION;
+  memcpy(record->sensor_id, sensor_id, IAQ_CALIB_SENSOR_ID_LEN);
+  record->gas_baseline = ctx->gas_baseline;
+  record->baseline_percentile = ctx->config.baseline_percentile;
+  record->samples_count = ctx->samples_count;
+  record->temp_coeff = ctx->comp_temp_coeff;
+  record->ah_coeff = ctx->comp_ah_coeff;
+  record->comp_updates = ctx->comp_fit.updates;
+  xSemaphoreGive(ctx->mutex);
+
+  time_t now = time(NULL);
+  record->saved_at = (now > CLOCK_VALID_AFTER) ? (uint32_t)now : 0;
+  record->crc = esp_rom_crc32_le(0, (const uint8_t *)record,
+                                 offsetof(iaq_calib_record_t, crc));
+  return ESP_OK;
+}
+
+esp_err_t iaq_ctx_import_calibration(
+    iaq_ctx_t *ctx, const uint8_t own_id[IAQ_CALIB_SENSOR_ID_LEN],
+    const void *data, size_t length) {
+  iaq_calib_record_t record;
+
+  if (ctx == NULL || !ctx->initialized) {
+    return ESP_ERR_INVALID_STATE;
+  }
+  if (data == NULL) {
+    return ESP_ERR_INVALID_ARG;
+  }
+  if (length != sizeof(record)) {
+    return ESP_ERR_INVALID_SIZE;
+  }
+  memcpy(&record, data, sizeof(record));
+  if (record.magic != IAQ_CALIB_MAGIC ||
+      record.version != IAQ_CALIB_VERSION) {
+    return ESP_ERR_INVALID_VERSION;
+  }
+  if (record.crc != esp_rom_crc32_le(0, (const uint8_t *)&record,
+                                     offsetof(iaq_calib_record_t, crc))) {
+    return ESP_ERR_INVALID_CRC;
+  }
+  if (!(record.gas_baseline > 0.0f) || !isfinite(record.gas_baseline) ||
+      !isfinite(record.temp_coeff) || !isfinite(record.ah_coeff)) {
+    return ESP_ERR_INVALID_ARG;
+  }
+  // Our own record, retained by the broker and delivered back on connect
+  if (own_id != NULL &&
+      memcmp(record.sensor_id, own_id, IAQ_CALIB_SENSOR_ID_LEN) == 0) {
+    return ESP_ERR_INVALID_STATE;
+  }
+
+  // A record ages like saved state: the room may have changed since
+  uint32_t age = saved_age(ctx, record.saved_at);
+  uint32_t burn_in = ctx->config.burn_in_samples;
+  float credit = CALIB_IMPORT_CREDIT * age_credit(ctx, age);
+  if (record.samples_count < burn_in) {
+    credit *= (float)record.samples_count / (float)burn_in;
+  }
+  uint32_t samples = (uint32_t)((float)burn_in * credit);
+
+  if (xSemaphoreTake(ctx->mutex, pdMS_TO_TICKS(100)) != pdTRUE) {
+    return ESP_ERR_TIMEOUT;
+  }
+  // Never overwrite a baseline this sensor has established itself, nor
+  // trade its own progress for a record too stale to be worth more
+  if (iaq_ctx_is_calibrated(ctx) || samples <= ctx->samples_count) {
+    xSemaphoreGive(ctx->mutex);
+    return ESP_ERR_INVALID_STATE;
+  }
+
+  ctx->samples_count = samples;
+  ctx->gas_baseline = record.gas_baseline;
+  iaq_baseline_tracker_seed(&ctx->baseline_tracker, record.gas_baseline,
+                            CALIB_SEED_EPOCHS);
+
+  // Learned coefficients are a better prior than the defaults; this
+  // sensor's own stable-air samples refine them from here
+  if (ctx->config.learn_compensation &&
+      record.comp_updates >= COMP_LEARN_MIN_UPDATES) {
+    comp_fit_init(ctx, record.gas_baseline, record.temp_coeff,
+                  record.ah_coeff);
+    ctx->comp_fit.updates = record.comp_updates;
+    apply_compensation(ctx);
+  }
+  xSemaphoreGive(ctx->mutex);
+
+  if (record.baseline_percentile != ctx->config.baseline_percentile) {
+    ESP_LOGW(TAG, "[%s] Imported baseline is P%.0f, tracking P%.0f",
+             ctx->nvs_namespace, record.baseline_percentile * 100.0f,
+             ctx->config.baseline_percentile * 100.0f);
+  }
+  const uint8_t *id = record.sensor_id;
+  ESP_LOGI(TAG,
+           "[%s] Calibration imported from %02x%02x%02x%02x%02x%02x%02x%02x"
+           ", saved %" PRIu32 " s ago%s (baseline %.0f Ohms, %" PRIu32
+           " samples to go)",
+           ctx->nvs_namespace, id[0], id[1], id[2], id[3], id[4], id[5],
+           id[6], id[7], age, record.saved_at ? "" : " (no clock)",
+           record.gas_baseline,
+           (samples < burn_in) ? burn_in - samples : 0);
+  return ESP_OK;
+}
+
+void iaq_pipeline_float(float gas_resistance, float temperature,
+                        float humidity, float baseline,
+                        iaq_pipeline_out_t *out) {
+  out->comp_gas = compensate_gas_resistance(gas_resistance, temperature,
+                                            humidity, TEMP_COMP_COEFF,
+                                            AH_COMP_COEFF);
+  out->iaq_score = calculate_iaq_from_gas(out->comp_gas, baseline);
+  out->co2_equivalent = estimate_co2(out->iaq_score);
+  out->voc_equivalent = estimate_voc(out->comp_gas, baseline);
+}
+
+void iaq_pipeline_fixed(float gas_resistance, float temperature,
+                        float humidity, float baseline,
+                        iaq_pipeline_out_t *out) {
+  uint32_t comp = iaq_fixed_compensate(
+      gas_resistance, temperature, humidity,
+      IAQ_FIXED_COEFF_Q24(TEMP_COMP_COEFF), IAQ_FIXED_COEFF_Q24(AH_COMP_COEFF));
+  uint32_t base = to_gas_q8(baseline);
+  int32_t iaq_q8 = iaq_fixed_iaq(comp, base);
+
+  out->comp_gas = (float)comp * (1.0f / 256.0f);
+  out->iaq_score = (float)iaq_q8 * (1.0f / 256.0f);
+  out->co2_equivalent = (float)iaq_fixed_co2(iaq_q8) * (1.0f / 256.0f);
+  out->voc_equivalent = (float)iaq_fixed_voc(comp, base) * (1.0f / 65536.0f);
+}
+
+esp_err_t iaq_run_benchmark(uint32_t samples, iaq_benchmark_t *bench) {
+  if (samples == 0 || bench == NULL) {
+    return ESP_ERR_INVALID_ARG;
+  }
+
+  float gas[IAQ_BENCH_BLOCK];
+  float temperature[IAQ_BENCH_BLOCK];
+  float humidity[IAQ_BENCH_BLOCK];
+  float baseline[IAQ_BENCH_BLOCK];
+  iaq_pipeline_out_t out_float;
+  iaq_pipeline_out_t out_fixed;
+  volatile float sink = 0.0f;
+
+  // Deterministic inputs spanning every IAQ segment and the VOC clamp
+  uint32_t lcg = 12345;
+  for (int i = 0; i < IAQ_BENCH_BLOCK; i++) {
+    lcg = lcg * 1664525u + 1013904223u;
+    gas[i] = 2000.0f + (float)(lcg >> 12);
+    lcg = lcg * 1664525u + 1013904223u;
+    temperature[i] = 5.0f + (float)(lcg >> 24) * (35.0f / 256.0f);
+    lcg = lcg * 1664525u + 1013904223u;
+    humidity[i] = 10.0f + (float)(lcg >> 24) * (80.0f / 256.0f);
+    lcg = lcg * 1664525u + 1013904223u;
+    baseline[i] = 50000.0f + (float)(lcg >> 13);
+  }
+
+  memset(bench, 0, sizeof(*bench));
+  bench->samples = samples;
+
+  for (int i = 0; i < IAQ_BENCH_BLOCK; i++) {
+    iaq_pipeline_float(gas[i], temperature[i], humidity[i], baseline[i],
+                       &out_float);
+    iaq_pipeline_fixed(gas[i], temperature[i], humidity[i], baseline[i],
+                       &out_fixed);
+    bench->max_iaq_error =
+        maxf(bench->max_iaq_error,
+             fabsf(out_float.iaq_score - out_fixed.iaq_score));
+    bench->max_co2_error =
+        maxf(bench->max_co2_error,
+             fabsf(out_float.co2_equivalent - out_fixed.co2_equivalent));
+    bench->max_voc_error =
+        maxf(bench->max_voc_error,
+             fabsf(out_float.voc_equivalent - out_fixed.voc_equivalent));
+  }
+  bench->within_bounds = bench->max_iaq_error <= IAQ_FIXED_MAX_IAQ_ERROR &&
+                         bench->max_co2_error <= IAQ_FIXED_MAX_CO2_ERROR &&
+                         bench->max_voc_error <= IAQ_FIXED_MAX_VOC_ERROR;
+
+  esp_cpu_cycle_count_t start = esp_cpu_get_cycle_count();
+  for (uint32_t n = 0; n < samples; n++) {
+    int i = n % IAQ_BENCH_BLOCK;
+    iaq_pipeline_float(gas[i], temperature[i], humidity[i], baseline[i],
+                       &out_float);
+    sink = out_float.co2_equivalent + out_float.voc_equivalent;
+  }
+  esp_cpu_cycle_count_t elapsed = esp_cpu_get_cycle_count() - start;
+  bench->float_cycles = (float)elapsed / (float)samples;
+
+  start = esp_cpu_get_cycle_count();
+  for (uint32_t n = 0; n < samples; n++) {
+    int i = n % IAQ_BENCH_BLOCK;
+    iaq_pipeline_fixed(gas[i], temperature[i], humidity[i], baseline[i],
+                       &out_fixed);
+    sink = out_fixed.co2_equivalent + out_fixed.voc_equivalent;
+  }
+  elapsed = esp_cpu_get_cycle_count() - start;
+  bench->fixed_cycles = (float)elapsed / (float)samples;
+  (void)sink;
+
+  return ESP_OK;
+}
+
+iaq_ctx_t *iaq_get_default_ctx(void) { return &s_default_ctx; }
+
+esp_err_t iaq_init(void) {
+  iaq_config_t default_config;
+  iaq_get_default_config(&default_config);
+  return iaq_init_with_config(&default_config);
+}
+
+esp_err_t iaq_init_with_config(const iaq_config_t *config) {
+  return iaq_ctx_init(&s_default_ctx, config, NVS_NAMESPACE);
+}
+
+esp_err_t iaq_calculate(const iaq_raw_data_t *raw_data, iaq_result_t *result) {
+  return iaq_ctx_calculate(&s_default_ctx, raw_data, result);
+}
+
+esp_err_t iaq_calculate_batch(const iaq_raw_block_t *raw,
+                              const iaq_result_block_t *results, size_t count) {
+  return iaq_ctx_calculate_batch(&s_default_ctx, raw, results, count);
+}
+
+esp_err_t iaq_get_result(iaq_result_t *result) {
+  return iaq_ctx_get_result(&s_default_ctx, result);
+}
+
+esp_err_t iaq_get_trend(iaq_trend_t *trend) {
+  return iaq_ctx_get_trend(&s_default_ctx, trend);
+}
+
+esp_err_t iaq_get_baselines(iaq_baselines_t *baselines) {
+  return iaq_ctx_get_baselines(&s_default_ctx, baselines);
+}
+
+esp_err_t iaq_get_compensation(iaq_compensation_t *comp) {
+  return iaq_ctx_get_compensation(&s_default_ctx, comp);
+}
+
+void iaq_reset(void) { iaq_ctx_reset(&s_default_ctx); }
+
+bool iaq_is_calibrated(void) { return iaq_ctx_is_calibrated(&s_default_ctx); }
+
+uint8_t iaq_get_calibration_progress(void) {
+  return iaq_ctx_get_calibration_progress(&s_default_ctx);
+}
+
+esp_err_t iaq_save_state(void) { return iaq_ctx_save_state(&s_default_ctx); }
+
+esp_err_t iaq_load_state(void) { return iaq_ctx_load_state(&s_default_ctx); }
+
+esp_err_t iaq_export_calibration(
+    const uint8_t sensor_id[IAQ_CALIB_SENSOR_ID_LEN],
+    iaq_calib_record_t *record) {
+  return iaq_ctx_export_calibration(&s_default_ctx, sensor_id, record);
+}
+
+esp_err_t iaq_import_calibration(
+    const uint8_t own_id[IAQ_CALIB_SENSOR_ID_LEN], const void *data,
+    size_t length) {
+  return iaq_ctx_import_calibration(&s_default_ctx, own_id, data, length);
 }
@@ -7,7 +7,17 @@
 #define IAQ_CALCULATOR_H
 
 #include "esp_err.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "iaq_anomaly.h"
+#include "iaq_cusum.h"
+#include "iaq_outlier.h"
+#include "iaq_quantile.h"
+#include "iaq_rls.h"
+#include "iaq_trend.h"
+#include "iaq_window.h"
 #include <stdbool.h>
+#include <stddef.h>
 #include <stdint.h>
 
 #ifdef __cplusplus
@@ -46,8 +56,52 @@ typedef struct {
   float pressure;
   float gas_resistance;
   bool gas_valid;
+  uint32_t timestamp_ms; /**< Sample time, 0 for the time of the call */
 } iaq_raw_data_t;
 
+/**
+ * @brief Sensor channels watched by the anomaly detector
+ */
+typedef enum {
+  IAQ_CHANNEL_TEMPERATURE = 0,
+  IAQ_CHANNEL_HUMIDITY,
+  IAQ_CHANNEL_PRESSURE,
+  IAQ_CHANNEL_GAS, /**< Compensated gas resistance */
+  IAQ_CHANNEL_COUNT
+} iaq_channel_t;
+
+/** Sample spacing assumed for blocks without timestamps, and the unit the
+ *  baseline and anomaly horizons count in whatever the read cadence */
+#define IAQ_NOMINAL_INTERVAL_MS 10000
+
+/**
+ * @brief Block of raw samples in structure-of-arrays layout
+ *
+ * Samples with gas_resistance <= 0 are treated as invalid readings. Without
+ * timestamps the samples are taken to be IAQ_NOMINAL_INTERVAL_MS apart.
+ */
+typedef struct {
+  const float *temperature;
+  const float *humidity;
+  const float *pressure; /**< Optional, may be NULL */
+  const float *gas_resistance;
+  const uint32_t *timestamp_ms; /**< Optional, may be NULL */
+} iaq_raw_block_t;
+
+/**
+ * @brief Output arrays for a batch calculation
+ *
+ * All arrays hold one entry per input sample. Only iaq_score is required.
+ */
+typedef struct {
+  float *iaq_score;
+  iaq_level_t *iaq_level;
+  float *co2_equivalent;
+  float *voc_equivalent;
+  float *gas_baseline;
+  uint8_t *anomaly_flags; /**< Bit per iaq_channel_t flagged */
+} iaq_result_block_t;
+
 /**
  * @brief Complete IAQ calculation result
  */
@@ -61,8 +115,19 @@ typedef struct {
   float comp_temperature;
   float comp_humidity;
   float gas_baseline;
+  /** Baseline steps taken, one per IAQ_NOMINAL_INTERVAL_MS of readings */
   uint32_t samples_count;
   bool is_calibrated;
+  uint32_t outliers_rejected; /**< Gas readings replaced since start */
+  bool gas_outlier; /**< This reading was replaced by the window median */
+  /** Distance of this reading from its channel's recent mean, in standard
+   *  deviations, indexed by iaq_channel_t */
+  float anomaly_score[IAQ_CHANNEL_COUNT];
+  uint32_t anomalies;    /**< Readings with any channel flagged since start */
+  uint8_t anomaly_flags; /**< Bit per iaq_channel_t beyond the threshold */
+  /** Raw readings over the last window_s, indexed by iaq_channel_t; the
+   *  gas entry is the uncompensated resistance */
+  iaq_window_stats_t window[IAQ_CHANNEL_COUNT];
 } iaq_result_t;
 
 /**
@@ -71,10 +136,416 @@ typedef struct {
 typedef struct {
   float temp_offset;
   float humidity_offset;
-  uint32_t burn_in_samples;
+  uint32_t burn_in_samples; /**< Baseline steps before it is calibrated */
   float gas_recalibration_rate;
+  float baseline_percentile;         /**< Gas quantile used as baseline */
+  uint32_t baseline_horizon_samples; /**< Steps covered by the baseline */
+  uint32_t restore_grace_s; /**< Off-time restored at full confidence */
+  uint32_t restore_decay_s; /**< Confidence decay constant past the grace */
+  uint32_t restore_unknown_age_s; /**< Off-time assumed without a clock,
+                                       0 to trust such state fully */
+  uint32_t trend_window_s;        /**< Time constant of the trend fit */
+  uint8_t outlier_window; /**< Hampel window in samples, 1 or 2 disables */
+  float outlier_threshold; /**< Rejection threshold in robust std devs */
+  bool learn_compensation; /**< Learn compensation coefficients on-device */
+  uint32_t baseline_short_horizon_samples; /**< Steps covered by the
+                                                short baseline */
+  float change_limit_up;   /**< CUSUM evidence for a cleaner environment */
+  float change_limit_down; /**< CUSUM evidence for a dirtier environment */
+  uint32_t anomaly_window_samples; /**< Anomaly EWMA length, in steps */
+  float anomaly_threshold; /**< Anomaly z-score, in standard deviations */
+  uint32_t window_s; /**< Span of the sliding-window statistics */
 } iaq_config_t;
 
+/**
+ * @brief Short-term trend of the IAQ score and compensated gas resistance
+ *
+ * Slopes come from exponentially weighted line fits over about the last
+ * trend_window_s. Confidence is the share of the recent variation that the
+ * fitted line explains, so a noisy flat signal scores near 0.
+ */
+typedef struct {
+  float iaq_slope;      /**< IAQ points per minute */
+  float iaq_confidence; /**< 0..1 */
+  float gas_slope;      /**< Ohms per minute */
+  float gas_confidence; /**< 0..1 */
+  /** Predicted seconds until IAQ_LEVEL_MODERATELY_POLLUTED, 0 if already
+   *  there, negative if not expected within trend_window_s */
+  float time_to_moderate_s;
+  bool valid; /**< Calibrated and enough samples in the window */
+} iaq_trend_t;
+
+/**
+ * @brief Gas resistance compensation coefficients in use
+ *
+ * Start at TEMP_COMP_COEFF and AH_COMP_COEFF. With learn_compensation the
+ * calculator fits ln(gas) against temperature and absolute humidity by
+ * recursive least squares on stable clean-air samples and switches to the
+ * device's own coefficients once enough of them have been seen.
+ */
+typedef struct {
+  float temp_coeff; /**< Gas change per degC */
+  float ah_coeff;   /**< Gas change per g/m3 absolute humidity */
+  uint32_t updates; /**< Stable-air samples learned from */
+  bool learned;     /**< Coefficients are learned rather than defaults */
+} iaq_compensation_t;
+
+/**
+ * @brief Short and long horizon gas baselines and the change detector
+ *
+ * Both baselines are the same gas quantile, over the short and the long
+ * horizon from the configuration. A sustained relative gap between
+ * them accumulates as CUSUM evidence; once it reaches change_limit_up or
+ * change_limit_down the environment is taken to have changed and the long
+ * baseline restarts from the short one. Downward gaps also look like
+ * pollution, so their limit is set much higher, and the baseline holds
+ * still while downward evidence is building.
+ */
+typedef struct {
+  float gas_baseline;   /**< Baseline in use, Ohms */
+  float short_baseline; /**< Ohms */
+  float long_baseline;  /**< Ohms */
+  float evidence_up;    /**< Share of change_limit_up reached, 0..1 */
+  float evidence_down;  /**< Share of change_limit_down reached, 0..1 */
+  uint32_t changes;     /**< Environment changes detected since start */
+} iaq_baselines_t;
+
+#define IAQ_NVS_NAMESPACE_MAX 16
+#define IAQ_STATE_VERSION 1
+
+/**
+ * @brief Persisted estimator state, stored as a single NVS blob
+ *
+ * Holds everything needed to resume where the previous boot stopped,
+ * including the last published result. The result comes last so that
+ * fields added to it only extend the blob.
+ */
+typedef struct {
+  uint16_t version;  /**< IAQ_STATE_VERSION */
+  uint16_t size;     /**< sizeof(iaq_state_blob_t) */
+  uint32_t saved_at; /**< Wall-clock seconds, 0 if the clock was not set */
+  float gas_baseline;
+  uint32_t samples_count;
+  float gas_min; /**< Gas window extremes when saved, not restored */
+  float gas_max;
+  iaq_baseline_tracker_t baseline_tracker;
+  iaq_rls_t comp_fit; /**< Compensation fit, unused while updates is 0 */
+  iaq_result_t last_result;
+  uint32_t crc; /**< CRC32 of all preceding bytes */
+} iaq_state_blob_t;
+
+#define IAQ_CALIB_MAGIC 0x4943 // "CI" little-endian
+#define IAQ_CALIB_VERSION 1
+#define IAQ_CALIB_SENSOR_ID_LEN 8
+
+/**
+ * @brief Portable calibration record for seeding another device
+ *
+ * The compact counterpart of iaq_state_blob_t: only what describes the
+ * room and the sensor type, meant to be handed to a replacement unit over
+ * the network. Fixed layout without padding, CRC'd like the state blob.
+ */
+typedef struct {
+  uint16_t magic;     /**< IAQ_CALIB_MAGIC */
+  uint8_t version;    /**< IAQ_CALIB_VERSION */
+  uint8_t reserved;
+  uint32_t saved_at;  /**< Wall-clock seconds, 0 if the clock was not set */
+  uint8_t sensor_id[IAQ_CALIB_SENSOR_ID_LEN]; /**< Producing device */
+  float gas_baseline;
+  float baseline_percentile;
+  uint32_t samples_count;
+  float temp_coeff;      /**< Compensation in use, see iaq_compensation_t */
+  float ah_coeff;
+  uint32_t comp_updates; /**< Stable-air samples behind the coefficients */
+  uint32_t crc;          /**< CRC32 of all preceding bytes */
+} iaq_calib_record_t;
+
+/**
+ * @brief What the background writer last committed for a context
+ *
+ * Enough to judge whether a new snapshot is worth a flash write; the
+ * snapshot itself is staged by the writer, not kept per context.
+ */
+typedef struct {
+  float gas_baseline;     /**< Ohms, 0 before anything was committed */
+  uint32_t samples_count;
+  int64_t at_us;          /**< esp_timer time of the commit */
+} iaq_persist_digest_t;
+
+// Size budget of a context, in bytes: a dozen must fit in on-chip RAM
+// beside the rest of the firmware
+#define IAQ_CTX_MAX_SIZE 3584
+
+/**
+ * @brief State of one independent IAQ calculator
+ *
+ * Each context tracks its own gas baseline and persists it under its own
+ * NVS namespace. Contexts need no heap, stay under IAQ_CTX_MAX_SIZE and
+ * can be allocated statically; the fields are private to iaq_calculator.c.
+ */
+typedef struct {
+  iaq_config_t config;
+  iaq_result_t result_slots[2];
+  uint32_t result_seq;
+  SemaphoreHandle_t mutex;
+  StaticSemaphore_t mutex_buffer;
+  float gas_baseline;
+  iaq_baseline_tracker_t baseline_tracker;
+  iaq_baseline_tracker_t short_tracker;
+  iaq_cusum_t change;
+  uint32_t baseline_changes;
+  uint32_t samples_count;
+  uint32_t sample_ms;      /**< Time of the last valid reading, 0 before it */
+  int32_t baseline_due_ms; /**< Reading time not yet taken as steps */
+  iaq_trend_tracker_t trend;
+  iaq_hampel_t outlier_filter;
+  iaq_ewma_t anomaly[IAQ_CHANNEL_COUNT];
+  uint32_t anomalies;
+  iaq_window_t window[IAQ_CHANNEL_COUNT];
+  iaq_rls_t comp_fit;
+  float comp_temp_coeff;
+  float comp_ah_coeff;
+  char nvs_namespace[IAQ_NVS_NAMESPACE_MAX];
+  iaq_persist_digest_t persist_written; /**< Last state committed to flash */
+  bool persist_queued;
+  bool initialized;
+} iaq_ctx_t;
+
+/**
+ * @brief Fill a configuration structure with the default settings
+ * @param config Pointer to configuration structure
+ */
+void iaq_get_default_config(iaq_config_t *config);
+
+/**
+ * @brief Initialize an IAQ calculator context
+ * @param ctx Context to initialize
+ * @param config Pointer to configuration structure
+ * @param nvs_namespace NVS namespace for this context's saved state (max 15
+ *                      characters), or NULL to disable persistence
+ * @return ESP_OK on success
+ */
+esp_err_t iaq_ctx_init(iaq_ctx_t *ctx, const iaq_config_t *config,
+                       const char *nvs_namespace);
+
+/**
+ * @brief Process raw sensor data and calculate IAQ for one context
+ * @param ctx Calculator context
+ * @param raw_data Pointer to raw sensor data
+ * @param result Pointer to store calculation result
+ * @return ESP_OK on success, ESP_ERR_INVALID_ARG on invalid input
+ */
+esp_err_t iaq_ctx_calculate(iaq_ctx_t *ctx, const iaq_raw_data_t *raw_data,
+                            iaq_result_t *result);
+
+/**
+ * @brief Process a block of samples for one context
+ * @see iaq_calculate_batch()
+ */
+esp_err_t iaq_ctx_calculate_batch(iaq_ctx_t *ctx, const iaq_raw_block_t *raw,
+                                  const iaq_result_block_t *results,
+                                  size_t count);
+
+/**
+ * @brief Get the latest result of one context (lock-free)
+ * @param ctx Calculator context
+ * @param result Pointer to store latest IAQ result
+ * @return ESP_OK on success
+ */
+esp_err_t iaq_ctx_get_result(const iaq_ctx_t *ctx, iaq_result_t *result);
+
+/**
+ * @brief Reset the algorithm state of one context (restart calibration)
+ * @param ctx Calculator context
+ */
+void iaq_ctx_reset(iaq_ctx_t *ctx);
+
+/**
+ * @brief Check if a context is calibrated
+ * @param ctx Calculator context
+ * @return true if calibrated, false otherwise
+ */
+bool iaq_ctx_is_calibrated(const iaq_ctx_t *ctx);
+
+/**
+ * @brief Get calibration progress of a context
+ * @param ctx Calculator context
+ * @return Progress percentage (0-100)
+ */
+uint8_t iaq_ctx_get_calibration_progress(const iaq_ctx_t *ctx);
+
+/**
+ * @brief Get the current trend of a context
+ * @param ctx Calculator context
+ * @param trend Pointer to store the trend
+ * @return ESP_OK on success, ESP_ERR_TIMEOUT if the context is busy
+ */
+esp_err_t iaq_ctx_get_trend(iaq_ctx_t *ctx, iaq_trend_t *trend);
+
+/**
+ * @brief Get the baselines and change detector state of a context
+ * @param ctx Calculator context
+ * @param baselines Pointer to store the baselines
+ * @return ESP_OK on success, ESP_ERR_TIMEOUT if the context is busy
+ */
+esp_err_t iaq_ctx_get_baselines(iaq_ctx_t *ctx, iaq_baselines_t *baselines);
+
+/**
+ * @brief Get the compensation coefficients a context currently applies
+ * @param ctx Calculator context
+ * @param comp Pointer to store the coefficients
+ * @return ESP_OK on success, ESP_ERR_TIMEOUT if the context is busy
+ */
+esp_err_t iaq_ctx_get_compensation(iaq_ctx_t *ctx, iaq_compensation_t *comp);
+
+/**
+ * @brief Save the calibration state of a context to its NVS namespace
+ * @param ctx Calculator context
+ * @return ESP_OK on success, ESP_ERR_NOT_SUPPORTED without a namespace
+ */
+esp_err_t iaq_ctx_save_state(iaq_ctx_t *ctx);
+
+/**
+ * @brief Snapshot the calibration state of a context
+ * @param ctx Calculator context
+ * @param state Snapshot, with version, size and CRC filled in
+ * @return ESP_OK on success
+ */
+esp_err_t iaq_ctx_get_state(iaq_ctx_t *ctx, iaq_state_blob_t *state);
+
+/**
+ * @brief Write a state snapshot to the context's NVS namespace and commit
+ *
+ * Blocks for the duration of the flash write; use iaq_ctx_request_save()
+ * from iaq_persist.h on time-critical tasks.
+ *
+ * @param ctx Calculator context
+ * @param state Snapshot from iaq_ctx_get_state()
+ * @return ESP_OK on success, ESP_ERR_NOT_SUPPORTED for volatile contexts
+ */
+esp_err_t iaq_ctx_write_state(const iaq_ctx_t *ctx,
+                              const iaq_state_blob_t *state);
+
+/**
+ * @brief Load the calibration state of a context from its NVS namespace
+ *
+ * Reads the state blob and rejects it on a version, size or CRC mismatch.
+ * Without a blob, the baseline and sample count saved as separate keys by
+ * older firmware are still accepted.
+ *
+ * The restored state is trusted according to how long the device was off:
+ * up to restore_grace_s it resumes at full accuracy, beyond that the
+ * calibration credit decays with restore_decay_s, sending the calculator
+ * back into (partial) burn-in. When the wall clock was not set at save or
+ * load time the off-time is taken as restore_unknown_age_s, by default
+ * beyond the grace period so that a restart without a clock always
+ * repeats part of burn-in.
+ *
+ * @param ctx Calculator context
+ * @return ESP_OK on success, ESP_ERR_NOT_FOUND if no saved state,
+ *         ESP_ERR_INVALID_CRC if the saved state is corrupt
+ */
+esp_err_t iaq_ctx_load_state(iaq_ctx_t *ctx);
+
+/**
+ * @brief Export the calibration of a context as a portable record
+ * @param ctx Calculator context
+ * @param sensor_id Identifier of this device, e.g. its MAC address padded
+ *                  with zeros, stored in the record
+ * @param record Record, with magic, version and CRC filled in
+ * @return ESP_OK on success, ESP_ERR_INVALID_STATE before calibration
+ */
+esp_err_t iaq_ctx_export_calibration(
+    iaq_ctx_t *ctx, const uint8_t sensor_id[IAQ_CALIB_SENSOR_ID_LEN],
+    iaq_calib_record_t *record);
+
+/**
+ * @brief Seed an uncalibrated context from another device's record
+ *
+ * The baseline and compensation are taken over, but with reduced
+ * confidence: the calculator resumes close to the end of burn-in, so it
+ * reports calibrated after a few samples instead of a full burn-in, and
+ * the imported baseline only counts for part of the baseline horizon, so
+ * this sensor's own readings take over as they accumulate.
+ *
+ * The record's age since saved_at is trusted like restored state, with
+ * restore_grace_s and restore_decay_s, and restore_unknown_age_s when
+ * either device had no clock; an old record resumes further from the end
+ * of burn-in.
+ *
+ * @param ctx Calculator context
+ * @param own_id Identifier of this device, whose own records are refused;
+ *               NULL to accept any
+ * @param data Received record
+ * @param length Length of data in bytes
+ * @return ESP_OK on success, ESP_ERR_INVALID_SIZE, ESP_ERR_INVALID_VERSION
+ *         or ESP_ERR_INVALID_CRC for a malformed record,
+ *         ESP_ERR_INVALID_ARG for implausible values,
+ *         ESP_ERR_INVALID_STATE for this device's own record, a context
+ *         that is already calibrated, or one that has made as much
+ *         progress itself as the aged record would give it
+ */
+esp_err_t iaq_ctx_import_calibration(
+    iaq_ctx_t *ctx, const uint8_t own_id[IAQ_CALIB_SENSOR_ID_LEN],
+    const void *data, size_t length);
+
+/**
+ * @brief Outputs of one stateless pass through the IAQ pipeline
+ */
+typedef struct {
+  float comp_gas;
+  float iaq_score;
+  float co2_equivalent;
+  float voc_equivalent;
+} iaq_pipeline_out_t;
+
+/**
+ * @brief Fixed-point versus float pipeline benchmark
+ *
+ * Cycle counts are per sample. The errors are the largest absolute
+ * differences between both pipelines over the benchmark inputs.
+ */
+typedef struct {
+  uint32_t samples;
+  float float_cycles;
+  float fixed_cycles;
+  float max_iaq_error;
+  float max_co2_error;
+  float max_voc_error;
+  bool within_bounds; /**< Errors within the IAQ_FIXED_MAX_* bounds */
+} iaq_benchmark_t;
+
+/**
+ * @brief Run the float pipeline on one sample with a given baseline
+ *
+ * Stateless, for comparing against iaq_pipeline_fixed(). The calculator
+ * uses the fixed-point pipeline when CONFIG_IAQ_FIXED_POINT is set.
+ */
+void iaq_pipeline_float(float gas_resistance, float temperature,
+                        float humidity, float baseline,
+                        iaq_pipeline_out_t *out);
+
+/**
+ * @brief Run the fixed-point pipeline on one sample with a given baseline
+ */
+void iaq_pipeline_fixed(float gas_resistance, float temperature,
+                        float humidity, float baseline,
+                        iaq_pipeline_out_t *out);
+
+/**
+ * @brief Measure both pipelines with the CPU cycle counter
+ * @param samples Number of samples to time per pipeline
+ * @param bench Benchmark results
+ * @return ESP_OK on success, ESP_ERR_INVALID_ARG on bad arguments
+ */
+esp_err_t iaq_run_benchmark(uint32_t samples, iaq_benchmark_t *bench);
+
+/**
+ * @brief Get the default context used by the iaq_* functions below
+ * @return Pointer to the default context
+ */
+iaq_ctx_t *iaq_get_default_ctx(void);
+
 /**
  * @brief Initialize IAQ calculator with default configuration
  * @return ESP_OK on success
@@ -97,17 +568,66 @@ esp_err_t iaq_init_with_config(const iaq_config_t *config);
 esp_err_t iaq_calculate(const iaq_raw_data_t *raw_data, iaq_result_t *result);
 
 /**
- * @brief Get the current IAQ result (thread-safe)
+ * @brief Process a block of samples in one call
+ *
+ * Takes the calculator mutex once for the whole block and produces the same
+ * values as calling iaq_calculate() on each sample in order. Invalid samples
+ * get score 0 and IAQ_LEVEL_UNKNOWN and leave the baseline untouched. The
+ * result of the last valid sample is published to iaq_get_result().
+ *
+ * @param raw Input sample arrays
+ * @param results Output arrays
+ * @param count Number of samples
+ * @return ESP_OK on success, ESP_ERR_INVALID_ARG on missing arrays
+ */
+esp_err_t iaq_calculate_batch(const iaq_raw_block_t *raw,
+                              const iaq_result_block_t *results, size_t count);
+
+/**
+ * @brief Get the current IAQ result (thread-safe, lock-free)
+ *
+ * Readers never take the calculator mutex, so any number of tasks can poll
+ * the latest result without delaying iaq_calculate(). A reader copies the
+ * result again if it was overwritten during the copy.
+ *
  * @param result Pointer to store latest IAQ result
  * @return ESP_OK on success
  */
 esp_err_t iaq_get_result(iaq_result_t *result);
 
+/**
+ * @brief Get the current IAQ trend
+ * @param trend Pointer to store the trend
+ * @return ESP_OK on success
+ */
+esp_err_t iaq_get_trend(iaq_trend_t *trend);
+
+/**
+ * @brief Get the short and long horizon baselines
+ * @param baselines Pointer to store the baselines
+ * @return ESP_OK on success
+ */
+esp_err_t iaq_get_baselines(iaq_baselines_t *baselines);
+
+/**
+ * @brief Get the compensation coefficients currently applied
+ * @param comp Pointer to store the coefficients
+ * @return ESP_OK on success
+ */
+esp_err_t iaq_get_compensation(iaq_compensation_t *comp);
+
 /**
  * @brief Reset IAQ algorithm state (restart calibration)
  */
 void iaq_reset(void);
 
+/**
+ * @brief Get the IAQ level a score falls in
+ * @param iaq_score IAQ score, 0..500
+ * @return IAQ level enum value
+ */
+iaq_level_t iaq_score_to_level(float iaq_score);
+
 /**
  * @brief Get string description for IAQ level
  * @param level IAQ level enum value
@@ -153,6 +673,22 @@ esp_err_t iaq_save_state(void);
  */
 esp_err_t iaq_load_state(void);
 
+/**
+ * @brief Export the current calibration as a portable record
+ * @see iaq_ctx_export_calibration()
+ */
+esp_err_t iaq_export_calibration(
+    const uint8_t sensor_id[IAQ_CALIB_SENSOR_ID_LEN],
+    iaq_calib_record_t *record);
+
+/**
+ * @brief Seed the calculator from another device's calibration record
+ * @see iaq_ctx_import_calibration()
+ */
+esp_err_t iaq_import_calibration(
+    const uint8_t own_id[IAQ_CALIB_SENSOR_ID_LEN], const void *data,
+    size_t length);
+
 #ifdef __cplusplus
 }
 #endif
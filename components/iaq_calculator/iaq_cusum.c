@@ -0,0 +1,37 @@
+/**
+ * @file iaq_cusum.c
+ * @brief Two-sided CUSUM change detector implementation
+ */
+
+#include "iaq_cusum.h"
+
+void iaq_cusum_init(iaq_cusum_t *cusum, float drift, float limit_up,
+                    float limit_down) {
+  cusum->drift = drift;
+  cusum->limit_up = limit_up;
+  cusum->limit_down = limit_down;
+  iaq_cusum_reset(cusum);
+}
+
+int iaq_cusum_add(iaq_cusum_t *cusum, float x) {
+  float up = cusum->up + x - cusum->drift;
+  float down = cusum->down - x - cusum->drift;
+  cusum->up = (up > 0.0f) ? up : 0.0f;
+  cusum->down = (down > 0.0f) ? down : 0.0f;
+
+  int change = 0;
+  if (cusum->up > cusum->limit_up) {
+    change = 1;
+  } else if (cusum->down > cusum->limit_down) {
+    change = -1;
+  }
+  if (change != 0) {
+    iaq_cusum_reset(cusum);
+  }
+  return change;
+}
+
+void iaq_cusum_reset(iaq_cusum_t *cusum) {
+  cusum->up = 0.0f;
+  cusum->down = 0.0f;
+}
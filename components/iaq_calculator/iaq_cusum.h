@@ -0,0 +1,62 @@
+/**
+ * @file iaq_cusum.h
+ * @brief Two-sided CUSUM change detector
+ */
+
+#ifndef IAQ_CUSUM_H
+#define IAQ_CUSUM_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Page's cumulative sum test for a shift of a zero-mean signal
+ *
+ * Deviations beyond drift accumulate in one sum per direction and bleed
+ * off otherwise, so brief excursions are forgotten while a sustained shift
+ * crosses its limit. The limits are separate, so one direction can demand
+ * more evidence than the other.
+ */
+typedef struct {
+  float up;   /**< Evidence for an upward shift */
+  float down; /**< Evidence for a downward shift */
+  float drift;
+  float limit_up;
+  float limit_down;
+} iaq_cusum_t;
+
+/**
+ * @brief Initialize a detector
+ * @param cusum Detector to initialize
+ * @param drift Deviation tolerated without accumulating evidence
+ * @param limit_up Evidence that signals an upward shift
+ * @param limit_down Evidence that signals a downward shift
+ */
+void iaq_cusum_init(iaq_cusum_t *cusum, float drift, float limit_up,
+                    float limit_down);
+
+/**
+ * @brief Add one deviation
+ *
+ * Both sums restart after a detection.
+ *
+ * @param cusum Detector
+ * @param x Deviation from the reference level
+ * @return 1 for an upward shift, -1 for a downward shift, 0 otherwise
+ */
+int iaq_cusum_add(iaq_cusum_t *cusum, float x);
+
+/**
+ * @brief Discard the accumulated evidence
+ * @param cusum Detector
+ */
+void iaq_cusum_reset(iaq_cusum_t *cusum);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // IAQ_CUSUM_H
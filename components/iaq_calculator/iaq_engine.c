@@ -0,0 +1,121 @@
+/**
+ * @file iaq_engine.c
+ * @brief Built-in IAQ scoring engines
+ */
+
+#include "iaq_engine.h"
+#include "iaq_humidity.h"
+#include "iaq_params.h"
+#include <math.h>
+
+// IAQ points per halving of the gas resistance relative to clean air
+#define LOG_RATIO_SLOPE 100.0f
+#define LOG_RATIO_CLEAN 50.0f
+// Learned engine: same priors and memory as the calculator's compensation
+// fit; after warm-up, readings below 80% of the predicted clean-air
+// resistance are learned as if they were at 80%
+#define LEARNED_LAMBDA 0.99995f
+#define LEARNED_WARMUP 50
+#define LEARNED_MAX_DEFICIT 0.2231f // ln(1 / 0.8)
+#define LOG2_E 1.4426950f
+
+static inline float clamp_score(float iaq) {
+  iaq = (iaq < 0.0f) ? 0.0f : iaq;
+  return (iaq > 500.0f) ? 500.0f : iaq;
+}
+
+static esp_err_t piecewise_init(void *state) {
+  iaq_config_t config;
+  iaq_get_default_config(&config);
+  return iaq_ctx_init(state, &config, NULL);
+}
+
+static esp_err_t piecewise_update(void *state, const iaq_raw_data_t *raw,
+                                  float *iaq_score) {
+  iaq_result_t result;
+  esp_err_t err = iaq_ctx_calculate(state, raw, &result);
+  *iaq_score = result.iaq_score;
+  return err;
+}
+
+const iaq_engine_t iaq_engine_piecewise = {
+    .name = "piecewise",
+    .state_size = sizeof(iaq_ctx_t),
+    .init = piecewise_init,
+    .update = piecewise_update,
+};
+
+static esp_err_t percentile_init(void *state) {
+  iaq_engine_percentile_state_t *s = state;
+  iaq_config_t config;
+  iaq_get_default_config(&config);
+  iaq_baseline_tracker_init(&s->baseline, config.baseline_percentile,
+                            config.baseline_horizon_samples);
+  s->samples = 0;
+  return ESP_OK;
+}
+
+static esp_err_t percentile_update(void *state, const iaq_raw_data_t *raw,
+                                   float *iaq_score) {
+  iaq_engine_percentile_state_t *s = state;
+  float abs_humidity = iaq_absolute_humidity(raw->temperature, raw->humidity);
+  float comp = raw->gas_resistance *
+               (1.0f + TEMP_COMP_COEFF * (raw->temperature - TEMP_COMP_REF)) /
+               (1.0f + AH_COMP_COEFF * (abs_humidity - AH_COMP_REF));
+
+  iaq_baseline_tracker_add(&s->baseline, comp);
+  s->samples++;
+  float baseline = iaq_baseline_tracker_get(&s->baseline);
+  *iaq_score =
+      clamp_score(LOG_RATIO_CLEAN + LOG_RATIO_SLOPE * log2f(baseline / comp));
+  return ESP_OK;
+}
+
+const iaq_engine_t iaq_engine_percentile = {
+    .name = "percentile",
+    .state_size = sizeof(iaq_engine_percentile_state_t),
+    .init = percentile_init,
+    .update = percentile_update,
+};
+
+static esp_err_t learned_init(void *state) {
+  iaq_engine_learned_state_t *s = state;
+  const float theta[IAQ_RLS_PARAMS] = {logf(GAS_BASELINE_DEFAULT),
+                                       -TEMP_COMP_COEFF, AH_COMP_COEFF};
+  const float p0[IAQ_RLS_PARAMS] = {4.0f, 1e-4f, 9e-4f};
+  iaq_rls_init(&s->clean_air, theta, p0, LEARNED_LAMBDA);
+  s->samples = 0;
+  return ESP_OK;
+}
+
+static esp_err_t learned_update(void *state, const iaq_raw_data_t *raw,
+                                float *iaq_score) {
+  iaq_engine_learned_state_t *s = state;
+  float abs_humidity = iaq_absolute_humidity(raw->temperature, raw->humidity);
+  const float x[IAQ_RLS_PARAMS] = {1.0f, raw->temperature - TEMP_COMP_REF,
+                                   abs_humidity - AH_COMP_REF};
+  const float *theta = s->clean_air.theta;
+  float clean = theta[0] + theta[1] * x[1] + theta[2] * x[2];
+  float y = logf(raw->gas_resistance);
+
+  // Clean air minus this reading, in ln units: positive when polluted
+  float deficit = clean - y;
+  s->samples++;
+  if (s->samples > LEARNED_WARMUP && deficit > LEARNED_MAX_DEFICIT) {
+    // Clipped, so pollution events barely move the model while a lasting
+    // shift is still absorbed within the fit's memory
+    y = clean - LEARNED_MAX_DEFICIT;
+  }
+  iaq_rls_update(&s->clean_air, x, y);
+
+  *iaq_score = clamp_score(LOG_RATIO_CLEAN +
+                           LOG_RATIO_SLOPE * deficit * LOG2_E);
+  return ESP_OK;
+}
+
+const iaq_engine_t iaq_engine_learned = {
+    .name = "learned",
+    .state_size = sizeof(iaq_engine_learned_state_t),
+    .init = learned_init,
+    .update = learned_update,
+};
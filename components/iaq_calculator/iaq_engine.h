@@ -0,0 +1,90 @@
+/**
+ * @file iaq_engine.h
+ * @brief Interchangeable IAQ scoring engines
+ *
+ * An engine turns the stream of raw readings into IAQ scores. Engines keep
+ * all their state in a caller-provided buffer of state_size bytes, so any
+ * number of them can run side by side on the same readings without heap;
+ * see iaq_eval.h for comparing them.
+ */
+
+#ifndef IAQ_ENGINE_H
+#define IAQ_ENGINE_H
+
+#include "esp_err.h"
+#include "iaq_calculator.h"
+#include "iaq_quantile.h"
+#include "iaq_rls.h"
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief IAQ engine operations
+ */
+typedef struct {
+  const char *name;
+  size_t state_size; /**< Bytes of state, aligned like any C object */
+  /**
+   * @brief Start the engine from scratch
+   * @param state state_size bytes
+   */
+  esp_err_t (*init)(void *state);
+  /**
+   * @brief Score one reading
+   * @param state State set up by init
+   * @param raw Reading with a valid gas resistance
+   * @param iaq_score Output, 0..500
+   */
+  esp_err_t (*update)(void *state, const iaq_raw_data_t *raw,
+                      float *iaq_score);
+} iaq_engine_t;
+
+/**
+ * @brief State of the percentile engine
+ */
+typedef struct {
+  iaq_baseline_tracker_t baseline;
+  uint32_t samples;
+} iaq_engine_percentile_state_t;
+
+/**
+ * @brief State of the learned engine
+ */
+typedef struct {
+  iaq_rls_t clean_air; /**< ln(gas) of clean air against T and AH */
+  uint32_t samples;
+} iaq_engine_learned_state_t;
+
+/**
+ * @brief The calculator itself: a volatile iaq_ctx_t with the default
+ *        configuration, piecewise-linear mapping and all its filters
+ */
+extern const iaq_engine_t iaq_engine_piecewise;
+
+/**
+ * @brief Default compensation, the baseline quantile over the default
+ *        horizon taken as is, and a log-ratio mapping:
+ *        50 + 100 * log2(baseline / gas)
+ */
+extern const iaq_engine_t iaq_engine_percentile;
+
+/**
+ * @brief Learned clean-air model
+ *
+ * Fits ln(gas) of clean air against temperature and absolute humidity by
+ * recursive least squares, with readings well below the model clipped
+ * towards it, and maps how far a reading falls below its predicted
+ * clean-air resistance like the percentile engine. Compensation and
+ * baseline come out of the same fit.
+ */
+extern const iaq_engine_t iaq_engine_learned;
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // IAQ_ENGINE_H
@@ -0,0 +1,115 @@
+/**
+ * @file iaq_eval.c
+ * @brief Side-by-side evaluation of IAQ engines
+ */
+
+#include "iaq_eval.h"
+#include "esp_cpu.h"
+#include <math.h>
+#include <string.h>
+
+esp_err_t iaq_eval_init(iaq_eval_t *eval, const iaq_engine_t *const *engines,
+                        void *const *states, size_t count) {
+  if (eval == NULL || engines == NULL || states == NULL || count == 0 ||
+      count > IAQ_EVAL_MAX_ENGINES) {
+    return ESP_ERR_INVALID_ARG;
+  }
+
+  memset(eval, 0, sizeof(*eval));
+  for (size_t i = 0; i < count; i++) {
+    if (engines[i] == NULL || states[i] == NULL) {
+      return ESP_ERR_INVALID_ARG;
+    }
+    esp_err_t err = engines[i]->init(states[i]);
+    if (err != ESP_OK) {
+      return err;
+    }
+    eval->engine[i].engine = engines[i];
+    eval->engine[i].state = states[i];
+  }
+  eval->count = count;
+  return ESP_OK;
+}
+
+esp_err_t iaq_eval_add(iaq_eval_t *eval, const iaq_raw_data_t *raw,
+                       float *scores) {
+  if (eval == NULL || eval->count == 0 || raw == NULL || !raw->gas_valid ||
+      raw->gas_resistance <= 0) {
+    return ESP_ERR_INVALID_ARG;
+  }
+
+  float score[IAQ_EVAL_MAX_ENGINES];
+  uint32_t cycles[IAQ_EVAL_MAX_ENGINES];
+  for (size_t i = 0; i < eval->count; i++) {
+    iaq_eval_engine_t *e = &eval->engine[i];
+    esp_cpu_cycle_count_t start = esp_cpu_get_cycle_count();
+    esp_err_t err = e->engine->update(e->state, raw, &score[i]);
+    cycles[i] = (uint32_t)(esp_cpu_get_cycle_count() - start);
+    if (err != ESP_OK) {
+      return err;
+    }
+  }
+
+  // Welford's updates; the co-moment pairs the reference's deviation from
+  // its previous mean with the engine's from its updated one
+  eval->samples++;
+  float n = (float)eval->samples;
+  float ref = score[0];
+  float ref_dev = ref - eval->engine[0].mean;
+  iaq_level_t ref_level = iaq_score_to_level(ref);
+  for (size_t i = 0; i < eval->count; i++) {
+    iaq_eval_engine_t *e = &eval->engine[i];
+    e->cycles += cycles[i];
+    if (cycles[i] > e->max_cycles) {
+      e->max_cycles = cycles[i];
+    }
+
+    float dev = score[i] - e->mean;
+    e->mean += dev / n;
+    e->m2 += dev * (score[i] - e->mean);
+    e->co += ref_dev * (score[i] - e->mean);
+
+    float diff = fabsf(score[i] - ref);
+    e->diff += (diff - e->diff) / n;
+    if (diff > e->max_diff) {
+      e->max_diff = diff;
+    }
+    if (iaq_score_to_level(score[i]) == ref_level) {
+      e->same_level++;
+    }
+  }
+
+  if (scores != NULL) {
+    memcpy(scores, score, eval->count * sizeof(float));
+  }
+  return ESP_OK;
+}
+
+esp_err_t iaq_eval_get(const iaq_eval_t *eval, size_t index,
+                       iaq_eval_stats_t *stats) {
+  if (eval == NULL || stats == NULL || index >= eval->count) {
+    return ESP_ERR_INVALID_ARG;
+  }
+
+  const iaq_eval_engine_t *e = &eval->engine[index];
+  const iaq_eval_engine_t *ref = &eval->engine[0];
+  memset(stats, 0, sizeof(*stats));
+  stats->name = e->engine->name;
+  stats->state_bytes = e->engine->state_size;
+  stats->samples = eval->samples;
+  if (eval->samples == 0) {
+    return ESP_OK;
+  }
+
+  float n = (float)eval->samples;
+  stats->cycles = (float)e->cycles / n;
+  stats->max_cycles = e->max_cycles;
+  stats->mean_score = e->mean;
+  stats->mean_abs_diff = e->diff;
+  stats->max_abs_diff = e->max_diff;
+  stats->level_agreement = (float)e->same_level / n;
+  if (ref->m2 > 0.0f && e->m2 > 0.0f) {
+    stats->correlation = e->co / sqrtf(ref->m2 * e->m2);
+  }
+  return ESP_OK;
+}
@@ -0,0 +1,103 @@
+/**
+ * @file iaq_eval.h
+ * @brief Side-by-side evaluation of IAQ engines
+ *
+ * Feeds every reading to several engines, timing each update with the CPU
+ * cycle counter and comparing every engine's scores with those of the
+ * first, the reference. All statistics are running, so an evaluation can
+ * cover an unbounded stream on-device as well as a replayed log.
+ */
+
+#ifndef IAQ_EVAL_H
+#define IAQ_EVAL_H
+
+#include "esp_err.h"
+#include "iaq_engine.h"
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define IAQ_EVAL_MAX_ENGINES 4
+
+/**
+ * @brief Cost and agreement of one engine
+ */
+typedef struct {
+  const char *name;
+  size_t state_bytes;
+  uint32_t samples;      /**< Readings scored */
+  float cycles;          /**< Mean CPU cycles per update */
+  uint32_t max_cycles;   /**< Slowest update */
+  float mean_score;
+  float mean_abs_diff;   /**< Mean |score - reference score| */
+  float max_abs_diff;
+  float level_agreement; /**< Share of readings on the reference's level */
+  float correlation;     /**< Pearson correlation with the reference */
+} iaq_eval_stats_t;
+
+/**
+ * @brief Running statistics of one engine, private to iaq_eval.c
+ */
+typedef struct {
+  const iaq_engine_t *engine;
+  void *state;
+  uint64_t cycles;
+  uint32_t max_cycles;
+  float mean;    /**< Running mean score */
+  float m2;      /**< Sum of squared deviations from the mean */
+  float co;      /**< Co-moment with the reference */
+  float diff;    /**< Running mean |difference| */
+  float max_diff;
+  uint32_t same_level;
+} iaq_eval_engine_t;
+
+/**
+ * @brief Evaluation of up to IAQ_EVAL_MAX_ENGINES engines
+ */
+typedef struct {
+  iaq_eval_engine_t engine[IAQ_EVAL_MAX_ENGINES];
+  size_t count;
+  uint32_t samples;
+} iaq_eval_t;
+
+/**
+ * @brief Initialize every engine and start an evaluation
+ * @param eval Evaluation to initialize
+ * @param engines Engines, the first one being the reference
+ * @param states One buffer of engines[i]->state_size bytes per engine
+ * @param count Number of engines, 1..IAQ_EVAL_MAX_ENGINES
+ * @return ESP_OK, ESP_ERR_INVALID_ARG, or the first engine init error
+ */
+esp_err_t iaq_eval_init(iaq_eval_t *eval, const iaq_engine_t *const *engines,
+                        void *const *states, size_t count);
+
+/**
+ * @brief Score one reading with every engine
+ * @param eval Evaluation
+ * @param raw Reading
+ * @param scores Optional output, one score per engine
+ * @return ESP_OK, ESP_ERR_INVALID_ARG for an invalid gas reading, which no
+ *         engine sees, or the first engine error, in which case the
+ *         reading is not counted
+ */
+esp_err_t iaq_eval_add(iaq_eval_t *eval, const iaq_raw_data_t *raw,
+                       float *scores);
+
+/**
+ * @brief Statistics of one engine so far
+ * @param eval Evaluation
+ * @param index Engine index as passed to iaq_eval_init()
+ * @param stats Output
+ * @return ESP_OK, or ESP_ERR_INVALID_ARG for an unknown index
+ */
+esp_err_t iaq_eval_get(const iaq_eval_t *eval, size_t index,
+                       iaq_eval_stats_t *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // IAQ_EVAL_H
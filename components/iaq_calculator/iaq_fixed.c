@@ -0,0 +1,122 @@
+/**
+ * @file iaq_fixed.c
+ * @brief Q-format fixed-point IAQ pipeline implementation
+ */
+
+#include "iaq_fixed.h"
+#include "iaq_humidity.h"
+#include "iaq_params.h"
+
+// Compile-time conversion of a positive float constant to Qn
+#define Q(x, n) ((int64_t)((x) * (float)(1LL << (n)) + 0.5f))
+
+#define ONE_Q16 (1 << 16)
+#define ONE_Q24 (1 << 24)
+#define RATIO_MAX_Q16 (2 << 16)
+// Well past the inverse ratio at which the VOC estimate saturates
+#define INV_RATIO_MAX_Q24 (1024ull << 24)
+
+/**
+ * @brief One segment of the piecewise IAQ mapping
+ *
+ * iaq = base + slope * (knot - ratio) for ratios below the upper bound.
+ */
+typedef struct {
+  int32_t upper_q16;
+  int32_t knot_q16;
+  int32_t base_q8;
+  uint32_t slope_q8; /**< IAQ points per unit ratio */
+} iaq_segment_t;
+
+static const iaq_segment_t s_segments[] = {
+    {(int32_t)Q(0.1f, 16), (int32_t)Q(0.1f, 16), 350 << 8, 1500u << 8},
+    {(int32_t)Q(0.2f, 16), (int32_t)Q(0.2f, 16), 250 << 8, 1000u << 8},
+    {(int32_t)Q(0.5f, 16), (int32_t)Q(0.5f, 16), 150 << 8,
+     (uint32_t)Q(100.0f / 0.3f, 8)},
+    {ONE_Q16, ONE_Q16, 50 << 8, 200u << 8},
+    {RATIO_MAX_Q16 + 1, RATIO_MAX_Q16, 0, 50u << 8},
+};
+
+static inline int32_t clamp_i32(int32_t x, int32_t lo, int32_t hi) {
+  x = (x < lo) ? lo : x;
+  return (x > hi) ? hi : x;
+}
+
+static inline int32_t to_q16(float x) {
+  return (int32_t)(x * 65536.0f + ((x < 0.0f) ? -0.5f : 0.5f));
+}
+
+uint32_t iaq_fixed_compensate(float gas_resistance, float temperature,
+                              float humidity, int32_t temp_coeff_q24,
+                              int32_t ah_coeff_q24) {
+  if (!(gas_resistance > 0.0f)) {
+    return 0;
+  }
+  if (gas_resistance >= (float)(UINT32_MAX >> 8)) {
+    return UINT32_MAX;
+  }
+
+  uint32_t gas_q8 = (uint32_t)(gas_resistance * 256.0f + 0.5f);
+  int32_t temp_q16 = to_q16(temperature);
+  int32_t ah_q16 = iaq_absolute_humidity_q16(temp_q16, to_q16(humidity));
+
+  // 1 + coeff * (x - ref) in Q16, with the coefficients in Q24
+  int32_t temp_factor =
+      ONE_Q16 + (int32_t)(((int64_t)temp_coeff_q24 *
+                           (temp_q16 - (int32_t)Q(TEMP_COMP_REF, 16))) >>
+                          24);
+  int32_t hum_factor =
+      ONE_Q16 + (int32_t)(((int64_t)ah_coeff_q24 *
+                           (ah_q16 - (int32_t)Q(AH_COMP_REF, 16))) >>
+                          24);
+  if (temp_factor <= 0 || hum_factor <= 0) {
+    return 0;
+  }
+
+  uint64_t comp = ((uint64_t)gas_q8 * (uint32_t)temp_factor +
+                   (uint32_t)hum_factor / 2) /
+                  (uint32_t)hum_factor;
+  return (comp > UINT32_MAX) ? UINT32_MAX : (uint32_t)comp;
+}
+
+int32_t iaq_fixed_iaq(uint32_t comp_gas_q8, uint32_t baseline_q8) {
+  baseline_q8 =
+      (baseline_q8 > 0) ? baseline_q8 : (uint32_t)Q(GAS_BASELINE_DEFAULT, 8);
+
+  uint64_t ratio =
+      (((uint64_t)comp_gas_q8 << 16) + baseline_q8 / 2) / baseline_q8;
+  int32_t r = (ratio < RATIO_MAX_Q16) ? (int32_t)ratio : RATIO_MAX_Q16;
+
+  const iaq_segment_t *seg = s_segments;
+  while (r >= seg->upper_q16) {
+    seg++;
+  }
+
+  uint64_t delta = (uint64_t)(seg->knot_q16 - r);
+  int32_t iaq =
+      seg->base_q8 + (int32_t)((seg->slope_q8 * delta + (1u << 15)) >> 16);
+  return clamp_i32(iaq, 0, 500 << 8);
+}
+
+int32_t iaq_fixed_co2(int32_t iaq_q8) {
+  return clamp_i32((int32_t)Q(CO2_BASE, 8) + iaq_q8 * (int32_t)CO2_SLOPE,
+                   (int32_t)Q(CO2_BASE, 8), (int32_t)Q(CO2_MAX, 8));
+}
+
+int32_t iaq_fixed_voc(uint32_t comp_gas_q8, uint32_t baseline_q8) {
+  if (comp_gas_q8 == 0 || baseline_q8 == 0) {
+    return 0;
+  }
+
+  // (baseline / gas - 1) * slope, saturating once past VOC_MAX. The slope
+  // multiplies the ratio's error by up to a hundred, hence its Q24
+  uint64_t inv_ratio =
+      (((uint64_t)baseline_q8 << 24) + comp_gas_q8 / 2) / comp_gas_q8;
+  inv_ratio = (inv_ratio < INV_RATIO_MAX_Q24) ? inv_ratio : INV_RATIO_MAX_Q24;
+  int64_t voc = (((int64_t)inv_ratio - ONE_Q24) * Q(VOC_SLOPE * 100.0f, 16) +
+                 (1 << 23)) >>
+                24;
+  voc = (voc < (int64_t)Q(VOC_BASE, 16)) ? (int64_t)Q(VOC_BASE, 16) : voc;
+  voc = (voc > (int64_t)Q(VOC_MAX, 16)) ? (int64_t)Q(VOC_MAX, 16) : voc;
+  return (int32_t)voc;
+}
@@ -0,0 +1,76 @@
+/**
+ * @file iaq_fixed.h
+ * @brief Q-format fixed-point IAQ pipeline for targets without an FPU
+ *
+ * Mirrors the float pipeline in iaq_calculator.c step by step. Readings are
+ * converted to fixed point once on entry, everything after that is integer
+ * arithmetic.
+ */
+
+#ifndef IAQ_FIXED_H
+#define IAQ_FIXED_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Maximum deviation of the fixed-point outputs from the float pipeline for
+ * gas resistances above 500 Ohms, humidity above 1 %RH and baselines of
+ * 2 kOhms to 2 MOhms, checked over a grid by tools/host/iaq_fixed_check.c
+ */
+#define IAQ_FIXED_MAX_IAQ_ERROR 0.1f
+#define IAQ_FIXED_MAX_CO2_ERROR 0.5f
+#define IAQ_FIXED_MAX_VOC_ERROR 0.001f
+
+/** Convert a compensation coefficient to the Q8.24 iaq_fixed_compensate()
+ *  takes */
+#define IAQ_FIXED_COEFF_Q24(x)                                                 \
+  ((int32_t)((x) * 16777216.0f + (((x) < 0.0f) ? -0.5f : 0.5f)))
+
+/**
+ * @brief Convert sensor readings to fixed point and compensate gas resistance
+ * @param gas_resistance Raw gas resistance in Ohms
+ * @param temperature Temperature in degC
+ * @param humidity Relative humidity in %
+ * @param temp_coeff_q24 Gas change per degC, Q8.24
+ * @param ah_coeff_q24 Gas change per g/m3 absolute humidity, Q8.24
+ * @return Compensated gas resistance in Ohms, Q24.8, 0 for invalid readings;
+ *         saturating at 16.7 MOhms, which only matters for baselines above
+ *         8 MOhms
+ */
+uint32_t iaq_fixed_compensate(float gas_resistance, float temperature,
+                              float humidity, int32_t temp_coeff_q24,
+                              int32_t ah_coeff_q24);
+
+/**
+ * @brief IAQ score from compensated gas resistance
+ * @param comp_gas_q8 Compensated gas resistance in Ohms, Q24.8
+ * @param baseline_q8 Gas baseline in Ohms, Q24.8 (0 selects the default
+ *                    baseline)
+ * @return IAQ score, Q24.8
+ */
+int32_t iaq_fixed_iaq(uint32_t comp_gas_q8, uint32_t baseline_q8);
+
+/**
+ * @brief CO2 equivalent from IAQ score
+ * @param iaq_q8 IAQ score, Q24.8
+ * @return CO2 equivalent in ppm, Q24.8
+ */
+int32_t iaq_fixed_co2(int32_t iaq_q8);
+
+/**
+ * @brief VOC equivalent from compensated gas resistance
+ * @param comp_gas_q8 Compensated gas resistance in Ohms, Q24.8
+ * @param baseline_q8 Gas baseline in Ohms, Q24.8
+ * @return VOC equivalent in ppm, Q16.16
+ */
+int32_t iaq_fixed_voc(uint32_t comp_gas_q8, uint32_t baseline_q8);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // IAQ_FIXED_H
@@ -0,0 +1,90 @@
+/**
+ * @file iaq_humidity.h
+ * @brief Absolute humidity from temperature and relative humidity
+ *
+ * AH = RH * f(T) with f from the Magnus relation. f is tabulated per degree
+ * in iaq_ah_table.c (generated by tools/gen_ah_table.py) and interpolated
+ * linearly, so a conversion costs one lookup and two multiply-adds.
+ */
+
+#ifndef IAQ_HUMIDITY_H
+#define IAQ_HUMIDITY_H
+
+#include <math.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define IAQ_AH_T_MIN (-40)
+#define IAQ_AH_T_MAX 85
+#define IAQ_AH_TABLE_LEN (IAQ_AH_T_MAX - IAQ_AH_T_MIN + 1)
+
+/** Absolute humidity per %RH at IAQ_AH_T_MIN + i degC, g/m3 */
+extern const float iaq_ah_per_rh[IAQ_AH_TABLE_LEN];
+/** Same table in Q20 */
+extern const int32_t iaq_ah_per_rh_q20[IAQ_AH_TABLE_LEN];
+
+/**
+ * @brief Absolute humidity via the interpolation table
+ *
+ * Temperatures outside the table range are clamped to it.
+ *
+ * @param temperature Temperature in degC
+ * @param humidity Relative humidity in %
+ * @return Absolute humidity in g/m3
+ */
+static inline float iaq_absolute_humidity(float temperature, float humidity) {
+  float x = temperature - (float)IAQ_AH_T_MIN;
+  x = (x > 0.0f) ? x : 0.0f;
+  x = (x < (float)(IAQ_AH_TABLE_LEN - 1)) ? x : (float)(IAQ_AH_TABLE_LEN - 1);
+  int i = (int)x;
+  i = (i < IAQ_AH_TABLE_LEN - 2) ? i : IAQ_AH_TABLE_LEN - 2;
+  float frac = x - (float)i;
+  float f = iaq_ah_per_rh[i] + frac * (iaq_ah_per_rh[i + 1] - iaq_ah_per_rh[i]);
+  return humidity * f;
+}
+
+/**
+ * @brief Absolute humidity in fixed point
+ *
+ * Takes its inputs in Q16: at Q8 the rounding of a hot, humid reading
+ * alone moves the result by a few parts in 10^4.
+ *
+ * @param temp_q16 Temperature in degC, Q16.16
+ * @param humidity_q16 Relative humidity in %, Q16.16
+ * @return Absolute humidity in g/m3, Q16.16
+ */
+static inline int32_t iaq_absolute_humidity_q16(int32_t temp_q16,
+                                                int32_t humidity_q16) {
+  int32_t x = temp_q16 - IAQ_AH_T_MIN * 65536;
+  x = (x > 0) ? x : 0;
+  x = (x < ((IAQ_AH_TABLE_LEN - 1) << 16)) ? x
+                                            : ((IAQ_AH_TABLE_LEN - 1) << 16);
+  int32_t i = x >> 16;
+  i = (i < IAQ_AH_TABLE_LEN - 2) ? i : IAQ_AH_TABLE_LEN - 2;
+  int32_t frac = x - (i << 16);
+  int32_t slope = iaq_ah_per_rh_q20[i + 1] - iaq_ah_per_rh_q20[i];
+  int32_t f =
+      iaq_ah_per_rh_q20[i] + (int32_t)(((int64_t)slope * frac) >> 16);
+  return (int32_t)(((int64_t)humidity_q16 * f) >> 20);
+}
+
+/**
+ * @brief Absolute humidity from the closed-form Magnus relation
+ *
+ * Reference for validating the tables; too slow for the per-sample path on
+ * targets without an FPU.
+ */
+static inline float iaq_absolute_humidity_magnus(float temperature,
+                                                 float humidity) {
+  return 6.112f * expf(17.62f * temperature / (243.12f + temperature)) *
+         humidity * 2.1674f / (273.15f + temperature);
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // IAQ_HUMIDITY_H
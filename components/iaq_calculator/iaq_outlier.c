@@ -0,0 +1,126 @@
+/**
+ * @file iaq_outlier.c
+ * @brief Streaming Hampel filter implementation
+ */
+
+#include "iaq_outlier.h"
+#include <math.h>
+#include <string.h>
+
+// MAD of a normal distribution times this is its standard deviation
+#define MAD_TO_SIGMA 1.4826f
+// Scale floor relative to the median, so a run of identical readings does
+// not turn ordinary sensor noise into outliers
+#define MIN_SCALE_REL 0.01f
+// Samples needed before anything is judged
+#define MIN_HISTORY 3
+
+/**
+ * @brief Position of x in the first n sorted entries
+ *
+ * Counted rather than searched, so the loop has no data-dependent exit.
+ */
+static uint8_t sorted_rank(const iaq_hampel_t *filter, float x, uint8_t n) {
+  uint8_t rank = 0;
+  for (uint8_t i = 0; i < n; i++) {
+    rank += (filter->sorted[i] < x);
+  }
+  return rank;
+}
+
+/**
+ * @brief Replace old by x in the sorted window of n entries
+ */
+static void sorted_replace(iaq_hampel_t *filter, float old, float x,
+                           uint8_t n) {
+  uint8_t from = sorted_rank(filter, old, n);
+  uint8_t to = sorted_rank(filter, x, n);
+  if (to > from) {
+    // Entries between the two positions shift down by one
+    to--;
+    for (uint8_t i = from; i < to; i++) {
+      filter->sorted[i] = filter->sorted[i + 1];
+    }
+  } else {
+    for (uint8_t i = from; i > to; i--) {
+      filter->sorted[i] = filter->sorted[i - 1];
+    }
+  }
+  filter->sorted[to] = x;
+}
+
+static void sorted_insert(iaq_hampel_t *filter, float x, uint8_t n) {
+  uint8_t to = sorted_rank(filter, x, n);
+  for (uint8_t i = n; i > to; i--) {
+    filter->sorted[i] = filter->sorted[i - 1];
+  }
+  filter->sorted[to] = x;
+}
+
+/**
+ * @brief Median absolute deviation from the window median
+ *
+ * Deviations grow outwards from the median in the sorted window, so the
+ * middle one is reached by merging both sides without another sort.
+ */
+static float window_mad(const iaq_hampel_t *filter, float median) {
+  int mid = filter->count / 2;
+  int lo = mid - 1;
+  int hi = mid + 1;
+  float dev = 0.0f;
+
+  for (int k = 0; k < mid; k++) {
+    float d_lo = (lo >= 0) ? median - filter->sorted[lo] : INFINITY;
+    float d_hi = (hi < filter->count) ? filter->sorted[hi] - median : INFINITY;
+    if (d_lo <= d_hi) {
+      dev = d_lo;
+      lo--;
+    } else {
+      dev = d_hi;
+      hi++;
+    }
+  }
+  return dev;
+}
+
+void iaq_hampel_init(iaq_hampel_t *filter, uint8_t len, float threshold) {
+  memset(filter, 0, sizeof(*filter));
+  filter->len = (len < IAQ_OUTLIER_WINDOW_MAX) ? len : IAQ_OUTLIER_WINDOW_MAX;
+  filter->threshold = threshold;
+}
+
+bool iaq_hampel_filter(iaq_hampel_t *filter, float x, float *out) {
+  bool outlier = false;
+  *out = x;
+
+  if (filter->len < MIN_HISTORY) {
+    return false;
+  }
+
+  if (filter->count >= MIN_HISTORY) {
+    float median = filter->sorted[filter->count / 2];
+    float dev = fabsf(x - median);
+    float limit = filter->threshold * MIN_SCALE_REL * fabsf(median);
+    // The MAD can only raise the limit, so most samples skip it
+    if (dev > limit) {
+      float scale = MAD_TO_SIGMA * window_mad(filter, median);
+      if (dev > filter->threshold * scale) {
+        outlier = true;
+        *out = median;
+        filter->flagged++;
+      }
+    }
+  }
+
+  // The window keeps raw samples so that level changes get through
+  if (filter->count == filter->len) {
+    sorted_replace(filter, filter->ring[filter->head], x, filter->count);
+  } else {
+    sorted_insert(filter, x, filter->count);
+    filter->count++;
+  }
+  filter->ring[filter->head] = x;
+  filter->head = (filter->head + 1 < filter->len) ? filter->head + 1 : 0;
+
+  return outlier;
+}
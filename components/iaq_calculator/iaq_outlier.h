@@ -0,0 +1,63 @@
+/**
+ * @file iaq_outlier.h
+ * @brief Streaming Hampel filter for gas resistance spikes
+ */
+
+#ifndef IAQ_OUTLIER_H
+#define IAQ_OUTLIER_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** Longest supported window; bounds the filter's memory and cost */
+#define IAQ_OUTLIER_WINDOW_MAX 15
+
+/**
+ * @brief Causal Hampel filter over the last len samples
+ *
+ * A sample further than threshold * 1.4826 * MAD from the median of the
+ * preceding samples is flagged and replaced by that median. The window
+ * keeps the raw samples, so a genuine level change passes once it makes up
+ * half of the window, after about len / 2 held samples.
+ *
+ * The window is also kept sorted, which makes the median a lookup and the
+ * MAD a merge walk outwards from it: O(len) per sample with len bounded by
+ * IAQ_OUTLIER_WINDOW_MAX.
+ */
+typedef struct {
+  float ring[IAQ_OUTLIER_WINDOW_MAX];   /**< Samples in arrival order */
+  float sorted[IAQ_OUTLIER_WINDOW_MAX]; /**< Same samples, ascending */
+  float threshold;
+  uint8_t len;
+  uint8_t head;
+  uint8_t count;
+  uint32_t flagged; /**< Samples replaced since init */
+} iaq_hampel_t;
+
+/**
+ * @brief Initialize a Hampel filter
+ * @param filter Filter to initialize
+ * @param len Window length, clamped to IAQ_OUTLIER_WINDOW_MAX; below 3 the
+ *            filter passes every sample
+ * @param threshold Rejection threshold in robust standard deviations
+ */
+void iaq_hampel_init(iaq_hampel_t *filter, uint8_t len, float threshold);
+
+/**
+ * @brief Filter one sample
+ * @param filter Filter
+ * @param x Sample
+ * @param out Filtered sample: x, or the window median if x is an outlier
+ * @return true if x was flagged as an outlier
+ */
+bool iaq_hampel_filter(iaq_hampel_t *filter, float x, float *out);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // IAQ_OUTLIER_H
@@ -0,0 +1,26 @@
+/**
+ * @file iaq_params.h
+ * @brief Model constants shared by the float and fixed-point IAQ pipelines
+ */
+
+#ifndef IAQ_PARAMS_H
+#define IAQ_PARAMS_H
+
+#define GAS_BASELINE_DEFAULT 250000.0f
+#define TEMP_COMP_REF 25.0f
+#define TEMP_COMP_COEFF 0.003f
+// Absolute humidity in g/m3 at 25 degC and 40 %RH, and gas change per g/m3
+#define AH_COMP_REF 9.19f
+#define AH_COMP_COEFF 0.065f
+// Bounds for learned coefficients; they keep both compensation factors
+// positive from -40 degC and for any absolute humidity
+#define TEMP_COMP_COEFF_MAX 0.01f
+#define AH_COMP_COEFF_MAX 0.1f
+#define CO2_BASE 400.0f
+#define CO2_MAX 2000.0f
+#define CO2_SLOPE 5.0f
+#define VOC_BASE 0.0f
+#define VOC_MAX 10.0f
+#define VOC_SLOPE 0.015f
+
+#endif // IAQ_PARAMS_H
@@ -0,0 +1,208 @@
+/**
+ * @file iaq_persist.c
+ * @brief Background writer for IAQ calibration state
+ */
+
+#include "iaq_persist.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+#include <inttypes.h>
+#include <math.h>
+#include <string.h>
+
+static const char *TAG = "IAQ_PERSIST";
+
+#define PERSIST_QUEUE_LEN 4
+#define PERSIST_TASK_STACK 3072
+#define PERSIST_TASK_PRIORITY 1
+// Relative baseline change that is worth a flash write
+#define PERSIST_BASELINE_DELTA 0.01f
+// Rewrite at least this often so the saved timestamp and sample count stay
+// current; warm restarts judge the off-time by the timestamp
+#define PERSIST_MAX_AGE_US (3600LL * 1000000)
+// Shortest span writes per day are extrapolated from
+#define PERSIST_MIN_RATE_SPAN_US (3600LL * 1000000)
+#define US_PER_DAY (86400.0f * 1000000.0f)
+
+static QueueHandle_t s_queue;
+static StaticQueue_t s_queue_buffer;
+static uint8_t s_queue_storage[PERSIST_QUEUE_LEN * sizeof(iaq_ctx_t *)];
+static StaticTask_t s_task_buffer;
+static StackType_t s_task_stack[PERSIST_TASK_STACK];
+static SemaphoreHandle_t s_stats_lock;
+static StaticSemaphore_t s_stats_lock_buffer;
+static iaq_persist_stats_t s_stats;
+static int64_t s_started_us;
+// Snapshot being written; only the writer task touches it
+static iaq_state_blob_t s_staging;
+
+/**
+ * @brief Decide whether a snapshot differs enough from the committed state
+ */
+static bool needs_write(const iaq_ctx_t *ctx, const iaq_state_blob_t *state,
+                        int64_t now_us) {
+  const iaq_persist_digest_t *written = &ctx->persist_written;
+  uint32_t burn_in = ctx->config.burn_in_samples;
+
+  if (written->gas_baseline <= 0.0f) {
+    return true;
+  }
+  if (now_us - written->at_us >= PERSIST_MAX_AGE_US) {
+    return true;
+  }
+  if ((written->samples_count >= burn_in) !=
+      (state->samples_count >= burn_in)) {
+    return true;
+  }
+  return fabsf(state->gas_baseline - written->gas_baseline) >
+         PERSIST_BASELINE_DELTA * written->gas_baseline;
+}
+
+static void record_commit(esp_err_t err, uint32_t commit_us, int64_t now_us) {
+  xSemaphoreTake(s_stats_lock, portMAX_DELAY);
+  if (err == ESP_OK) {
+    s_stats.writes++;
+    s_stats.last_commit_us = commit_us;
+    if (commit_us > s_stats.max_commit_us) {
+      s_stats.max_commit_us = commit_us;
+    }
+    int64_t span = now_us - s_started_us;
+    if (span < PERSIST_MIN_RATE_SPAN_US) {
+      span = PERSIST_MIN_RATE_SPAN_US;
+    }
+    s_stats.writes_per_day = (float)s_stats.writes * US_PER_DAY / (float)span;
+  } else {
+    s_stats.failures++;
+  }
+  xSemaphoreGive(s_stats_lock);
+}
+
+static void count(uint32_t *counter) {
+  xSemaphoreTake(s_stats_lock, portMAX_DELAY);
+  (*counter)++;
+  xSemaphoreGive(s_stats_lock);
+}
+
+static void writer_task(void *pvParameters) {
+  (void)pvParameters;
+  iaq_ctx_t *ctx;
+
+  while (1) {
+    if (xQueueReceive(s_queue, &ctx, portMAX_DELAY) != pdTRUE) {
+      continue;
+    }
+
+    // Snapshot the latest state; later requests queue the context again
+    xSemaphoreTake(ctx->mutex, portMAX_DELAY);
+    ctx->persist_queued = false;
+    xSemaphoreGive(ctx->mutex);
+    esp_err_t err = iaq_ctx_get_state(ctx, &s_staging);
+    if (err != ESP_OK) {
+      record_commit(err, 0, esp_timer_get_time());
+      continue;
+    }
+
+    int64_t start = esp_timer_get_time();
+    if (!needs_write(ctx, &s_staging, start)) {
+      count(&s_stats.skipped);
+      continue;
+    }
+
+    err = iaq_ctx_write_state(ctx, &s_staging);
+    int64_t end = esp_timer_get_time();
+    uint32_t commit_us = (uint32_t)(end - start);
+    record_commit(err, commit_us, end);
+
+    if (err == ESP_OK) {
+      ctx->persist_written = (iaq_persist_digest_t){
+          .gas_baseline = s_staging.gas_baseline,
+          .samples_count = s_staging.samples_count,
+          .at_us = end,
+      };
+      ESP_LOGI(TAG, "[%s] State committed in %" PRIu32 " us (baseline %.0f)",
+               ctx->nvs_namespace, commit_us, s_staging.gas_baseline);
+    } else {
+      ESP_LOGE(TAG, "[%s] State commit failed: %s", ctx->nvs_namespace,
+               esp_err_to_name(err));
+    }
+  }
+}
+
+esp_err_t iaq_persist_start(void) {
+  if (s_queue != NULL) {
+    return ESP_OK;
+  }
+
+  s_stats_lock = xSemaphoreCreateMutexStatic(&s_stats_lock_buffer);
+  s_queue = xQueueCreateStatic(PERSIST_QUEUE_LEN, sizeof(iaq_ctx_t *),
+                               s_queue_storage, &s_queue_buffer);
+  if (s_stats_lock == NULL || s_queue == NULL) {
+    ESP_LOGE(TAG, "Failed to create writer queue");
+    return ESP_FAIL;
+  }
+
+  s_started_us = esp_timer_get_time();
+  if (xTaskCreateStatic(writer_task, "iaq_persist", PERSIST_TASK_STACK, NULL,
+                        PERSIST_TASK_PRIORITY, s_task_stack,
+                        &s_task_buffer) == NULL) {
+    ESP_LOGE(TAG, "Failed to create writer task");
+    return ESP_FAIL;
+  }
+
+  ESP_LOGI(TAG, "State writer started");
+  return ESP_OK;
+}
+
+esp_err_t iaq_ctx_request_save(iaq_ctx_t *ctx) {
+  if (s_queue == NULL) {
+    return ESP_ERR_INVALID_STATE;
+  }
+  if (ctx == NULL || !ctx->initialized) {
+    return ESP_ERR_INVALID_STATE;
+  }
+  if (ctx->nvs_namespace[0] == '\0') {
+    return ESP_ERR_NOT_SUPPORTED;
+  }
+
+  if (xSemaphoreTake(ctx->mutex, pdMS_TO_TICKS(100)) != pdTRUE) {
+    return ESP_ERR_TIMEOUT;
+  }
+  bool queued = ctx->persist_queued;
+  ctx->persist_queued = true;
+  xSemaphoreGive(ctx->mutex);
+
+  count(&s_stats.requests);
+  if (queued) {
+    count(&s_stats.coalesced);
+    return ESP_OK;
+  }
+
+  if (xQueueSend(s_queue, &ctx, 0) != pdTRUE) {
+    xSemaphoreTake(ctx->mutex, portMAX_DELAY);
+    ctx->persist_queued = false;
+    xSemaphoreGive(ctx->mutex);
+    return ESP_ERR_NO_MEM;
+  }
+  return ESP_OK;
+}
+
+esp_err_t iaq_request_save(void) {
+  return iaq_ctx_request_save(iaq_get_default_ctx());
+}
+
+void iaq_persist_get_stats(iaq_persist_stats_t *stats) {
+  if (stats == NULL) {
+    return;
+  }
+  if (s_stats_lock == NULL) {
+    memset(stats, 0, sizeof(*stats));
+    return;
+  }
+  xSemaphoreTake(s_stats_lock, portMAX_DELAY);
+  *stats = s_stats;
+  xSemaphoreGive(s_stats_lock);
+}
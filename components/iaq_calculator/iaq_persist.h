@@ -0,0 +1,67 @@
+/**
+ * @file iaq_persist.h
+ * @brief Background writer for IAQ calibration state
+ *
+ * Callers request a save and return immediately; a low-priority task
+ * commits the latest snapshot to NVS. Requests for a context that is
+ * already queued are coalesced, and snapshots that differ too little from
+ * the last committed one are dropped to spare the flash.
+ */
+
+#ifndef IAQ_PERSIST_H
+#define IAQ_PERSIST_H
+
+#include "esp_err.h"
+#include "iaq_calculator.h"
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Writer statistics, summed over all contexts
+ */
+typedef struct {
+  uint32_t requests;
+  uint32_t coalesced; /**< Requests merged into one already queued */
+  uint32_t skipped;   /**< Snapshots too close to the committed state */
+  uint32_t writes;
+  uint32_t failures;
+  uint32_t last_commit_us;
+  uint32_t max_commit_us;
+  float writes_per_day; /**< Extrapolated from writes since start */
+} iaq_persist_stats_t;
+
+/**
+ * @brief Start the writer task
+ * @return ESP_OK on success or if already running
+ */
+esp_err_t iaq_persist_start(void);
+
+/**
+ * @brief Request a non-blocking save of a context's calibration state
+ * @param ctx Calculator context with an NVS namespace
+ * @return ESP_OK if queued or coalesced, ESP_ERR_INVALID_STATE if the writer
+ *         is not running, ESP_ERR_NOT_SUPPORTED for volatile contexts,
+ *         ESP_ERR_NO_MEM if the writer queue is full
+ */
+esp_err_t iaq_ctx_request_save(iaq_ctx_t *ctx);
+
+/**
+ * @brief Request a non-blocking save of the default context
+ * @return See iaq_ctx_request_save()
+ */
+esp_err_t iaq_request_save(void);
+
+/**
+ * @brief Get writer statistics
+ * @param stats Pointer to store the statistics
+ */
+void iaq_persist_get_stats(iaq_persist_stats_t *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // IAQ_PERSIST_H
@@ -0,0 +1,180 @@
+/**
+ * @file iaq_quantile.c
+ * @brief Constant-memory streaming quantile estimators implementation
+ */
+
+#include "iaq_quantile.h"
+#include <string.h>
+
+static void sort5(float *v, uint32_t len) {
+  for (uint32_t i = 1; i < len; i++) {
+    float key = v[i];
+    int32_t j = (int32_t)i - 1;
+    while (j >= 0 && v[j] > key) {
+      v[j + 1] = v[j];
+      j--;
+    }
+    v[j + 1] = key;
+  }
+}
+
+/**
+ * @brief Piecewise-parabolic prediction of marker i moved by d (+1/-1)
+ */
+static float p2_parabolic(const iaq_p2_t *p2, int i, float d) {
+  float n_prev = (float)p2->n[i - 1];
+  float n_cur = (float)p2->n[i];
+  float n_next = (float)p2->n[i + 1];
+
+  return p2->q[i] +
+         d / (n_next - n_prev) *
+             ((n_cur - n_prev + d) * (p2->q[i + 1] - p2->q[i]) /
+                  (n_next - n_cur) +
+              (n_next - n_cur - d) * (p2->q[i] - p2->q[i - 1]) /
+                  (n_cur - n_prev));
+}
+
+static float p2_linear(const iaq_p2_t *p2, int i, int d) {
+  return p2->q[i] + (float)d * (p2->q[i + d] - p2->q[i]) /
+                        (float)(p2->n[i + d] - p2->n[i]);
+}
+
+void iaq_p2_init(iaq_p2_t *p2, float p) {
+  memset(p2, 0, sizeof(*p2));
+  p2->p = p;
+}
+
+void iaq_p2_add(iaq_p2_t *p2, float x) {
+  if (p2->count < 5) {
+    p2->q[p2->count++] = x;
+    if (p2->count == 5) {
+      sort5(p2->q, 5);
+      float p = p2->p;
+      for (int i = 0; i < 5; i++) {
+        p2->n[i] = i;
+      }
+      p2->np[0] = 0.0f;
+      p2->np[1] = 2.0f * p;
+      p2->np[2] = 4.0f * p;
+      p2->np[3] = 2.0f + 2.0f * p;
+      p2->np[4] = 4.0f;
+    }
+    return;
+  }
+
+  int k;
+  if (x < p2->q[0]) {
+    p2->q[0] = x;
+    k = 0;
+  } else if (x >= p2->q[4]) {
+    p2->q[4] = x;
+    k = 3;
+  } else {
+    k = 0;
+    while (k < 3 && x >= p2->q[k + 1]) {
+      k++;
+    }
+  }
+
+  for (int i = k + 1; i < 5; i++) {
+    p2->n[i]++;
+  }
+
+  float p = p2->p;
+  p2->np[1] += p * 0.5f;
+  p2->np[2] += p;
+  p2->np[3] += (1.0f + p) * 0.5f;
+  p2->np[4] += 1.0f;
+  p2->count++;
+
+  for (int i = 1; i <= 3; i++) {
+    float d = p2->np[i] - (float)p2->n[i];
+    if ((d >= 1.0f && p2->n[i + 1] - p2->n[i] > 1) ||
+        (d <= -1.0f && p2->n[i - 1] - p2->n[i] < -1)) {
+      int ds = (d > 0) ? 1 : -1;
+      float qp = p2_parabolic(p2, i, (float)ds);
+      if (p2->q[i - 1] < qp && qp < p2->q[i + 1]) {
+        p2->q[i] = qp;
+      } else {
+        p2->q[i] = p2_linear(p2, i, ds);
+      }
+      p2->n[i] += ds;
+    }
+  }
+}
+
+float iaq_p2_get(const iaq_p2_t *p2) {
+  if (p2->count == 0) {
+    return 0.0f;
+  }
+
+  if (p2->count < 5) {
+    float sorted[5];
+    memcpy(sorted, p2->q, sizeof(sorted));
+    sort5(sorted, p2->count);
+    uint32_t idx = (uint32_t)(p2->p * (float)(p2->count - 1) + 0.5f);
+    return sorted[idx];
+  }
+
+  return p2->q[2];
+}
+
+void iaq_baseline_tracker_init(iaq_baseline_tracker_t *tracker, float p,
+                               uint32_t horizon_samples) {
+  memset(tracker, 0, sizeof(*tracker));
+  iaq_p2_init(&tracker->current, p);
+  tracker->epoch_len = horizon_samples / IAQ_BASELINE_EPOCHS;
+  if (tracker->epoch_len == 0) {
+    tracker->epoch_len = 1;
+  }
+}
+
+void iaq_baseline_tracker_add(iaq_baseline_tracker_t *tracker, float x) {
+  iaq_p2_add(&tracker->current, x);
+
+  if (tracker->current.count < tracker->epoch_len) {
+    return;
+  }
+
+  // Epoch complete: retire its quantile into the ring and start a new one
+  tracker->epoch_q[tracker->epoch_head] = iaq_p2_get(&tracker->current);
+  tracker->epoch_head = (tracker->epoch_head + 1) % IAQ_BASELINE_EPOCHS;
+  if (tracker->epoch_count < IAQ_BASELINE_EPOCHS) {
+    tracker->epoch_count++;
+  }
+
+  // Re-sum from scratch so no rounding error accumulates across epochs
+  float sum = 0.0f;
+  for (uint8_t i = 0; i < tracker->epoch_count; i++) {
+    sum += tracker->epoch_q[i];
+  }
+  tracker->epoch_sum = sum;
+
+  iaq_p2_init(&tracker->current, tracker->current.p);
+}
+
+void iaq_baseline_tracker_seed(iaq_baseline_tracker_t *tracker, float value,
+                               uint8_t epochs) {
+  if (epochs > IAQ_BASELINE_EPOCHS) {
+    epochs = IAQ_BASELINE_EPOCHS;
+  }
+  for (uint8_t i = 0; i < epochs; i++) {
+    tracker->epoch_q[i] = value;
+  }
+  tracker->epoch_count = epochs;
+  tracker->epoch_head = epochs % IAQ_BASELINE_EPOCHS;
+  tracker->epoch_sum = value * (float)epochs;
+}
+
+float iaq_baseline_tracker_get(const iaq_baseline_tracker_t *tracker) {
+  float current = iaq_p2_get(&tracker->current);
+
+  if (tracker->epoch_count == 0) {
+    return current;
+  }
+
+  // Blend in the running epoch according to how much of it has been seen
+  float weight = (float)tracker->current.count / (float)tracker->epoch_len;
+  return (tracker->epoch_sum + weight * current) /
+         ((float)tracker->epoch_count + weight);
+}
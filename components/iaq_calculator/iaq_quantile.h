@@ -0,0 +1,108 @@
+/**
+ * @file iaq_quantile.h
+ * @brief Constant-memory streaming quantile estimators for the gas baseline
+ */
+
+#ifndef IAQ_QUANTILE_H
+#define IAQ_QUANTILE_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define IAQ_BASELINE_EPOCHS 8
+
+/**
+ * @brief P-square (Jain & Chlamtac) single-quantile estimator
+ *
+ * Tracks one quantile with five markers, O(1) memory and time per sample.
+ */
+typedef struct {
+  float q[5];
+  float np[5];
+  int32_t n[5];
+  float p;
+  uint32_t count;
+} iaq_p2_t;
+
+/**
+ * @brief Horizon-limited quantile tracker
+ *
+ * The horizon is split into IAQ_BASELINE_EPOCHS epochs, each summarised by
+ * its own P-square estimate. Completed epochs fall out of a fixed ring, so
+ * the tracked quantile follows the data in both directions while the state
+ * stays bounded regardless of deployment length.
+ */
+typedef struct {
+  iaq_p2_t current;
+  float epoch_q[IAQ_BASELINE_EPOCHS];
+  float epoch_sum;
+  uint32_t epoch_len;
+  uint8_t epoch_head;
+  uint8_t epoch_count;
+} iaq_baseline_tracker_t;
+
+/**
+ * @brief Initialize a P-square estimator
+ * @param p2 Estimator to initialize
+ * @param p Quantile to track (0 < p < 1)
+ */
+void iaq_p2_init(iaq_p2_t *p2, float p);
+
+/**
+ * @brief Add one observation to a P-square estimator
+ * @param p2 Estimator
+ * @param x Observation
+ */
+void iaq_p2_add(iaq_p2_t *p2, float x);
+
+/**
+ * @brief Get the current quantile estimate
+ * @param p2 Estimator
+ * @return Quantile estimate, 0 if no observation has been added
+ */
+float iaq_p2_get(const iaq_p2_t *p2);
+
+/**
+ * @brief Initialize a horizon-limited quantile tracker
+ * @param tracker Tracker to initialize
+ * @param p Quantile to track (0 < p < 1)
+ * @param horizon_samples Number of samples covered by the horizon
+ */
+void iaq_baseline_tracker_init(iaq_baseline_tracker_t *tracker, float p,
+                               uint32_t horizon_samples);
+
+/**
+ * @brief Add one observation to the tracker
+ * @param tracker Tracker
+ * @param x Observation
+ */
+void iaq_baseline_tracker_add(iaq_baseline_tracker_t *tracker, float x);
+
+/**
+ * @brief Replace the completed epochs by a known quantile
+ *
+ * The running epoch is kept and blends in as usual, so the seed is
+ * outweighed once real epochs complete and falls out of the ring with them.
+ *
+ * @param tracker Tracker
+ * @param value Quantile to assume for the seeded epochs
+ * @param epochs Number of epochs to seed, at most IAQ_BASELINE_EPOCHS
+ */
+void iaq_baseline_tracker_seed(iaq_baseline_tracker_t *tracker, float value,
+                               uint8_t epochs);
+
+/**
+ * @brief Get the quantile estimate over the horizon
+ * @param tracker Tracker
+ * @return Quantile estimate, 0 if no observation has been added
+ */
+float iaq_baseline_tracker_get(const iaq_baseline_tracker_t *tracker);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // IAQ_QUANTILE_H
@@ -0,0 +1,63 @@
+/**
+ * @file iaq_rls.c
+ * @brief Recursive least squares implementation
+ */
+
+#include "iaq_rls.h"
+#include <stdbool.h>
+#include <string.h>
+
+#define N IAQ_RLS_PARAMS
+
+void iaq_rls_init(iaq_rls_t *rls, const float theta[IAQ_RLS_PARAMS],
+                  const float p0[IAQ_RLS_PARAMS], float lambda) {
+  memset(rls, 0, sizeof(*rls));
+  memcpy(rls->theta, theta, sizeof(rls->theta));
+  memcpy(rls->p_max, p0, sizeof(rls->p_max));
+  for (int i = 0; i < N; i++) {
+    rls->p[i][i] = p0[i];
+  }
+  rls->lambda = lambda;
+}
+
+float iaq_rls_update(iaq_rls_t *rls, const float x[IAQ_RLS_PARAMS], float y) {
+  float px[N];
+  float denom = rls->lambda;
+  float error = y;
+
+  for (int i = 0; i < N; i++) {
+    px[i] = 0.0f;
+    for (int j = 0; j < N; j++) {
+      px[i] += rls->p[i][j] * x[j];
+    }
+    denom += x[i] * px[i];
+    error -= rls->theta[i] * x[i];
+  }
+
+  float inv = 1.0f / denom;
+  for (int i = 0; i < N; i++) {
+    rls->theta[i] += px[i] * inv * error;
+  }
+
+  // P = (P - P x x' P / denom) / lambda, kept symmetric
+  float scale = 1.0f / rls->lambda;
+  bool forget = true;
+  for (int i = 0; i < N; i++) {
+    for (int j = i; j < N; j++) {
+      float v = rls->p[i][j] - px[i] * px[j] * inv;
+      rls->p[i][j] = v;
+      rls->p[j][i] = v;
+    }
+    forget = forget && rls->p[i][i] * scale <= rls->p_max[i];
+  }
+  if (forget) {
+    for (int i = 0; i < N; i++) {
+      for (int j = 0; j < N; j++) {
+        rls->p[i][j] *= scale;
+      }
+    }
+  }
+
+  rls->updates++;
+  return error;
+}
@@ -0,0 +1,56 @@
+/**
+ * @file iaq_rls.h
+ * @brief Recursive least squares with exponential forgetting
+ */
+
+#ifndef IAQ_RLS_H
+#define IAQ_RLS_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define IAQ_RLS_PARAMS 3
+
+/**
+ * @brief Fixed-size RLS estimator for y = theta . x
+ *
+ * Fixed memory, O(IAQ_RLS_PARAMS^2) per update. Forgetting is suspended
+ * while any parameter's variance is back at its prior, so periods in which
+ * a regressor does not move cannot wind the covariance up.
+ */
+typedef struct {
+  float theta[IAQ_RLS_PARAMS];
+  float p[IAQ_RLS_PARAMS][IAQ_RLS_PARAMS]; /**< Parameter covariance */
+  float p_max[IAQ_RLS_PARAMS];             /**< Prior variances */
+  float lambda;                            /**< Forgetting factor */
+  uint32_t updates;
+} iaq_rls_t;
+
+/**
+ * @brief Initialize an estimator
+ * @param rls Estimator to initialize
+ * @param theta Initial parameters
+ * @param p0 Prior variance of each parameter, which its variance never
+ *           exceeds
+ * @param lambda Forgetting factor (0 < lambda <= 1)
+ */
+void iaq_rls_init(iaq_rls_t *rls, const float theta[IAQ_RLS_PARAMS],
+                  const float p0[IAQ_RLS_PARAMS], float lambda);
+
+/**
+ * @brief Add one observation
+ * @param rls Estimator
+ * @param x Regressors
+ * @param y Observation
+ * @return Prediction error before the update
+ */
+float iaq_rls_update(iaq_rls_t *rls, const float x[IAQ_RLS_PARAMS], float y);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // IAQ_RLS_H
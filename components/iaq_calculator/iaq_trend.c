@@ -0,0 +1,98 @@
+/**
+ * @file iaq_trend.c
+ * @brief Constant-memory trend estimators implementation
+ */
+
+#include "iaq_trend.h"
+#include <math.h>
+#include <string.h>
+
+/**
+ * @brief Add y at time 0 to a series
+ *
+ * d is the decay of the older samples, a the new sample's share of the
+ * total weight and dt0 its time offset from the old mean time.
+ *
+ * West's weighted update: the co-moment grows by the product of the
+ * deviations from the old and the new mean.
+ */
+static void series_add(iaq_trend_series_t *series, float d, float a, float dt0,
+                       float y) {
+  float dy = y - series->mean_y;
+  series->mean_y += a * dy;
+  float dy_new = y - series->mean_y;
+  series->cty = d * series->cty + dt0 * dy_new;
+  series->cyy = d * series->cyy + dy * dy_new;
+}
+
+void iaq_trend_init(iaq_trend_tracker_t *tracker, float window_s) {
+  memset(tracker, 0, sizeof(*tracker));
+  tracker->window_s = window_s;
+}
+
+void iaq_trend_add(iaq_trend_tracker_t *tracker, uint32_t time_ms, float iaq,
+                   float gas) {
+  uint32_t dt_ms = time_ms - tracker->last_ms;
+
+  if (!tracker->started || dt_ms > INT32_MAX) {
+    float window_s = tracker->window_s;
+    iaq_trend_init(tracker, window_s);
+    tracker->started = true;
+    dt_ms = 0;
+  }
+  tracker->last_ms = time_ms;
+
+  // Regular sampling repeats the same interval, so expf rarely runs
+  if (dt_ms != tracker->last_dt_ms || tracker->decay == 0.0f) {
+    tracker->decay = expf(-(float)dt_ms * 0.001f / tracker->window_s);
+    tracker->last_dt_ms = dt_ms;
+  }
+  float d = tracker->decay;
+
+  // Age the older samples, then add the new one at time 0
+  tracker->mean_t -= (float)dt_ms * 0.001f;
+  tracker->weight = d * tracker->weight + 1.0f;
+  float a = 1.0f / tracker->weight;
+  float dt0 = -tracker->mean_t;
+  tracker->mean_t += a * dt0;
+  tracker->ctt = d * tracker->ctt + dt0 * -tracker->mean_t;
+
+  series_add(&tracker->iaq, d, a, dt0, iaq);
+  series_add(&tracker->gas, d, a, dt0, gas);
+}
+
+float iaq_trend_slope(const iaq_trend_tracker_t *tracker,
+                      const iaq_trend_series_t *series) {
+  return (tracker->ctt > 0.0f) ? series->cty / tracker->ctt : 0.0f;
+}
+
+float iaq_trend_r2(const iaq_trend_tracker_t *tracker,
+                   const iaq_trend_series_t *series) {
+  if (tracker->ctt <= 0.0f || series->cyy <= 0.0f) {
+    return 0.0f;
+  }
+  float r2 = series->cty * series->cty / (tracker->ctt * series->cyy);
+  return (r2 < 1.0f) ? r2 : 1.0f;
+}
+
+float iaq_trend_level(const iaq_trend_tracker_t *tracker,
+                      const iaq_trend_series_t *series) {
+  return series->mean_y - iaq_trend_slope(tracker, series) * tracker->mean_t;
+}
+
+float iaq_trend_time_to(const iaq_trend_tracker_t *tracker,
+                        const iaq_trend_series_t *series, float threshold,
+                        float horizon_s) {
+  float level = iaq_trend_level(tracker, series);
+  if (level >= threshold) {
+    return 0.0f;
+  }
+
+  float slope = iaq_trend_slope(tracker, series);
+  if (slope <= 0.0f) {
+    return -1.0f;
+  }
+
+  float t = (threshold - level) / slope;
+  return (t <= horizon_s) ? t : -1.0f;
+}
@@ -0,0 +1,109 @@
+/**
+ * @file iaq_trend.h
+ * @brief Constant-memory trend estimators for IAQ and gas resistance
+ */
+
+#ifndef IAQ_TREND_H
+#define IAQ_TREND_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Weighted moments of one series against time
+ */
+typedef struct {
+  float mean_y;
+  float cty;
+  float cyy;
+} iaq_trend_series_t;
+
+/**
+ * @brief Exponentially weighted least-squares trend of IAQ and gas
+ *
+ * Fits a line to each series with weights exp(-age / window_s), so
+ * irregular sampling is handled and no history is stored: O(1) memory and
+ * time per sample. Both series share the sample times, so the time moments
+ * are kept once.
+ *
+ * Weighted means and co-moments are kept instead of raw sums, so the fit
+ * stays accurate in float even for values around 1e5 with small variation.
+ * Times are relative to the newest sample; shifting the time origin only
+ * moves mean_t and leaves the co-moments unchanged.
+ */
+typedef struct {
+  float weight; /**< Sum of sample weights */
+  float mean_t; /**< Weighted mean time relative to the newest sample, s */
+  float ctt;
+  iaq_trend_series_t iaq;
+  iaq_trend_series_t gas;
+  float window_s;
+  float decay; /**< Cached decay for last_dt_ms */
+  uint32_t last_dt_ms;
+  uint32_t last_ms;
+  bool started;
+} iaq_trend_tracker_t;
+
+/**
+ * @brief Initialize a trend tracker
+ * @param tracker Tracker to initialize
+ * @param window_s Time constant of the exponential weighting, s
+ */
+void iaq_trend_init(iaq_trend_tracker_t *tracker, float window_s);
+
+/**
+ * @brief Add one sample
+ *
+ * A timestamp that goes backwards is treated as a long gap and restarts
+ * the fit.
+ *
+ * @param tracker Tracker
+ * @param time_ms Sample time, ms (may wrap)
+ * @param iaq IAQ score
+ * @param gas Compensated gas resistance, Ohms
+ */
+void iaq_trend_add(iaq_trend_tracker_t *tracker, uint32_t time_ms, float iaq,
+                   float gas);
+
+/**
+ * @brief Slope of a series
+ * @return Units per second, 0 until two distinct times have been seen
+ */
+float iaq_trend_slope(const iaq_trend_tracker_t *tracker,
+                      const iaq_trend_series_t *series);
+
+/**
+ * @brief Share of a series' weighted variance explained by its line
+ * @return R-squared in [0, 1], 0 for a constant series
+ */
+float iaq_trend_r2(const iaq_trend_tracker_t *tracker,
+                   const iaq_trend_series_t *series);
+
+/**
+ * @brief Value of a series' fitted line at the newest sample
+ */
+float iaq_trend_level(const iaq_trend_tracker_t *tracker,
+                      const iaq_trend_series_t *series);
+
+/**
+ * @brief Extrapolate the time until a series rises to a threshold
+ * @param tracker Tracker
+ * @param series Series of the tracker
+ * @param threshold Level to reach
+ * @param horizon_s Longest extrapolation to trust
+ * @return Seconds from the newest sample, 0 if already at or above the
+ *         threshold, negative if the line does not reach it within horizon_s
+ */
+float iaq_trend_time_to(const iaq_trend_tracker_t *tracker,
+                        const iaq_trend_series_t *series, float threshold,
+                        float horizon_s);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // IAQ_TREND_H
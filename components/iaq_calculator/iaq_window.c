@@ -0,0 +1,91 @@
+/**
+ * @file iaq_window.c
+ * @brief Sliding-window statistics implementation
+ */
+
+#include "iaq_window.h"
+#include <math.h>
+#include <string.h>
+
+void iaq_window_init(iaq_window_t *window, uint32_t span_ms) {
+  memset(window, 0, sizeof(*window));
+  window->span_ms = span_ms;
+  window->bucket_ms = span_ms / IAQ_WINDOW_BUCKETS;
+  if (window->bucket_ms == 0) {
+    window->bucket_ms = 1;
+  }
+}
+
+void iaq_window_add(iaq_window_t *window, uint32_t now_ms, float x) {
+  uint32_t number = now_ms / window->bucket_ms;
+  uint32_t advance = number - window->newest;
+
+  // Empty the buckets passed since the last sample; times that step back,
+  // as when the clock wraps, restart the window
+  if (advance >= IAQ_WINDOW_BUCKETS) {
+    for (int i = 0; i < IAQ_WINDOW_BUCKETS; i++) {
+      window->bucket[i].count = 0;
+    }
+  } else {
+    for (uint32_t i = 1; i <= advance; i++) {
+      window->bucket[(window->newest + i) % IAQ_WINDOW_BUCKETS].count = 0;
+    }
+  }
+  window->newest = number;
+  window->newest_ms = now_ms;
+
+  iaq_window_bucket_t *b = &window->bucket[number % IAQ_WINDOW_BUCKETS];
+  if (b->count == 0) {
+    *b = (iaq_window_bucket_t){
+        .count = 1, .first_ms = now_ms, .mean = x, .min = x, .max = x};
+    return;
+  }
+  b->count++;
+  float d = x - b->mean;
+  b->mean += d / (float)b->count;
+  b->m2 += d * (x - b->mean);
+  b->min = (x < b->min) ? x : b->min;
+  b->max = (x > b->max) ? x : b->max;
+}
+
+void iaq_window_get(const iaq_window_t *window, iaq_window_stats_t *stats) {
+  memset(stats, 0, sizeof(*stats));
+
+  // Merge the buckets oldest first (Chan et al.), so the result does not
+  // depend on where the ring happens to start
+  float mean = 0.0f;
+  float m2 = 0.0f;
+  uint32_t oldest_ms = 0;
+  for (uint32_t i = 1; i <= IAQ_WINDOW_BUCKETS; i++) {
+    const iaq_window_bucket_t *b =
+        &window->bucket[(window->newest + i) % IAQ_WINDOW_BUCKETS];
+    if (b->count == 0) {
+      continue;
+    }
+    if (stats->count == 0) {
+      mean = b->mean;
+      m2 = b->m2;
+      stats->min = b->min;
+      stats->max = b->max;
+      stats->count = b->count;
+      oldest_ms = b->first_ms;
+      continue;
+    }
+    uint32_t n = stats->count + b->count;
+    float d = b->mean - mean;
+    float share = (float)b->count / (float)n;
+    mean += d * share;
+    m2 += b->m2 + d * d * (float)stats->count * share;
+    stats->min = (b->min < stats->min) ? b->min : stats->min;
+    stats->max = (b->max > stats->max) ? b->max : stats->max;
+    stats->count = n;
+  }
+  if (stats->count == 0) {
+    return;
+  }
+
+  float var = m2 / (float)stats->count;
+  stats->mean = mean;
+  stats->std = (var > 0.0f) ? sqrtf(var) : 0.0f;
+  stats->covered_ms = window->newest_ms - oldest_ms;
+}
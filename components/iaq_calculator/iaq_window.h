@@ -0,0 +1,90 @@
+/**
+ * @file iaq_window.h
+ * @brief Sliding-window mean, variance, minimum and maximum
+ */
+
+#ifndef IAQ_WINDOW_H
+#define IAQ_WINDOW_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** Time buckets a window is divided into; sets its expiry granularity */
+#define IAQ_WINDOW_BUCKETS 20
+
+/**
+ * @brief Statistics of the samples in a window
+ */
+typedef struct {
+  float mean;
+  float std; /**< Population standard deviation */
+  float min;
+  float max;
+  uint32_t count; /**< Samples in the window, 0 leaves the rest at 0 */
+  /** Time from the oldest sample in the window to the newest. Less than
+   *  span_ms by more than one bucket means the window has not filled yet
+   *  or readings were missing, and the statistics describe less time */
+  uint32_t covered_ms;
+} iaq_window_stats_t;
+
+/**
+ * @brief Summary of the samples that fell into one time bucket
+ */
+typedef struct {
+  uint32_t count;
+  uint32_t first_ms; /**< Time of the bucket's first sample */
+  float mean;
+  float m2; /**< Sum of squared deviations from the mean */
+  float min;
+  float max;
+} iaq_window_bucket_t;
+
+/**
+ * @brief Samples of about the last span_ms, kept as time buckets
+ *
+ * The span is split into IAQ_WINDOW_BUCKETS buckets of span_ms /
+ * IAQ_WINDOW_BUCKETS, aligned to the clock. Each bucket keeps a running
+ * mean and squared deviation (Welford) plus its extremes, and a whole
+ * bucket expires at once, so the window holds between span_ms less one
+ * bucket and span_ms of history however fast samples arrive. Memory is
+ * fixed and independent of the sample rate; adding is O(1) and reading
+ * the statistics merges the buckets in O(IAQ_WINDOW_BUCKETS).
+ */
+typedef struct {
+  iaq_window_bucket_t bucket[IAQ_WINDOW_BUCKETS];
+  uint32_t span_ms;
+  uint32_t bucket_ms;
+  uint32_t newest; /**< Bucket number, time / bucket_ms, of the last add */
+  uint32_t newest_ms; /**< Time of the last sample */
+} iaq_window_t;
+
+/**
+ * @brief Initialize an empty window
+ * @param window Window to initialize
+ * @param span_ms Age beyond which samples leave the window
+ */
+void iaq_window_init(iaq_window_t *window, uint32_t span_ms);
+
+/**
+ * @brief Add a sample and expire the buckets that fell out of the span
+ * @param window Window
+ * @param now_ms Sample time; times must not decrease
+ * @param x Sample
+ */
+void iaq_window_add(iaq_window_t *window, uint32_t now_ms, float x);
+
+/**
+ * @brief Statistics of the samples currently in the window
+ * @param window Window
+ * @param stats Output
+ */
+void iaq_window_get(const iaq_window_t *window, iaq_window_stats_t *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // IAQ_WINDOW_H
@@ -5,18 +5,22 @@
 
 #include "mqtt_client_app.h"
 
-#include "cJSON.h"
 #include "esp_event.h"
 #include "esp_log.h"
 #include "esp_netif.h"
 #include "esp_system.h"
 #include "esp_wifi.h"
+#include "fixed_fmt.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/event_groups.h"
 #include "freertos/semphr.h"
 #include "freertos/task.h"
 #include "mqtt_client.h"
 #include "nvs_flash.h"
+#include <inttypes.h>
+#include <math.h>
+#include <stdarg.h>
+#include <stdio.h>
 #include <string.h>
 #include <time.h>
 
@@ -25,11 +29,17 @@
 #define WIFI_FAIL_BIT BIT1
 
 static EventGroupHandle_t s_wifi_event_group = NULL;
+static StaticEventGroup_t s_wifi_event_group_buffer;
 static int s_retry_num = 0;
 static bool s_wifi_connected = false;
 static esp_mqtt_client_handle_t s_mqtt_client = NULL;
 static mqtt_status_t s_mqtt_status = MQTT_STATUS_DISCONNECTED;
+// Guards s_payload, which every JSON message is built in
 static SemaphoreHandle_t s_mqtt_mutex = NULL;
+static StaticSemaphore_t s_mqtt_mutex_buffer;
+static char s_payload[MQTT_PAYLOAD_SIZE];
+static mqtt_calibration_handler_t s_calibration_handler = NULL;
+static mqtt_rate_handler_t s_rate_handler = NULL;
 
 /**
  * @brief WiFi event handler
@@ -60,6 +70,11 @@ static void wifi_event_handler(void *arg, esp_event_base_t event_base,
   }
 }
 
+static bool is_topic(esp_mqtt_event_handle_t event, const char *topic) {
+  size_t len = strlen(topic);
+  return event->topic_len == (int)len && memcmp(event->topic, topic, len) == 0;
+}
+
 /**
  * @brief MQTT event handler
  */
@@ -71,6 +86,12 @@ static void mqtt_event_handler(void *handler_args, esp_event_base_t base,
   case MQTT_EVENT_CONNECTED:
     ESP_LOGI(TAG, "MQTT Connected to broker");
     s_mqtt_status = MQTT_STATUS_CONNECTED;
+    if (s_calibration_handler != NULL) {
+      esp_mqtt_client_subscribe(s_mqtt_client, MQTT_TOPIC_CALIBRATION, 1);
+    }
+    if (s_rate_handler != NULL) {
+      esp_mqtt_client_subscribe(s_mqtt_client, MQTT_TOPIC_RATE, 1);
+    }
 
 #if !MQTT_USE_THINGSBOARD
     mqtt_publish_status("online");
@@ -95,6 +116,22 @@ static void mqtt_event_handler(void *handler_args, esp_event_base_t base,
     break;
 
   case MQTT_EVENT_DATA:
+    if (is_topic(event, MQTT_TOPIC_CALIBRATION)) {
+      // Records are far below the buffer size, so they arrive in one piece
+      if (event->current_data_offset == 0 &&
+          event->data_len == event->total_data_len &&
+          s_calibration_handler != NULL) {
+        s_calibration_handler(event->data, (size_t)event->data_len);
+      }
+      break;
+    }
+    if (is_topic(event, MQTT_TOPIC_RATE)) {
+      if (event->current_data_offset == 0 &&
+          event->data_len == event->total_data_len && s_rate_handler != NULL) {
+        s_rate_handler(event->data, (size_t)event->data_len);
+      }
+      break;
+    }
     ESP_LOGI(TAG, "MQTT Data received");
     ESP_LOGI(TAG, "  Topic: %.*s", event->topic_len, event->topic);
     ESP_LOGI(TAG, "  Data: %.*s", event->data_len, event->data);
@@ -115,94 +152,210 @@ static void mqtt_event_handler(void *handler_args, esp_event_base_t base,
   }
 }
 
+// Decimals sent per quantity, at least the resolution of the source
+#define DECIMALS_CLIMATE 2 // degC, %RH, hPa
+#define DECIMALS_GAS 1     // Ohms
+#define DECIMALS_INDEX 1   // IAQ, ppm CO2
+#define DECIMALS_VOC 3     // ppm VOC
+#define DECIMALS_ANOMALY 2 // z-scores
+
+/**
+ * @brief JSON object written in place into s_payload
+ *
+ * len reaches size once the object no longer fits; everything written after
+ * that is ignored and json_publish() refuses the payload.
+ */
+typedef struct {
+  char *buf;
+  size_t size;
+  size_t len;
+} json_writer_t;
+
+static void json_append(json_writer_t *w, const char *fmt, ...) {
+  if (w->len >= w->size) {
+    return;
+  }
+  va_list args;
+  va_start(args, fmt);
+  int n = vsnprintf(w->buf + w->len, w->size - w->len, fmt, args);
+  va_end(args);
+  w->len = n < 0 ? w->size : w->len + (size_t)n;
+}
+
+static void json_key(json_writer_t *w, const char *key) {
+  json_append(w, "%s\"%s\":", w->len > 1 ? "," : "", key);
+}
+
+static void json_begin(json_writer_t *w) {
+  w->buf = s_payload;
+  w->size = sizeof(s_payload);
+  w->len = 0;
+  json_append(w, "{");
+}
+
 /**
- * @brief Create JSON string from sensor data
+ * @brief Add a number rounded to decimals places
+ *
+ * Printed from integers: the MQTT sink is heap audited, and newlib's float
+ * formatting may allocate on any call.
  */
-static char *create_sensor_json(const mqtt_sensor_data_t *data) {
-  cJSON *root = cJSON_CreateObject();
-  if (root == NULL) {
-    return NULL;
+static void json_number(json_writer_t *w, const char *key, float value,
+                        int decimals) {
+  json_key(w, key);
+  // JSON has no NaN or infinity
+  if (isfinite(value)) {
+    fixed_fmt_t f = fixed_split(value, decimals);
+    json_append(w, FIXED_FMT, FIXED_ARGS(f));
+  } else {
+    json_append(w, "null");
   }
+}
 
-  cJSON_AddNumberToObject(root, "temperature", data->temperature);
-  cJSON_AddNumberToObject(root, "humidity", data->humidity);
-  cJSON_AddNumberToObject(root, "pressure", data->pressure);
-  cJSON_AddNumberToObject(root, "gas_resistance", data->gas_resistance);
-  cJSON_AddBoolToObject(root, "gas_valid", data->gas_valid);
-  cJSON_AddNumberToObject(root, "timestamp", (double)time(NULL));
+static void json_int(json_writer_t *w, const char *key, int64_t value) {
+  json_key(w, key);
+  json_append(w, "%" PRId64, value);
+}
 
-  char *json_str = cJSON_PrintUnformatted(root);
-  cJSON_Delete(root);
+static void json_bool(json_writer_t *w, const char *key, bool value) {
+  json_key(w, key);
+  json_append(w, value ? "true" : "false");
+}
 
-  return json_str;
+static void json_string(json_writer_t *w, const char *key, const char *value) {
+  json_key(w, key);
+  json_append(w, "\"");
+  for (const char *c = value; *c != '\0'; c++) {
+    if (*c == '"' || *c == '\\') {
+      json_append(w, "\\%c", *c);
+    } else if ((unsigned char)*c < 0x20) {
+      json_append(w, "\\u%04x", (unsigned char)*c);
+    } else {
+      json_append(w, "%c", *c);
+    }
+  }
+  json_append(w, "\"");
 }
 
 /**
- * @brief Create JSON string from IAQ data
+ * @brief Close the object and publish it; the client copies the payload
+ *        before returning, so the caller may release s_mqtt_mutex after
  */
-static char *create_iaq_json(const mqtt_iaq_data_t *data) {
-  cJSON *root = cJSON_CreateObject();
-  if (root == NULL) {
-    return NULL;
-  }
-
-  cJSON_AddNumberToObject(root, "iaq_score", data->iaq_score);
-  cJSON_AddNumberToObject(root, "iaq_level", data->iaq_level);
-  cJSON_AddStringToObject(root, "iaq_text",
-                          data->iaq_text ? data->iaq_text : "Unknown");
-  cJSON_AddNumberToObject(root, "accuracy", data->accuracy);
-  cJSON_AddNumberToObject(root, "co2_equivalent", data->co2_equivalent);
-  cJSON_AddNumberToObject(root, "voc_equivalent", data->voc_equivalent);
-  cJSON_AddBoolToObject(root, "is_calibrated", data->is_calibrated);
-  cJSON_AddNumberToObject(root, "timestamp", (double)time(NULL));
-
-  char *json_str = cJSON_PrintUnformatted(root);
-  cJSON_Delete(root);
-
-  return json_str;
+static esp_err_t json_publish(json_writer_t *w, const char *topic, int qos,
+                              int retain) {
+  json_append(w, "}");
+  if (w->len >= w->size) {
+    ESP_LOGE(TAG, "Payload for %s exceeds %u bytes", topic,
+             (unsigned)w->size);
+    return ESP_ERR_INVALID_SIZE;
+  }
+
+  int msg_id = esp_mqtt_client_publish(s_mqtt_client, topic, w->buf,
+                                       (int)w->len, qos, retain);
+  if (msg_id < 0) {
+    return ESP_FAIL;
+  }
+  ESP_LOGD(TAG, "Published to %s, msg_id=%d", topic, msg_id);
+  return ESP_OK;
+}
+
+/**
+ * @brief Add the sampling cadence fields to a telemetry object
+ */
+static void add_rate_json(json_writer_t *w, const mqtt_rate_data_t *rate) {
+  json_string(w, "sample_mode", rate->mode);
+  json_int(w, "sample_interval_ms", rate->interval_ms);
+  json_bool(w, "sample_override", rate->override);
+  json_int(w, "time_slow_s", rate->time_slow_s);
+  json_int(w, "time_normal_s", rate->time_normal_s);
+  json_int(w, "time_burst_s", rate->time_burst_s);
+}
+
+/**
+ * @brief Write the JSON object for sensor data
+ */
+static void write_sensor_json(json_writer_t *w,
+                              const mqtt_sensor_data_t *data) {
+  json_begin(w);
+  json_number(w, "temperature", data->temperature, DECIMALS_CLIMATE);
+  json_number(w, "humidity", data->humidity, DECIMALS_CLIMATE);
+  json_number(w, "pressure", data->pressure, DECIMALS_CLIMATE);
+  json_number(w, "gas_resistance", data->gas_resistance, DECIMALS_GAS);
+  json_bool(w, "gas_valid", data->gas_valid);
+  if (data->rate != NULL) {
+    add_rate_json(w, data->rate);
+  }
+  json_int(w, "timestamp", (int64_t)time(NULL));
+}
+
+/**
+ * @brief Write the JSON object for IAQ data
+ */
+static void write_iaq_json(json_writer_t *w, const mqtt_iaq_data_t *data) {
+  json_begin(w);
+  json_number(w, "iaq_score", data->iaq_score, DECIMALS_INDEX);
+  json_int(w, "iaq_level", data->iaq_level);
+  json_string(w, "iaq_text", data->iaq_text ? data->iaq_text : "Unknown");
+  json_int(w, "accuracy", data->accuracy);
+  json_number(w, "co2_equivalent", data->co2_equivalent, DECIMALS_INDEX);
+  json_number(w, "voc_equivalent", data->voc_equivalent, DECIMALS_VOC);
+  json_bool(w, "is_calibrated", data->is_calibrated);
+  json_number(w, "anomaly_temperature", data->anomaly_temperature,
+              DECIMALS_ANOMALY);
+  json_number(w, "anomaly_humidity", data->anomaly_humidity,
+              DECIMALS_ANOMALY);
+  json_number(w, "anomaly_pressure", data->anomaly_pressure,
+              DECIMALS_ANOMALY);
+  json_number(w, "anomaly_gas", data->anomaly_gas, DECIMALS_ANOMALY);
+  json_bool(w, "anomaly", data->anomaly);
+  json_int(w, "timestamp", (int64_t)time(NULL));
 }
 
 #if MQTT_USE_THINGSBOARD
 /**
- * @brief Create JSON for ThingsBoard telemetry (sensor + IAQ in one payload)
+ * @brief Write the JSON object for ThingsBoard telemetry (sensor + IAQ in
+ *        one payload)
  */
-static char *create_thingsboard_telemetry_json(const mqtt_sensor_data_t *sensor,
-                                                const mqtt_iaq_data_t *iaq) {
-  cJSON *root = cJSON_CreateObject();
-  if (root == NULL) {
-    return NULL;
+static void write_thingsboard_telemetry_json(json_writer_t *w,
+                                             const mqtt_sensor_data_t *sensor,
+                                             const mqtt_iaq_data_t *iaq) {
+  json_begin(w);
+  json_number(w, "temperature", sensor->temperature, DECIMALS_CLIMATE);
+  json_number(w, "humidity", sensor->humidity, DECIMALS_CLIMATE);
+  json_number(w, "pressure", sensor->pressure, DECIMALS_CLIMATE);
+  json_number(w, "gas_resistance", sensor->gas_resistance, DECIMALS_GAS);
+  json_bool(w, "gas_valid", sensor->gas_valid);
+  if (sensor->rate != NULL) {
+    add_rate_json(w, sensor->rate);
   }
 
-  cJSON_AddNumberToObject(root, "temperature", sensor->temperature);
-  cJSON_AddNumberToObject(root, "humidity", sensor->humidity);
-  cJSON_AddNumberToObject(root, "pressure", sensor->pressure);
-  cJSON_AddNumberToObject(root, "gas_resistance", sensor->gas_resistance);
-  cJSON_AddBoolToObject(root, "gas_valid", sensor->gas_valid);
-
   if (iaq != NULL) {
-    cJSON_AddNumberToObject(root, "iaq_score", iaq->iaq_score);
-    cJSON_AddNumberToObject(root, "iaq_level", iaq->iaq_level);
-    cJSON_AddNumberToObject(root, "co2_equivalent", iaq->co2_equivalent);
-    cJSON_AddNumberToObject(root, "voc_equivalent", iaq->voc_equivalent);
-    cJSON_AddBoolToObject(root, "is_calibrated", iaq->is_calibrated);
-    cJSON_AddNumberToObject(root, "accuracy", iaq->accuracy);
+    json_number(w, "iaq_score", iaq->iaq_score, DECIMALS_INDEX);
+    json_int(w, "iaq_level", iaq->iaq_level);
+    json_number(w, "co2_equivalent", iaq->co2_equivalent, DECIMALS_INDEX);
+    json_number(w, "voc_equivalent", iaq->voc_equivalent, DECIMALS_VOC);
+    json_bool(w, "is_calibrated", iaq->is_calibrated);
+    json_int(w, "accuracy", iaq->accuracy);
+    json_number(w, "anomaly_temperature", iaq->anomaly_temperature,
+                DECIMALS_ANOMALY);
+    json_number(w, "anomaly_humidity", iaq->anomaly_humidity,
+                DECIMALS_ANOMALY);
+    json_number(w, "anomaly_pressure", iaq->anomaly_pressure,
+                DECIMALS_ANOMALY);
+    json_number(w, "anomaly_gas", iaq->anomaly_gas, DECIMALS_ANOMALY);
+    json_bool(w, "anomaly", iaq->anomaly);
     if (iaq->iaq_text != NULL) {
-      cJSON_AddStringToObject(root, "iaq_text", iaq->iaq_text);
+      json_string(w, "iaq_text", iaq->iaq_text);
     }
   }
 
-  cJSON_AddNumberToObject(root, "ts", (double)(time(NULL) * 1000));
-
-  char *json_str = cJSON_PrintUnformatted(root);
-  cJSON_Delete(root);
-  return json_str;
+  json_int(w, "ts", (int64_t)time(NULL) * 1000);
 }
 #endif
 
 esp_err_t wifi_init_sta(void) {
   ESP_LOGI(TAG, "Initializing WiFi Station mode...");
 
-  s_wifi_event_group = xEventGroupCreate();
+  s_wifi_event_group = xEventGroupCreateStatic(&s_wifi_event_group_buffer);
   if (s_wifi_event_group == NULL) {
     ESP_LOGE(TAG, "Failed to create WiFi event group");
     return ESP_ERR_NO_MEM;
@@ -260,7 +413,7 @@ esp_err_t wifi_init_sta(void) {
 esp_err_t mqtt_app_init(void) {
   ESP_LOGI(TAG, "Initializing MQTT client...");
 
-  s_mqtt_mutex = xSemaphoreCreateMutex();
+  s_mqtt_mutex = xSemaphoreCreateMutexStatic(&s_mqtt_mutex_buffer);
   if (s_mqtt_mutex == NULL) {
     ESP_LOGE(TAG, "Failed to create MQTT mutex");
     return ESP_ERR_NO_MEM;
@@ -331,24 +484,16 @@ esp_err_t mqtt_publish_sensor_data(const mqtt_sensor_data_t *data) {
     return ESP_ERR_INVALID_STATE;
   }
 
-  char *json_str = create_sensor_json(data);
-  if (json_str == NULL) {
-    ESP_LOGE(TAG, "Failed to create sensor JSON");
-    return ESP_ERR_NO_MEM;
-  }
-
-  int msg_id = esp_mqtt_client_publish(s_mqtt_client, MQTT_TOPIC_SENSOR,
-                                       json_str, strlen(json_str), 1, 0);
+  json_writer_t w;
+  xSemaphoreTake(s_mqtt_mutex, portMAX_DELAY);
+  write_sensor_json(&w, data);
+  esp_err_t ret = json_publish(&w, MQTT_TOPIC_SENSOR, MQTT_TELEMETRY_QOS, 0);
+  xSemaphoreGive(s_mqtt_mutex);
 
-  free(json_str);
-
-  if (msg_id < 0) {
+  if (ret != ESP_OK) {
     ESP_LOGE(TAG, "Failed to publish sensor data");
-    return ESP_FAIL;
   }
-
-  ESP_LOGD(TAG, "Sensor data published, msg_id=%d", msg_id);
-  return ESP_OK;
+  return ret;
 }
 
 esp_err_t mqtt_publish_iaq_data(const mqtt_iaq_data_t *data) {
@@ -361,24 +506,16 @@ esp_err_t mqtt_publish_iaq_data(const mqtt_iaq_data_t *data) {
     return ESP_ERR_INVALID_STATE;
   }
 
-  char *json_str = create_iaq_json(data);
-  if (json_str == NULL) {
-    ESP_LOGE(TAG, "Failed to create IAQ JSON");
-    return ESP_ERR_NO_MEM;
-  }
-
-  int msg_id = esp_mqtt_client_publish(s_mqtt_client, MQTT_TOPIC_IAQ, json_str,
-                                       strlen(json_str), 1, 0);
+  json_writer_t w;
+  xSemaphoreTake(s_mqtt_mutex, portMAX_DELAY);
+  write_iaq_json(&w, data);
+  esp_err_t ret = json_publish(&w, MQTT_TOPIC_IAQ, MQTT_TELEMETRY_QOS, 0);
+  xSemaphoreGive(s_mqtt_mutex);
 
-  free(json_str);
-
-  if (msg_id < 0) {
+  if (ret != ESP_OK) {
     ESP_LOGE(TAG, "Failed to publish IAQ data");
-    return ESP_FAIL;
   }
-
-  ESP_LOGD(TAG, "IAQ data published, msg_id=%d", msg_id);
-  return ESP_OK;
+  return ret;
 }
 
 esp_err_t mqtt_publish_status(const char *status) {
@@ -390,30 +527,19 @@ esp_err_t mqtt_publish_status(const char *status) {
     return ESP_ERR_INVALID_STATE;
   }
 
-  cJSON *root = cJSON_CreateObject();
-  if (root == NULL) {
-    return ESP_ERR_NO_MEM;
-  }
-
-  cJSON_AddStringToObject(root, "status", status);
-  cJSON_AddStringToObject(root, "client_id", MQTT_CLIENT_ID);
-  cJSON_AddNumberToObject(root, "timestamp", (double)time(NULL));
-
-  char *json_str = cJSON_PrintUnformatted(root);
-  cJSON_Delete(root);
-
-  if (json_str == NULL) {
-    return ESP_ERR_NO_MEM;
-  }
-
-  int msg_id = esp_mqtt_client_publish(s_mqtt_client, MQTT_TOPIC_STATUS,
-                                       json_str, strlen(json_str), 1, 1);
-
-  free(json_str);
+  // Only sent on (dis)connecting, so it can afford QoS 1
+  json_writer_t w;
+  xSemaphoreTake(s_mqtt_mutex, portMAX_DELAY);
+  json_begin(&w);
+  json_string(&w, "status", status);
+  json_string(&w, "client_id", MQTT_CLIENT_ID);
+  json_int(&w, "timestamp", (int64_t)time(NULL));
+  esp_err_t ret = json_publish(&w, MQTT_TOPIC_STATUS, 1, 1);
+  xSemaphoreGive(s_mqtt_mutex);
 
-  if (msg_id < 0) {
+  if (ret != ESP_OK) {
     ESP_LOGE(TAG, "Failed to publish status");
-    return ESP_FAIL;
+    return ret;
   }
 
   ESP_LOGI(TAG, "Status published: %s", status);
@@ -429,34 +555,83 @@ esp_err_t mqtt_publish_alert(const char *alert_type, const char *message) {
     return ESP_ERR_INVALID_STATE;
   }
 
-  cJSON *root = cJSON_CreateObject();
-  if (root == NULL) {
-    return ESP_ERR_NO_MEM;
+  // Repeated with every polluted reading
+  json_writer_t w;
+  xSemaphoreTake(s_mqtt_mutex, portMAX_DELAY);
+  json_begin(&w);
+  json_string(&w, "type", alert_type);
+  json_string(&w, "message", message);
+  json_string(&w, "client_id", MQTT_CLIENT_ID);
+  json_int(&w, "timestamp", (int64_t)time(NULL));
+  esp_err_t ret = json_publish(&w, MQTT_TOPIC_ALERT, MQTT_ALERT_QOS, 0);
+  xSemaphoreGive(s_mqtt_mutex);
+
+  if (ret != ESP_OK) {
+    ESP_LOGE(TAG, "Failed to publish alert");
+    return ret;
   }
 
-  cJSON_AddStringToObject(root, "type", alert_type);
-  cJSON_AddStringToObject(root, "message", message);
-  cJSON_AddStringToObject(root, "client_id", MQTT_CLIENT_ID);
-  cJSON_AddNumberToObject(root, "timestamp", (double)time(NULL));
+  ESP_LOGW(TAG, "Alert published: [%s] %s", alert_type, message);
+  return ESP_OK;
+}
 
-  char *json_str = cJSON_PrintUnformatted(root);
-  cJSON_Delete(root);
+esp_err_t mqtt_publish_calibration(const void *record, size_t length) {
+  if (record == NULL || length == 0) {
+    return ESP_ERR_INVALID_ARG;
+  }
 
-  if (json_str == NULL) {
-    return ESP_ERR_NO_MEM;
+  if (s_mqtt_status != MQTT_STATUS_CONNECTED) {
+    return ESP_ERR_INVALID_STATE;
+  }
+
+  // QoS 0: the next hourly record replaces a lost one, and at QoS 1 the
+  // client would allocate an outbox entry on the audited MQTT sink
+  int msg_id = esp_mqtt_client_publish(s_mqtt_client, MQTT_TOPIC_CALIBRATION,
+                                       (const char *)record, (int)length, 0,
+                                       1);
+  if (msg_id < 0) {
+    ESP_LOGE(TAG, "Failed to publish calibration");
+    return ESP_FAIL;
   }
 
-  int msg_id = esp_mqtt_client_publish(s_mqtt_client, MQTT_TOPIC_ALERT,
-                                       json_str, strlen(json_str), 1, 0);
+  ESP_LOGD(TAG, "Calibration published, msg_id=%d", msg_id);
+  return ESP_OK;
+}
 
-  free(json_str);
+esp_err_t mqtt_subscribe_calibration(mqtt_calibration_handler_t handler) {
+  if (handler == NULL) {
+    return ESP_ERR_INVALID_ARG;
+  }
+  if (s_mqtt_client == NULL) {
+    return ESP_ERR_INVALID_STATE;
+  }
 
-  if (msg_id < 0) {
-    ESP_LOGE(TAG, "Failed to publish alert");
+  s_calibration_handler = handler;
+  // Otherwise the subscription is made on MQTT_EVENT_CONNECTED
+  if (s_mqtt_status == MQTT_STATUS_CONNECTED &&
+      esp_mqtt_client_subscribe(s_mqtt_client, MQTT_TOPIC_CALIBRATION, 1) <
+          0) {
+    ESP_LOGE(TAG, "Failed to subscribe to calibration");
     return ESP_FAIL;
   }
+  return ESP_OK;
+}
 
-  ESP_LOGW(TAG, "Alert published: [%s] %s", alert_type, message);
+esp_err_t mqtt_subscribe_rate(mqtt_rate_handler_t handler) {
+  if (handler == NULL) {
+    return ESP_ERR_INVALID_ARG;
+  }
+  if (s_mqtt_client == NULL) {
+    return ESP_ERR_INVALID_STATE;
+  }
+
+  s_rate_handler = handler;
+  // Otherwise the subscription is made on MQTT_EVENT_CONNECTED
+  if (s_mqtt_status == MQTT_STATUS_CONNECTED &&
+      esp_mqtt_client_subscribe(s_mqtt_client, MQTT_TOPIC_RATE, 1) < 0) {
+    ESP_LOGE(TAG, "Failed to subscribe to sampling commands");
+    return ESP_FAIL;
+  }
   return ESP_OK;
 }
 
@@ -471,22 +646,17 @@ esp_err_t mqtt_publish_thingsboard_telemetry(const mqtt_sensor_data_t *sensor,
     return ESP_ERR_INVALID_STATE;
   }
 
-  char *json_str = create_thingsboard_telemetry_json(sensor, iaq);
-  if (json_str == NULL) {
-    ESP_LOGE(TAG, "Failed to create ThingsBoard telemetry JSON");
-    return ESP_ERR_NO_MEM;
-  }
-
-  int msg_id = esp_mqtt_client_publish(s_mqtt_client, MQTT_TOPIC_TELEMETRY,
-                                       json_str, strlen(json_str), 1, 0);
-  free(json_str);
+  json_writer_t w;
+  xSemaphoreTake(s_mqtt_mutex, portMAX_DELAY);
+  write_thingsboard_telemetry_json(&w, sensor, iaq);
+  esp_err_t ret =
+      json_publish(&w, MQTT_TOPIC_TELEMETRY, MQTT_TELEMETRY_QOS, 0);
+  xSemaphoreGive(s_mqtt_mutex);
 
-  if (msg_id < 0) {
+  if (ret != ESP_OK) {
     ESP_LOGE(TAG, "Failed to publish ThingsBoard telemetry");
-    return ESP_FAIL;
   }
-  ESP_LOGD(TAG, "ThingsBoard telemetry published, msg_id=%d", msg_id);
-  return ESP_OK;
+  return ret;
 }
 #endif
 
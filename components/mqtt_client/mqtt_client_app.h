@@ -9,6 +9,7 @@
 #include "esp_err.h"
 #include "sdkconfig.h"
 #include <stdbool.h>
+#include <stddef.h>
 #include <stdint.h>
 
 #ifdef __cplusplus
@@ -30,6 +31,31 @@ extern "C" {
 #define MQTT_TOPIC_IAQ "sensor/bme680/iaq"
 #define MQTT_TOPIC_STATUS "sensor/bme680/status"
 #define MQTT_TOPIC_ALERT "sensor/bme680/alert"
+// Room this device measures; devices with the same room share calibration
+#define MQTT_ROOM_ID "default"
+// Retained binary calibration record of the room
+#define MQTT_TOPIC_CALIBRATION "sensor/bme680/" MQTT_ROOM_ID "/calibration"
+// Sampling mode override: "slow", "normal", "burst" or "auto", retained
+#define MQTT_TOPIC_RATE "sensor/bme680/rate"
+
+// QoS of the messages sent for each reading, see Kconfig
+#define MQTT_TELEMETRY_QOS CONFIG_MQTT_TELEMETRY_QOS
+// QoS of alerts, which no later reading repeats
+#define MQTT_ALERT_QOS 1
+// Largest JSON payload, built in place in a static buffer
+#define MQTT_PAYLOAD_SIZE 768
+
+/**
+ * @brief Sampling cadence for MQTT publishing
+ */
+typedef struct {
+  const char *mode;
+  uint32_t interval_ms;
+  bool override; /**< Mode set remotely */
+  uint32_t time_slow_s;
+  uint32_t time_normal_s;
+  uint32_t time_burst_s;
+} mqtt_rate_data_t;
 
 /**
  * @brief Sensor data structure for MQTT publishing
@@ -40,6 +66,7 @@ typedef struct {
   float pressure;
   float gas_resistance;
   bool gas_valid;
+  const mqtt_rate_data_t *rate; /**< Optional */
 } mqtt_sensor_data_t;
 
 /**
@@ -53,8 +80,34 @@ typedef struct {
   float co2_equivalent;
   float voc_equivalent;
   bool is_calibrated;
+  /* Z-scores of the reading against each channel's recent behaviour */
+  float anomaly_temperature;
+  float anomaly_humidity;
+  float anomaly_pressure;
+  float anomaly_gas;
+  bool anomaly; /**< Some channel is beyond the anomaly threshold */
 } mqtt_iaq_data_t;
 
+/**
+ * @brief Handler for a calibration record received from the broker
+ *
+ * Called from the MQTT client task.
+ *
+ * @param data Record payload
+ * @param length Payload length in bytes
+ */
+typedef void (*mqtt_calibration_handler_t)(const void *data, size_t length);
+
+/**
+ * @brief Handler for a sampling mode command received from the broker
+ *
+ * Called from the MQTT client task.
+ *
+ * @param data Command text, not terminated
+ * @param length Text length in bytes
+ */
+typedef void (*mqtt_rate_handler_t)(const char *data, size_t length);
+
 /**
  * @brief MQTT Connection status
  */
@@ -118,6 +171,36 @@ esp_err_t mqtt_publish_status(const char *status);
  */
 esp_err_t mqtt_publish_alert(const char *alert_type, const char *message);
 
+/**
+ * @brief Publish a binary calibration record, retained for future devices
+ * @param record Record payload
+ * @param length Payload length in bytes
+ * @return ESP_OK on success, error code otherwise
+ */
+esp_err_t mqtt_publish_calibration(const void *record, size_t length);
+
+/**
+ * @brief Receive calibration records, now and after every reconnect
+ *
+ * The broker delivers the retained record right after subscribing, so a
+ * new device gets the last one published for its room.
+ *
+ * @param handler Called for every complete record
+ * @return ESP_OK on success, error code otherwise
+ */
+esp_err_t mqtt_subscribe_calibration(mqtt_calibration_handler_t handler);
+
+/**
+ * @brief Receive sampling mode commands, now and after every reconnect
+ *
+ * A retained command is delivered again after each reconnect, so an
+ * override outlives connection drops until "auto" is published.
+ *
+ * @param handler Called for every command
+ * @return ESP_OK on success, error code otherwise
+ */
+esp_err_t mqtt_subscribe_rate(mqtt_rate_handler_t handler);
+
 #if MQTT_USE_THINGSBOARD
 /**
  * @brief Publish combined sensor + IAQ telemetry to ThingsBoard
@@ -0,0 +1,105 @@
+/**
+ * @file periodic.c
+ * @brief Drift-free periodic scheduling with jitter accounting
+ */
+
+#include "periodic.h"
+#include "esp_timer.h"
+#include "freertos/task.h"
+#include <stdlib.h>
+#include <string.h>
+
+static int64_t period_us(const periodic_t *p) {
+  return (int64_t)p->period * portTICK_PERIOD_MS * 1000;
+}
+
+esp_err_t periodic_init(periodic_t *p, uint32_t period_ms,
+                        periodic_overrun_t policy) {
+  if (p == NULL || pdMS_TO_TICKS(period_ms) == 0) {
+    return ESP_ERR_INVALID_ARG;
+  }
+
+  memset(p, 0, sizeof(*p));
+  p->period = pdMS_TO_TICKS(period_ms);
+  p->policy = policy;
+  p->last_wake = xTaskGetTickCount();
+  SemaphoreHandle_t wake = xSemaphoreCreateBinaryStatic(&p->wake_buffer);
+  __atomic_store_n(&p->wake, wake, __ATOMIC_RELEASE);
+  return ESP_OK;
+}
+
+void periodic_set_period(periodic_t *p, uint32_t period_ms) {
+  TickType_t period = pdMS_TO_TICKS(period_ms);
+  if (period > 0) {
+    p->period = period;
+  }
+}
+
+bool periodic_wait(periodic_t *p) {
+  TickType_t behind = xTaskGetTickCount() - p->last_wake;
+  bool overran = behind >= p->period;
+
+  if (overran) {
+    p->stats.overruns++;
+    // Move the grid to the last passed instant, so the delay below wakes at
+    // the first one still ahead; catching up lets it return at once instead
+    if (p->policy == PERIODIC_SKIP) {
+      uint32_t missed = behind / p->period;
+      p->last_wake += missed * p->period;
+      p->ideal_us += missed * period_us(p);
+      p->stats.skipped += missed;
+    }
+  }
+
+  // Block until the next instant, which is due at once if it has passed,
+  // unless a wake comes first
+  TickType_t next = p->last_wake + p->period;
+  TickType_t ahead = next - xTaskGetTickCount();
+  bool woken =
+      xSemaphoreTake(p->wake, ahead <= p->period ? ahead : 0) == pdTRUE;
+  int64_t now_us = esp_timer_get_time();
+
+  // The first wake anchors the grid, as does one from periodic_wake(); the
+  // tick and esp_timer clocks share a crystal, so from here on any
+  // difference is wake-up latency
+  if (woken) {
+    p->last_wake = xTaskGetTickCount();
+    p->ideal_us = now_us;
+    p->stats.woken++;
+  } else {
+    p->last_wake = next;
+    if (p->stats.cycles == 0) {
+      p->ideal_us = now_us;
+    } else {
+      p->ideal_us += period_us(p);
+    }
+  }
+
+  int32_t jitter = (int32_t)(now_us - p->ideal_us);
+  uint32_t magnitude = (uint32_t)abs(jitter);
+  p->stats.cycles++;
+  p->stats.last_jitter_us = jitter;
+  if (magnitude > p->stats.max_jitter_us) {
+    p->stats.max_jitter_us = magnitude;
+  }
+  p->jitter_total_us += magnitude;
+  return overran;
+}
+
+uint32_t periodic_instant_ms(const periodic_t *p) {
+  return (uint32_t)p->last_wake * portTICK_PERIOD_MS;
+}
+
+void periodic_wake(periodic_t *p) {
+  SemaphoreHandle_t wake = __atomic_load_n(&p->wake, __ATOMIC_ACQUIRE);
+  if (wake != NULL) {
+    xSemaphoreGive(wake);
+  }
+}
+
+void periodic_get_stats(const periodic_t *p, periodic_stats_t *stats) {
+  *stats = p->stats;
+  if (p->stats.cycles > 0) {
+    stats->mean_jitter_us = (uint32_t)(p->jitter_total_us / p->stats.cycles);
+  }
+}
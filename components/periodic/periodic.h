@@ -0,0 +1,121 @@
+/**
+ * @file periodic.h
+ * @brief Drift-free periodic scheduling with jitter accounting
+ *
+ * Instants are kept on an absolute tick grid: each wait blocks until the
+ * last instant plus the period, so the time a cycle spends working never
+ * pushes later instants back. Each wake is timed with esp_timer against
+ * the ideal grid, and a cycle that runs past the next instant is handled
+ * by an explicit overrun policy. Another task can end a wait early, for a
+ * new period to take effect at once.
+ */
+
+#ifndef PERIODIC_H
+#define PERIODIC_H
+
+#include "esp_err.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief What a wait does when the next instant has already passed
+ */
+typedef enum {
+  PERIODIC_SKIP = 0, /**< Drop the missed instants, resume on the grid */
+  PERIODIC_CATCH_UP, /**< Run the missed instants back to back */
+} periodic_overrun_t;
+
+/**
+ * @brief Schedule counters
+ */
+typedef struct {
+  uint32_t cycles;         /**< Waits completed */
+  uint32_t overruns;       /**< Cycles still busy when the next instant came */
+  uint32_t skipped;        /**< Instants dropped under PERIODIC_SKIP */
+  uint32_t woken;          /**< Waits ended early by periodic_wake() */
+  int32_t last_jitter_us;  /**< Last wake minus its ideal instant */
+  uint32_t max_jitter_us;  /**< Largest |jitter| */
+  uint32_t mean_jitter_us; /**< Mean |jitter| */
+} periodic_stats_t;
+
+/**
+ * @brief Scheduler state, owned by the task that waits on it
+ *
+ * Only periodic_wake() may be called from other tasks. Holds its own
+ * semaphore, so it must stay where it was initialized.
+ */
+typedef struct {
+  TickType_t period;    /**< Ticks between instants */
+  TickType_t last_wake; /**< Grid instant of the current cycle */
+  periodic_overrun_t policy;
+  int64_t ideal_us; /**< esp_timer time of the current instant */
+  uint64_t jitter_total_us;
+  periodic_stats_t stats;
+  SemaphoreHandle_t wake; /**< Given by periodic_wake() */
+  StaticSemaphore_t wake_buffer;
+} periodic_t;
+
+/**
+ * @brief Start a grid at the current tick
+ * @param p Scheduler
+ * @param period_ms Interval, at least one tick
+ * @param policy Overrun policy
+ * @return ESP_OK, or ESP_ERR_INVALID_ARG for a period under one tick
+ */
+esp_err_t periodic_init(periodic_t *p, uint32_t period_ms,
+                        periodic_overrun_t policy);
+
+/**
+ * @brief Change the interval from the current instant on
+ * @param p Scheduler
+ * @param period_ms Interval, at least one tick; shorter ones are ignored
+ */
+void periodic_set_period(periodic_t *p, uint32_t period_ms);
+
+/**
+ * @brief Block until the next instant on the grid or a periodic_wake()
+ *
+ * A wake, including one that came while the cycle was still running, ends
+ * the wait at once and restarts the grid there.
+ *
+ * @param p Scheduler
+ * @return true if the cycle before this wait overran
+ */
+bool periodic_wait(periodic_t *p);
+
+/**
+ * @brief Grid instant of the current cycle on the tick clock
+ *
+ * Unlike a timestamp taken during the cycle, successive instants are
+ * exact multiples of the period apart, so a consumer that weights samples
+ * by the time between them sees the same interval every cycle.
+ *
+ * @param p Scheduler
+ * @return Milliseconds since boot, wrapping like any uint32_t clock
+ */
+uint32_t periodic_instant_ms(const periodic_t *p);
+
+/**
+ * @brief End the current or next wait early; safe from any task
+ * @param p Scheduler, ignored until initialized
+ */
+void periodic_wake(periodic_t *p);
+
+/**
+ * @brief Snapshot the counters
+ * @param p Scheduler
+ * @param stats Output
+ */
+void periodic_get_stats(const periodic_t *p, periodic_stats_t *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // PERIODIC_H
@@ -0,0 +1,155 @@
+/**
+ * @file rate_ctl.c
+ * @brief Event-driven sampling rate controller
+ */
+
+#include "rate_ctl.h"
+#include <math.h>
+#include <string.h>
+
+#define NO_OVERRIDE -1
+
+static const char *const mode_names[RATE_MODE_COUNT] = {"slow", "normal",
+                                                        "burst"};
+
+void rate_ctl_get_default_config(rate_ctl_config_t *config) {
+  config->interval_ms[RATE_MODE_SLOW] = 30000;
+  config->interval_ms[RATE_MODE_NORMAL] = 10000;
+  config->interval_ms[RATE_MODE_BURST] = 1000;
+  config->burst_slope = 5.0f;
+  config->settled_slope = 1.0f;
+  config->burst_hold_ms = 120000;
+  config->slow_after_ms = 600000;
+}
+
+esp_err_t rate_ctl_init(rate_ctl_t *ctl, const rate_ctl_config_t *config,
+                        uint32_t now_ms) {
+  if (ctl == NULL) {
+    return ESP_ERR_INVALID_ARG;
+  }
+
+  memset(ctl, 0, sizeof(*ctl));
+  if (config != NULL) {
+    ctl->config = *config;
+  } else {
+    rate_ctl_get_default_config(&ctl->config);
+  }
+  for (int i = 0; i < RATE_MODE_COUNT; i++) {
+    if (ctl->config.interval_ms[i] == 0) {
+      return ESP_ERR_INVALID_ARG;
+    }
+  }
+
+  ctl->mode = RATE_MODE_NORMAL;
+  ctl->automatic = RATE_MODE_NORMAL;
+  ctl->override = NO_OVERRIDE;
+  ctl->last_ms = now_ms;
+  ctl->calm_since_ms = now_ms;
+  return ESP_OK;
+}
+
+static rate_mode_t choose_mode(rate_ctl_t *ctl, const rate_ctl_input_t *in,
+                               uint32_t now_ms) {
+  const rate_ctl_config_t *cfg = &ctl->config;
+  float slope = fabsf(in->slope);
+
+  // Levels and trends mean nothing until the baseline is calibrated
+  if (!in->calibrated) {
+    ctl->clean = false;
+    return RATE_MODE_NORMAL;
+  }
+
+  bool event = in->alert || in->level >= IAQ_LEVEL_MODERATELY_POLLUTED ||
+               slope >= cfg->burst_slope;
+  if (event) {
+    ctl->calm_since_ms = now_ms;
+    ctl->clean = false;
+    return RATE_MODE_BURST;
+  }
+  // A burst outlasts its trigger, so an event that pauses for a reading or
+  // two is still followed closely
+  if (ctl->automatic == RATE_MODE_BURST &&
+      now_ms - ctl->calm_since_ms < cfg->burst_hold_ms) {
+    return RATE_MODE_BURST;
+  }
+
+  bool clean = in->level <= IAQ_LEVEL_GOOD && slope <= cfg->settled_slope;
+  if (!clean) {
+    ctl->clean = false;
+    return RATE_MODE_NORMAL;
+  }
+  if (!ctl->clean) {
+    ctl->clean = true;
+    ctl->clean_since_ms = now_ms;
+  }
+  return now_ms - ctl->clean_since_ms >= cfg->slow_after_ms ? RATE_MODE_SLOW
+                                                            : RATE_MODE_NORMAL;
+}
+
+rate_mode_t rate_ctl_update(rate_ctl_t *ctl, const rate_ctl_input_t *input,
+                            uint32_t now_ms) {
+  ctl->time_ms[ctl->mode] += now_ms - ctl->last_ms;
+  ctl->last_ms = now_ms;
+
+  // The controller keeps tracking the air under an override, so handing
+  // control back resumes from the current conditions
+  __atomic_store_n(&ctl->automatic, choose_mode(ctl, input, now_ms),
+                   __ATOMIC_RELAXED);
+
+  int override = __atomic_load_n(&ctl->override, __ATOMIC_RELAXED);
+  rate_mode_t mode =
+      override == NO_OVERRIDE ? ctl->automatic : (rate_mode_t)override;
+  if (mode != ctl->mode) {
+    ctl->mode = mode;
+    ctl->switches++;
+  }
+  return mode;
+}
+
+esp_err_t rate_ctl_set_override(rate_ctl_t *ctl, rate_mode_t mode) {
+  if (ctl == NULL || (int)mode < 0 || mode > RATE_MODE_COUNT) {
+    return ESP_ERR_INVALID_ARG;
+  }
+  int value = mode == RATE_MODE_COUNT ? NO_OVERRIDE : (int)mode;
+  __atomic_store_n(&ctl->override, value, __ATOMIC_RELAXED);
+  return ESP_OK;
+}
+
+uint32_t rate_ctl_get_interval_ms(const rate_ctl_t *ctl) {
+  int override = __atomic_load_n(&ctl->override, __ATOMIC_RELAXED);
+  rate_mode_t mode = override == NO_OVERRIDE
+                         ? __atomic_load_n(&ctl->automatic, __ATOMIC_RELAXED)
+                         : (rate_mode_t)override;
+  return ctl->config.interval_ms[mode];
+}
+
+void rate_ctl_get_stats(const rate_ctl_t *ctl, rate_ctl_stats_t *stats) {
+  stats->mode = ctl->mode;
+  stats->interval_ms = ctl->config.interval_ms[ctl->mode];
+  stats->override =
+      __atomic_load_n(&ctl->override, __ATOMIC_RELAXED) != NO_OVERRIDE;
+  stats->switches = ctl->switches;
+  for (int i = 0; i < RATE_MODE_COUNT; i++) {
+    stats->time_in_mode_s[i] = (uint32_t)(ctl->time_ms[i] / 1000);
+  }
+}
+
+const char *rate_ctl_mode_to_string(rate_mode_t mode) {
+  return ((int)mode >= 0 && mode < RATE_MODE_COUNT) ? mode_names[mode]
+                                                    : "unknown";
+}
+
+esp_err_t rate_ctl_parse_mode(const char *text, size_t length,
+                              rate_mode_t *mode) {
+  if (text == NULL || mode == NULL) {
+    return ESP_ERR_INVALID_ARG;
+  }
+  for (int i = 0; i <= RATE_MODE_COUNT; i++) {
+    const char *name = i < RATE_MODE_COUNT ? mode_names[i] : "auto";
+    if (strlen(name) == length && memcmp(text, name, length) == 0) {
+      *mode = (rate_mode_t)i;
+      return ESP_OK;
+    }
+  }
+  return ESP_ERR_NOT_FOUND;
+}
@@ -0,0 +1,158 @@
+/**
+ * @file rate_ctl.h
+ * @brief Event-driven sampling rate controller
+ *
+ * Picks the read cadence from what the air is doing: slow in settled clean
+ * air, burst during a pollution event, normal otherwise. Calibration runs
+ * at the normal cadence. Hysteresis comes from separate thresholds for
+ * entering and leaving a mode and from hold times, so a reading near a
+ * threshold does not flip the cadence back and forth. A remote override
+ * pins the mode until it is cleared.
+ */
+
+#ifndef RATE_CTL_H
+#define RATE_CTL_H
+
+#include "esp_err.h"
+#include "iaq_calculator.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Sampling cadence
+ */
+typedef enum {
+  RATE_MODE_SLOW = 0,
+  RATE_MODE_NORMAL,
+  RATE_MODE_BURST,
+  RATE_MODE_COUNT
+} rate_mode_t;
+
+/**
+ * @brief Controller tuning
+ */
+typedef struct {
+  uint32_t interval_ms[RATE_MODE_COUNT];
+  float burst_slope;      /**< |IAQ/min| that starts a burst */
+  float settled_slope;    /**< |IAQ/min| still counted as settled air */
+  uint32_t burst_hold_ms; /**< Quiet time before a burst ends */
+  uint32_t slow_after_ms; /**< Settled clean time before slowing down */
+} rate_ctl_config_t;
+
+/**
+ * @brief What the controller decides on, per reading
+ */
+typedef struct {
+  bool calibrated;
+  iaq_level_t level;
+  float slope; /**< IAQ points per minute, 0 without a confident trend */
+  bool alert;  /**< A crossing into pollution is forecast */
+} rate_ctl_input_t;
+
+/**
+ * @brief Controller state and time accounting
+ */
+typedef struct {
+  rate_mode_t mode;
+  uint32_t interval_ms;
+  bool override; /**< Mode set remotely rather than by the controller */
+  uint32_t switches;
+  uint32_t time_in_mode_s[RATE_MODE_COUNT];
+} rate_ctl_stats_t;
+
+/**
+ * @brief Controller state, private to rate_ctl.c
+ *
+ * Updates and stats belong to one task; the override may be set and the
+ * interval read from any.
+ */
+typedef struct {
+  rate_ctl_config_t config;
+  rate_mode_t mode;      /**< Effective mode */
+  rate_mode_t automatic; /**< Mode the controller itself chose */
+  int override;          /**< rate_mode_t, or -1 for none */
+  uint32_t last_ms;
+  uint32_t calm_since_ms;
+  uint32_t clean_since_ms;
+  bool clean;
+  uint32_t switches;
+  uint64_t time_ms[RATE_MODE_COUNT];
+} rate_ctl_t;
+
+/**
+ * @brief Get the default tuning: 30 s, 10 s and 1 s reads
+ * @param config Output
+ */
+void rate_ctl_get_default_config(rate_ctl_config_t *config);
+
+/**
+ * @brief Start in normal mode
+ * @param ctl Controller
+ * @param config Tuning, NULL for the default
+ * @param now_ms Current time
+ * @return ESP_OK, or ESP_ERR_INVALID_ARG for a zero interval
+ */
+esp_err_t rate_ctl_init(rate_ctl_t *ctl, const rate_ctl_config_t *config,
+                        uint32_t now_ms);
+
+/**
+ * @brief Decide the cadence after a reading
+ * @param ctl Controller
+ * @param input Reading summary
+ * @param now_ms Current time
+ * @return Mode in effect, override included
+ */
+rate_mode_t rate_ctl_update(rate_ctl_t *ctl, const rate_ctl_input_t *input,
+                            uint32_t now_ms);
+
+/**
+ * @brief Pin the mode
+ *
+ * rate_ctl_get_interval_ms() follows at once; the mode in the stats and
+ * the time accounting change at the next update.
+ *
+ * @param ctl Controller
+ * @param mode Mode to hold, or RATE_MODE_COUNT to hand control back
+ * @return ESP_OK, or ESP_ERR_INVALID_ARG for an unknown mode
+ */
+esp_err_t rate_ctl_set_override(rate_ctl_t *ctl, rate_mode_t mode);
+
+/**
+ * @brief Interval of the mode in effect, override included; safe from any
+ *        task
+ * @param ctl Controller
+ * @return Milliseconds between reads
+ */
+uint32_t rate_ctl_get_interval_ms(const rate_ctl_t *ctl);
+
+/**
+ * @brief Snapshot the state, with time accounted up to the last update
+ * @param ctl Controller
+ * @param stats Output
+ */
+void rate_ctl_get_stats(const rate_ctl_t *ctl, rate_ctl_stats_t *stats);
+
+/**
+ * @brief Name of a mode: "slow", "normal" or "burst"
+ */
+const char *rate_ctl_mode_to_string(rate_mode_t mode);
+
+/**
+ * @brief Parse a mode name, or "auto" for RATE_MODE_COUNT
+ * @param text Name, not necessarily terminated
+ * @param length Characters in text
+ * @param mode Output
+ * @return ESP_OK, or ESP_ERR_NOT_FOUND for an unknown name
+ */
+esp_err_t rate_ctl_parse_mode(const char *text, size_t length,
+                              rate_mode_t *mode);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // RATE_CTL_H
@@ -0,0 +1,145 @@
+/**
+ * @file sink_registry.c
+ * @brief Fan-out of records to independently paced consumers
+ */
+
+#include "sink_registry.h"
+#include "esp_timer.h"
+#include <string.h>
+
+static void sink_task(void *arg) {
+  sink_t *sink = arg;
+
+  while (1) {
+    ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+    while (spsc_ring_pop(&sink->queue, sink->work)) {
+      if (sink->room != NULL) {
+        xSemaphoreGive(sink->room);
+      }
+      int64_t start = esp_timer_get_time();
+      sink->config.handler(sink->work, sink->config.arg);
+      uint32_t us = (uint32_t)(esp_timer_get_time() - start);
+
+      sink->handler_total_us += us;
+      if (us > sink->max_handler_us) {
+        __atomic_store_n(&sink->max_handler_us, us, __ATOMIC_RELAXED);
+      }
+      __atomic_store_n(&sink->delivered, sink->delivered + 1,
+                       __ATOMIC_RELAXED);
+    }
+  }
+}
+
+esp_err_t sink_registry_init(sink_registry_t *registry, size_t record_size) {
+  if (registry == NULL || record_size == 0) {
+    return ESP_ERR_INVALID_ARG;
+  }
+  memset(registry, 0, sizeof(*registry));
+  registry->record_size = record_size;
+  return ESP_OK;
+}
+
+esp_err_t sink_register(sink_registry_t *registry, sink_t *sink,
+                        const sink_config_t *config) {
+  if (registry == NULL || sink == NULL || config == NULL ||
+      config->handler == NULL || config->stack == NULL ||
+      config->policy > SINK_BLOCK) {
+    return ESP_ERR_INVALID_ARG;
+  }
+  if (registry->count == SINK_REGISTRY_MAX_SINKS) {
+    return ESP_ERR_NO_MEM;
+  }
+
+  memset(sink, 0, sizeof(*sink));
+  sink->config = *config;
+  spsc_ring_policy_t overflow = config->policy == SINK_DROP_OLDEST
+                                    ? SPSC_RING_DROP_OLDEST
+                                    : SPSC_RING_DROP_NEWEST;
+  esp_err_t err = spsc_ring_init(&sink->queue, config->storage,
+                                 registry->record_size, config->capacity,
+                                 overflow);
+  if (err != ESP_OK) {
+    return err;
+  }
+  sink->work = (uint8_t *)config->storage +
+               (size_t)config->capacity * registry->record_size;
+  if (config->policy == SINK_BLOCK) {
+    sink->room = xSemaphoreCreateBinaryStatic(&sink->room_buffer);
+  }
+
+  sink->task = xTaskCreateStatic(sink_task, config->name, config->stack_size,
+                                 sink, config->priority, config->stack,
+                                 &sink->task_buffer);
+  if (sink->task == NULL) {
+    return ESP_ERR_NO_MEM;
+  }
+  registry->sinks[registry->count++] = sink;
+  return ESP_OK;
+}
+
+/**
+ * @brief Wait up to block_ms for a SINK_BLOCK queue to have room
+ *
+ * The sink task gives room after every pop, so the wait ends as soon as a
+ * slot frees. A give left from a pop before the queue filled only costs
+ * one more look at the depth.
+ */
+static void wait_for_room(sink_t *sink) {
+  TickType_t limit = pdMS_TO_TICKS(sink->config.block_ms);
+  TickType_t start = xTaskGetTickCount();
+  TickType_t waited = 0;
+  spsc_ring_stats_t queue;
+  spsc_ring_get_stats(&sink->queue, &queue);
+  while (queue.depth == queue.capacity && waited < limit) {
+    xSemaphoreTake(sink->room, limit - waited);
+    waited = xTaskGetTickCount() - start;
+    spsc_ring_get_stats(&sink->queue, &queue);
+  }
+  if (waited > 0) {
+    __atomic_store_n(&sink->blocked_ticks, sink->blocked_ticks + waited,
+                     __ATOMIC_RELAXED);
+  }
+}
+
+esp_err_t sink_registry_publish(sink_registry_t *registry,
+                                const void *record) {
+  esp_err_t result = ESP_OK;
+
+  for (size_t i = 0; i < registry->count; i++) {
+    sink_t *sink = registry->sinks[i];
+    if (sink->config.policy == SINK_BLOCK) {
+      wait_for_room(sink);
+    }
+
+    uint32_t dropped = sink->queue.dropped;
+    if (spsc_ring_push(&sink->queue, record) == ESP_OK) {
+      xTaskNotifyGive(sink->task);
+    }
+    if (sink->queue.dropped != dropped) {
+      result = ESP_ERR_NO_MEM;
+    }
+  }
+  return result;
+}
+
+void sink_get_stats(const sink_t *sink, sink_stats_t *stats) {
+  spsc_ring_stats_t queue;
+  spsc_ring_get_stats(&sink->queue, &queue);
+
+  memset(stats, 0, sizeof(*stats));
+  stats->name = sink->config.name;
+  stats->delivered = __atomic_load_n(&sink->delivered, __ATOMIC_RELAXED);
+  stats->dropped = queue.dropped;
+  stats->depth = queue.depth;
+  stats->high_water = queue.high_water;
+  stats->capacity = queue.capacity;
+  stats->blocked_ms =
+      __atomic_load_n(&sink->blocked_ticks, __ATOMIC_RELAXED) *
+      portTICK_PERIOD_MS;
+  stats->max_handler_us =
+      __atomic_load_n(&sink->max_handler_us, __ATOMIC_RELAXED);
+  if (stats->delivered > 0) {
+    stats->mean_handler_us =
+        (uint32_t)(sink->handler_total_us / stats->delivered);
+  }
+}
@@ -0,0 +1,151 @@
+/**
+ * @file sink_registry.h
+ * @brief Fan-out of records to independently paced consumers
+ *
+ * Each registered sink owns a bounded queue and a task that runs its
+ * handler, so a slow sink only ever fills its own queue. What happens when
+ * that queue is full is the sink's choice of policy. Publishing never
+ * waits except for SINK_BLOCK sinks, and then at most their block_ms.
+ *
+ * All storage, queues and stacks, is provided by the caller. Sinks are
+ * registered before the first publish, and one task publishes.
+ */
+
+#ifndef SINK_REGISTRY_H
+#define SINK_REGISTRY_H
+
+#include "esp_err.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+#include "spsc_ring.h"
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define SINK_REGISTRY_MAX_SINKS 6
+
+/**
+ * @brief Bytes of queue storage for a sink: capacity records plus the one
+ *        its handler works on
+ */
+#define SINK_STORAGE_SIZE(record_size, capacity)                               \
+  ((size_t)(record_size) * ((capacity) + 1))
+
+/**
+ * @brief What publishing to a full sink queue does
+ */
+typedef enum {
+  SINK_DROP_OLDEST = 0, /**< Replace the oldest queued record */
+  SINK_DROP_NEWEST,     /**< Discard the published record */
+  SINK_BLOCK,           /**< Wait up to block_ms for room, then discard */
+} sink_policy_t;
+
+/**
+ * @brief Consume one record, on the sink's own task
+ * @param record record_size bytes, valid until the handler returns
+ * @param arg Registration argument
+ */
+typedef void (*sink_handler_t)(const void *record, void *arg);
+
+/**
+ * @brief Sink registration
+ */
+typedef struct {
+  const char *name;
+  sink_handler_t handler;
+  void *arg;
+  sink_policy_t policy;
+  uint32_t block_ms; /**< SINK_BLOCK only */
+  void *storage;     /**< SINK_STORAGE_SIZE(record_size, capacity) bytes */
+  uint32_t capacity; /**< Queued records, a power of two */
+  StackType_t *stack;
+  uint32_t stack_size;
+  UBaseType_t priority;
+} sink_config_t;
+
+/**
+ * @brief Sink counters
+ */
+typedef struct {
+  const char *name;
+  uint32_t delivered;  /**< Records handled */
+  uint32_t dropped;    /**< Records lost to the policy */
+  uint32_t depth;      /**< Records queued now */
+  uint32_t high_water; /**< Deepest the queue has been */
+  uint32_t capacity;
+  uint32_t blocked_ms; /**< Time publishing spent waiting for room */
+  uint32_t mean_handler_us;
+  uint32_t max_handler_us;
+} sink_stats_t;
+
+/**
+ * @brief Sink state, private to sink_registry.c
+ */
+typedef struct {
+  sink_config_t config;
+  spsc_ring_t queue;
+  uint8_t *work; /**< The handler's copy of the record */
+  TaskHandle_t task;
+  StaticTask_t task_buffer;
+  SemaphoreHandle_t room; /**< Given after each pop, SINK_BLOCK only */
+  StaticSemaphore_t room_buffer;
+  uint32_t delivered;
+  uint32_t blocked_ticks;
+  uint32_t max_handler_us;
+  uint64_t handler_total_us;
+} sink_t;
+
+/**
+ * @brief Registry of sinks for one record type
+ */
+typedef struct {
+  size_t record_size;
+  sink_t *sinks[SINK_REGISTRY_MAX_SINKS];
+  size_t count;
+} sink_registry_t;
+
+/**
+ * @brief Start an empty registry
+ * @param registry Registry
+ * @param record_size Bytes per record
+ * @return ESP_OK, or ESP_ERR_INVALID_ARG
+ */
+esp_err_t sink_registry_init(sink_registry_t *registry, size_t record_size);
+
+/**
+ * @brief Add a sink and start its task
+ * @param registry Registry
+ * @param sink Sink state, which must outlive the registry
+ * @param config Registration
+ * @return ESP_OK, ESP_ERR_INVALID_ARG for a bad config, ESP_ERR_NO_MEM if
+ *         the registry is full or the task could not be created
+ */
+esp_err_t sink_register(sink_registry_t *registry, sink_t *sink,
+                        const sink_config_t *config);
+
+/**
+ * @brief Queue a copy of a record for every sink
+ * @param registry Registry
+ * @param record record_size bytes
+ * @return ESP_OK if every sink took the record, ESP_ERR_NO_MEM if some
+ *         sink dropped it or an older one
+ */
+esp_err_t sink_registry_publish(sink_registry_t *registry,
+                                const void *record);
+
+/**
+ * @brief Snapshot a sink's counters; any task
+ * @param sink Sink
+ * @param stats Output
+ */
+void sink_get_stats(const sink_t *sink, sink_stats_t *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // SINK_REGISTRY_H
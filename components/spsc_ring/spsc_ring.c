@@ -0,0 +1,85 @@
+/**
+ * @file spsc_ring.c
+ * @brief Lock-free single-producer/single-consumer ring implementation
+ */
+
+#include "spsc_ring.h"
+#include <string.h>
+
+static inline uint8_t *slot(const spsc_ring_t *ring, uint32_t index) {
+  return ring->buffer + (size_t)(index & (ring->capacity - 1)) *
+                            ring->record_size;
+}
+
+esp_err_t spsc_ring_init(spsc_ring_t *ring, void *buffer, size_t record_size,
+                         uint32_t capacity, spsc_ring_policy_t policy) {
+  if (ring == NULL || buffer == NULL || record_size == 0 || capacity == 0 ||
+      (capacity & (capacity - 1)) != 0) {
+    return ESP_ERR_INVALID_ARG;
+  }
+
+  memset(ring, 0, sizeof(*ring));
+  ring->buffer = buffer;
+  ring->record_size = record_size;
+  ring->capacity = capacity;
+  ring->policy = policy;
+  return ESP_OK;
+}
+
+esp_err_t spsc_ring_push(spsc_ring_t *ring, const void *record) {
+  uint32_t head = ring->head;
+  uint32_t tail = __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE);
+
+  if (head - tail >= ring->capacity) {
+    if (ring->policy == SPSC_RING_DROP_NEWEST) {
+      __atomic_store_n(&ring->dropped, ring->dropped + 1, __ATOMIC_RELAXED);
+      return ESP_ERR_NO_MEM;
+    }
+    // Failing means the consumer just took that record, which frees the
+    // slot all the same
+    if (__atomic_compare_exchange_n(&ring->tail, &tail, tail + 1, false,
+                                    __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+      __atomic_store_n(&ring->dropped, ring->dropped + 1, __ATOMIC_RELAXED);
+    }
+  }
+
+  memcpy(slot(ring, head), record, ring->record_size);
+  __atomic_store_n(&ring->head, head + 1, __ATOMIC_RELEASE);
+
+  __atomic_store_n(&ring->pushed, ring->pushed + 1, __ATOMIC_RELAXED);
+  uint32_t depth = head + 1 - __atomic_load_n(&ring->tail, __ATOMIC_RELAXED);
+  if (depth > ring->high_water) {
+    __atomic_store_n(&ring->high_water, depth, __ATOMIC_RELAXED);
+  }
+  return ESP_OK;
+}
+
+bool spsc_ring_pop(spsc_ring_t *ring, void *record) {
+  uint32_t tail = __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE);
+
+  for (;;) {
+    uint32_t head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+    if (tail == head) {
+      return false;
+    }
+    memcpy(record, slot(ring, tail), ring->record_size);
+    // Claim the record only after copying it; on failure tail is reloaded
+    // and the possibly torn copy is replaced by the next record
+    if (__atomic_compare_exchange_n(&ring->tail, &tail, tail + 1, false,
+                                    __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+      return true;
+    }
+  }
+}
+
+void spsc_ring_get_stats(const spsc_ring_t *ring, spsc_ring_stats_t *stats) {
+  uint32_t tail = __atomic_load_n(&ring->tail, __ATOMIC_RELAXED);
+  uint32_t head = __atomic_load_n(&ring->head, __ATOMIC_RELAXED);
+
+  stats->pushed = __atomic_load_n(&ring->pushed, __ATOMIC_RELAXED);
+  stats->dropped = __atomic_load_n(&ring->dropped, __ATOMIC_RELAXED);
+  stats->high_water = __atomic_load_n(&ring->high_water, __ATOMIC_RELAXED);
+  stats->capacity = ring->capacity;
+  // Both sides may move between the loads; clamp the transient
+  stats->depth = (head - tail <= ring->capacity) ? head - tail : 0;
+}
@@ -0,0 +1,108 @@
+/**
+ * @file spsc_ring.h
+ * @brief Lock-free single-producer/single-consumer ring of fixed-size records
+ *
+ * One task pushes and one task pops, neither ever blocks or takes a lock,
+ * so the ring can connect tasks of any priority. Storage is provided by the
+ * caller and records are copied in and out, so the ring needs no heap and
+ * a record never aliases storage the other side may reuse.
+ *
+ * When the ring is full the overflow policy decides which record is lost.
+ * Waking the consumer is left to the caller, e.g. with a task notification
+ * after each push.
+ */
+
+#ifndef SPSC_RING_H
+#define SPSC_RING_H
+
+#include "esp_err.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief What a push into a full ring does
+ */
+typedef enum {
+  SPSC_RING_DROP_NEWEST = 0, /**< Reject the pushed record */
+  SPSC_RING_DROP_OLDEST,     /**< Discard the oldest queued record */
+} spsc_ring_policy_t;
+
+/**
+ * @brief Ring counters, all maintained by the producer
+ */
+typedef struct {
+  uint32_t pushed;     /**< Records queued */
+  uint32_t dropped;    /**< Records lost to the overflow policy */
+  uint32_t depth;      /**< Records currently queued */
+  uint32_t high_water; /**< Deepest the queue has been */
+  uint32_t capacity;
+} spsc_ring_stats_t;
+
+/**
+ * @brief Ring state, private to spsc_ring.c
+ *
+ * head and tail count records ever pushed and popped; their difference is
+ * the depth and their value modulo capacity the slot. Under
+ * SPSC_RING_DROP_OLDEST the producer advances tail too, with the same
+ * compare-and-swap the consumer uses to claim a record. A consumer that
+ * loses that race was copying a slot the producer may be overwriting, and
+ * retries with the next record.
+ */
+typedef struct {
+  uint8_t *buffer;
+  size_t record_size;
+  uint32_t capacity; /**< Records, a power of two */
+  spsc_ring_policy_t policy;
+  uint32_t head;
+  uint32_t tail;
+  uint32_t pushed;
+  uint32_t dropped;
+  uint32_t high_water;
+} spsc_ring_t;
+
+/**
+ * @brief Initialize an empty ring
+ * @param ring Ring to initialize
+ * @param buffer Storage for capacity records of record_size bytes
+ * @param record_size Bytes per record
+ * @param capacity Records, a power of two
+ * @param policy Overflow policy
+ * @return ESP_OK, or ESP_ERR_INVALID_ARG for a bad buffer or capacity
+ */
+esp_err_t spsc_ring_init(spsc_ring_t *ring, void *buffer, size_t record_size,
+                         uint32_t capacity, spsc_ring_policy_t policy);
+
+/**
+ * @brief Queue a copy of a record; producer only
+ * @param ring Ring
+ * @param record record_size bytes
+ * @return ESP_OK if the record was queued, ESP_ERR_NO_MEM if the ring was
+ *         full and the policy is SPSC_RING_DROP_NEWEST
+ */
+esp_err_t spsc_ring_push(spsc_ring_t *ring, const void *record);
+
+/**
+ * @brief Take the oldest queued record; consumer only
+ * @param ring Ring
+ * @param record Output, record_size bytes
+ * @return true if a record was taken, false if the ring was empty
+ */
+bool spsc_ring_pop(spsc_ring_t *ring, void *record);
+
+/**
+ * @brief Snapshot the counters; any task
+ * @param ring Ring
+ * @param stats Output
+ */
+void spsc_ring_get_stats(const spsc_ring_t *ring, spsc_ring_stats_t *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // SPSC_RING_H
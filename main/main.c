@@ -5,215 +5,887 @@
 
 #include "bme680_app.h"
 #include "buzzer.h"
+#include "deferred_log.h"
+#include "fixed_fmt.h"
+#include "gas_classifier.h"
+#include "heap_audit.h"
 #include "i2c_config.h"
 #include "iaq_calculator.h"
+#include "iaq_eval.h"
+#include "iaq_persist.h"
 #include "mqtt_client_app.h"
+#include "periodic.h"
+#include "rate_ctl.h"
+#include "sink_registry.h"
+#include "spsc_ring.h"
 
+#include "esp_cpu.h"
 #include "esp_log.h"
+#include "esp_mac.h"
 #include "esp_system.h"
+#include "esp_timer.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include "nvs_flash.h"
 #include <inttypes.h>
 #include <stdio.h>
+#include <string.h>
 
 #define TAG "MAIN"
 #define SENSOR_READ_INTERVAL_MS 10000
+// Cadence during pollution events
+#define SENSOR_FAST_INTERVAL_MS 1000
+// Cadence once the air has been clean and settled for a while
+#define SENSOR_SLOW_INTERVAL_MS 30000
+// Reads between schedule reports, 1 h at the normal interval
+#define SCHEDULE_REPORT_INTERVAL 360
+#define IAQ_FORECAST_HORIZON_S 300
+#define IAQ_FORECAST_MIN_CONFIDENCE 0.5f
 #define IAQ_SAVE_INTERVAL 20
+// Samples between calibration records, 1 h at the normal interval
+#define IAQ_CALIB_PUBLISH_INTERVAL 360
+// Readings between engine comparison reports, 1 h at the normal interval
+#define IAQ_EVAL_REPORT_INTERVAL 360
+// Readings queued for the compute stage, and for each sink
+#define SAMPLE_RING_LEN 8
+#define LOG_SINK_LEN 8
+#define MQTT_SINK_LEN 4
+#define ALERT_SINK_LEN 2
+#define MQTT_ALERT_SINK_LEN 2
+// Longest the compute stage waits for room in the log sink
+#define LOG_SINK_BLOCK_MS 50
+// Results between pipeline reports, 1 h at the normal interval
+#define PIPELINE_REPORT_INTERVAL 360
 #define MQTT_ENABLED 1
 
+/* Model from the gas_model partition, used in place from flash */
+static gas_classifier_t gas_classifier;
+
+/* Updated by the compute stage, overridden from MQTT */
+static rate_ctl_t rate_ctl;
+
+/* Read cadence, chosen by compute and followed by acquisition; a remote
+ * override sets it directly and wakes acquisition to apply it at once */
+static uint32_t read_interval_ms = SENSOR_READ_INTERVAL_MS;
+static periodic_t read_schedule;
+
+#if CONFIG_IAQ_ENGINE_EVAL
+/* Engines compared on the live readings, the calculator's twin first */
+static iaq_ctx_t eval_piecewise;
+static iaq_engine_percentile_state_t eval_percentile;
+static iaq_engine_learned_state_t eval_learned;
+static iaq_eval_t iaq_eval;
+
+static esp_err_t engine_eval_start(void)
+{
+  static const iaq_engine_t *const engines[] = {
+      &iaq_engine_piecewise, &iaq_engine_percentile, &iaq_engine_learned};
+  void *const states[] = {&eval_piecewise, &eval_percentile, &eval_learned};
+  return iaq_eval_init(&iaq_eval, engines, states,
+                       sizeof(engines) / sizeof(engines[0]));
+}
+
+static void engine_eval_report(void)
+{
+  for (size_t i = 0; i < iaq_eval.count; i++)
+  {
+    iaq_eval_stats_t st;
+    iaq_eval_get(&iaq_eval, i, &st);
+    fixed_fmt_t score = fixed_split(st.mean_score, 1);
+    fixed_fmt_t diff = fixed_split(st.mean_abs_diff, 1);
+    fixed_fmt_t corr = fixed_split(st.correlation, 2);
+    ESP_LOGI(TAG,
+             "Engine %-10s: %6" PRIu32 " cycles (max %" PRIu32 "), %u B, "
+             "IAQ " FIXED_FMT ", |diff| " FIXED_FMT ", level %" PRIu32
+             "%%, corr " FIXED_FMT,
+             st.name, (uint32_t)(st.cycles + 0.5f), st.max_cycles,
+             (unsigned)st.state_bytes, FIXED_ARGS(score), FIXED_ARGS(diff),
+             (uint32_t)(st.level_agreement * 100.0f + 0.5f), FIXED_ARGS(corr));
+  }
+}
+#endif
+
+#if MQTT_ENABLED
+/* This device in calibration records, set before subscribing */
+static uint8_t sensor_id[IAQ_CALIB_SENSOR_ID_LEN];
+
+/**
+ * @brief Identify this device in calibration records by its MAC address
+ */
+static void get_sensor_id(uint8_t id[IAQ_CALIB_SENSOR_ID_LEN])
+{
+  memset(id, 0, IAQ_CALIB_SENSOR_ID_LEN);
+  esp_efuse_mac_get_default(id);
+}
+
+/**
+ * @brief Seed a replacement device from the room's retained calibration
+ */
+static void on_calibration_received(const void *data, size_t length)
+{
+  esp_err_t err = iaq_import_calibration(sensor_id, data, length);
+  if (err == ESP_OK)
+  {
+    ESP_LOGI(TAG, "Calibration imported - burn-in shortened");
+  }
+  else if (err == ESP_ERR_INVALID_STATE)
+  {
+    /* Our own record coming back, or nothing to gain from it */
+    ESP_LOGD(TAG, "Calibration record ignored");
+  }
+  else
+  {
+    ESP_LOGW(TAG, "Calibration record rejected: %s", esp_err_to_name(err));
+  }
+}
+
+/**
+ * @brief Pin the sampling mode remotely, or hand it back with "auto"
+ */
+static void on_rate_command(const char *data, size_t length)
+{
+  rate_mode_t mode;
+  if (rate_ctl_parse_mode(data, length, &mode) == ESP_OK)
+  {
+    rate_ctl_set_override(&rate_ctl, mode);
+    uint32_t interval_ms = rate_ctl_get_interval_ms(&rate_ctl);
+    __atomic_store_n(&read_interval_ms, interval_ms, __ATOMIC_RELAXED);
+    periodic_wake(&read_schedule);
+    ESP_LOGI(TAG, "Sampling override: %.*s, every %" PRIu32 " ms",
+             (int)length, data, interval_ms);
+  }
+  else
+  {
+    ESP_LOGW(TAG, "Unknown sampling command: %.*s", (int)length, data);
+  }
+}
+#endif
+
+/**
+ * @brief One sensor reading, from acquisition to compute
+ */
+typedef struct
+{
+  uint32_t seq;
+  int64_t read_start_us; /* Sensor read started */
+  int64_t read_done_us;  /* Sensor read completed */
+  iaq_raw_data_t iaq_input;
+} sample_record_t;
+
+/**
+ * @brief One processed reading, from compute to the sinks
+ */
+typedef struct
+{
+  uint32_t seq;
+  int64_t read_start_us;
+  int64_t read_done_us;
+  int64_t computed_us; /* Compute stage finished */
+  iaq_raw_data_t iaq_input;
+  esp_err_t iaq_ret;
+  iaq_result_t iaq_result;
+  iaq_trend_t trend;
+  bool crossing_soon;
+  uint8_t calibration_progress;
+  rate_ctl_stats_t rate;
+} result_record_t;
+
+/**
+ * @brief Latency of one pipeline stage, in microseconds
+ */
+typedef struct
+{
+  uint32_t count;
+  uint32_t last_us;
+  uint32_t max_us;
+  uint64_t total_us;
+} stage_stats_t;
+
+typedef enum
+{
+  STAGE_ACQUIRE = 0, /* Blocking sensor read */
+  STAGE_COMPUTE,     /* Queued for and running IAQ */
+  STAGE_LOG,         /* Queued for and running the log sink */
+  STAGE_TOTAL,       /* Start of the read to the reading being logged */
+  STAGE_COUNT
+} stage_t;
+
+/* A full sample ring rejects the new reading so IAQ sees an unbroken, if
+ * delayed, history */
+static sample_record_t sample_slots[SAMPLE_RING_LEN];
+static spsc_ring_t sample_ring;
+static TaskHandle_t compute_task_handle;
+static StaticTask_t compute_task_buffer;
+static StackType_t compute_task_stack[6144];
+static StaticTask_t acquisition_task_buffer;
+static StackType_t acquisition_task_stack[4096];
+
+/* Every processed reading goes to each sink through the sink's own queue.
+ * The log sink holds compute back briefly rather than lose lines; MQTT and
+ * the buzzer only care about the latest reading and drop the oldest. */
+static sink_registry_t sinks;
+static sink_t log_sink;
+static uint8_t log_sink_storage[SINK_STORAGE_SIZE(sizeof(result_record_t),
+                                                  LOG_SINK_LEN)];
+static StackType_t log_sink_stack[3072];
+static sink_t alert_sink;
+static uint8_t alert_sink_storage[SINK_STORAGE_SIZE(sizeof(result_record_t),
+                                                    ALERT_SINK_LEN)];
+static StackType_t alert_sink_stack[2048];
+#if MQTT_ENABLED
+static sink_t mqtt_sink;
+static uint8_t mqtt_sink_storage[SINK_STORAGE_SIZE(sizeof(result_record_t),
+                                                   MQTT_SINK_LEN)];
+static StackType_t mqtt_sink_stack[8192];
+#if !MQTT_USE_THINGSBOARD
+/* Alerts go at QoS 1, which allocates an outbox entry, so they have a sink
+ * of their own outside the heap audit */
+static sink_t mqtt_alert_sink;
+static uint8_t mqtt_alert_sink_storage[SINK_STORAGE_SIZE(
+    sizeof(result_record_t), MQTT_ALERT_SINK_LEN)];
+static StackType_t mqtt_alert_sink_stack[4096];
+#endif
+#endif
+
+
+/* Sensor conditioning at boot, set before the first reading is queued */
+static uint32_t conditioning_ms;
+static uint32_t conditioned_at_ms; /* Since boot */
+
+static void stage_stats_add(stage_stats_t *stats, int64_t us)
+{
+  uint32_t v = us > 0 ? (uint32_t)us : 0;
+  stats->count++;
+  stats->last_us = v;
+  stats->total_us += v;
+  if (v > stats->max_us)
+  {
+    stats->max_us = v;
+  }
+}
+
+static uint32_t stage_mean_us(const stage_stats_t *stats)
+{
+  return stats->count ? (uint32_t)(stats->total_us / stats->count) : 0;
+}
+
+static void pipeline_report(const stage_stats_t stats[STAGE_COUNT],
+                            uint64_t log_cycles)
+{
+  DLOG_I(TAG,
+         "Pipeline us : read %" PRIu32 "/%" PRIu32 ", compute %" PRIu32
+         "/%" PRIu32 ", log %" PRIu32 "/%" PRIu32 ", total %" PRIu32
+         "/%" PRIu32 " (mean/max)",
+         stage_mean_us(&stats[STAGE_ACQUIRE]), stats[STAGE_ACQUIRE].max_us,
+         stage_mean_us(&stats[STAGE_COMPUTE]), stats[STAGE_COMPUTE].max_us,
+         stage_mean_us(&stats[STAGE_LOG]), stats[STAGE_LOG].max_us,
+         stage_mean_us(&stats[STAGE_TOTAL]), stats[STAGE_TOTAL].max_us);
+
+  spsc_ring_stats_t samples;
+  spsc_ring_get_stats(&sample_ring, &samples);
+  DLOG_I(TAG,
+         "Samples     : queue %" PRIu32 "/%" PRIu32 " (max %" PRIu32
+         "), %" PRIu32 " dropped",
+         samples.depth, samples.capacity, samples.high_water,
+         samples.dropped);
+
+  for (size_t i = 0; i < sinks.count; i++)
+  {
+    sink_stats_t sink;
+    sink_get_stats(sinks.sinks[i], &sink);
+    DLOG_I(TAG,
+           "Sink %-6s : %" PRIu32 " handled, %" PRIu32 " dropped, max %" PRIu32
+           "/%" PRIu32 " queued, %" PRIu32 " ms blocked, %" PRIu32
+           "/%" PRIu32 " us",
+           sink.name, sink.delivered, sink.dropped, sink.high_water,
+           sink.capacity, sink.blocked_ms, sink.mean_handler_us,
+           sink.max_handler_us);
+  }
+
+  /* In line is what logging still costs the log sink; with
+   * CONFIG_DEFERRED_LOG off it is the full formatting and UART cost */
+  uint32_t readings = stats[STAGE_TOTAL].count;
+  dlog_stats_t dlog;
+  dlog_get_stats(&dlog);
+  DLOG_I(TAG,
+         "Logging     : %" PRIu32 " cycles/reading in line, %.0f deferred"
+         " (%" PRIu32 " records dropped)",
+         readings ? (uint32_t)(log_cycles / readings) : 0,
+         readings ? dlog.format_cycles * dlog.written / readings : 0.0f,
+         dlog.dropped);
+
+  /* Any count here is a heap operation in a steady-state cycle */
+  for (size_t i = 0; i < heap_audit_task_count(); i++)
+  {
+    heap_audit_stats_t audit;
+    heap_audit_get_stats(i, &audit);
+    DLOG_I(TAG,
+           "Heap %-12s: %" PRIu32 " cycles, %" PRIu32 " mallocs, %" PRIu32
+           " frees, %" PRIu32 " in steady state",
+           audit.name, audit.cycles, audit.allocs, audit.frees,
+           audit.steady_ops);
+  }
+}
+
 /**
- * @brief Sensor reading task with IAQ calculation
+ * @brief Acquisition stage: condition the sensor, then read it at the
+ *        cadence the compute stage asks for
  */
-static void sensor_task(void *pvParameters)
+static void acquisition_task(void *pvParameters)
 {
   (void)pvParameters;
-  ESP_LOGI(TAG, "Sensor task started - Interval: %d ms",
-           SENSOR_READ_INTERVAL_MS);
+  uint32_t interval_ms = __atomic_load_n(&read_interval_ms, __ATOMIC_RELAXED);
+  ESP_LOGI(TAG, "Sensor task started - %s mode, interval %" PRIu32 " ms",
+           rate_ctl_mode_to_string(rate_ctl.mode), interval_ms);
 
-  uint32_t save_counter = 0;
+  /* A cold sensor drifts for minutes; condition it before calibrating */
+  bme680_condition_report_t cond = {0};
+  if (bme680_app_condition(NULL, &cond) == ESP_OK)
+  {
+    ESP_LOGI(TAG, "Sensor conditioned in %.1f s (%" PRIu32 " cycles)",
+             cond.duration_ms / 1000.0f, cond.cycles);
+  }
+  else
+  {
+    ESP_LOGW(TAG, "Sensor not stable after %.1f s (drift %.1f%%)",
+             cond.duration_ms / 1000.0f, cond.drift * 100.0f);
+  }
+  conditioning_ms = cond.duration_ms;
+  conditioned_at_ms = (uint32_t)(esp_timer_get_time() / 1000);
+
+  /* Reads sit on a fixed grid; a cycle that overruns gives up the missed
+   * reads rather than bunching them, which would upset the heater cadence */
+  periodic_init(&read_schedule,
+                __atomic_load_n(&read_interval_ms, __ATOMIC_RELAXED),
+                PERIODIC_SKIP);
 
+  uint32_t seq = 0;
   while (1)
   {
     struct bme68x_data raw_data;
-    bme680_sensor_data_t sensor_data;
+    int64_t read_start = esp_timer_get_time();
 
     if (bme680_app_read(&raw_data) == ESP_OK)
     {
       bme680_app_update_data(&raw_data);
-      bme680_app_get_data(&sensor_data);
 
-      iaq_raw_data_t iaq_input = {
-          .temperature = raw_data.temperature,
-          .humidity = raw_data.humidity,
-          .pressure = raw_data.pressure,
-          .gas_resistance = (float)raw_data.gas_resistance,
-          .gas_valid =
-              (raw_data.status & BME68X_GASM_VALID_MSK) ? true : false};
+      sample_record_t sample = {
+          .seq = seq++,
+          .read_start_us = read_start,
+          .read_done_us = esp_timer_get_time(),
+          .iaq_input = {
+              .temperature = raw_data.temperature,
+              .humidity = raw_data.humidity,
+              .pressure = raw_data.pressure,
+              .gas_resistance = (float)raw_data.gas_resistance,
+              .gas_valid =
+                  (raw_data.status & BME68X_GASM_VALID_MSK) ? true : false}};
+      /* Stamp the reading with its grid instant rather than when it was
+       * computed or even read: the instants are a whole period apart, so
+       * IAQ sees the same interval every read and reuses its weights */
+      sample.iaq_input.timestamp_ms = periodic_instant_ms(&read_schedule);
 
-      iaq_result_t iaq_result;
-      esp_err_t iaq_ret = iaq_calculate(&iaq_input, &iaq_result);
-
-      ESP_LOGI(TAG, "----BME680 SENSOR DATA----");
-      ESP_LOGI(TAG, "Temperature : %8.2f °C ", raw_data.temperature);
-      ESP_LOGI(TAG, "Humidity    : %8.2f %% ", raw_data.humidity);
-      ESP_LOGI(TAG, "Pressure    : %8.2f hPa ", raw_data.pressure / 100.0f);
-
-      if (raw_data.status & BME68X_GASM_VALID_MSK)
+      if (spsc_ring_push(&sample_ring, &sample) == ESP_OK)
       {
-        ESP_LOGI(TAG, "Gas Resist. : %8.0f Ohms ",
-                 (float)raw_data.gas_resistance);
+        xTaskNotifyGive(compute_task_handle);
       }
       else
       {
-        ESP_LOGW(TAG, "Gas Resist. :  Invalid");
+        ESP_LOGW(TAG, "Compute stage behind - reading %" PRIu32 " dropped",
+                 sample.seq);
       }
+    }
+    else
+    {
+      ESP_LOGE(TAG, "Failed to read sensor data!");
+    }
 
-      ESP_LOGI(TAG, "----INDOOR AIR QUALITY (IAQ)----");
+    periodic_set_period(&read_schedule, __atomic_load_n(&read_interval_ms,
+                                                        __ATOMIC_RELAXED));
+    periodic_wait(&read_schedule);
 
-      if (iaq_ret == ESP_OK)
-      {
-        const char *level_str = iaq_level_to_string(iaq_result.iaq_level);
-        const char *acc_str = iaq_accuracy_to_string(iaq_result.accuracy);
+    periodic_stats_t sched;
+    periodic_get_stats(&read_schedule, &sched);
+    if (sched.cycles % SCHEDULE_REPORT_INTERVAL == 0)
+    {
+      ESP_LOGI(TAG,
+               "Schedule    : jitter %" PRIu32 "/%" PRIu32
+               " us (mean/max), %" PRIu32 " overruns, %" PRIu32
+               " reads skipped",
+               sched.mean_jitter_us, sched.max_jitter_us, sched.overruns,
+               sched.skipped);
+    }
+    heap_audit_cycle();
+  }
+}
 
-        if (iaq_result.iaq_score <= 50)
-        {
-          ESP_LOGI(TAG, "IAQ Score   : %8.1f  [%s]", iaq_result.iaq_score,
-                   level_str);
-        }
-        else if (iaq_result.iaq_score <= 150)
-        {
-          ESP_LOGW(TAG, "IAQ Score   : %8.1f  [%s]", iaq_result.iaq_score,
-                   level_str);
-        }
-        else
-        {
-          ESP_LOGE(TAG, "IAQ Score   : %8.1f  [%s]", iaq_result.iaq_score,
-                   level_str);
-        }
+/**
+ * @brief Run IAQ on one reading; acting on and reporting the result is
+ *        left to the sinks
+ */
+static void compute_sample(const sample_record_t *sample,
+                           result_record_t *result)
+{
+  static uint32_t save_counter;
 
-        ESP_LOGI(TAG, "CO2 Equiv.  : %8.0f ppm", iaq_result.co2_equivalent);
-        ESP_LOGI(TAG, "VOC Equiv.  : %8.2f ppm", iaq_result.voc_equivalent);
-        ESP_LOGI(TAG, "Accuracy    : %s", acc_str);
+  memset(result, 0, sizeof(*result));
+  result->seq = sample->seq;
+  result->read_start_us = sample->read_start_us;
+  result->read_done_us = sample->read_done_us;
+  result->iaq_input = sample->iaq_input;
 
-        if (!iaq_result.is_calibrated)
-        {
-          uint8_t progress = iaq_get_calibration_progress();
-          ESP_LOGW(TAG, "Calibrating : %d%% complete", progress);
-        }
+  iaq_result_t *iaq_result = &result->iaq_result;
+  result->iaq_ret = iaq_calculate(&sample->iaq_input, iaq_result);
+#if CONFIG_IAQ_ENGINE_EVAL
+  if (iaq_eval_add(&iaq_eval, &sample->iaq_input, NULL) == ESP_OK &&
+      iaq_eval.samples % IAQ_EVAL_REPORT_INTERVAL == 0)
+  {
+    engine_eval_report();
+  }
+#endif
 
-        save_counter++;
-        if (save_counter >= IAQ_SAVE_INTERVAL && iaq_result.is_calibrated)
-        {
-          iaq_save_state();
-          save_counter = 0;
-        }
-      }
-      else
-      {
-        ESP_LOGW(TAG, "IAQ         : Waiting for valid gas data...");
-      }
+  bool ok = result->iaq_ret == ESP_OK;
+  if (ok && !iaq_result->is_calibrated)
+  {
+    result->calibration_progress = iaq_get_calibration_progress();
+  }
 
-      if (iaq_ret == ESP_OK && iaq_result.is_calibrated)
-      {
-        if (iaq_result.iaq_level >= IAQ_LEVEL_MODERATELY_POLLUTED)
-        {
-          ESP_LOGE(TAG, "ALERT: %s! IAQ=%.0f - Buzzer ON",
-                   iaq_level_to_string(iaq_result.iaq_level),
-                   iaq_result.iaq_score);
-          buzzer_set_active(true);
-        }
-        else if (iaq_result.iaq_level == IAQ_LEVEL_LIGHTLY_POLLUTED)
-        {
-          ESP_LOGW(TAG, "WARNING: Lightly Polluted Air! IAQ=%.0f",
-                   iaq_result.iaq_score);
-          buzzer_set_active(false);
-        }
-        else
-        {
-          ESP_LOGI(TAG, "NORMAL: Air Quality Status: %s",
-                   iaq_level_to_string(iaq_result.iaq_level));
-          buzzer_set_active(false);
-        }
-      }
-      else
-      {
-        ESP_LOGI(TAG, "Status: Calibrating IAQ sensor...");
-        buzzer_set_active(false);
-      }
+  if (ok && ++save_counter >= IAQ_SAVE_INTERVAL && iaq_result->is_calibrated)
+  {
+    // Handed to the background writer, which skips unchanged state
+    iaq_request_save();
+    save_counter = 0;
+
+    iaq_persist_stats_t persist;
+    iaq_persist_get_stats(&persist);
+    fixed_fmt_t per_day = fixed_split(persist.writes_per_day, 1);
+    ESP_LOGI(TAG,
+             "State saves : %" PRIu32 " writes (" FIXED_FMT "/day), %" PRIu32
+             " skipped, last %" PRIu32 " us, max %" PRIu32 " us",
+             persist.writes, FIXED_ARGS(per_day), persist.skipped,
+             persist.last_commit_us, persist.max_commit_us);
+  }
+
+  /* Act on a forecast crossing before the level is reached */
+  iaq_trend_t *trend = &result->trend;
+  if (ok && iaq_get_trend(trend) == ESP_OK && trend->valid &&
+      trend->iaq_confidence >= IAQ_FORECAST_MIN_CONFIDENCE &&
+      trend->time_to_moderate_s > 0 &&
+      trend->time_to_moderate_s <= IAQ_FORECAST_HORIZON_S)
+  {
+    result->crossing_soon = true;
+  }
+
+  /* Without a score there is nothing to decide on; keep the cadence */
+  if (ok)
+  {
+    bool confident = trend->valid &&
+                     trend->iaq_confidence >= IAQ_FORECAST_MIN_CONFIDENCE;
+    rate_ctl_input_t rate_input = {
+        .calibrated = iaq_result->is_calibrated,
+        .level = iaq_result->iaq_level,
+        .slope = confident ? trend->iaq_slope : 0.0f,
+        .alert = result->crossing_soon};
+    rate_ctl_update(&rate_ctl, &rate_input, sample->iaq_input.timestamp_ms);
+  }
+
+  rate_ctl_stats_t *rate = &result->rate;
+  rate_ctl_get_stats(&rate_ctl, rate);
+  /* Read live rather than from the stats, so an override that came in
+   * since the update is not undone */
+  uint32_t interval_ms = rate_ctl_get_interval_ms(&rate_ctl);
+  if (interval_ms != __atomic_load_n(&read_interval_ms, __ATOMIC_RELAXED))
+  {
+    ESP_LOGI(TAG, "Sampling    : %s, every %" PRIu32 " ms%s",
+             rate_ctl_mode_to_string(rate->mode), interval_ms,
+             rate->override ? " (remote override)" : "");
+    __atomic_store_n(&read_interval_ms, interval_ms, __ATOMIC_RELAXED);
+  }
+}
+
+/**
+ * @brief Compute stage: drain the sample ring into the sinks
+ */
+static void compute_task(void *pvParameters)
+{
+  (void)pvParameters;
+  sample_record_t sample;
+  result_record_t result;
+
+  while (1)
+  {
+    ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+    while (spsc_ring_pop(&sample_ring, &sample))
+    {
+      compute_sample(&sample, &result);
+      result.computed_us = esp_timer_get_time();
+      sink_registry_publish(&sinks, &result);
+      heap_audit_cycle();
+    }
+  }
+}
+
+/**
+ * @brief Log one processed reading
+ *
+ * The log sink is the only DLOG_* writer; the other tasks log rarely and
+ * keep ESP_LOG.
+ */
+static void log_result(const result_record_t *rec)
+{
+  static bool iaq_valid;
+  const iaq_raw_data_t *in = &rec->iaq_input;
+  const iaq_result_t *iaq_result = &rec->iaq_result;
+  bool ok = rec->iaq_ret == ESP_OK;
+
+  DLOG_I(TAG, "----BME680 SENSOR DATA----");
+  DLOG_I(TAG, "Temperature : %8.2f °C ", in->temperature);
+  DLOG_I(TAG, "Humidity    : %8.2f %% ", in->humidity);
+  DLOG_I(TAG, "Pressure    : %8.2f hPa ", in->pressure / 100.0f);
+
+  if (in->gas_valid && ok && iaq_result->gas_outlier)
+  {
+    DLOG_W(TAG, "Gas Resist. : %8.0f Ohms (spike, %" PRIu32 " rejected)",
+           in->gas_resistance, iaq_result->outliers_rejected);
+  }
+  else if (in->gas_valid)
+  {
+    DLOG_I(TAG, "Gas Resist. : %8.0f Ohms ", in->gas_resistance);
+  }
+  else
+  {
+    DLOG_W(TAG, "Gas Resist. :  Invalid");
+  }
+
+  DLOG_I(TAG, "----INDOOR AIR QUALITY (IAQ)----");
+
+  if (ok)
+  {
+    const char *level_str = iaq_level_to_string(iaq_result->iaq_level);
+    const char *acc_str = iaq_accuracy_to_string(iaq_result->accuracy);
+
+    if (iaq_result->iaq_score <= 50)
+    {
+      DLOG_I(TAG, "IAQ Score   : %8.1f  [%s]", iaq_result->iaq_score,
+             level_str);
+    }
+    else if (iaq_result->iaq_score <= 150)
+    {
+      DLOG_W(TAG, "IAQ Score   : %8.1f  [%s]", iaq_result->iaq_score,
+             level_str);
+    }
+    else
+    {
+      DLOG_E(TAG, "IAQ Score   : %8.1f  [%s]", iaq_result->iaq_score,
+             level_str);
+    }
+
+    DLOG_I(TAG, "CO2 Equiv.  : %8.0f ppm", iaq_result->co2_equivalent);
+    DLOG_I(TAG, "VOC Equiv.  : %8.2f ppm", iaq_result->voc_equivalent);
+    DLOG_I(TAG, "Accuracy    : %s", acc_str);
+
+    if (iaq_result->anomaly_flags != 0)
+    {
+      DLOG_W(TAG, "Anomaly     : T %.1f  H %.1f  P %.1f  gas %.1f sd",
+             iaq_result->anomaly_score[IAQ_CHANNEL_TEMPERATURE],
+             iaq_result->anomaly_score[IAQ_CHANNEL_HUMIDITY],
+             iaq_result->anomaly_score[IAQ_CHANNEL_PRESSURE],
+             iaq_result->anomaly_score[IAQ_CHANNEL_GAS]);
+    }
+
+    if (!iaq_result->is_calibrated)
+    {
+      DLOG_W(TAG, "Calibrating : %d%% complete", rec->calibration_progress);
+    }
+  }
+  else
+  {
+    DLOG_W(TAG, "IAQ         : Waiting for valid gas data...");
+  }
+
+  if (rec->crossing_soon)
+  {
+    DLOG_W(TAG, "FORECAST: %s in ~%.0f s (IAQ %+.1f/min, R2 %.2f)",
+           iaq_level_to_string(IAQ_LEVEL_MODERATELY_POLLUTED),
+           rec->trend.time_to_moderate_s, rec->trend.iaq_slope,
+           rec->trend.iaq_confidence);
+  }
+
+  if (ok && iaq_result->is_calibrated)
+  {
+    if (iaq_result->iaq_level >= IAQ_LEVEL_MODERATELY_POLLUTED)
+    {
+      DLOG_E(TAG, "ALERT: %s! IAQ=%.0f - Buzzer ON",
+             iaq_level_to_string(iaq_result->iaq_level),
+             iaq_result->iaq_score);
+    }
+    else if (iaq_result->iaq_level == IAQ_LEVEL_LIGHTLY_POLLUTED)
+    {
+      DLOG_W(TAG, "WARNING: Lightly Polluted Air! IAQ=%.0f",
+             iaq_result->iaq_score);
+    }
+    else
+    {
+      DLOG_I(TAG, "NORMAL: Air Quality Status: %s",
+             iaq_level_to_string(iaq_result->iaq_level));
+    }
+  }
+  else
+  {
+    DLOG_I(TAG, "Status: Calibrating IAQ sensor...");
+  }
+
+  /* Burn-in runs at the normal cadence whether or not the sensor was
+   * conditioned; conditioning only makes the readings it sees settled */
+  if (ok && iaq_result->is_calibrated && !iaq_valid)
+  {
+    uint32_t valid_ms = (uint32_t)(rec->read_done_us / 1000);
+    iaq_valid = true;
+    DLOG_I(TAG,
+           "Time to valid IAQ: %.1f s (conditioning %.1f s, burn-in %.1f s)",
+           valid_ms / 1000.0f, conditioning_ms / 1000.0f,
+           (valid_ms - conditioned_at_ms) / 1000.0f);
+  }
+}
 
 #if MQTT_ENABLED
-      /* Publish data to MQTT broker */
-      if (mqtt_is_connected())
-      {
+/**
+ * @brief Publish one processed reading to the MQTT broker
+ * @return false if the broker was not connected
+ */
+static bool publish_result(const result_record_t *rec)
+{
+  static uint32_t calib_counter = IAQ_CALIB_PUBLISH_INTERVAL;
+  const iaq_raw_data_t *in = &rec->iaq_input;
+  const iaq_result_t *iaq_result = &rec->iaq_result;
+  bool ok = rec->iaq_ret == ESP_OK;
+
+  if (!mqtt_is_connected())
+  {
+    return false;
+  }
+
+  mqtt_rate_data_t mqtt_rate = {
+      .mode = rate_ctl_mode_to_string(rec->rate.mode),
+      .interval_ms = rec->rate.interval_ms,
+      .override = rec->rate.override,
+      .time_slow_s = rec->rate.time_in_mode_s[RATE_MODE_SLOW],
+      .time_normal_s = rec->rate.time_in_mode_s[RATE_MODE_NORMAL],
+      .time_burst_s = rec->rate.time_in_mode_s[RATE_MODE_BURST]};
+  mqtt_sensor_data_t mqtt_sensor = {.temperature = in->temperature,
+                                    .humidity = in->humidity,
+                                    .pressure = in->pressure / 100.0f,
+                                    .gas_resistance = in->gas_resistance,
+                                    .gas_valid = in->gas_valid,
+                                    .rate = &mqtt_rate};
+  mqtt_iaq_data_t mqtt_iaq;
+  if (ok)
+  {
+    mqtt_iaq = (mqtt_iaq_data_t){
+        .iaq_score = iaq_result->iaq_score,
+        .iaq_level = (int)iaq_result->iaq_level,
+        .iaq_text = iaq_level_to_string(iaq_result->iaq_level),
+        .accuracy = (int)iaq_result->accuracy,
+        .co2_equivalent = iaq_result->co2_equivalent,
+        .voc_equivalent = iaq_result->voc_equivalent,
+        .is_calibrated = iaq_result->is_calibrated,
+        .anomaly_temperature =
+            iaq_result->anomaly_score[IAQ_CHANNEL_TEMPERATURE],
+        .anomaly_humidity = iaq_result->anomaly_score[IAQ_CHANNEL_HUMIDITY],
+        .anomaly_pressure = iaq_result->anomaly_score[IAQ_CHANNEL_PRESSURE],
+        .anomaly_gas = iaq_result->anomaly_score[IAQ_CHANNEL_GAS],
+        .anomaly = iaq_result->anomaly_flags != 0};
+  }
+
 #if MQTT_USE_THINGSBOARD
-        mqtt_sensor_data_t mqtt_sensor = {
-            .temperature = raw_data.temperature,
-            .humidity = raw_data.humidity,
-            .pressure = raw_data.pressure / 100.0f,
-            .gas_resistance = (float)raw_data.gas_resistance,
-            .gas_valid =
-                (raw_data.status & BME68X_GASM_VALID_MSK) ? true : false};
-        mqtt_iaq_data_t mqtt_iaq;
-        mqtt_iaq_data_t *iaq_ptr = NULL;
-        if (iaq_ret == ESP_OK)
-        {
-          mqtt_iaq = (mqtt_iaq_data_t){
-              .iaq_score = iaq_result.iaq_score,
-              .iaq_level = (int)iaq_result.iaq_level,
-              .iaq_text = iaq_level_to_string(iaq_result.iaq_level),
-              .accuracy = (int)iaq_result.accuracy,
-              .co2_equivalent = iaq_result.co2_equivalent,
-              .voc_equivalent = iaq_result.voc_equivalent,
-              .is_calibrated = iaq_result.is_calibrated};
-          iaq_ptr = &mqtt_iaq;
-        }
-        mqtt_publish_thingsboard_telemetry(&mqtt_sensor, iaq_ptr);
+  mqtt_publish_thingsboard_telemetry(&mqtt_sensor, ok ? &mqtt_iaq : NULL);
 #else
-        mqtt_sensor_data_t mqtt_sensor = {
-            .temperature = raw_data.temperature,
-            .humidity = raw_data.humidity,
-            .pressure = raw_data.pressure / 100.0f,
-            .gas_resistance = (float)raw_data.gas_resistance,
-            .gas_valid =
-                (raw_data.status & BME68X_GASM_VALID_MSK) ? true : false};
-        mqtt_publish_sensor_data(&mqtt_sensor);
-
-        if (iaq_ret == ESP_OK)
-        {
-          mqtt_iaq_data_t mqtt_iaq = {
-              .iaq_score = iaq_result.iaq_score,
-              .iaq_level = (int)iaq_result.iaq_level,
-              .iaq_text = iaq_level_to_string(iaq_result.iaq_level),
-              .accuracy = (int)iaq_result.accuracy,
-              .co2_equivalent = iaq_result.co2_equivalent,
-              .voc_equivalent = iaq_result.voc_equivalent,
-              .is_calibrated = iaq_result.is_calibrated};
-          mqtt_publish_iaq_data(&mqtt_iaq);
-
-          if (iaq_result.is_calibrated &&
-              iaq_result.iaq_level >= IAQ_LEVEL_MODERATELY_POLLUTED)
-          {
-            char alert_msg[128];
-            snprintf(alert_msg, sizeof(alert_msg),
-                     "Air quality is %s! IAQ Score: %.0f",
-                     iaq_level_to_string(iaq_result.iaq_level),
-                     iaq_result.iaq_score);
-            mqtt_publish_alert("IAQ_ALERT", alert_msg);
-          }
-        }
+  mqtt_publish_sensor_data(&mqtt_sensor);
+
+  if (ok)
+  {
+    mqtt_publish_iaq_data(&mqtt_iaq);
+  }
 #endif
-        ESP_LOGI(TAG, "MQTT: Data published successfully");
-      }
+
+  /* Keep the room's calibration current for replacement devices */
+  calib_counter++;
+  iaq_calib_record_t calib;
+  if (ok && iaq_result->is_calibrated &&
+      calib_counter >= IAQ_CALIB_PUBLISH_INTERVAL &&
+      iaq_export_calibration(sensor_id, &calib) == ESP_OK &&
+      mqtt_publish_calibration(&calib, sizeof(calib)) == ESP_OK)
+  {
+    calib_counter = 0;
+  }
+  ESP_LOGI(TAG, "MQTT: Data published successfully");
+  return true;
+}
 #endif
-    }
-    else
+
+/**
+ * @brief Log sink: log each reading and time the pipeline
+ */
+static void log_sink_handler(const void *record, void *arg)
+{
+  static stage_stats_t stats[STAGE_COUNT];
+  static uint64_t log_cycles;
+  const result_record_t *rec = record;
+  (void)arg;
+
+  esp_cpu_cycle_count_t log_start = esp_cpu_get_cycle_count();
+  log_result(rec);
+  log_cycles += (uint32_t)(esp_cpu_get_cycle_count() - log_start);
+
+  int64_t now = esp_timer_get_time();
+  stage_stats_add(&stats[STAGE_ACQUIRE],
+                  rec->read_done_us - rec->read_start_us);
+  stage_stats_add(&stats[STAGE_COMPUTE], rec->computed_us - rec->read_done_us);
+  stage_stats_add(&stats[STAGE_LOG], now - rec->computed_us);
+  stage_stats_add(&stats[STAGE_TOTAL], now - rec->read_start_us);
+  if (stats[STAGE_TOTAL].count % PIPELINE_REPORT_INTERVAL == 0)
+  {
+    pipeline_report(stats, log_cycles);
+  }
+  heap_audit_cycle();
+}
+
+/**
+ * @brief Alert sink: sound the buzzer while the air is polluted
+ */
+static void alert_sink_handler(const void *record, void *arg)
+{
+  const result_record_t *rec = record;
+  (void)arg;
+  buzzer_set_active(rec->iaq_ret == ESP_OK && rec->iaq_result.is_calibrated &&
+                    rec->iaq_result.iaq_level >= IAQ_LEVEL_MODERATELY_POLLUTED);
+  heap_audit_cycle();
+}
+
+#if MQTT_ENABLED
+/**
+ * @brief MQTT sink: publish each reading; a stalled broker only delays this
+ *        task
+ */
+static void mqtt_sink_handler(const void *record, void *arg)
+{
+  (void)arg;
+  /* Offline cycles would use up the heap audit warm-up doing nothing, and
+   * at QoS 1 every publish allocates an outbox entry by design */
+  if (publish_result(record) && MQTT_TELEMETRY_QOS == 0)
+  {
+    heap_audit_cycle();
+  }
+}
+
+#if !MQTT_USE_THINGSBOARD
+/**
+ * @brief MQTT alert sink: publish an alert for each polluted reading
+ */
+static void mqtt_alert_sink_handler(const void *record, void *arg)
+{
+  const result_record_t *rec = record;
+  const iaq_result_t *iaq_result = &rec->iaq_result;
+  (void)arg;
+
+  if (rec->iaq_ret != ESP_OK || !iaq_result->is_calibrated ||
+      iaq_result->iaq_level < IAQ_LEVEL_MODERATELY_POLLUTED ||
+      !mqtt_is_connected())
+  {
+    return;
+  }
+  char alert_msg[128];
+  snprintf(alert_msg, sizeof(alert_msg),
+           "Air quality is %s! IAQ Score: %" PRIu32,
+           iaq_level_to_string(iaq_result->iaq_level),
+           (uint32_t)(iaq_result->iaq_score + 0.5f));
+  mqtt_publish_alert("IAQ_ALERT", alert_msg);
+}
+#endif
+#endif
+
+/**
+ * @brief Set up the queues and start the pipeline, consumers first so the
+ *        producers always have a task to notify
+ */
+static esp_err_t pipeline_start(void)
+{
+  esp_err_t ret = spsc_ring_init(&sample_ring, sample_slots,
+                                 sizeof(sample_record_t), SAMPLE_RING_LEN,
+                                 SPSC_RING_DROP_NEWEST);
+  if (ret == ESP_OK)
+  {
+    ret = sink_registry_init(&sinks, sizeof(result_record_t));
+  }
+  if (ret != ESP_OK)
+  {
+    return ret;
+  }
+
+  const sink_config_t sink_configs[] = {
+      {.name = "log",
+       .handler = log_sink_handler,
+       .policy = SINK_BLOCK,
+       .block_ms = LOG_SINK_BLOCK_MS,
+       .storage = log_sink_storage,
+       .capacity = LOG_SINK_LEN,
+       .stack = log_sink_stack,
+       .stack_size = sizeof(log_sink_stack),
+       .priority = 3},
+      {.name = "alert",
+       .handler = alert_sink_handler,
+       .policy = SINK_DROP_OLDEST,
+       .storage = alert_sink_storage,
+       .capacity = ALERT_SINK_LEN,
+       .stack = alert_sink_stack,
+       .stack_size = sizeof(alert_sink_stack),
+       .priority = 5},
+#if MQTT_ENABLED
+      {.name = "mqtt",
+       .handler = mqtt_sink_handler,
+       .policy = SINK_DROP_OLDEST,
+       .storage = mqtt_sink_storage,
+       .capacity = MQTT_SINK_LEN,
+       .stack = mqtt_sink_stack,
+       .stack_size = sizeof(mqtt_sink_stack),
+       .priority = 4},
+#if !MQTT_USE_THINGSBOARD
+      {.name = "mqtt alert",
+       .handler = mqtt_alert_sink_handler,
+       .policy = SINK_DROP_OLDEST,
+       .storage = mqtt_alert_sink_storage,
+       .capacity = MQTT_ALERT_SINK_LEN,
+       .stack = mqtt_alert_sink_stack,
+       .stack_size = sizeof(mqtt_alert_sink_stack),
+       .priority = 4},
+#endif
+#endif
+  };
+  sink_t *const sink_states[] = {&log_sink, &alert_sink,
+#if MQTT_ENABLED
+                                 &mqtt_sink,
+#if !MQTT_USE_THINGSBOARD
+                                 &mqtt_alert_sink,
+#endif
+#endif
+  };
+  for (size_t i = 0; i < sizeof(sink_configs) / sizeof(sink_configs[0]); i++)
+  {
+    ret = sink_register(&sinks, sink_states[i], &sink_configs[i]);
+    if (ret != ESP_OK)
     {
-      ESP_LOGE(TAG, "Failed to read sensor data!");
+      ESP_LOGE(TAG, "Failed to start %s sink", sink_configs[i].name);
+      return ret;
     }
-
-    vTaskDelay(pdMS_TO_TICKS(SENSOR_READ_INTERVAL_MS));
   }
+
+  compute_task_handle = xTaskCreateStatic(
+      compute_task, "compute_task", sizeof(compute_task_stack), NULL, 5,
+      compute_task_stack, &compute_task_buffer);
+  xTaskCreateStatic(acquisition_task, "sensor_task",
+                    sizeof(acquisition_task_stack), NULL, 6,
+                    acquisition_task_stack, &acquisition_task_buffer);
+  return ESP_OK;
 }
 
 static void print_banner(void)
@@ -233,7 +905,9 @@ static void print_system_info(void)
   ESP_LOGI(TAG, "BME680: Address=0x%02X", bme680_app_get_address());
   ESP_LOGI(TAG, "Buzzer: GPIO%d", buzzer_get_gpio());
   ESP_LOGI(TAG, "Temp Threshold: %.1f°C", bme680_app_get_threshold());
-  ESP_LOGI(TAG, "Read Interval: %d ms", SENSOR_READ_INTERVAL_MS);
+  ESP_LOGI(TAG, "Read Interval: %d ms (%d ms in clean air, %d ms in events)",
+           SENSOR_READ_INTERVAL_MS, SENSOR_SLOW_INTERVAL_MS,
+           SENSOR_FAST_INTERVAL_MS);
   ESP_LOGI(TAG, "IAQ Enabled: Yes (Software Algorithm)");
 #if MQTT_ENABLED
   ESP_LOGI(TAG, "MQTT: %s", mqtt_is_connected() ? "Connected" : "Disconnected");
@@ -302,7 +976,67 @@ void app_main(void)
   }
   ESP_LOGI(TAG, "IAQ Calculator initialized");
 
+  ret = iaq_persist_start();
+  if (ret != ESP_OK)
+  {
+    ESP_LOGW(TAG, "IAQ state writer unavailable - state will not be saved");
+  }
+
+#if CONFIG_IAQ_BENCHMARK_AT_BOOT
+  iaq_benchmark_t bench;
+  if (iaq_run_benchmark(10000, &bench) == ESP_OK)
+  {
+    ESP_LOGI(TAG, "IAQ pipeline: float %.0f cycles, fixed %.0f cycles/sample",
+             bench.float_cycles, bench.fixed_cycles);
+    ESP_LOGI(TAG, "  - Max error: IAQ %.3f, CO2 %.3f ppm, VOC %.4f ppm (%s)",
+             bench.max_iaq_error, bench.max_co2_error, bench.max_voc_error,
+             bench.within_bounds ? "within bounds" : "OUT OF BOUNDS");
+  }
+#endif
+
+#if CONFIG_IAQ_ENGINE_EVAL
+  if (engine_eval_start() != ESP_OK)
+  {
+    ESP_LOGW(TAG, "IAQ engine comparison unavailable");
+  }
+#endif
+
+  /* The classifier waits for heater-scan fingerprints; for now it is only
+   * loaded and, if configured, benchmarked */
+  ret = gas_classifier_load_partition(&gas_classifier);
+  if (ret == ESP_OK)
+  {
+#if CONFIG_GAS_CLASSIFIER_BENCHMARK_AT_BOOT
+    gas_classifier_benchmark_t clf_bench;
+    if (gas_classifier_benchmark(&gas_classifier, 2000, &clf_bench) == ESP_OK)
+    {
+      ESP_LOGI(TAG,
+               "Gas classifier: %.0f cycles, %.0f inferences/s, "
+               "checksum %08" PRIx32,
+               clf_bench.cycles,
+               CONFIG_ESP_DEFAULT_CPU_FREQ_MHZ * 1e6f / clf_bench.cycles,
+               clf_bench.checksum);
+    }
+#endif
+  }
+  else
+  {
+    ESP_LOGI(TAG, "No gas classifier model (%s)", esp_err_to_name(ret));
+  }
+
+  /* Before MQTT, which may deliver a retained override right away */
+  rate_ctl_config_t rate_config;
+  rate_ctl_get_default_config(&rate_config);
+  rate_config.interval_ms[RATE_MODE_SLOW] = SENSOR_SLOW_INTERVAL_MS;
+  rate_config.interval_ms[RATE_MODE_NORMAL] = SENSOR_READ_INTERVAL_MS;
+  rate_config.interval_ms[RATE_MODE_BURST] = SENSOR_FAST_INTERVAL_MS;
+  ESP_ERROR_CHECK(rate_ctl_init(&rate_ctl, &rate_config,
+                                (uint32_t)(esp_timer_get_time() / 1000)));
+
 #if MQTT_ENABLED
+  /* Before subscribing, so our own retained record is recognized */
+  get_sensor_id(sensor_id);
+
   /* Initialize WiFi */
   ESP_LOGI(TAG, "");
   ESP_LOGI(TAG, "Initializing WiFi...");
@@ -322,6 +1056,17 @@ void app_main(void)
       {
         ESP_LOGW(TAG, "Failed to start MQTT client");
       }
+      else
+      {
+        if (mqtt_subscribe_calibration(on_calibration_received) != ESP_OK)
+        {
+          ESP_LOGW(TAG, "Calibration sharing unavailable");
+        }
+        if (mqtt_subscribe_rate(on_rate_command) != ESP_OK)
+        {
+          ESP_LOGW(TAG, "Remote sampling control unavailable");
+        }
+      }
     }
     else
     {
@@ -330,7 +1075,17 @@ void app_main(void)
   }
 #endif
 
-  xTaskCreate(sensor_task, "sensor_task", 8192, NULL, 5, NULL);
+  if (dlog_start() != ESP_OK)
+  {
+    ESP_LOGW(TAG, "Deferred log unavailable - logging in line");
+  }
+
+  ret = pipeline_start();
+  if (ret != ESP_OK)
+  {
+    ESP_LOGE(TAG, "Failed to start sensor pipeline");
+    return;
+  }
   buzzer_start_task();
 
   print_system_info();
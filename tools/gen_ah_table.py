@@ -0,0 +1,60 @@
+#!/usr/bin/env python3
+"""Generate the absolute-humidity interpolation table for iaq_calculator.
+
+Absolute humidity follows from temperature and relative humidity with the
+Magnus relation:
+
+    AH [g/m3] = 6.112 * exp(17.62 * T / (243.12 + T)) * RH * 2.1674 / (273.15 + T)
+
+AH is linear in RH, so the table only holds the factor per %RH as a function
+of temperature, sampled every degree. The calculator interpolates it
+linearly, which keeps the relative error within about 0.1 % (worst at the
+cold end of the range).
+
+Usage: tools/gen_ah_table.py > components/iaq_calculator/iaq_ah_table.c
+"""
+
+import math
+
+T_MIN = -40
+T_MAX = 85
+Q = 20
+
+
+def ah_per_rh(t):
+    return 6.112 * math.exp(17.62 * t / (243.12 + t)) * 2.1674 / (273.15 + t)
+
+
+def emit(name, ctype, values, fmt, per_line):
+    print(f"const {ctype} {name}[] = {{")
+    for i in range(0, len(values), per_line):
+        row = ", ".join(fmt(v) for v in values[i:i + per_line])
+        print(f"    {row},")
+    print("};")
+    print(f"_Static_assert(sizeof({name}) == IAQ_AH_TABLE_LEN * sizeof({ctype}),")
+    print('               "table does not match iaq_humidity.h");')
+
+
+def main():
+    temps = range(T_MIN, T_MAX + 1)
+    values = [ah_per_rh(t) for t in temps]
+
+    print("""/**
+ * @file iaq_ah_table.c
+ * @brief Absolute humidity per %RH versus temperature (Magnus relation)
+ *
+ * Generated by tools/gen_ah_table.py, do not edit.
+ */
+
+#include "iaq_humidity.h"
+""")
+    print(f"// Sampled every degree from {T_MIN} to {T_MAX} degC, g/m3 per %RH")
+    emit("iaq_ah_per_rh", "float", values, lambda v: f"{v:.7e}f", 4)
+    print()
+    print(f"// Same table in Q{Q}")
+    emit("iaq_ah_per_rh_q20", "int32_t", values,
+         lambda v: f"{round(v * (1 << Q))}", 8)
+
+
+if __name__ == "__main__":
+    main()
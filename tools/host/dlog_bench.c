@@ -0,0 +1,132 @@
+/**
+ * @file dlog_bench.c
+ * @brief Host check of the deferred log against in-line formatting
+ *
+ * Logs the lines the publish stage prints for every reading, once
+ * formatted in line as ESP_LOG would (without the UART) and once through
+ * DLOG_I, and times both. Every deferred record is then formatted and
+ * compared with the in-line text.
+ */
+
+#include "deferred_log.h"
+#include <inttypes.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#define TAG "MAIN"
+#define BENCH_ROUNDS 20000
+#define MAX_LINES 16
+
+typedef struct {
+  float temperature;
+  float humidity;
+  float pressure;
+  float gas;
+  float iaq;
+  float co2;
+  float voc;
+  uint32_t outliers;
+  const char *level;
+  const char *accuracy;
+} reading_t;
+
+static char inline_text[MAX_LINES][DLOG_LINE_MAX];
+static int inline_lines;
+
+static uint64_t now_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+#define LINE_INLINE(format, ...)                                               \
+  snprintf(inline_text[inline_lines++], DLOG_LINE_MAX, format, ##__VA_ARGS__)
+#define LINE_DEFERRED(format, ...) DLOG_I(TAG, format, ##__VA_ARGS__)
+
+/* The publish stage's lines for a calibrated reading with a gas spike */
+#define SAMPLE_LINES(LINE, r)                                                  \
+  do {                                                                         \
+    LINE("----BME680 SENSOR DATA----");                                        \
+    LINE("Temperature : %8.2f °C ", (r)->temperature);                        \
+    LINE("Humidity    : %8.2f %% ", (r)->humidity);                            \
+    LINE("Pressure    : %8.2f hPa ", (r)->pressure / 100.0f);                  \
+    LINE("Gas Resist. : %8.0f Ohms (spike, %" PRIu32 " rejected)",             \
+         (r)->gas, (r)->outliers);                                             \
+    LINE("----INDOOR AIR QUALITY (IAQ)----");                                  \
+    LINE("IAQ Score   : %8.1f  [%s]", (r)->iaq, (r)->level);                   \
+    LINE("CO2 Equiv.  : %8.0f ppm", (r)->co2);                                 \
+    LINE("VOC Equiv.  : %8.2f ppm", (r)->voc);                                 \
+    LINE("Accuracy    : %s", (r)->accuracy);                                   \
+    LINE("NORMAL: Air Quality Status: %s", (r)->level);                        \
+    LINE("MQTT: Data published successfully");                                 \
+  } while (0)
+
+static void make_reading(int i, reading_t *r) {
+  r->temperature = 21.0f + (float)(i % 97) * 0.037f;
+  r->humidity = 40.0f + (float)(i % 89) * 0.21f;
+  r->pressure = 100800.0f + (float)(i % 301);
+  r->gas = 52000.0f + (float)(i % 5003) * 3.1f;
+  r->iaq = 25.0f + (float)(i % 211) * 0.7f;
+  r->co2 = 450.0f + r->iaq * 8.0f;
+  r->voc = 0.3f + r->iaq * 0.01f;
+  r->outliers = (uint32_t)i / 100;
+  r->level = "Good";
+  r->accuracy = "High";
+}
+
+int main(void) {
+  // DLOG_I lines below the runtime level are not even recorded
+  esp_log_host_level = ESP_LOG_INFO;
+  if (dlog_init() != ESP_OK) {
+    fprintf(stderr, "dlog_init failed\n");
+    return 1;
+  }
+
+  uint64_t inline_ns = 0;
+  uint64_t write_ns = 0;
+  uint64_t format_ns = 0;
+  int lines = 0;
+  int mismatches = 0;
+  for (int i = 0; i < BENCH_ROUNDS; i++) {
+    reading_t r;
+    make_reading(i, &r);
+
+    inline_lines = 0;
+    uint64_t t0 = now_ns();
+    SAMPLE_LINES(LINE_INLINE, &r);
+    uint64_t t1 = now_ns();
+    SAMPLE_LINES(LINE_DEFERRED, &r);
+    uint64_t t2 = now_ns();
+    inline_ns += t1 - t0;
+    write_ns += t2 - t1;
+    lines = inline_lines;
+
+    dlog_record_t record;
+    char text[DLOG_LINE_MAX];
+    for (int n = 0; dlog_read(&record); n++) {
+      uint64_t t3 = now_ns();
+      dlog_format(&record, text, sizeof(text));
+      format_ns += now_ns() - t3;
+      if (n >= inline_lines || strcmp(text, inline_text[n]) != 0) {
+        if (mismatches++ == 0) {
+          fprintf(stderr, "Mismatch: \"%s\" vs \"%s\"\n", text,
+                  n < inline_lines ? inline_text[n] : "");
+        }
+      }
+    }
+  }
+
+  dlog_stats_t stats;
+  dlog_get_stats(&stats);
+  printf("Lines    : %d per reading, %" PRIu32 " records, %" PRIu32
+         " dropped\n",
+         lines, stats.written, stats.dropped);
+  printf("In line  : %.0f ns/reading\n", (double)inline_ns / BENCH_ROUNDS);
+  printf("Deferred : %.0f ns/reading to write, %.0f ns/reading to format\n",
+         (double)write_ns / BENCH_ROUNDS, (double)format_ns / BENCH_ROUNDS);
+  bool ok = mismatches == 0 && stats.dropped == 0 &&
+            stats.written == (uint32_t)lines * BENCH_ROUNDS;
+  printf("%s\n", ok ? "Output identical" : "OUTPUT DIFFERS");
+  return ok ? 0 : 1;
+}
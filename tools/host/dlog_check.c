@@ -0,0 +1,161 @@
+/**
+ * @file dlog_check.c
+ * @brief Host check of the deferred log's argument capture and formatting
+ *
+ * Each case is logged through DLOG_W and formatted back from its record,
+ * and the text must match snprintf() of the same format and arguments:
+ * every conversion the component supports, "*" widths and precisions,
+ * 64-bit and size_t integers, pointers, and conversions after each of
+ * those, which read the wrong argument if one was not consumed. Float
+ * arguments are stored as float, so the cases use values a float holds
+ * exactly. Lines past the argument slots, and lines below the runtime or
+ * compile-time level, are checked as well.
+ *
+ * Usage: dlog_check
+ */
+
+#include "deferred_log.h"
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+
+#define TAG "CHECK"
+
+static int failures;
+static int cases;
+
+static void expect(bool ok, const char *what) {
+  if (!ok) {
+    fprintf(stderr, "FAILED: %s\n", what);
+    failures++;
+  }
+}
+
+/**
+ * @brief Format the oldest record and compare it with the expected text
+ */
+static void expect_record(const char *format, const char *want) {
+  dlog_record_t record;
+  char text[DLOG_LINE_MAX];
+  cases++;
+  if (!dlog_read(&record)) {
+    fprintf(stderr, "FAILED: nothing recorded for \"%s\"\n", format);
+    failures++;
+    return;
+  }
+  dlog_format(&record, text, sizeof(text));
+  if (strcmp(text, want) != 0) {
+    fprintf(stderr, "FAILED: \"%s\" gave \"%s\", not \"%s\"\n", format, text,
+            want);
+    failures++;
+  }
+}
+
+#define CASE(format, ...)                                                      \
+  do {                                                                         \
+    char want[DLOG_LINE_MAX];                                                  \
+    snprintf(want, sizeof(want), format, ##__VA_ARGS__);                       \
+    DLOG_W(TAG, format, ##__VA_ARGS__);                                        \
+    expect_record(format, want);                                               \
+  } while (0)
+
+static void check_conversions(void) {
+  int local;
+  const void *ptr = &local;
+  size_t size = 123456;
+  ptrdiff_t diff = -42;
+
+  CASE("plain text, 100%% sure");
+  CASE("%d %i %u %x %X %o %c", -7, 8, 9u, 0xabu, 0xcdu, 8u, 'q');
+  CASE("%5d|%-5d|%05d|%+d|% d", 1, 2, 3, 4, 5);
+  CASE("%hd %hhu %d", (short)-3, (unsigned char)250, 11);
+  CASE("%ld %lu %lx then %d", -100000L, 4000000000UL, 0xbeefUL, 12);
+  CASE("%" PRIu32 " %" PRIi32 " %" PRIx32, (uint32_t)4000000000u,
+       (int32_t)-5, (uint32_t)0xfeed);
+  CASE("%f %.2f %8.3f %e %g %G", 1.5, 2.25, -3.125, 1024.0, 0.5, 1e-5);
+  CASE("%s|%10s|%-6s|%.3s", "abc", "right", "left", "truncated");
+
+  // Arguments the writer used to skip, and what comes after them
+  CASE("%lld %llu then %d", -1234567890123LL, 18000000000000000000ULL, 14);
+  CASE("%llx %d", 0x123456789abcdefULL, 15);
+  CASE("%" PRIu64 " %" PRIi64 " then %s", (uint64_t)1 << 40, (int64_t)-1,
+       "ok");
+  CASE("%zu %zd then %d", size, (ptrdiff_t)-9, 16);
+  CASE("%td %jd then %d", diff, (intmax_t)-77, 16);
+  CASE("%p then %d", ptr, 17);
+  CASE("%*d|%-*d|%.*f then %d", 6, 18, 6, 19, 2, 3.75, 20);
+  CASE("%*.*f then %s", 9, 3, 1.25, "done");
+  CASE("%.*f with no precision", -1, 2.5);
+  CASE("%*d left by a negative width", -7, 21);
+  CASE("%.*s then %d", 2, "abc", 22);
+}
+
+static void check_slots(void) {
+  char want[DLOG_LINE_MAX];
+
+  // Eight slots: the ninth conversion is printed as written
+  DLOG_W(TAG, "%d %d %d %d %d %d %d %d %d", 1, 2, 3, 4, 5, 6, 7, 8, 9);
+  expect_record("nine ints", "1 2 3 4 5 6 7 8 %d");
+
+  // A 64-bit integer that would need the last slot and one more
+  DLOG_W(TAG, "%d %d %d %d %d %d %d %lld %d", 1, 2, 3, 4, 5, 6, 7,
+         (long long)8, 9);
+  expect_record("wide past the slots", "1 2 3 4 5 6 7 %lld %d");
+
+  // Stars take slots too
+  DLOG_W(TAG, "%*d %*d %*d %*d %d", 1, 1, 2, 2, 3, 3, 4, 4, 5);
+  snprintf(want, sizeof(want), "%*d %*d %*d %*d %%d", 1, 1, 2, 2, 3, 3, 4,
+           4);
+  expect_record("stars past the slots", want);
+
+  // Unsupported conversions print as written and take no argument
+  DLOG_W(TAG, "%q %d", 23);
+  expect_record("unsupported conversion", "%q 23");
+}
+
+static void check_levels(void) {
+  dlog_record_t record;
+  while (dlog_read(&record)) {
+  }
+
+  esp_log_host_level = ESP_LOG_WARN;
+  DLOG_I(TAG, "below the runtime level %d", 1);
+  expect(!dlog_read(&record), "line below the runtime level not recorded");
+  DLOG_E(TAG, "above it %d", 2);
+  expect_record("error line", "above it 2");
+
+  esp_log_host_level = ESP_LOG_NONE;
+  DLOG_E(TAG, "logging off %d", 3);
+  expect(!dlog_read(&record), "nothing recorded with logging off");
+
+  // A level compiled out never reaches the writer, whatever the runtime
+  esp_log_host_level = ESP_LOG_VERBOSE;
+#undef LOG_LOCAL_LEVEL
+#define LOG_LOCAL_LEVEL ESP_LOG_ERROR
+  DLOG_W(TAG, "compiled out %d", 4);
+  expect(!dlog_read(&record), "line above LOG_LOCAL_LEVEL compiled out");
+#undef LOG_LOCAL_LEVEL
+#define LOG_LOCAL_LEVEL ESP_LOG_VERBOSE
+
+  dlog_stats_t stats;
+  dlog_get_stats(&stats);
+  expect(stats.dropped == 0, "nothing dropped");
+}
+
+int main(void) {
+  if (dlog_init() != ESP_OK) {
+    fprintf(stderr, "dlog_init failed\n");
+    return 1;
+  }
+  esp_log_host_level = ESP_LOG_WARN;
+
+  check_conversions();
+  check_slots();
+  check_levels();
+
+  printf("Cases       : %d, %d failed\n", cases, failures);
+  printf("%s\n", failures == 0 ? "Formatting matches" : "FORMATTING DIFFERS");
+  return failures == 0 ? 0 : 1;
+}
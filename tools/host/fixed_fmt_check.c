@@ -0,0 +1,117 @@
+/**
+ * @file fixed_fmt_check.c
+ * @brief Host check of printing values through fixed_split()
+ *
+ * Prints a sweep of values with FIXED_FMT at every supported number of
+ * decimals. The text must read back within half a unit in the last place
+ * of the value, give or take the float rounding of the scaling, and must
+ * match printf's "%.*f" except where that rounding tips a value within a
+ * float's precision of a tie. Negative values that round to zero print
+ * without a sign, and magnitudes too large for 32 bits saturate.
+ *
+ * Usage: fixed_fmt_check
+ */
+
+#include "fixed_fmt.h"
+#include <float.h>
+#include <math.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define SWEEP_STEPS 200000
+#define SWEEP_DIGITS 7
+
+static int failures;
+
+static void expect(bool ok, const char *what) {
+  if (!ok) {
+    fprintf(stderr, "FAILED: %s\n", what);
+    failures++;
+  }
+}
+
+static void print_fixed(char *text, size_t size, float value, int decimals) {
+  fixed_fmt_t f = fixed_split(value, decimals);
+  snprintf(text, size, FIXED_FMT, FIXED_ARGS(f));
+}
+
+/**
+ * @brief Print one value both ways
+ * @return true if the texts differ, which they may only on a tie
+ */
+static bool check_value(float value, int decimals) {
+  char text[32];
+  char want[32];
+  print_fixed(text, sizeof(text), value, decimals);
+  snprintf(want, sizeof(want), "%.*f", decimals, (double)value);
+
+  double scaled = fabs((double)value) * pow(10.0, decimals);
+  double rounding = scaled * FLT_EPSILON;
+  double error = fabs(strtod(text, NULL) * pow(10.0, decimals) -
+                      copysign(scaled, (double)value));
+  if (error > 0.5 + rounding) {
+    fprintf(stderr, "FAILED: %.9g at %d decimals printed as %s\n",
+            (double)value, decimals, text);
+    failures++;
+  }
+
+  // printf keeps the sign of a negative zero, which is not a difference
+  const char *unsigned_want = want;
+  if (want[0] == '-' && strspn(want + 1, "0.") == strlen(want + 1)) {
+    unsigned_want++;
+  }
+  if (strcmp(text, unsigned_want) == 0) {
+    return false;
+  }
+  // printf rounds the exact value, the split its float scaling
+  if (fabs(scaled - floor(scaled) - 0.5) > rounding) {
+    fprintf(stderr, "FAILED: %.9g at %d decimals printed as %s, not %s\n",
+            (double)value, decimals, text, want);
+    failures++;
+  }
+  return true;
+}
+
+static void check_sweep(void) {
+  for (int decimals = 1; decimals <= FIXED_FMT_MAX_DECIMALS; decimals++) {
+    // Seven significant digits, all a float carries
+    float max = powf(10.0f, (float)(SWEEP_DIGITS - decimals));
+    unsigned ties = 0;
+    for (int i = 0; i <= SWEEP_STEPS; i++) {
+      // Dense near zero, where each digit counts, and sparse further out
+      float t = (float)i / SWEEP_STEPS;
+      float value = max * t * t * t;
+      ties += check_value(value, decimals);
+      ties += check_value(-value, decimals);
+    }
+    printf("Decimals %d  : %u of %d values round a tie unlike printf\n",
+           decimals, ties, 2 * (SWEEP_STEPS + 1));
+  }
+}
+
+static void check_edges(void) {
+  char text[32];
+  print_fixed(text, sizeof(text), -0.004f, 2);
+  expect(strcmp(text, "0.00") == 0, "no sign on a negative zero");
+  print_fixed(text, sizeof(text), -0.006f, 2);
+  expect(strcmp(text, "-0.01") == 0, "sign on a small negative value");
+  print_fixed(text, sizeof(text), 9.9996f, 3);
+  expect(strcmp(text, "10.000") == 0, "rounding carries into the whole part");
+  print_fixed(text, sizeof(text), 1.5f, 0);
+  expect(strcmp(text, "1.5") == 0, "decimals below one clamped to one");
+  print_fixed(text, sizeof(text), NAN, 2);
+  expect(strcmp(text, "0.00") == 0, "NaN prints as zero");
+  print_fixed(text, sizeof(text), 1e12f, 2);
+  expect(strcmp(text, "42949672.95") == 0, "large magnitudes saturate");
+  print_fixed(text, sizeof(text), -INFINITY, 1);
+  expect(strcmp(text, "-429496729.5") == 0, "infinity saturates");
+}
+
+int main(void) {
+  check_sweep();
+  check_edges();
+  printf("%s\n", failures == 0 ? "Values print" : "VALUES MISPRINT");
+  return failures == 0 ? 0 : 1;
+}
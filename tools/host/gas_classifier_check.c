@@ -0,0 +1,155 @@
+/**
+ * @file gas_classifier_check.c
+ * @brief Host check of the int8 gas classifier against a pinned model
+ *
+ * Loads data/gas_model_check.bin, a three-class model trained by
+ *   gas_model train -H 8 -e 200 -s 1
+ * on synthetic heater scans. A fingerprint shaped like each class must be
+ * classified as that class, and the outputs for these fingerprints and
+ * for the benchmark's must match checksums pinned from a known-good
+ * build; inference is integer-only, so any change to the results is a
+ * change to the arithmetic. Copies of the blob broken in one way each,
+ * with the CRC fixed up where it would otherwise catch the damage first,
+ * must be refused with the matching error.
+ *
+ * Usage: gas_classifier_check <gas_model_check.bin>
+ */
+
+#include "esp_rom_crc.h"
+#include "gas_classifier.h"
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+
+#define CHECK_BLOB_MAX 1024
+#define CHECK_STEPS 8
+#define CHECK_BENCH_INFERENCES 100
+#define CHECK_RESULTS_CRC 0x8178ec82u
+#define CHECK_BENCH_CRC 0x6fe9425bu
+
+static int failures;
+
+static void expect(bool ok, const char *what) {
+  if (!ok) {
+    fprintf(stderr, "FAILED: %s\n", what);
+    failures++;
+  }
+}
+
+static const struct {
+  const char *name;
+  uint32_t fingerprint[CHECK_STEPS];
+} samples[] = {
+    {"clean", {40000, 43000, 47500, 54500, 65000, 80000, 102000, 134000}},
+    {"ethanol", {120000, 97000, 85000, 79000, 82000, 91000, 104000, 124000}},
+    {"co", {15000, 19000, 22700, 24400, 23500, 21200, 18500, 16100}},
+};
+
+/**
+ * @brief Fix up the CRC after editing a blob
+ */
+static void reseal(uint8_t *blob) {
+  const gas_classifier_header_t *header = (const void *)blob;
+  uint32_t crc_at = header->size - sizeof(uint32_t);
+  uint32_t crc = esp_rom_crc32_le(0, blob, crc_at);
+  memcpy(blob + crc_at, &crc, sizeof(crc));
+}
+
+static void check_classify(const gas_classifier_t *clf) {
+  uint32_t checksum = 0;
+  for (size_t s = 0; s < sizeof(samples) / sizeof(samples[0]); s++) {
+    gas_classifier_result_t result;
+    esp_err_t err = gas_classifier_run(clf, samples[s].fingerprint,
+                                       CHECK_STEPS, &result);
+    const char *name = gas_classifier_class_name(clf, result.class_id);
+    printf("Sample %-8s: %s, margin %d\n", samples[s].name,
+           err == ESP_OK ? name : esp_err_to_name(err), result.margin);
+    expect(err == ESP_OK && strcmp(name, samples[s].name) == 0,
+           "sample classified as its class");
+    checksum =
+        esp_rom_crc32_le(checksum, (const uint8_t *)&result, sizeof(result));
+  }
+  printf("Results      : checksum %08" PRIx32 "\n", checksum);
+  expect(checksum == CHECK_RESULTS_CRC, "results match the pinned checksum");
+
+  gas_classifier_benchmark_t bench;
+  expect(gas_classifier_benchmark(clf, CHECK_BENCH_INFERENCES, &bench) ==
+             ESP_OK,
+         "benchmark runs");
+  printf("Benchmark    : checksum %08" PRIx32 "\n", bench.checksum);
+  expect(bench.checksum == CHECK_BENCH_CRC,
+         "benchmark matches the pinned checksum");
+}
+
+static void expect_load(const void *blob, size_t size, esp_err_t want,
+                        const char *what) {
+  gas_classifier_t clf;
+  esp_err_t err = gas_classifier_load(&clf, blob, size);
+  printf("Load %-23s: %s\n", what, esp_err_to_name(err));
+  expect(err == want, what);
+}
+
+static void check_rejects(const uint32_t *good, size_t size) {
+  static uint32_t copy[CHECK_BLOB_MAX / sizeof(uint32_t)];
+  uint8_t *bytes = (uint8_t *)copy;
+  gas_classifier_header_t *header = (gas_classifier_header_t *)copy;
+  size_t layer_at = sizeof(*header) + 2 * CHECK_STEPS * sizeof(int32_t);
+  gas_classifier_layer_t *layer = (gas_classifier_layer_t *)(bytes + layer_at);
+
+  memcpy(copy, good, size);
+  reseal(bytes);
+  expect_load(copy, size, ESP_OK, "resealed copy loads");
+
+  memcpy(copy, good, size);
+  bytes[layer_at + sizeof(*layer)] ^= 0x01; // A weight
+  expect_load(copy, size, ESP_ERR_INVALID_CRC, "corrupt weight");
+
+  memcpy(copy, good, size);
+  layer->inputs++;
+  reseal(bytes);
+  expect_load(copy, size, ESP_ERR_INVALID_SIZE, "layer width mismatch");
+
+  memcpy(copy, good, size);
+  memset(header->class_names[1], 'x', GAS_CLASSIFIER_NAME_LEN);
+  reseal(bytes);
+  expect_load(copy, size, ESP_ERR_INVALID_SIZE, "unterminated class name");
+
+  memcpy(copy, good, size);
+  header->magic ^= 1;
+  expect_load(copy, size, ESP_ERR_INVALID_VERSION, "foreign magic");
+
+  memcpy(copy, good, size);
+  expect_load(copy, size - sizeof(uint32_t), ESP_ERR_INVALID_SIZE,
+              "truncated blob");
+  expect_load(bytes + 2, size, ESP_ERR_INVALID_ARG, "misaligned blob");
+}
+
+int main(int argc, char **argv) {
+  if (argc != 2) {
+    fprintf(stderr, "Usage: %s <gas_model_check.bin>\n", argv[0]);
+    return 2;
+  }
+  static uint32_t blob[CHECK_BLOB_MAX / sizeof(uint32_t)];
+  FILE *f = fopen(argv[1], "rb");
+  if (f == NULL) {
+    perror(argv[1]);
+    return 1;
+  }
+  size_t size = fread(blob, 1, sizeof(blob), f);
+  fclose(f);
+
+  gas_classifier_t clf;
+  esp_err_t err = gas_classifier_load(&clf, blob, size);
+  printf("Model        : %zu bytes, %s\n", size, esp_err_to_name(err));
+  expect(err == ESP_OK, "model loads");
+  if (err == ESP_OK) {
+    check_classify(&clf);
+  }
+  check_rejects(blob, size);
+
+  printf("%s\n",
+         failures == 0 ? "Classifier behaves" : "CLASSIFIER MISBEHAVES");
+  return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,678 @@
+/**
+ * @file gas_model.c
+ * @brief Host tool for the int8 gas classifier
+ *
+ *   gas_model train [-H 16,16] [-e N] [-s SEED] <data.csv> <model.bin>
+ *   gas_model eval <model.bin> <data.csv>
+ *   gas_model bench [-n N] <model.bin>
+ *
+ * train fits a float MLP to labelled fingerprints, quantizes it to int8
+ * with activation ranges calibrated on the same data and writes the model
+ * blob for the gas_model partition. eval runs a blob through the firmware's
+ * classifier code, and bench times it and prints the output checksum that
+ * the firmware logs at boot with CONFIG_GAS_CLASSIFIER_BENCHMARK_AT_BOOT.
+ *
+ * CSV input: label,r1,...,rN with the gas resistance in Ohms at each heater
+ * step. Lines starting with '#' are skipped; classes are numbered in order
+ * of first appearance.
+ */
+
+#include "esp_rom_crc.h"
+#include "gas_classifier.h"
+#include <getopt.h>
+#include <inttypes.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define MODEL_LINE_MAX 512
+#define MODEL_BLOB_MAX 0x10000 // Size of the gas_model partition
+#define TRAIN_RATE 0.003
+#define TRAIN_MOMENTUM 0.9
+#define TRAIN_EPOCHS_DEFAULT 300
+
+typedef struct {
+  char names[GAS_CLASSIFIER_MAX_CLASSES][GAS_CLASSIFIER_NAME_LEN];
+  int classes;
+  int steps;
+  uint32_t *fingerprint; /**< count * steps */
+  uint8_t *label;
+  size_t count;
+  size_t capacity;
+} dataset_t;
+
+/**
+ * @brief Float network; weights[l] is outputs x inputs, row-major
+ */
+typedef struct {
+  int layers;
+  int width[GAS_CLASSIFIER_MAX_LAYERS + 1];
+  double *weights[GAS_CLASSIFIER_MAX_LAYERS];
+  double *bias[GAS_CLASSIFIER_MAX_LAYERS];
+  double *weights_v[GAS_CLASSIFIER_MAX_LAYERS]; /**< Momentum */
+  double *bias_v[GAS_CLASSIFIER_MAX_LAYERS];
+  double mean[GAS_CLASSIFIER_MAX_INPUTS];
+  double std[GAS_CLASSIFIER_MAX_INPUTS];
+} mlp_t;
+
+static int class_index(dataset_t *set, const char *name) {
+  for (int c = 0; c < set->classes; c++) {
+    if (strcmp(set->names[c], name) == 0) {
+      return c;
+    }
+  }
+  if (set->classes == GAS_CLASSIFIER_MAX_CLASSES ||
+      strlen(name) >= GAS_CLASSIFIER_NAME_LEN) {
+    return -1;
+  }
+  strcpy(set->names[set->classes], name);
+  return set->classes++;
+}
+
+static int load_dataset(const char *path, dataset_t *set) {
+  FILE *f = fopen(path, "r");
+  if (f == NULL) {
+    perror(path);
+    return -1;
+  }
+
+  char line[MODEL_LINE_MAX];
+  int lineno = 0;
+  while (fgets(line, sizeof(line), f) != NULL) {
+    lineno++;
+    char *name = strtok(line, ",\r\n");
+    if (name == NULL || name[0] == '#') {
+      continue;
+    }
+
+    uint32_t fp[GAS_CLASSIFIER_MAX_INPUTS];
+    int steps = 0;
+    char *tok;
+    while ((tok = strtok(NULL, ",\r\n")) != NULL &&
+           steps < GAS_CLASSIFIER_MAX_INPUTS) {
+      fp[steps++] = (uint32_t)strtoul(tok, NULL, 10);
+    }
+    int label = class_index(set, name);
+    if (label < 0 || steps == 0 || (set->steps && steps != set->steps)) {
+      fprintf(stderr, "%s:%d: bad record\n", path, lineno);
+      fclose(f);
+      return -1;
+    }
+    set->steps = steps;
+
+    if (set->count == set->capacity) {
+      size_t cap = set->capacity ? set->capacity * 2 : 1024;
+      uint32_t *fps = realloc(set->fingerprint,
+                              cap * GAS_CLASSIFIER_MAX_INPUTS * sizeof(*fps));
+      uint8_t *labels = realloc(set->label, cap);
+      if (fps == NULL || labels == NULL) {
+        free(fps ? fps : set->fingerprint);
+        free(labels ? labels : set->label);
+        fclose(f);
+        return -1;
+      }
+      set->fingerprint = fps;
+      set->label = labels;
+      set->capacity = cap;
+    }
+    memcpy(&set->fingerprint[set->count * GAS_CLASSIFIER_MAX_INPUTS], fp,
+           sizeof(fp));
+    set->label[set->count++] = (uint8_t)label;
+  }
+  fclose(f);
+
+  if (set->count == 0 || set->classes < 2) {
+    fprintf(stderr, "%s: need samples of at least two classes\n", path);
+    return -1;
+  }
+  return 0;
+}
+
+static const uint32_t *sample(const dataset_t *set, size_t i) {
+  return &set->fingerprint[i * GAS_CLASSIFIER_MAX_INPUTS];
+}
+
+/**
+ * @brief Classifier features in log2 units, as the firmware computes them
+ */
+static void features(const dataset_t *set, size_t i, double *x) {
+  int32_t q[GAS_CLASSIFIER_MAX_INPUTS];
+  gas_classifier_features(sample(set, i), (size_t)set->steps, q);
+  for (int k = 0; k < set->steps; k++) {
+    x[k] = q[k] / 65536.0;
+  }
+}
+
+static double uniform(void) { return rand() / (RAND_MAX + 1.0); }
+
+static int mlp_init(mlp_t *net, const dataset_t *set, const int *hidden,
+                    int hidden_layers) {
+  memset(net, 0, sizeof(*net));
+  net->layers = hidden_layers + 1;
+  net->width[0] = set->steps;
+  for (int l = 0; l < hidden_layers; l++) {
+    net->width[l + 1] = hidden[l];
+  }
+  net->width[net->layers] = set->classes;
+
+  for (int l = 0; l < net->layers; l++) {
+    int n = net->width[l] * net->width[l + 1];
+    net->weights[l] = calloc((size_t)n, sizeof(double));
+    net->weights_v[l] = calloc((size_t)n, sizeof(double));
+    net->bias[l] = calloc((size_t)net->width[l + 1], sizeof(double));
+    net->bias_v[l] = calloc((size_t)net->width[l + 1], sizeof(double));
+    if (!net->weights[l] || !net->weights_v[l] || !net->bias[l] ||
+        !net->bias_v[l]) {
+      return -1;
+    }
+    // He initialization for the ReLU layers
+    double range = sqrt(6.0 / net->width[l]);
+    for (int k = 0; k < n; k++) {
+      net->weights[l][k] = (2.0 * uniform() - 1.0) * range;
+    }
+  }
+
+  // Standardize the inputs
+  double x[GAS_CLASSIFIER_MAX_INPUTS];
+  for (size_t i = 0; i < set->count; i++) {
+    features(set, i, x);
+    for (int k = 0; k < set->steps; k++) {
+      net->mean[k] += x[k];
+      net->std[k] += x[k] * x[k];
+    }
+  }
+  for (int k = 0; k < set->steps; k++) {
+    net->mean[k] /= (double)set->count;
+    double var =
+        net->std[k] / (double)set->count - net->mean[k] * net->mean[k];
+    net->std[k] = sqrt(var > 1e-12 ? var : 1e-12);
+  }
+  return 0;
+}
+
+static void mlp_free(mlp_t *net) {
+  for (int l = 0; l < net->layers; l++) {
+    free(net->weights[l]);
+    free(net->weights_v[l]);
+    free(net->bias[l]);
+    free(net->bias_v[l]);
+  }
+}
+
+/**
+ * @brief Forward pass keeping every layer's activations
+ */
+static void mlp_forward(const mlp_t *net, const double *features_in,
+                        double act[][GAS_CLASSIFIER_MAX_WIDTH]) {
+  for (int k = 0; k < net->width[0]; k++) {
+    act[0][k] = (features_in[k] - net->mean[k]) / net->std[k];
+  }
+  for (int l = 0; l < net->layers; l++) {
+    const double *w = net->weights[l];
+    for (int o = 0; o < net->width[l + 1]; o++) {
+      double v = net->bias[l][o];
+      for (int i = 0; i < net->width[l]; i++) {
+        v += w[o * net->width[l] + i] * act[l][i];
+      }
+      act[l + 1][o] = (l < net->layers - 1 && v < 0) ? 0 : v;
+    }
+  }
+}
+
+static int argmax(const double *v, int n) {
+  int best = 0;
+  for (int k = 1; k < n; k++) {
+    if (v[k] > v[best]) {
+      best = k;
+    }
+  }
+  return best;
+}
+
+/**
+ * @brief One epoch of per-sample SGD with momentum on softmax cross-entropy
+ */
+static double mlp_epoch(mlp_t *net, const dataset_t *set, size_t *order) {
+  double act[GAS_CLASSIFIER_MAX_LAYERS + 1][GAS_CLASSIFIER_MAX_WIDTH];
+  double grad[GAS_CLASSIFIER_MAX_LAYERS + 1][GAS_CLASSIFIER_MAX_WIDTH];
+  double x[GAS_CLASSIFIER_MAX_INPUTS];
+  double loss = 0;
+
+  for (size_t n = set->count - 1; n > 0; n--) {
+    size_t j = (size_t)(uniform() * (double)(n + 1));
+    size_t t = order[n];
+    order[n] = order[j];
+    order[j] = t;
+  }
+
+  for (size_t n = 0; n < set->count; n++) {
+    size_t s = order[n];
+    features(set, s, x);
+    mlp_forward(net, x, act);
+
+    int out = net->layers;
+    int classes = net->width[out];
+    double max = act[out][argmax(act[out], classes)];
+    double sum = 0;
+    for (int c = 0; c < classes; c++) {
+      grad[out][c] = exp(act[out][c] - max);
+      sum += grad[out][c];
+    }
+    for (int c = 0; c < classes; c++) {
+      grad[out][c] /= sum;
+    }
+    loss -= log(grad[out][set->label[s]] + 1e-12);
+    grad[out][set->label[s]] -= 1.0;
+
+    for (int l = net->layers - 1; l >= 0; l--) {
+      int in_w = net->width[l];
+      double *w = net->weights[l];
+      double *wv = net->weights_v[l];
+      for (int i = 0; i < in_w; i++) {
+        grad[l][i] = 0;
+      }
+      for (int o = 0; o < net->width[l + 1]; o++) {
+        double g = grad[l + 1][o];
+        for (int i = 0; i < in_w; i++) {
+          grad[l][i] += w[o * in_w + i] * g;
+          double *v = &wv[o * in_w + i];
+          *v = TRAIN_MOMENTUM * *v - TRAIN_RATE * g * act[l][i];
+          w[o * in_w + i] += *v;
+        }
+        net->bias_v[l][o] = TRAIN_MOMENTUM * net->bias_v[l][o] -
+                            TRAIN_RATE * g;
+        net->bias[l][o] += net->bias_v[l][o];
+      }
+      for (int i = 0; i < in_w; i++) {
+        if (act[l][i] <= 0 && l > 0) {
+          grad[l][i] = 0; // ReLU
+        }
+      }
+    }
+  }
+  return loss / (double)set->count;
+}
+
+/**
+ * @brief Split a positive scale into a Q31 multiplier and a right shift
+ */
+static int quantize_multiplier(double scale, int32_t *multiplier,
+                               uint8_t *shift) {
+  int exponent;
+  double mantissa = frexp(scale, &exponent); // scale = mantissa * 2^exponent
+  int64_t m = llround(mantissa * 2147483648.0);
+  if (m == (1ll << 31)) {
+    m >>= 1;
+    exponent++;
+  }
+  if (exponent > 0 || -exponent > 31) {
+    return -1;
+  }
+  *multiplier = (int32_t)m;
+  *shift = (uint8_t)-exponent;
+  return 0;
+}
+
+static int32_t clamp_i32(double v) {
+  if (v > INT32_MAX) {
+    return INT32_MAX;
+  }
+  if (v < INT32_MIN) {
+    return INT32_MIN;
+  }
+  return (int32_t)llround(v);
+}
+
+/**
+ * @brief Quantize the network into a model blob
+ *
+ * Symmetric int8 throughout: weights per layer by their largest magnitude,
+ * activations by the largest magnitude seen on the data.
+ */
+static size_t build_blob(const mlp_t *net, const dataset_t *set,
+                         uint8_t *blob) {
+  double range[GAS_CLASSIFIER_MAX_LAYERS + 1] = {0};
+  double act[GAS_CLASSIFIER_MAX_LAYERS + 1][GAS_CLASSIFIER_MAX_WIDTH];
+  double x[GAS_CLASSIFIER_MAX_INPUTS];
+  for (size_t s = 0; s < set->count; s++) {
+    features(set, s, x);
+    mlp_forward(net, x, act);
+    for (int l = 0; l <= net->layers; l++) {
+      for (int k = 0; k < net->width[l]; k++) {
+        range[l] = fmax(range[l], fabs(act[l][k]));
+      }
+    }
+  }
+  double act_scale[GAS_CLASSIFIER_MAX_LAYERS + 1];
+  for (int l = 0; l <= net->layers; l++) {
+    act_scale[l] = (range[l] > 0 ? range[l] : 1.0) / 127.0;
+  }
+
+  memset(blob, 0, MODEL_BLOB_MAX);
+  gas_classifier_header_t *header = (gas_classifier_header_t *)blob;
+  header->magic = GAS_CLASSIFIER_MAGIC;
+  header->version = GAS_CLASSIFIER_VERSION;
+  header->inputs = (uint8_t)set->steps;
+  header->layers = (uint8_t)net->layers;
+  header->classes = (uint8_t)set->classes;
+  memcpy(header->class_names, set->names, sizeof(header->class_names));
+
+  size_t at = sizeof(*header);
+  int32_t *offset = (int32_t *)(blob + at);
+  at += (size_t)set->steps * sizeof(int32_t);
+  int32_t *scale = (int32_t *)(blob + at);
+  at += (size_t)set->steps * sizeof(int32_t);
+  for (int k = 0; k < set->steps; k++) {
+    offset[k] = clamp_i32(net->mean[k] * 65536.0);
+    scale[k] = clamp_i32(65536.0 / (net->std[k] * act_scale[0]));
+  }
+
+  for (int l = 0; l < net->layers; l++) {
+    int in_w = net->width[l];
+    int out_w = net->width[l + 1];
+    double wmax = 0;
+    for (int k = 0; k < in_w * out_w; k++) {
+      wmax = fmax(wmax, fabs(net->weights[l][k]));
+    }
+    double w_scale = (wmax > 0 ? wmax : 1.0) / 127.0;
+    double acc_scale = act_scale[l] * w_scale;
+
+    gas_classifier_layer_t *layer = (gas_classifier_layer_t *)(blob + at);
+    at += sizeof(*layer);
+    layer->inputs = (uint8_t)in_w;
+    layer->outputs = (uint8_t)out_w;
+    layer->relu = l < net->layers - 1;
+    if (quantize_multiplier(acc_scale / act_scale[l + 1], &layer->multiplier,
+                            &layer->shift) != 0) {
+      fprintf(stderr, "layer %d: scale out of range\n", l);
+      return 0;
+    }
+
+    int8_t *w = (int8_t *)(blob + at);
+    for (int k = 0; k < in_w * out_w; k++) {
+      w[k] = (int8_t)lround(net->weights[l][k] / w_scale);
+    }
+    at += ((size_t)in_w * out_w + 3u) & ~(size_t)3u;
+    int32_t *b = (int32_t *)(blob + at);
+    for (int o = 0; o < out_w; o++) {
+      b[o] = clamp_i32(net->bias[l][o] / acc_scale);
+    }
+    at += (size_t)out_w * sizeof(int32_t);
+  }
+
+  header->size = (uint32_t)(at + sizeof(uint32_t));
+  uint32_t crc = esp_rom_crc32_le(0, blob, (uint32_t)at);
+  memcpy(blob + at, &crc, sizeof(crc));
+  return header->size;
+}
+
+/**
+ * @brief Run the firmware classifier over a data set
+ * @return Share of samples classified correctly
+ */
+static double evaluate(const gas_classifier_t *clf, const dataset_t *set,
+                       const mlp_t *net, uint32_t *checksum) {
+  size_t confusion[GAS_CLASSIFIER_MAX_CLASSES][GAS_CLASSIFIER_MAX_CLASSES] = {
+      {0}};
+  size_t correct = 0;
+  size_t agree = 0;
+  *checksum = 0;
+
+  for (size_t s = 0; s < set->count; s++) {
+    gas_classifier_result_t result;
+    if (gas_classifier_run(clf, sample(set, s), (size_t)set->steps,
+                           &result) != ESP_OK) {
+      continue;
+    }
+    *checksum = esp_rom_crc32_le(*checksum, (const uint8_t *)&result,
+                                 sizeof(result));
+    confusion[set->label[s]][result.class_id]++;
+    correct += result.class_id == set->label[s];
+    if (net != NULL) {
+      double act[GAS_CLASSIFIER_MAX_LAYERS + 1][GAS_CLASSIFIER_MAX_WIDTH];
+      double x[GAS_CLASSIFIER_MAX_INPUTS];
+      features(set, s, x);
+      mlp_forward(net, x, act);
+      agree += argmax(act[net->layers], set->classes) == result.class_id;
+    }
+  }
+
+  printf("%-16s", "true \\ int8");
+  for (int c = 0; c < set->classes; c++) {
+    printf(" %8.8s", set->names[c]);
+  }
+  printf("\n");
+  for (int t = 0; t < set->classes; t++) {
+    printf("%-16s", set->names[t]);
+    for (int c = 0; c < set->classes; c++) {
+      printf(" %8zu", confusion[t][c]);
+    }
+    printf("\n");
+  }
+  if (net != NULL) {
+    printf("Float agreement  : %.2f%%\n", 100.0 * agree / set->count);
+  }
+  return (double)correct / (double)set->count;
+}
+
+static int save_blob(const char *path, const uint8_t *blob, size_t size) {
+  FILE *f = fopen(path, "wb");
+  if (f == NULL || fwrite(blob, 1, size, f) != size) {
+    perror(path);
+    if (f != NULL) {
+      fclose(f);
+    }
+    return -1;
+  }
+  return fclose(f) == 0 ? 0 : -1;
+}
+
+/**
+ * @brief Read a blob into 4-byte aligned memory and load it
+ */
+static int load_blob(const char *path, uint32_t *blob, gas_classifier_t *clf) {
+  FILE *f = fopen(path, "rb");
+  if (f == NULL) {
+    perror(path);
+    return -1;
+  }
+  size_t size = fread(blob, 1, MODEL_BLOB_MAX, f);
+  fclose(f);
+
+  esp_err_t err = gas_classifier_load(clf, blob, size);
+  if (err != ESP_OK) {
+    fprintf(stderr, "%s: invalid model (%s)\n", path, esp_err_to_name(err));
+    return -1;
+  }
+  return 0;
+}
+
+static int parse_hidden(const char *arg, int *hidden) {
+  int n = 0;
+  char buf[64];
+  snprintf(buf, sizeof(buf), "%s", arg);
+  for (char *tok = strtok(buf, ","); tok != NULL; tok = strtok(NULL, ",")) {
+    int w = atoi(tok);
+    if (n == GAS_CLASSIFIER_MAX_LAYERS - 1 || w <= 0 ||
+        w > GAS_CLASSIFIER_MAX_WIDTH) {
+      return -1;
+    }
+    hidden[n++] = w;
+  }
+  return n;
+}
+
+static int cmd_train(int argc, char **argv) {
+  int hidden[GAS_CLASSIFIER_MAX_LAYERS] = {16};
+  int hidden_layers = 1;
+  int epochs = TRAIN_EPOCHS_DEFAULT;
+  unsigned seed = 1;
+
+  int c;
+  while ((c = getopt(argc, argv, "H:e:s:")) != -1) {
+    switch (c) {
+    case 'H':
+      hidden_layers = parse_hidden(optarg, hidden);
+      if (hidden_layers < 0) {
+        return 2;
+      }
+      break;
+    case 'e':
+      epochs = atoi(optarg);
+      break;
+    case 's':
+      seed = (unsigned)strtoul(optarg, NULL, 10);
+      break;
+    default:
+      return 2;
+    }
+  }
+  if (optind != argc - 2) {
+    return 2;
+  }
+
+  dataset_t set = {0};
+  if (load_dataset(argv[optind], &set) != 0) {
+    return 1;
+  }
+  printf("Loaded           : %zu fingerprints, %d steps, %d classes\n",
+         set.count, set.steps, set.classes);
+
+  srand(seed);
+  mlp_t net = {0};
+  size_t *order = malloc(set.count * sizeof(size_t));
+  static uint32_t blob[MODEL_BLOB_MAX / sizeof(uint32_t)];
+  int ret = 1;
+  if (order == NULL || mlp_init(&net, &set, hidden, hidden_layers) != 0) {
+    goto out;
+  }
+  for (size_t s = 0; s < set.count; s++) {
+    order[s] = s;
+  }
+  for (int e = 1; e <= epochs; e++) {
+    double loss = mlp_epoch(&net, &set, order);
+    if (e == epochs || e % 50 == 0) {
+      printf("Epoch %4d       : loss %.4f\n", e, loss);
+    }
+  }
+
+  size_t size = build_blob(&net, &set, (uint8_t *)blob);
+  gas_classifier_t clf;
+  if (size == 0 || gas_classifier_load(&clf, blob, size) != ESP_OK) {
+    fprintf(stderr, "quantized model does not load\n");
+    goto out;
+  }
+  uint32_t checksum;
+  double accuracy = evaluate(&clf, &set, &net, &checksum);
+  printf("Int8 accuracy    : %.2f%% on the training data\n", accuracy * 100);
+  printf("Model            : %zu bytes\n", size);
+  ret = save_blob(argv[optind + 1], (const uint8_t *)blob, size) == 0 ? 0 : 1;
+
+out:
+  mlp_free(&net);
+  free(order);
+  free(set.fingerprint);
+  free(set.label);
+  return ret;
+}
+
+static int cmd_eval(int argc, char **argv) {
+  if (argc != 3) {
+    return 2;
+  }
+  static uint32_t blob[MODEL_BLOB_MAX / sizeof(uint32_t)];
+  gas_classifier_t clf;
+  dataset_t set = {0};
+  if (load_blob(argv[1], blob, &clf) != 0 ||
+      load_dataset(argv[2], &set) != 0) {
+    return 1;
+  }
+
+  int ret = 0;
+  if (set.steps != clf.header->inputs ||
+      set.classes > clf.header->classes) {
+    fprintf(stderr, "data does not match the model\n");
+    ret = 1;
+  } else {
+    // Number the data's classes as the model does
+    uint8_t map[GAS_CLASSIFIER_MAX_CLASSES];
+    for (int c = 0; c < set.classes; c++) {
+      map[c] = 0xff;
+      for (int k = 0; k < clf.header->classes; k++) {
+        if (strcmp(set.names[c], clf.header->class_names[k]) == 0) {
+          map[c] = (uint8_t)k;
+        }
+      }
+      if (map[c] == 0xff) {
+        fprintf(stderr, "class %s is not in the model\n", set.names[c]);
+        ret = 1;
+      }
+    }
+    if (ret == 0) {
+      for (size_t s = 0; s < set.count; s++) {
+        set.label[s] = map[set.label[s]];
+      }
+      memcpy(set.names, clf.header->class_names, sizeof(set.names));
+      set.classes = clf.header->classes;
+      uint32_t checksum;
+      double accuracy = evaluate(&clf, &set, NULL, &checksum);
+      printf("Int8 accuracy    : %.2f%% (%zu fingerprints)\n",
+             accuracy * 100, set.count);
+      printf("Checksum         : %08" PRIx32 "\n", checksum);
+    }
+  }
+  free(set.fingerprint);
+  free(set.label);
+  return ret;
+}
+
+static int cmd_bench(int argc, char **argv) {
+  uint32_t inferences = 200000;
+  int c;
+  while ((c = getopt(argc, argv, "n:")) != -1) {
+    if (c != 'n') {
+      return 2;
+    }
+    inferences = (uint32_t)strtoul(optarg, NULL, 10);
+  }
+  if (optind != argc - 1) {
+    return 2;
+  }
+
+  static uint32_t blob[MODEL_BLOB_MAX / sizeof(uint32_t)];
+  gas_classifier_t clf;
+  gas_classifier_benchmark_t bench;
+  if (load_blob(argv[optind], blob, &clf) != 0 ||
+      gas_classifier_benchmark(&clf, inferences, &bench) != ESP_OK) {
+    return 1;
+  }
+  // The host cycle counter counts nanoseconds
+  printf("Inference        : %.0f ns, %.0f inferences/s (%" PRIu32 " runs)\n",
+         bench.cycles, 1e9 / bench.cycles, bench.inferences);
+  printf("Checksum         : %08" PRIx32 "\n", bench.checksum);
+  return 0;
+}
+
+static void usage(const char *prog) {
+  fprintf(stderr,
+          "Usage: %s train [-H 16,16] [-e N] [-s SEED] <data.csv> <model.bin>\n"
+          "       %s eval <model.bin> <data.csv>\n"
+          "       %s bench [-n N] <model.bin>\n",
+          prog, prog, prog);
+}
+
+int main(int argc, char **argv) {
+  int ret = 2;
+  if (argc >= 2 && strcmp(argv[1], "train") == 0) {
+    ret = cmd_train(argc - 1, argv + 1);
+  } else if (argc >= 2 && strcmp(argv[1], "eval") == 0) {
+    ret = cmd_eval(argc - 1, argv + 1);
+  } else if (argc >= 2 && strcmp(argv[1], "bench") == 0) {
+    ret = cmd_bench(argc - 1, argv + 1);
+  }
+  if (ret == 2) {
+    usage(argv[0]);
+  }
+  return ret;
+}
@@ -0,0 +1,127 @@
+/**
+ * @file iaq_ah_bench.c
+ * @brief Host check of the absolute-humidity tables
+ *
+ * Sweeps the table's temperature range and 0..100 %RH, comparing the float
+ * and fixed-point conversions against the closed-form Magnus relation in
+ * double precision, then times all three.
+ */
+
+#include "iaq_humidity.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#define BENCH_SAMPLES 4096
+#define BENCH_ROUNDS 2000
+// Relative errors are only meaningful above a minimum absolute humidity
+#define REL_ERROR_MIN_AH 0.1
+#define MAX_REL_ERROR 1.5e-3
+
+typedef struct {
+  double max_abs;
+  double max_rel;
+  float worst_t;
+  float worst_rh;
+} ah_error_t;
+
+static uint64_t now_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+static double magnus(double t, double rh) {
+  return 6.112 * exp(17.62 * t / (243.12 + t)) * rh * 2.1674 / (273.15 + t);
+}
+
+static void track(ah_error_t *e, double ref, double val, float t, float rh) {
+  double abs_err = fabs(val - ref);
+  double rel_err = ref > REL_ERROR_MIN_AH ? abs_err / ref : 0.0;
+  if (abs_err > e->max_abs) {
+    e->max_abs = abs_err;
+  }
+  if (rel_err > e->max_rel) {
+    e->max_rel = rel_err;
+    e->worst_t = t;
+    e->worst_rh = rh;
+  }
+}
+
+static void print_error(const char *name, const ah_error_t *e) {
+  printf("%-8s: max abs %.6f g/m3, max rel %.4f%% (at %.2f degC, %.1f %%RH)\n",
+         name, e->max_abs, e->max_rel * 100.0, e->worst_t, e->worst_rh);
+}
+
+int main(void) {
+  ah_error_t err_float = {0};
+  ah_error_t err_q16 = {0};
+
+  for (int ti = IAQ_AH_T_MIN * 100; ti <= IAQ_AH_T_MAX * 100; ti++) {
+    float t = (float)ti / 100.0f;
+    for (int hi = 1; hi <= 200; hi++) {
+      float rh = (float)hi / 2.0f;
+      double ref = magnus(t, rh);
+      track(&err_float, ref, iaq_absolute_humidity(t, rh), t, rh);
+      int32_t q16 = iaq_absolute_humidity_q16(
+          (int32_t)lroundf(t * 65536.0f), (int32_t)lroundf(rh * 65536.0f));
+      track(&err_q16, ref, (double)q16 / 65536.0, t, rh);
+    }
+  }
+  print_error("Table", &err_float);
+  print_error("Q16", &err_q16);
+
+  float temperature[BENCH_SAMPLES];
+  float humidity[BENCH_SAMPLES];
+  int32_t temp_q16[BENCH_SAMPLES];
+  int32_t hum_q16[BENCH_SAMPLES];
+  srand(1);
+  for (int i = 0; i < BENCH_SAMPLES; i++) {
+    temperature[i] = -10.0f + 50.0f * (float)rand() / (float)RAND_MAX;
+    humidity[i] = 100.0f * (float)rand() / (float)RAND_MAX;
+    temp_q16[i] = (int32_t)(temperature[i] * 65536.0f);
+    hum_q16[i] = (int32_t)(humidity[i] * 65536.0f);
+  }
+
+  volatile float sink_f = 0;
+  volatile int32_t sink_q = 0;
+  double samples = (double)BENCH_SAMPLES * BENCH_ROUNDS;
+
+  uint64_t t0 = now_ns();
+  for (int r = 0; r < BENCH_ROUNDS; r++) {
+    float acc = 0;
+    for (int i = 0; i < BENCH_SAMPLES; i++) {
+      acc += iaq_absolute_humidity_magnus(temperature[i], humidity[i]);
+    }
+    sink_f = acc;
+  }
+  uint64_t t1 = now_ns();
+  for (int r = 0; r < BENCH_ROUNDS; r++) {
+    float acc = 0;
+    for (int i = 0; i < BENCH_SAMPLES; i++) {
+      acc += iaq_absolute_humidity(temperature[i], humidity[i]);
+    }
+    sink_f = acc;
+  }
+  uint64_t t2 = now_ns();
+  for (int r = 0; r < BENCH_ROUNDS; r++) {
+    int32_t acc = 0;
+    for (int i = 0; i < BENCH_SAMPLES; i++) {
+      acc += iaq_absolute_humidity_q16(temp_q16[i], hum_q16[i]);
+    }
+    sink_q = acc;
+  }
+  uint64_t t3 = now_ns();
+  (void)sink_f;
+  (void)sink_q;
+
+  printf("Magnus  : %.2f ns/sample\n", (double)(t1 - t0) / samples);
+  printf("Table   : %.2f ns/sample\n", (double)(t2 - t1) / samples);
+  printf("Q16     : %.2f ns/sample\n", (double)(t3 - t2) / samples);
+
+  int ok = err_float.max_rel <= MAX_REL_ERROR &&
+           err_q16.max_rel <= MAX_REL_ERROR;
+  printf("%s\n", ok ? "Within bounds" : "OUT OF BOUNDS");
+  return ok ? 0 : 1;
+}
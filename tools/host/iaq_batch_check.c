@@ -0,0 +1,282 @@
+/**
+ * @file iaq_batch_check.c
+ * @brief Host check that the batch path matches the scalar path
+ *
+ * Feeds the same synthetic readings to two volatile contexts, one sample
+ * at a time through iaq_ctx_calculate() and in blocks of random size
+ * through iaq_ctx_calculate_batch(), and requires bit-identical outputs
+ * for every sample as well as identical published results after every
+ * block. Blocks come with and without timestamps.
+ *
+ * The readings follow a temperature and humidity response the default
+ * compensation does not match, so the learned coefficients keep changing;
+ * the check fails unless some of those changes land in the middle of a
+ * batch chunk, where the batch path has to recompensate the rest of it.
+ * Gas spikes and invalid readings are mixed in as well.
+ *
+ * Usage: iaq_batch_check [samples] [seed]
+ */
+
+#include "esp_log.h"
+#include "iaq_calculator.h"
+#include <inttypes.h>
+#include <math.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define CHECK_SAMPLES_DEFAULT 2000000u
+#define CHECK_BLOCK_MAX 200
+// Batch chunk size in iaq_calculator.c, to classify where changes land
+#define CHECK_CHUNK 32
+// Response of the simulated sensor, unlike TEMP_COMP_COEFF/AH_COMP_COEFF
+#define SIM_TEMP_COEFF 0.007f
+#define SIM_AH_COEFF 0.04f
+
+typedef struct {
+  uint32_t samples;
+  uint32_t blocks;
+  uint32_t untimed_blocks;
+  uint32_t invalid;
+  uint32_t coeff_changes;
+  uint32_t changes_mid_chunk; /**< With later samples in the same chunk */
+  uint32_t mismatches;
+} check_stats_t;
+
+static uint64_t s_rng;
+
+static uint32_t rng_next(void) {
+  s_rng ^= s_rng << 13;
+  s_rng ^= s_rng >> 7;
+  s_rng ^= s_rng << 17;
+  return (uint32_t)(s_rng >> 16);
+}
+
+static float rng_unit(void) {
+  return (float)(rng_next() & 0xffffff) / (float)0x1000000;
+}
+
+static bool same(float a, float b) {
+  return a == b || (isnan(a) && isnan(b));
+}
+
+/**
+ * @brief Simulated reading k; gas 0 marks an invalid one
+ */
+static void simulate(uint32_t k, float *temperature, float *humidity,
+                     float *pressure, float *gas) {
+  float day = (float)k * (6.2831853f / 8640.0f);
+  *temperature = 22.0f + 4.0f * sinf(day) + 0.3f * rng_unit();
+  *humidity = 45.0f + 15.0f * sinf(day * 0.37f + 1.0f) + rng_unit();
+  *pressure = 101000.0f + 300.0f * sinf(day * 0.05f);
+
+  float t_term = 1.0f + SIM_TEMP_COEFF * (*temperature - 25.0f);
+  float ah = *humidity * 0.0723f * expf(0.0636f * (*temperature - 25.0f));
+  float ah_term = 1.0f + SIM_AH_COEFF * (ah - 9.19f);
+  float level = 180000.0f * (1.0f + 0.5f * sinf(day * 0.11f));
+  *gas = level * ah_term / t_term * (0.98f + 0.04f * rng_unit());
+
+  uint32_t event = rng_next() % 1000;
+  if (event < 3) {
+    *gas *= 0.1f; // Spike for the outlier filter and anomaly test
+  } else if (event < 5) {
+    *gas = 0.0f;
+  }
+}
+
+static int compare_results(const char *what, uint32_t k,
+                           const iaq_result_t *a, const iaq_result_t *b) {
+  bool ok = same(a->iaq_score, b->iaq_score) &&
+            a->iaq_level == b->iaq_level && a->accuracy == b->accuracy &&
+            same(a->co2_equivalent, b->co2_equivalent) &&
+            same(a->voc_equivalent, b->voc_equivalent) &&
+            same(a->static_iaq, b->static_iaq) &&
+            same(a->comp_temperature, b->comp_temperature) &&
+            same(a->comp_humidity, b->comp_humidity) &&
+            same(a->gas_baseline, b->gas_baseline) &&
+            a->samples_count == b->samples_count &&
+            a->is_calibrated == b->is_calibrated &&
+            a->outliers_rejected == b->outliers_rejected &&
+            a->gas_outlier == b->gas_outlier &&
+            a->anomalies == b->anomalies &&
+            a->anomaly_flags == b->anomaly_flags;
+  for (int c = 0; ok && c < IAQ_CHANNEL_COUNT; c++) {
+    const iaq_window_stats_t *wa = &a->window[c];
+    const iaq_window_stats_t *wb = &b->window[c];
+    ok = same(a->anomaly_score[c], b->anomaly_score[c]) &&
+         same(wa->mean, wb->mean) && same(wa->std, wb->std) &&
+         same(wa->min, wb->min) && same(wa->max, wb->max) &&
+         wa->count == wb->count;
+  }
+  if (!ok) {
+    fprintf(stderr, "%s differs at sample %" PRIu32 ": IAQ %.9g vs %.9g\n",
+            what, k, a->iaq_score, b->iaq_score);
+  }
+  return ok ? 0 : 1;
+}
+
+int main(int argc, char **argv) {
+  uint32_t samples = CHECK_SAMPLES_DEFAULT;
+  s_rng = 0x9e3779b97f4a7c15ULL;
+  if (argc > 1) {
+    samples = (uint32_t)strtoul(argv[1], NULL, 0);
+  }
+  if (argc > 2) {
+    s_rng ^= strtoull(argv[2], NULL, 0);
+  }
+  // Invalid readings make the scalar path warn on every one
+  esp_log_host_level = ESP_LOG_ERROR;
+
+  iaq_config_t config;
+  iaq_get_default_config(&config);
+  static iaq_ctx_t scalar;
+  static iaq_ctx_t batch;
+  if (iaq_ctx_init(&scalar, &config, NULL) != ESP_OK ||
+      iaq_ctx_init(&batch, &config, NULL) != ESP_OK) {
+    fprintf(stderr, "iaq_ctx_init failed\n");
+    return 1;
+  }
+
+  static float temperature[CHECK_BLOCK_MAX];
+  static float humidity[CHECK_BLOCK_MAX];
+  static float pressure[CHECK_BLOCK_MAX];
+  static float gas[CHECK_BLOCK_MAX];
+  static uint32_t timestamp[CHECK_BLOCK_MAX];
+  static float out_score[CHECK_BLOCK_MAX];
+  static iaq_level_t out_level[CHECK_BLOCK_MAX];
+  static float out_co2[CHECK_BLOCK_MAX];
+  static float out_voc[CHECK_BLOCK_MAX];
+  static float out_baseline[CHECK_BLOCK_MAX];
+  static uint8_t out_anomaly[CHECK_BLOCK_MAX];
+  static iaq_result_t expected[CHECK_BLOCK_MAX];
+  static bool valid[CHECK_BLOCK_MAX];
+
+  const iaq_result_block_t results = {
+      .iaq_score = out_score,
+      .iaq_level = out_level,
+      .co2_equivalent = out_co2,
+      .voc_equivalent = out_voc,
+      .gas_baseline = out_baseline,
+      .anomaly_flags = out_anomaly,
+  };
+
+  check_stats_t stats = {0};
+  iaq_compensation_t comp;
+  iaq_ctx_get_compensation(&scalar, &comp);
+  uint32_t clock_ms = 0;
+  bool last_valid = true;
+  iaq_result_t last_expected;
+  bool published = false;
+
+  for (uint32_t k = 0; k < samples && stats.mismatches < 10;) {
+    uint32_t n = 1 + rng_next() % CHECK_BLOCK_MAX;
+    if (n > samples - k) {
+      n = samples - k;
+    }
+    // Without timestamps the batch path steps from the last valid sample
+    bool untimed = last_valid && (rng_next() & 1);
+    for (uint32_t i = 0; i < n; i++) {
+      simulate(k + i, &temperature[i], &humidity[i], &pressure[i], &gas[i]);
+      uint32_t step = untimed || (rng_next() & 3)
+                          ? IAQ_NOMINAL_INTERVAL_MS
+                          : 1000 + rng_next() % 14000;
+      clock_ms += step;
+      timestamp[i] = clock_ms;
+      valid[i] = gas[i] > 0;
+    }
+
+    for (uint32_t i = 0; i < n; i++) {
+      iaq_raw_data_t raw = {
+          .temperature = temperature[i],
+          .humidity = humidity[i],
+          .pressure = pressure[i],
+          .gas_resistance = gas[i],
+          .gas_valid = valid[i],
+          .timestamp_ms = timestamp[i],
+      };
+      esp_err_t err = iaq_ctx_calculate(&scalar, &raw, &expected[i]);
+      if (err != (valid[i] ? ESP_OK : ESP_ERR_INVALID_ARG)) {
+        fprintf(stderr, "iaq_ctx_calculate: %s\n", esp_err_to_name(err));
+        return 1;
+      }
+      if (!valid[i]) {
+        stats.invalid++;
+        continue;
+      }
+      last_expected = expected[i];
+      published = true;
+
+      iaq_compensation_t now;
+      iaq_ctx_get_compensation(&scalar, &now);
+      if (now.temp_coeff != comp.temp_coeff ||
+          now.ah_coeff != comp.ah_coeff) {
+        stats.coeff_changes++;
+        stats.changes_mid_chunk +=
+            i + 1 < n && i % CHECK_CHUNK != CHECK_CHUNK - 1;
+        comp = now;
+      }
+    }
+
+    const iaq_raw_block_t raw = {
+        .temperature = temperature,
+        .humidity = humidity,
+        .pressure = pressure,
+        .gas_resistance = gas,
+        .timestamp_ms = untimed ? NULL : timestamp,
+    };
+    if (iaq_ctx_calculate_batch(&batch, &raw, &results, n) != ESP_OK) {
+      fprintf(stderr, "iaq_ctx_calculate_batch failed\n");
+      return 1;
+    }
+
+    for (uint32_t i = 0; i < n; i++) {
+      const iaq_result_t *e = &expected[i];
+      bool ok = same(out_score[i], e->iaq_score) &&
+                out_level[i] == e->iaq_level;
+      if (valid[i]) {
+        ok = ok && same(out_co2[i], e->co2_equivalent) &&
+             same(out_voc[i], e->voc_equivalent) &&
+             same(out_baseline[i], e->gas_baseline) &&
+             out_anomaly[i] == e->anomaly_flags;
+      }
+      if (!ok) {
+        fprintf(stderr,
+                "Sample %" PRIu32 " differs: IAQ %.9g vs %.9g, baseline "
+                "%.9g vs %.9g\n",
+                k + i, out_score[i], e->iaq_score, out_baseline[i],
+                e->gas_baseline);
+        stats.mismatches++;
+      }
+    }
+
+    if (published) {
+      iaq_result_t a;
+      iaq_result_t b;
+      iaq_ctx_get_result(&scalar, &a);
+      iaq_ctx_get_result(&batch, &b);
+      stats.mismatches += compare_results("Scalar result", k, &last_expected,
+                                          &a);
+      stats.mismatches += compare_results("Batch result", k, &a, &b);
+    }
+
+    last_valid = valid[n - 1];
+    stats.untimed_blocks += untimed;
+    stats.blocks++;
+    stats.samples += n;
+    k += n;
+  }
+
+  printf("Samples     : %" PRIu32 " in %" PRIu32 " blocks (%" PRIu32
+         " without timestamps), %" PRIu32 " invalid\n",
+         stats.samples, stats.blocks, stats.untimed_blocks, stats.invalid);
+  printf("Coefficients: %" PRIu32 " changes, %" PRIu32
+         " in the middle of a chunk (now %.5f, %.5f)\n",
+         stats.coeff_changes, stats.changes_mid_chunk, comp.temp_coeff,
+         comp.ah_coeff);
+  printf("Mismatches  : %" PRIu32 "\n", stats.mismatches);
+
+  bool ok = stats.mismatches == 0 && stats.changes_mid_chunk > 0;
+  printf("%s\n", ok ? "Batch matches scalar" : "BATCH DIFFERS");
+  return ok ? 0 : 1;
+}
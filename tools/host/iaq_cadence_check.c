@@ -0,0 +1,123 @@
+/**
+ * @file iaq_cadence_check.c
+ * @brief Host check that the baseline keeps its horizons at any read rate
+ *
+ * Calibrates a volatile context on two days of clean air read every 10 s,
+ * then reads polluted air, gas resistance down to 30%, at each of the rate
+ * controller's cadences until the baseline has followed it halfway. That
+ * must take the same time, about a day, whether the pollution is read in
+ * bursts of 1 s, at 10 s or slowly at 30 s; counted in readings instead,
+ * bursts would hand the room's pollution to the baseline ten times sooner.
+ * An hour of readings must also add an hour's worth of baseline steps.
+ *
+ * Usage: iaq_cadence_check
+ */
+
+#include "esp_log.h"
+#include "iaq_calculator.h"
+#include <inttypes.h>
+#include <math.h>
+#include <stdbool.h>
+#include <stdio.h>
+
+#define CLEAN_GAS 200000.0f
+#define POLLUTED_GAS 60000.0f
+#define CLEAN_HOURS 48
+// Longest wait for the baseline to follow before giving up
+#define POLLUTED_HOURS_MAX 200
+// Spread allowed between cadences in the time the baseline takes
+#define CADENCE_TOLERANCE 0.1
+
+static const uint32_t cadence_ms[] = {1000, IAQ_NOMINAL_INTERVAL_MS, 30000};
+#define CADENCES (sizeof(cadence_ms) / sizeof(cadence_ms[0]))
+
+static uint32_t s_rng = 1;
+
+/**
+ * @brief Gas around level, with a few percent of noise
+ */
+static float noisy(float level) {
+  s_rng = s_rng * 1103515245u + 12345u;
+  return level * (0.97f + 0.06f * (float)(s_rng >> 16) / 65536.0f);
+}
+
+static iaq_result_t read_gas(iaq_ctx_t *ctx, uint32_t now_ms, float gas) {
+  iaq_raw_data_t raw = {
+      .temperature = 22.0f,
+      .humidity = 45.0f,
+      .pressure = 101000.0f,
+      .gas_resistance = noisy(gas),
+      .gas_valid = true,
+      .timestamp_ms = now_ms,
+  };
+  iaq_result_t result;
+  iaq_ctx_calculate(ctx, &raw, &result);
+  return result;
+}
+
+/**
+ * @brief Hours of polluted air read at interval_ms until the baseline
+ *        halves, and the baseline steps the first hour of it added
+ */
+static double hours_to_follow(uint32_t interval_ms, uint32_t *hour_steps) {
+  iaq_config_t config;
+  iaq_get_default_config(&config);
+  static iaq_ctx_t ctx;
+  iaq_ctx_init(&ctx, &config, NULL);
+  s_rng = 1;
+
+  uint32_t now_ms = 0;
+  iaq_result_t r = {0};
+  for (uint32_t t = 0; t < CLEAN_HOURS * 3600u; t += 10) {
+    now_ms += IAQ_NOMINAL_INTERVAL_MS;
+    r = read_gas(&ctx, now_ms, CLEAN_GAS);
+  }
+  float clean = r.gas_baseline;
+  uint32_t start_ms = now_ms;
+  uint32_t start_steps = r.samples_count;
+  *hour_steps = 0;
+
+  while (r.gas_baseline > 0.5f * clean &&
+         now_ms - start_ms < POLLUTED_HOURS_MAX * 3600000u) {
+    now_ms += interval_ms;
+    r = read_gas(&ctx, now_ms, POLLUTED_GAS);
+    if (*hour_steps == 0 && now_ms - start_ms >= 3600000u) {
+      *hour_steps = r.samples_count - start_steps;
+    }
+  }
+  return (double)(now_ms - start_ms) / 3.6e6;
+}
+
+int main(void) {
+  esp_log_host_level = ESP_LOG_ERROR;
+  int failures = 0;
+  double hours[CADENCES];
+  uint32_t nominal = 0;
+
+  for (size_t i = 0; i < CADENCES; i++) {
+    uint32_t steps;
+    hours[i] = hours_to_follow(cadence_ms[i], &steps);
+    printf("Read every %5" PRIu32 " ms: baseline halved after %.1f h, "
+           "%" PRIu32 " steps in the first hour\n",
+           cadence_ms[i], hours[i], steps);
+    if (steps < 355 || steps > 365) {
+      fprintf(stderr, "FAILED: an hour is not 360 steps\n");
+      failures++;
+    }
+    if (cadence_ms[i] == IAQ_NOMINAL_INTERVAL_MS) {
+      nominal = (uint32_t)i;
+    }
+  }
+
+  for (size_t i = 0; i < CADENCES; i++) {
+    if (hours[i] >= POLLUTED_HOURS_MAX ||
+        fabs(hours[i] / hours[nominal] - 1.0) > CADENCE_TOLERANCE) {
+      fprintf(stderr, "FAILED: %" PRIu32 " ms cadence changes the horizon\n",
+              cadence_ms[i]);
+      failures++;
+    }
+  }
+
+  printf("%s\n", failures == 0 ? "Horizons hold" : "HORIZONS FOLLOW CADENCE");
+  return failures == 0 ? 0 : 1;
+}
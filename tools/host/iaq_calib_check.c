@@ -0,0 +1,156 @@
+/**
+ * @file iaq_calib_check.c
+ * @brief Host check of calibration record import between devices
+ *
+ * Calibrates one volatile context on clean air and exports its record,
+ * then imports it into fresh contexts. A fresh record must resume close to
+ * the end of burn-in; records saved days ago, or without a clock, must
+ * resume further back by the same age credit as restored state, and one
+ * too old to beat the progress a context has made itself must be refused.
+ * The exporting device's own record, a calibrated context and a corrupt
+ * record must be refused as well.
+ *
+ * Usage: iaq_calib_check
+ */
+
+#include "esp_log.h"
+#include "esp_rom_crc.h"
+#include "iaq_calculator.h"
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#define CLEAN_GAS 200000.0f
+#define DAY_S (24 * 3600)
+
+static const uint8_t source_id[IAQ_CALIB_SENSOR_ID_LEN] = {1, 2, 3, 4, 5, 6};
+static const uint8_t device_id[IAQ_CALIB_SENSOR_ID_LEN] = {6, 5, 4, 3, 2, 1};
+
+static int failures;
+
+static void expect(bool ok, const char *what) {
+  if (!ok) {
+    fprintf(stderr, "FAILED: %s\n", what);
+    failures++;
+  }
+}
+
+static void read_clean(iaq_ctx_t *ctx, uint32_t readings) {
+  static uint32_t now_ms;
+  for (uint32_t i = 0; i < readings; i++) {
+    now_ms += IAQ_NOMINAL_INTERVAL_MS;
+    iaq_raw_data_t raw = {
+        .temperature = 22.0f,
+        .humidity = 45.0f,
+        .pressure = 101000.0f,
+        .gas_resistance = CLEAN_GAS,
+        .gas_valid = true,
+        .timestamp_ms = now_ms,
+    };
+    iaq_result_t result;
+    iaq_ctx_calculate(ctx, &raw, &result);
+  }
+}
+
+/**
+ * @brief A copy of record saved age_s earlier, or without a clock for 0
+ */
+static iaq_calib_record_t aged(const iaq_calib_record_t *record,
+                               uint32_t age_s) {
+  iaq_calib_record_t copy = *record;
+  copy.saved_at = age_s ? (uint32_t)time(NULL) - age_s : 0;
+  copy.crc = esp_rom_crc32_le(0, (const uint8_t *)&copy,
+                              offsetof(iaq_calib_record_t, crc));
+  return copy;
+}
+
+/**
+ * @brief Import into a fresh context
+ * @return Calibration progress afterwards, in percent
+ */
+static uint8_t import_fresh(const iaq_calib_record_t *record,
+                            esp_err_t *err) {
+  static iaq_ctx_t ctx;
+  iaq_config_t config;
+  iaq_get_default_config(&config);
+  iaq_ctx_init(&ctx, &config, NULL);
+  *err = iaq_ctx_import_calibration(&ctx, device_id, record, sizeof(*record));
+  return iaq_ctx_get_calibration_progress(&ctx);
+}
+
+int main(void) {
+  esp_log_host_level = ESP_LOG_ERROR;
+
+  static iaq_ctx_t source;
+  iaq_config_t config;
+  iaq_get_default_config(&config);
+  iaq_ctx_init(&source, &config, NULL);
+  read_clean(&source, config.burn_in_samples + 10);
+  iaq_calib_record_t record;
+  expect(iaq_ctx_export_calibration(&source, source_id, &record) == ESP_OK,
+         "calibrated context exports");
+  expect(record.saved_at != 0, "record stamped with the clock");
+
+  // Import progress by age; the default grace is two hours
+  static const struct {
+    const char *name;
+    uint32_t age_s;
+    uint8_t min_progress;
+    uint8_t max_progress;
+  } ages[] = {
+      {"just saved", 1, 85, 90},
+      {"an hour old", 3600, 85, 90},
+      {"no clock", 0, 45, 65},
+      {"a day old", DAY_S, 25, 40},
+      {"three days old", 3 * DAY_S, 1, 10},
+  };
+  uint8_t last = 100;
+  for (size_t i = 0; i < sizeof(ages) / sizeof(ages[0]); i++) {
+    iaq_calib_record_t copy = aged(&record, ages[i].age_s);
+    esp_err_t err;
+    uint8_t progress = import_fresh(&copy, &err);
+    printf("Record %-14s: %s, resumes at %u%% of burn-in\n", ages[i].name,
+           esp_err_to_name(err), progress);
+    expect(err == ESP_OK, "record imported");
+    expect(progress >= ages[i].min_progress &&
+               progress <= ages[i].max_progress,
+           "progress follows the record's age");
+    if (ages[i].age_s != 0) {
+      expect(progress <= last, "older records resume further back");
+      last = progress;
+    }
+  }
+
+  esp_err_t err;
+  iaq_calib_record_t stale = aged(&record, 30 * DAY_S);
+  import_fresh(&stale, &err);
+  expect(err == ESP_ERR_INVALID_STATE, "a month-old record refused");
+
+  // A context that got this far itself keeps its own progress
+  static iaq_ctx_t partial;
+  iaq_ctx_init(&partial, &config, NULL);
+  read_clean(&partial, config.burn_in_samples / 2);
+  iaq_calib_record_t day_old = aged(&record, DAY_S);
+  expect(iaq_ctx_import_calibration(&partial, device_id, &day_old,
+                                    sizeof(day_old)) == ESP_ERR_INVALID_STATE,
+         "record worth less than own progress refused");
+
+  expect(iaq_ctx_import_calibration(&partial, source_id, &record,
+                                    sizeof(record)) == ESP_ERR_INVALID_STATE,
+         "own record refused");
+  expect(iaq_ctx_import_calibration(&source, device_id, &record,
+                                    sizeof(record)) == ESP_ERR_INVALID_STATE,
+         "calibrated context refuses");
+  iaq_calib_record_t corrupt = record;
+  corrupt.gas_baseline *= 2.0f;
+  import_fresh(&corrupt, &err);
+  expect(err == ESP_ERR_INVALID_CRC, "corrupt record refused");
+  import_fresh(&record, &err);
+  expect(err == ESP_OK, "record intact after the checks");
+
+  printf("%s\n", failures == 0 ? "Imports behave" : "IMPORTS MISBEHAVE");
+  return failures == 0 ? 0 : 1;
+}
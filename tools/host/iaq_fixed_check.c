@@ -0,0 +1,102 @@
+/**
+ * @file iaq_fixed_check.c
+ * @brief Host check of the fixed-point pipeline against the float one
+ *
+ * Sweeps gas resistance, temperature, humidity and baseline over a grid
+ * covering the range the IAQ_FIXED_MAX_* bounds are stated for: gas from
+ * 500 Ohms, humidity from 1 %RH, the whole temperature range of the
+ * absolute-humidity table and baselines from 2 kOhms to 2 MOhms. Steps are
+ * chosen so the points fall between the Q-format grid lines rather than on
+ * them. One more sample is the hot, humid reading against a low baseline
+ * that broke the VOC bound while the pipeline carried fewer fraction bits.
+ * Every sample's IAQ, CO2 and VOC must stay within the bounds of the float
+ * pipeline's.
+ *
+ * Usage: iaq_fixed_check
+ */
+
+#include "iaq_calculator.h"
+#include "iaq_fixed.h"
+#include "iaq_humidity.h"
+#include <math.h>
+#include <stdbool.h>
+#include <stdio.h>
+
+#define GAS_MIN 500.0f
+#define GAS_MAX 5e6f
+#define GAS_STEPS 120
+#define BASELINE_MIN 2000.0f
+#define BASELINE_MAX 2e6f
+#define BASELINE_STEPS 16
+#define TEMP_STEP 0.53f
+#define HUMIDITY_MIN 1.0f
+#define HUMIDITY_STEP 2.9f
+
+typedef struct {
+  float error;
+  float gas;
+  float temperature;
+  float humidity;
+  float baseline;
+} worst_t;
+
+static float log_step(float min, float max, int i, int steps) {
+  return min * powf(max / min, (float)i / (float)steps);
+}
+
+static worst_t s_iaq;
+static worst_t s_co2;
+static worst_t s_voc;
+static unsigned s_samples;
+
+static void track(worst_t *w, float error, float gas, float temperature,
+                  float humidity, float baseline) {
+  if (error > w->error) {
+    *w = (worst_t){error, gas, temperature, humidity, baseline};
+  }
+}
+
+static void check_sample(float gas, float t, float rh, float baseline) {
+  iaq_pipeline_out_t ref;
+  iaq_pipeline_out_t out;
+  iaq_pipeline_float(gas, t, rh, baseline, &ref);
+  iaq_pipeline_fixed(gas, t, rh, baseline, &out);
+  track(&s_iaq, fabsf(ref.iaq_score - out.iaq_score), gas, t, rh, baseline);
+  track(&s_co2, fabsf(ref.co2_equivalent - out.co2_equivalent), gas, t, rh,
+        baseline);
+  track(&s_voc, fabsf(ref.voc_equivalent - out.voc_equivalent), gas, t, rh,
+        baseline);
+  s_samples++;
+}
+
+static bool report(const char *name, const worst_t *w, float bound) {
+  bool ok = w->error <= bound;
+  printf("%-4s: max error %.6f of %.6f at %.1f Ohms, %.2f degC, %.1f %%RH, "
+         "baseline %.0f Ohms%s\n",
+         name, w->error, bound, w->gas, w->temperature, w->humidity,
+         w->baseline, ok ? "" : " - OUT OF BOUNDS");
+  return ok;
+}
+
+int main(void) {
+  check_sample(1017.4f, 46.1f, 82.1f, 2000.0f);
+  for (int b = 0; b <= BASELINE_STEPS; b++) {
+    float baseline = log_step(BASELINE_MIN, BASELINE_MAX, b, BASELINE_STEPS);
+    for (int g = 0; g <= GAS_STEPS; g++) {
+      float gas = log_step(GAS_MIN, GAS_MAX, g, GAS_STEPS);
+      for (float t = (float)IAQ_AH_T_MIN; t <= (float)IAQ_AH_T_MAX;
+           t += TEMP_STEP) {
+        for (float rh = HUMIDITY_MIN; rh <= 100.0f; rh += HUMIDITY_STEP) {
+          check_sample(gas, t, rh, baseline);
+        }
+      }
+    }
+  }
+
+  printf("Samples: %u\n", s_samples);
+  bool ok = report("IAQ", &s_iaq, IAQ_FIXED_MAX_IAQ_ERROR);
+  ok &= report("CO2", &s_co2, IAQ_FIXED_MAX_CO2_ERROR);
+  ok &= report("VOC", &s_voc, IAQ_FIXED_MAX_VOC_ERROR);
+  printf("%s\n", ok ? "Within bounds" : "OUT OF BOUNDS");
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,688 @@
+/**
+ * @file iaq_replay.c
+ * @brief Host replay benchmark for the IAQ calculator
+ *
+ * Replays recorded sensor logs through iaq_calculate() as fast as possible
+ * and reports throughput, per-sample latency and the IAQ trajectory. With -F
+ * it instead checks the fixed-point pipeline against the float one on every
+ * sample, at the baseline the calculator had at that point. With -E it runs
+ * the IAQ engines from iaq_engine.h side by side and compares their cost
+ * and scores.
+ *
+ * CSV input: timestamp_s,temperature,humidity,pressure,gas_resistance[,valid]
+ * Lines that do not start with a number are skipped. Binary input (see
+ * replay_bin_header_t) is detected by its magic and is much faster to load.
+ */
+
+#include "esp_log.h"
+#include "iaq_calculator.h"
+#include "iaq_eval.h"
+#include "iaq_fixed.h"
+#include <getopt.h>
+#include <inttypes.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define REPLAY_BIN_MAGIC "IAQR"
+#define REPLAY_BIN_VERSION 1
+#define REPLAY_BATCH_SIZE 4096
+#define REPLAY_LINE_MAX 256
+// Forecasts below this confidence are not counted as warnings
+#define REPLAY_FORECAST_MIN_CONFIDENCE 0.5f
+
+/**
+ * @brief Binary log header, followed by count replay_bin_record_t
+ */
+typedef struct {
+  char magic[4];
+  uint32_t version;
+  uint32_t count;
+  uint32_t reserved;
+} replay_bin_header_t;
+
+/**
+ * @brief Binary log record; gas_resistance <= 0 marks an invalid reading
+ */
+typedef struct {
+  uint32_t timestamp;
+  float temperature;
+  float humidity;
+  float pressure;
+  float gas_resistance;
+} replay_bin_record_t;
+
+typedef struct {
+  uint32_t *timestamp;
+  float *temperature;
+  float *humidity;
+  float *pressure;
+  float *gas_resistance;
+  size_t count;
+  size_t capacity;
+} replay_log_t;
+
+typedef struct {
+  const char *input;
+  const char *convert_path;
+  const char *trajectory_path;
+  uint32_t decimation;
+  uint32_t repeat;
+  bool batch;
+  bool fixed_check;
+  bool engine_eval;
+  iaq_config_t config;
+} replay_options_t;
+
+static uint64_t now_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+static int log_reserve(replay_log_t *log, size_t capacity) {
+  if (capacity <= log->capacity) {
+    return 0;
+  }
+  uint32_t *ts = realloc(log->timestamp, capacity * sizeof(uint32_t));
+  if (ts == NULL) {
+    return -1;
+  }
+  log->timestamp = ts;
+
+  float **columns[] = {&log->temperature, &log->humidity, &log->pressure,
+                       &log->gas_resistance};
+  for (size_t i = 0; i < sizeof(columns) / sizeof(columns[0]); i++) {
+    float *col = realloc(*columns[i], capacity * sizeof(float));
+    if (col == NULL) {
+      return -1;
+    }
+    *columns[i] = col;
+  }
+  log->capacity = capacity;
+  return 0;
+}
+
+static void log_free(replay_log_t *log) {
+  free(log->timestamp);
+  free(log->temperature);
+  free(log->humidity);
+  free(log->pressure);
+  free(log->gas_resistance);
+  memset(log, 0, sizeof(*log));
+}
+
+static int load_binary(FILE *f, replay_log_t *log) {
+  replay_bin_header_t header;
+  if (fread(&header, sizeof(header), 1, f) != 1 ||
+      header.version != REPLAY_BIN_VERSION) {
+    fprintf(stderr, "Unsupported binary log version\n");
+    return -1;
+  }
+  if (log_reserve(log, header.count ? header.count : 1) != 0) {
+    return -1;
+  }
+
+  replay_bin_record_t rec;
+  while (log->count < header.count && fread(&rec, sizeof(rec), 1, f) == 1) {
+    size_t i = log->count++;
+    log->timestamp[i] = rec.timestamp;
+    log->temperature[i] = rec.temperature;
+    log->humidity[i] = rec.humidity;
+    log->pressure[i] = rec.pressure;
+    log->gas_resistance[i] = rec.gas_resistance;
+  }
+  return 0;
+}
+
+static int load_csv(FILE *f, replay_log_t *log) {
+  char line[REPLAY_LINE_MAX];
+
+  while (fgets(line, sizeof(line), f) != NULL) {
+    if (!((line[0] >= '0' && line[0] <= '9') || line[0] == '-' ||
+          line[0] == '.')) {
+      continue;
+    }
+
+    double ts;
+    float t, h, p, g;
+    int valid = 1;
+    int n = sscanf(line, "%lf,%f,%f,%f,%f,%d", &ts, &t, &h, &p, &g, &valid);
+    if (n < 5) {
+      continue;
+    }
+
+    if (log->count == log->capacity &&
+        log_reserve(log, log->capacity ? log->capacity * 2 : 65536) != 0) {
+      return -1;
+    }
+    size_t i = log->count++;
+    log->timestamp[i] = (uint32_t)ts;
+    log->temperature[i] = t;
+    log->humidity[i] = h;
+    log->pressure[i] = p;
+    log->gas_resistance[i] = valid ? g : 0.0f;
+  }
+  return 0;
+}
+
+static int load_log(const char *path, replay_log_t *log) {
+  FILE *f = fopen(path, "rb");
+  if (f == NULL) {
+    perror(path);
+    return -1;
+  }
+
+  char magic[4] = {0};
+  size_t n = fread(magic, 1, sizeof(magic), f);
+  rewind(f);
+
+  int ret = (n == sizeof(magic) && memcmp(magic, REPLAY_BIN_MAGIC, 4) == 0)
+                ? load_binary(f, log)
+                : load_csv(f, log);
+  fclose(f);
+  return ret;
+}
+
+static int save_binary(const char *path, const replay_log_t *log) {
+  FILE *f = fopen(path, "wb");
+  if (f == NULL) {
+    perror(path);
+    return -1;
+  }
+
+  replay_bin_header_t header = {.version = REPLAY_BIN_VERSION,
+                                .count = (uint32_t)log->count};
+  memcpy(header.magic, REPLAY_BIN_MAGIC, 4);
+  fwrite(&header, sizeof(header), 1, f);
+
+  for (size_t i = 0; i < log->count; i++) {
+    replay_bin_record_t rec = {.timestamp = log->timestamp[i],
+                               .temperature = log->temperature[i],
+                               .humidity = log->humidity[i],
+                               .pressure = log->pressure[i],
+                               .gas_resistance = log->gas_resistance[i]};
+    fwrite(&rec, sizeof(rec), 1, f);
+  }
+
+  int ret = ferror(f) ? -1 : 0;
+  fclose(f);
+  return ret;
+}
+
+static iaq_raw_data_t raw_at(const replay_log_t *log, size_t i) {
+  return (iaq_raw_data_t){.temperature = log->temperature[i],
+                          .humidity = log->humidity[i],
+                          .pressure = log->pressure[i],
+                          .gas_resistance = log->gas_resistance[i],
+                          .gas_valid = log->gas_resistance[i] > 0,
+                          .timestamp_ms = log->timestamp[i] * 1000u};
+}
+
+/**
+ * @brief Untimed-per-sample pass measuring raw throughput
+ */
+static double run_throughput(const replay_log_t *log,
+                             const replay_options_t *opt) {
+  float *score = NULL;
+  if (opt->batch) {
+    score = malloc(REPLAY_BATCH_SIZE * sizeof(float));
+    if (score == NULL) {
+      return 0;
+    }
+  }
+
+  uint64_t start = now_ns();
+  for (uint32_t r = 0; r < opt->repeat; r++) {
+    iaq_reset();
+    if (opt->batch) {
+      for (size_t s = 0; s < log->count; s += REPLAY_BATCH_SIZE) {
+        size_t n = log->count - s;
+        if (n > REPLAY_BATCH_SIZE) {
+          n = REPLAY_BATCH_SIZE;
+        }
+        iaq_raw_block_t raw = {.temperature = &log->temperature[s],
+                               .humidity = &log->humidity[s],
+                               .pressure = &log->pressure[s],
+                               .gas_resistance = &log->gas_resistance[s]};
+        iaq_result_block_t out = {.iaq_score = score};
+        iaq_calculate_batch(&raw, &out, n);
+      }
+    } else {
+      for (size_t i = 0; i < log->count; i++) {
+        iaq_raw_data_t raw = raw_at(log, i);
+        iaq_result_t result;
+        iaq_calculate(&raw, &result);
+      }
+    }
+  }
+  uint64_t elapsed = now_ns() - start;
+  free(score);
+
+  return elapsed ? (double)log->count * opt->repeat * 1e9 / (double)elapsed
+                 : 0;
+}
+
+static int cmp_u32(const void *a, const void *b) {
+  uint32_t x = *(const uint32_t *)a;
+  uint32_t y = *(const uint32_t *)b;
+  return (x > y) - (x < y);
+}
+
+static uint32_t percentile(const uint32_t *sorted, size_t n, double p) {
+  if (n == 0) {
+    return 0;
+  }
+  size_t idx = (size_t)(p * (double)(n - 1) + 0.5);
+  return sorted[idx];
+}
+
+/**
+ * @brief Per-sample timed pass collecting latency and trajectory statistics
+ */
+static int run_trajectory(const replay_log_t *log,
+                          const replay_options_t *opt) {
+  uint32_t *latency = malloc(log->count * sizeof(uint32_t));
+  if (latency == NULL) {
+    return -1;
+  }
+
+  FILE *traj = NULL;
+  if (opt->trajectory_path != NULL) {
+    traj = fopen(opt->trajectory_path, "w");
+    if (traj == NULL) {
+      perror(opt->trajectory_path);
+      free(latency);
+      return -1;
+    }
+    fprintf(traj, "index,timestamp,iaq,level,accuracy,baseline,co2,voc,"
+                  "iaq_slope,time_to_moderate\n");
+  }
+
+  size_t timed = 0;
+  size_t invalid = 0;
+  size_t level_count[IAQ_LEVEL_UNKNOWN + 1] = {0};
+  size_t anomaly_count[IAQ_CHANNEL_COUNT] = {0};
+  long high_accuracy_at = -1;
+  double iaq_sum = 0;
+  iaq_result_t result = {0};
+  iaq_level_t prev_level = IAQ_LEVEL_UNKNOWN;
+  long forecast_since = -1;
+  size_t onsets = 0;
+  size_t forecast_onsets = 0;
+  double lead_sum = 0;
+
+  iaq_reset();
+  for (size_t i = 0; i < log->count; i++) {
+    iaq_raw_data_t raw = raw_at(log, i);
+
+    uint64_t t0 = now_ns();
+    esp_err_t ret = iaq_calculate(&raw, &result);
+    uint64_t t1 = now_ns();
+
+    if (ret != ESP_OK) {
+      invalid++;
+      continue;
+    }
+    latency[timed++] = (uint32_t)(t1 - t0);
+    level_count[result.iaq_level]++;
+    iaq_sum += result.iaq_score;
+    for (int c = 0; c < IAQ_CHANNEL_COUNT; c++) {
+      anomaly_count[c] += (result.anomaly_flags >> c) & 1u;
+    }
+    if (high_accuracy_at < 0 && result.accuracy == IAQ_ACCURACY_HIGH) {
+      high_accuracy_at = (long)i;
+    }
+
+    // How far ahead the trend saw each rise into moderate pollution coming
+    iaq_trend_t trend;
+    iaq_get_trend(&trend);
+    bool moderate = result.iaq_level >= IAQ_LEVEL_MODERATELY_POLLUTED;
+    if (result.is_calibrated && moderate &&
+        prev_level < IAQ_LEVEL_MODERATELY_POLLUTED) {
+      onsets++;
+      if (forecast_since >= 0) {
+        forecast_onsets++;
+        lead_sum += log->timestamp[i] - log->timestamp[forecast_since];
+      }
+    }
+    bool forecast = trend.valid && trend.time_to_moderate_s > 0 &&
+                    trend.iaq_confidence >= REPLAY_FORECAST_MIN_CONFIDENCE;
+    if (!forecast || moderate) {
+      forecast_since = -1;
+    } else if (forecast_since < 0) {
+      forecast_since = (long)i;
+    }
+    prev_level = result.iaq_level;
+
+    if (traj != NULL && (i % opt->decimation) == 0) {
+      fprintf(traj, "%zu,%" PRIu32 ",%.2f,%d,%d,%.0f,%.0f,%.3f,%.2f,%.0f\n",
+              i, log->timestamp[i], result.iaq_score, (int)result.iaq_level,
+              (int)result.accuracy, result.gas_baseline,
+              result.co2_equivalent, result.voc_equivalent,
+              trend.iaq_slope, trend.time_to_moderate_s);
+    }
+  }
+
+  if (traj != NULL) {
+    fclose(traj);
+  }
+
+  qsort(latency, timed, sizeof(uint32_t), cmp_u32);
+  printf("Latency (ns)     : p50 %" PRIu32 "  p90 %" PRIu32 "  p99 %" PRIu32
+         "  p99.9 %" PRIu32 "  max %" PRIu32 "\n",
+         percentile(latency, timed, 0.50), percentile(latency, timed, 0.90),
+         percentile(latency, timed, 0.99), percentile(latency, timed, 0.999),
+         timed ? latency[timed - 1] : 0);
+  free(latency);
+
+  printf("Invalid samples  : %zu\n", invalid);
+  if (high_accuracy_at >= 0) {
+    printf("High accuracy at : sample %ld (+%" PRIu32 " s)\n", high_accuracy_at,
+           log->timestamp[high_accuracy_at] - log->timestamp[0]);
+  } else {
+    printf("High accuracy at : never\n");
+  }
+  printf("Moderate onsets  : %zu, %zu forecast", onsets, forecast_onsets);
+  if (forecast_onsets) {
+    printf(" (mean lead %.0f s)", lead_sum / (double)forecast_onsets);
+  }
+  printf("\n");
+  printf("Outliers         : %" PRIu32 " gas readings replaced\n",
+         result.outliers_rejected);
+  printf("Anomalies        : %" PRIu32 " readings (T %zu, H %zu, P %zu, "
+         "gas %zu)\n",
+         result.anomalies, anomaly_count[IAQ_CHANNEL_TEMPERATURE],
+         anomaly_count[IAQ_CHANNEL_HUMIDITY],
+         anomaly_count[IAQ_CHANNEL_PRESSURE], anomaly_count[IAQ_CHANNEL_GAS]);
+  const iaq_window_stats_t *gas_window = &result.window[IAQ_CHANNEL_GAS];
+  printf("Gas window       : %.0f +- %.0f Ohms (%.0f to %.0f, %" PRIu32
+         " samples over %.0f s)\n",
+         gas_window->mean, gas_window->std, gas_window->min, gas_window->max,
+         gas_window->count, gas_window->covered_ms / 1000.0);
+  iaq_baselines_t baselines;
+  if (iaq_get_baselines(&baselines) == ESP_OK) {
+    printf("Env. changes     : %" PRIu32 " (short %.0f, long %.0f Ohms)\n",
+           baselines.changes, baselines.short_baseline,
+           baselines.long_baseline);
+  }
+  iaq_compensation_t comp;
+  if (iaq_get_compensation(&comp) == ESP_OK) {
+    printf("Compensation     : %.5f /degC, %.4f per g/m3 (%s, %" PRIu32
+           " stable samples)\n",
+           comp.temp_coeff, comp.ah_coeff,
+           comp.learned ? "learned" : "defaults", comp.updates);
+  }
+  printf("Final baseline   : %.0f Ohms\n", result.gas_baseline);
+  printf("Mean IAQ         : %.1f\n", timed ? iaq_sum / (double)timed : 0.0);
+  printf("IAQ levels       :");
+  for (int l = IAQ_LEVEL_EXCELLENT; l < IAQ_LEVEL_UNKNOWN; l++) {
+    if (level_count[l]) {
+      printf("  %s %.1f%%", iaq_level_to_string((iaq_level_t)l),
+             100.0 * (double)level_count[l] / (double)timed);
+    }
+  }
+  printf("\n");
+  return 0;
+}
+
+/**
+ * @brief Compare the fixed-point and float pipelines over the whole log
+ * @return 0 if every sample is within the IAQ_FIXED_MAX_* bounds
+ */
+static int run_fixed_check(const replay_log_t *log) {
+  float max_err[3] = {0};
+  size_t worst[3] = {0};
+  size_t checked = 0;
+  iaq_result_t result = {0};
+
+  iaq_reset();
+  for (size_t i = 0; i < log->count; i++) {
+    iaq_raw_data_t raw = raw_at(log, i);
+    if (!raw.gas_valid) {
+      continue;
+    }
+
+    // Both pipelines see the baseline in effect before this sample
+    float baseline = result.gas_baseline;
+    iaq_calculate(&raw, &result);
+    if (baseline <= 0) {
+      continue;
+    }
+
+    iaq_pipeline_out_t ref;
+    iaq_pipeline_out_t fix;
+    iaq_pipeline_float(raw.gas_resistance, raw.temperature, raw.humidity,
+                       baseline, &ref);
+    iaq_pipeline_fixed(raw.gas_resistance, raw.temperature, raw.humidity,
+                       baseline, &fix);
+    float err[3] = {fabsf(ref.iaq_score - fix.iaq_score),
+                    fabsf(ref.co2_equivalent - fix.co2_equivalent),
+                    fabsf(ref.voc_equivalent - fix.voc_equivalent)};
+    for (int k = 0; k < 3; k++) {
+      if (err[k] > max_err[k]) {
+        max_err[k] = err[k];
+        worst[k] = i;
+      }
+    }
+    checked++;
+  }
+
+  static const char *names[] = {"IAQ", "CO2", "VOC"};
+  static const float bounds[] = {IAQ_FIXED_MAX_IAQ_ERROR,
+                                 IAQ_FIXED_MAX_CO2_ERROR,
+                                 IAQ_FIXED_MAX_VOC_ERROR};
+  int ret = 0;
+  printf("Fixed vs float   : %zu samples\n", checked);
+  for (int k = 0; k < 3; k++) {
+    bool ok = max_err[k] <= bounds[k];
+    printf("  %s max error   : %.5f (bound %.5f, sample %zu) %s\n", names[k],
+           max_err[k], bounds[k], worst[k], ok ? "ok" : "FAIL");
+    ret |= ok ? 0 : -1;
+  }
+
+  iaq_benchmark_t bench;
+  iaq_run_benchmark(1000000, &bench);
+  printf("Benchmark        : float %.1f ns, fixed %.1f ns per sample, %s\n",
+         bench.float_cycles, bench.fixed_cycles,
+         bench.within_bounds ? "within bounds" : "OUT OF BOUNDS");
+  return bench.within_bounds ? ret : -1;
+}
+
+/**
+ * @brief Run every built-in engine over the log, the calculator first
+ */
+static int run_engine_eval(const replay_log_t *log) {
+  static iaq_ctx_t piecewise;
+  static iaq_engine_percentile_state_t percentile;
+  static iaq_engine_learned_state_t learned;
+  static const iaq_engine_t *const engines[] = {
+      &iaq_engine_piecewise, &iaq_engine_percentile, &iaq_engine_learned};
+  void *const states[] = {&piecewise, &percentile, &learned};
+  const size_t count = sizeof(engines) / sizeof(engines[0]);
+
+  iaq_eval_t eval;
+  if (iaq_eval_init(&eval, engines, states, count) != ESP_OK) {
+    return -1;
+  }
+  for (size_t i = 0; i < log->count; i++) {
+    iaq_raw_data_t raw = raw_at(log, i);
+    iaq_eval_add(&eval, &raw, NULL);
+  }
+
+  printf("Engines          : %" PRIu32 " samples, reference %s\n",
+         eval.samples, engines[0]->name);
+  printf("  %-12s %7s %8s %8s %6s %6s %6s %6s %6s\n", "engine", "bytes",
+         "ns", "max ns", "IAQ", "|diff|", "max", "level", "corr");
+  for (size_t k = 0; k < count; k++) {
+    iaq_eval_stats_t st;
+    iaq_eval_get(&eval, k, &st);
+    printf("  %-12s %7zu %8.1f %8" PRIu32 " %6.1f %6.1f %6.1f %5.1f%% %6.3f\n",
+           st.name, st.state_bytes, st.cycles, st.max_cycles, st.mean_score,
+           st.mean_abs_diff, st.max_abs_diff, st.level_agreement * 100.0f,
+           st.correlation);
+  }
+  return 0;
+}
+
+static void usage(const char *prog) {
+  fprintf(stderr,
+          "Usage: %s [options] <log.csv|log.bin>\n"
+          "  -o FILE          write the IAQ trajectory as CSV\n"
+          "  -d N             write every Nth sample to the trajectory\n"
+          "  -r N             repeat the throughput pass N times\n"
+          "  -B               use iaq_calculate_batch() for throughput\n"
+          "  -F               check the fixed-point pipeline against float\n"
+          "  -E               compare the IAQ engines side by side\n"
+          "  -c FILE          convert the log to binary and exit\n"
+          "  -v               print calculator logs\n"
+          "  --burn-in N      burn-in samples\n"
+          "  --rate R         gas recalibration rate\n"
+          "  --percentile P   baseline percentile (0..1)\n"
+          "  --horizon N      baseline horizon in samples\n"
+          "  --trend S        trend window in seconds\n"
+          "  --outlier-window N  Hampel window in samples (1 disables)\n"
+          "  --outlier-k K    Hampel threshold in robust std devs\n"
+          "  --no-learn       keep the default compensation coefficients\n",
+          prog);
+}
+
+static int parse_options(int argc, char **argv, replay_options_t *opt) {
+  static const struct option long_opts[] = {
+      {"burn-in", required_argument, NULL, 'I'},
+      {"rate", required_argument, NULL, 'R'},
+      {"percentile", required_argument, NULL, 'P'},
+      {"horizon", required_argument, NULL, 'H'},
+      {"trend", required_argument, NULL, 'T'},
+      {"outlier-window", required_argument, NULL, 'W'},
+      {"outlier-k", required_argument, NULL, 'K'},
+      {"no-learn", no_argument, NULL, 'N'},
+      {NULL, 0, NULL, 0}};
+
+  int c;
+  while ((c = getopt_long(argc, argv, "o:d:r:BFEc:v", long_opts, NULL)) != -1) {
+    switch (c) {
+    case 'o':
+      opt->trajectory_path = optarg;
+      break;
+    case 'd':
+      opt->decimation = (uint32_t)strtoul(optarg, NULL, 10);
+      break;
+    case 'r':
+      opt->repeat = (uint32_t)strtoul(optarg, NULL, 10);
+      break;
+    case 'B':
+      opt->batch = true;
+      break;
+    case 'F':
+      opt->fixed_check = true;
+      break;
+    case 'E':
+      opt->engine_eval = true;
+      break;
+    case 'c':
+      opt->convert_path = optarg;
+      break;
+    case 'v':
+      esp_log_host_level = ESP_LOG_INFO;
+      break;
+    case 'I':
+      opt->config.burn_in_samples = (uint32_t)strtoul(optarg, NULL, 10);
+      break;
+    case 'R':
+      opt->config.gas_recalibration_rate = strtof(optarg, NULL);
+      break;
+    case 'P':
+      opt->config.baseline_percentile = strtof(optarg, NULL);
+      break;
+    case 'H':
+      opt->config.baseline_horizon_samples =
+          (uint32_t)strtoul(optarg, NULL, 10);
+      break;
+    case 'T':
+      opt->config.trend_window_s = (uint32_t)strtoul(optarg, NULL, 10);
+      break;
+    case 'W':
+      opt->config.outlier_window = (uint8_t)strtoul(optarg, NULL, 10);
+      break;
+    case 'K':
+      opt->config.outlier_threshold = strtof(optarg, NULL);
+      break;
+    case 'N':
+      opt->config.learn_compensation = false;
+      break;
+    default:
+      return -1;
+    }
+  }
+
+  if (optind != argc - 1) {
+    return -1;
+  }
+  opt->input = argv[optind];
+  if (opt->decimation == 0) {
+    opt->decimation = 1;
+  }
+  if (opt->repeat == 0) {
+    opt->repeat = 1;
+  }
+  return 0;
+}
+
+int main(int argc, char **argv) {
+  replay_options_t opt = {.decimation = 1,
+                          .repeat = 1,
+                          .config = {.burn_in_samples = 50,
+                                     .gas_recalibration_rate = 0.001f,
+                                     .learn_compensation = true}};
+
+  // Per-sample warnings would dominate the measurement; -v re-enables them
+  esp_log_host_level = ESP_LOG_ERROR;
+  if (parse_options(argc, argv, &opt) != 0) {
+    usage(argv[0]);
+    return 2;
+  }
+
+  replay_log_t log = {0};
+  uint64_t t0 = now_ns();
+  if (load_log(opt.input, &log) != 0) {
+    log_free(&log);
+    return 1;
+  }
+  printf("Loaded           : %zu samples from %s in %.1f ms\n", log.count,
+         opt.input, (double)(now_ns() - t0) / 1e6);
+
+  if (opt.convert_path != NULL) {
+    int ret = save_binary(opt.convert_path, &log);
+    log_free(&log);
+    return ret == 0 ? 0 : 1;
+  }
+
+  if (log.count == 0 || iaq_init_with_config(&opt.config) != ESP_OK) {
+    log_free(&log);
+    return 1;
+  }
+
+  if (opt.fixed_check) {
+    int ret = run_fixed_check(&log);
+    log_free(&log);
+    return ret == 0 ? 0 : 1;
+  }
+
+  if (opt.engine_eval) {
+    int ret = run_engine_eval(&log);
+    log_free(&log);
+    return ret == 0 ? 0 : 1;
+  }
+
+  double rate = run_throughput(&log, &opt);
+  printf("Throughput       : %.2f M samples/s (%s, %" PRIu32 " run%s)\n",
+         rate / 1e6, opt.batch ? "batch" : "scalar", opt.repeat,
+         opt.repeat == 1 ? "" : "s");
+
+  int ret = run_trajectory(&log, &opt);
+  log_free(&log);
+  return ret == 0 ? 0 : 1;
+}
@@ -0,0 +1,194 @@
+/**
+ * @file iaq_seqlock_stress.c
+ * @brief Host stress test of the result seqlock
+ *
+ * One writer thread runs iaq_ctx_calculate() on a volatile context while
+ * reader threads poll iaq_ctx_get_result() as fast as they can. Every
+ * sample encodes its number k in the inputs, so a snapshot mixing two
+ * publications shows up as a disagreement between fields:
+ *
+ *   temperature = k % STRESS_TAG_MOD, humidity = that + STRESS_HUM_OFFSET
+ *   pressure    = k, increasing, so its window maximum is the newest k
+ *
+ * Readers also check that the score, static score and level agree and that
+ * nothing goes backwards. The writer's longest call is reported, since
+ * readers must never hold it up.
+ *
+ * Usage: iaq_seqlock_stress [updates] [readers]
+ */
+
+#include "esp_log.h"
+#include "iaq_calculator.h"
+#include <inttypes.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define STRESS_UPDATES_DEFAULT 4000000u
+#define STRESS_READERS_DEFAULT 4
+#define STRESS_READERS_MAX 16
+#define STRESS_TAG_MOD 40u
+#define STRESS_HUM_OFFSET 20.0f
+// Sample spacing; keeps 2^24 samples inside the 32-bit millisecond clock
+#define STRESS_INTERVAL_MS 200u
+// Largest k the pressure channel carries exactly as a float
+#define STRESS_UPDATES_MAX (1u << 24)
+
+typedef struct {
+  pthread_t thread;
+  uint64_t reads;
+  uint64_t torn;
+  uint64_t regressions;
+  uint32_t distinct; /**< Reads that saw a newer sample than the last */
+} reader_t;
+
+static iaq_ctx_t s_ctx;
+static volatile bool s_done;
+
+static uint64_t now_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+/**
+ * @brief Check the fields of one snapshot against each other
+ * @param k Sample number decoded from the snapshot
+ */
+static bool consistent(const iaq_result_t *r, uint32_t *k) {
+  const iaq_window_stats_t *p = &r->window[IAQ_CHANNEL_PRESSURE];
+  if (p->count == 0) {
+    return false;
+  }
+  *k = (uint32_t)p->max;
+  return r->comp_temperature == (float)(*k % STRESS_TAG_MOD) &&
+         r->comp_humidity == r->comp_temperature + STRESS_HUM_OFFSET &&
+         r->static_iaq == r->iaq_score &&
+         r->iaq_level == iaq_score_to_level(r->iaq_score) &&
+         r->is_calibrated ==
+             (r->samples_count >= s_ctx.config.burn_in_samples);
+}
+
+static void *reader_main(void *arg) {
+  reader_t *reader = arg;
+  uint32_t last_k = 0;
+  uint32_t last_samples = 0;
+  uint32_t last_anomalies = 0;
+
+  while (!__atomic_load_n(&s_done, __ATOMIC_RELAXED)) {
+    iaq_result_t r;
+    if (iaq_ctx_get_result(&s_ctx, &r) != ESP_OK) {
+      continue;
+    }
+    reader->reads++;
+    if (r.samples_count == 0 && r.window[IAQ_CHANNEL_PRESSURE].count == 0) {
+      continue; // Nothing published yet
+    }
+
+    uint32_t k;
+    if (!consistent(&r, &k)) {
+      if (reader->torn++ == 0) {
+        fprintf(stderr,
+                "Torn snapshot: T %.1f RH %.1f k %u IAQ %.3f/%.3f level %d\n",
+                r.comp_temperature, r.comp_humidity,
+                (unsigned)r.window[IAQ_CHANNEL_PRESSURE].max, r.iaq_score,
+                r.static_iaq, r.iaq_level);
+      }
+      continue;
+    }
+    if (k < last_k || r.samples_count < last_samples ||
+        r.anomalies < last_anomalies) {
+      reader->regressions++;
+    }
+    reader->distinct += k > last_k;
+    last_k = k;
+    last_samples = r.samples_count;
+    last_anomalies = r.anomalies;
+  }
+  return NULL;
+}
+
+int main(int argc, char **argv) {
+  uint32_t updates = STRESS_UPDATES_DEFAULT;
+  int readers = STRESS_READERS_DEFAULT;
+  if (argc > 1) {
+    updates = (uint32_t)strtoul(argv[1], NULL, 0);
+  }
+  if (argc > 2) {
+    readers = atoi(argv[2]);
+  }
+  if (updates == 0 || updates > STRESS_UPDATES_MAX || readers < 1 ||
+      readers > STRESS_READERS_MAX) {
+    fprintf(stderr, "Usage: %s [updates <= %u] [readers 1..%d]\n", argv[0],
+            STRESS_UPDATES_MAX, STRESS_READERS_MAX);
+    return 2;
+  }
+
+  iaq_config_t config;
+  iaq_get_default_config(&config);
+  if (iaq_ctx_init(&s_ctx, &config, NULL) != ESP_OK) {
+    fprintf(stderr, "iaq_ctx_init failed\n");
+    return 1;
+  }
+
+  static reader_t reader[STRESS_READERS_MAX];
+  for (int i = 0; i < readers; i++) {
+    if (pthread_create(&reader[i].thread, NULL, reader_main, &reader[i]) !=
+        0) {
+      fprintf(stderr, "pthread_create failed\n");
+      return 1;
+    }
+  }
+
+  uint64_t max_call_ns = 0;
+  uint64_t t0 = now_ns();
+  for (uint32_t k = 1; k <= updates; k++) {
+    iaq_raw_data_t raw = {
+        .temperature = (float)(k % STRESS_TAG_MOD),
+        .humidity = (float)(k % STRESS_TAG_MOD) + STRESS_HUM_OFFSET,
+        .pressure = (float)k,
+        .gas_resistance = 50000.0f + (float)(k % 997) * 300.0f,
+        .gas_valid = true,
+        .timestamp_ms = k * STRESS_INTERVAL_MS,
+    };
+    iaq_result_t result;
+    uint64_t c0 = now_ns();
+    esp_err_t err = iaq_ctx_calculate(&s_ctx, &raw, &result);
+    uint64_t call_ns = now_ns() - c0;
+    if (err != ESP_OK) {
+      fprintf(stderr, "iaq_ctx_calculate failed at %" PRIu32 ": %s\n", k,
+              esp_err_to_name(err));
+      return 1;
+    }
+    max_call_ns = call_ns > max_call_ns ? call_ns : max_call_ns;
+  }
+  double elapsed_s = (double)(now_ns() - t0) / 1e9;
+
+  __atomic_store_n(&s_done, true, __ATOMIC_RELAXED);
+  uint64_t reads = 0;
+  uint64_t torn = 0;
+  uint64_t regressions = 0;
+  uint64_t distinct = 0;
+  for (int i = 0; i < readers; i++) {
+    pthread_join(reader[i].thread, NULL);
+    reads += reader[i].reads;
+    torn += reader[i].torn;
+    regressions += reader[i].regressions;
+    distinct += reader[i].distinct;
+  }
+
+  printf("Updates     : %" PRIu32 " in %.2f s, longest call %.1f us\n",
+         updates, elapsed_s, (double)max_call_ns / 1000.0);
+  printf("Reads       : %" PRIu64 " by %d readers, %" PRIu64
+         " saw a newer sample\n",
+         reads, readers, distinct);
+  printf("Torn        : %" PRIu64 "\n", torn);
+  printf("Regressions : %" PRIu64 "\n", regressions);
+
+  bool ok = torn == 0 && regressions == 0 && distinct > 0;
+  printf("%s\n", ok ? "Snapshots consistent" : "SNAPSHOTS INCONSISTENT");
+  return ok ? 0 : 1;
+}
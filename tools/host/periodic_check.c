@@ -0,0 +1,226 @@
+/**
+ * @file periodic_check.c
+ * @brief Host check of the periodic scheduler's grid and overrun policies
+ *
+ * Runs a loop of periodic_wait() against the shim's millisecond ticks with
+ * a varying amount of work per cycle and times every wake. The wakes must
+ * stay on the grid laid down by the first one, however long the work took,
+ * so the error after hundreds of cycles is no larger than after one. A
+ * cycle made to overrun must then give up whole instants under
+ * PERIODIC_SKIP and run them back to back under PERIODIC_CATCH_UP, and
+ * a period change must move the spacing from the next instant on. The
+ * instants reported must be exact multiples of the period apart. A wake
+ * from another thread must end a long wait at once and restart the grid.
+ *
+ * Usage: periodic_check [cycles]
+ */
+
+#include "esp_timer.h"
+#include "freertos/task.h"
+#include "periodic.h"
+#include <inttypes.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#define CHECK_CYCLES_DEFAULT 200
+#define CHECK_CYCLES_MAX 1000
+#define CHECK_PERIOD_MS 20
+// Wake latency allowed on a loaded host, half a period; a loop that drifts
+// by its work exceeds it within a few cycles
+#define CHECK_TOLERANCE_US (CHECK_PERIOD_MS * 1000 / 2)
+// Cycle made to overrun, and by how much: three instants and a half
+#define OVERRUN_CYCLE 10
+#define OVERRUN_MS (3 * CHECK_PERIOD_MS + CHECK_PERIOD_MS / 2)
+
+static int failures;
+
+static void expect(bool ok, const char *what) {
+  if (!ok) {
+    fprintf(stderr, "FAILED: %s\n", what);
+    failures++;
+  }
+}
+
+static uint32_t s_rng = 12345;
+
+static uint32_t work_ms(void) {
+  s_rng = s_rng * 1103515245u + 12345u;
+  return (s_rng >> 16) % (CHECK_PERIOD_MS * 3 / 5);
+}
+
+/**
+ * @brief Wait through cycles instants, recording when each wait returned
+ * @param overrun_at Cycle whose work overruns, or -1 for none
+ * @return Largest distance of a wake from its grid instant, in us
+ */
+static int64_t run(periodic_t *p, int cycles, int overrun_at,
+                   int64_t *wake_us, periodic_stats_t *stats) {
+  int64_t worst = 0;
+  uint32_t first_ms = 0;
+  bool exact = true;
+  for (int k = 0; k < cycles; k++) {
+    if (k > 0) {
+      vTaskDelay(k == overrun_at ? OVERRUN_MS : work_ms());
+    }
+    periodic_wait(p);
+    wake_us[k] = esp_timer_get_time();
+
+    // Instant k sits k periods after the first, plus any dropped ones
+    periodic_get_stats(p, stats);
+    int64_t ideal = wake_us[0] + ((int64_t)k + stats->skipped) *
+                                     CHECK_PERIOD_MS * 1000;
+    int64_t error = llabs(wake_us[k] - ideal);
+    worst = error > worst ? error : worst;
+
+    // and its reported time exactly so, whatever the wake latency
+    uint32_t instant_ms = periodic_instant_ms(p);
+    if (k == 0) {
+      first_ms = instant_ms;
+    }
+    exact &= instant_ms - first_ms ==
+             ((uint32_t)k + stats->skipped) * CHECK_PERIOD_MS;
+  }
+  expect(exact, "instants reported on the grid");
+  return worst;
+}
+
+static void check_grid(int cycles) {
+  static int64_t wake_us[CHECK_CYCLES_MAX];
+  periodic_t p;
+  periodic_stats_t stats;
+  periodic_init(&p, CHECK_PERIOD_MS, PERIODIC_SKIP);
+  int64_t worst = run(&p, cycles, -1, wake_us, &stats);
+  int64_t span = wake_us[cycles - 1] - wake_us[0];
+
+  printf("Grid        : %d cycles over %.3f s, worst wake %.2f ms off, "
+         "jitter %" PRIu32 "/%" PRIu32 " us\n",
+         cycles, (double)span / 1e6, (double)worst / 1000.0,
+         stats.mean_jitter_us, stats.max_jitter_us);
+  expect(worst < CHECK_TOLERANCE_US, "wakes stay on the grid");
+  expect(stats.cycles == (uint32_t)cycles, "cycles counted");
+  expect(stats.max_jitter_us < CHECK_TOLERANCE_US, "jitter reported");
+}
+
+static void check_overrun(periodic_overrun_t policy) {
+  static int64_t wake_us[CHECK_CYCLES_MAX];
+  const int cycles = OVERRUN_CYCLE + 10;
+  periodic_t p;
+  periodic_stats_t stats;
+  periodic_init(&p, CHECK_PERIOD_MS, policy);
+  int64_t worst = run(&p, cycles, OVERRUN_CYCLE, wake_us, &stats);
+  bool skip = policy == PERIODIC_SKIP;
+
+  // Waits right after the overrun return at once when catching up
+  int immediate = 0;
+  for (int k = OVERRUN_CYCLE + 1; k < cycles; k++) {
+    immediate += wake_us[k] - wake_us[k - 1] < CHECK_PERIOD_MS * 500;
+  }
+
+  printf("%-12s: %" PRIu32 " overruns, %" PRIu32 " skipped, %d immediate "
+         "waits, worst wake %.2f ms off\n",
+         skip ? "Skip" : "Catch up", stats.overruns, stats.skipped, immediate,
+         (double)worst / 1000.0);
+  expect(stats.overruns >= 1, "overrun counted");
+  if (skip) {
+    expect(stats.skipped == OVERRUN_MS / CHECK_PERIOD_MS,
+           "missed instants skipped");
+    expect(immediate == 0, "no instants bunched after skipping");
+    expect(worst < CHECK_TOLERANCE_US, "back on the grid after skipping");
+  } else {
+    expect(stats.skipped == 0, "nothing skipped when catching up");
+    expect(immediate == OVERRUN_MS / CHECK_PERIOD_MS,
+           "missed instants run back to back");
+    // Caught up, the last wake is where it would have been anyway
+    int64_t last_error = llabs(wake_us[cycles - 1] - wake_us[0] -
+                               (int64_t)(cycles - 1) * CHECK_PERIOD_MS * 1000);
+    expect(last_error < CHECK_TOLERANCE_US,
+           "back on the grid after catching up");
+  }
+}
+
+static void check_set_period(void) {
+  periodic_t p;
+  periodic_init(&p, CHECK_PERIOD_MS, PERIODIC_SKIP);
+  periodic_wait(&p);
+  int64_t before = esp_timer_get_time();
+  periodic_wait(&p);
+  int64_t changed = esp_timer_get_time();
+  periodic_set_period(&p, CHECK_PERIOD_MS / 2);
+  periodic_wait(&p);
+  periodic_wait(&p);
+  int64_t after = esp_timer_get_time();
+
+  expect(llabs(changed - before - CHECK_PERIOD_MS * 1000) < CHECK_TOLERANCE_US,
+         "old period until the change");
+  expect(llabs(after - changed - CHECK_PERIOD_MS * 1000) < CHECK_TOLERANCE_US,
+         "new period from the next instant");
+  expect(periodic_init(&p, 0, PERIODIC_SKIP) == ESP_ERR_INVALID_ARG,
+         "zero period rejected");
+}
+
+static void *waker_main(void *arg) {
+  vTaskDelay(CHECK_PERIOD_MS);
+  periodic_wake(arg);
+  return NULL;
+}
+
+static void check_wake(void) {
+  static periodic_t p;
+  periodic_wake(&p); // Not initialized yet, so ignored
+  periodic_init(&p, CHECK_PERIOD_MS, PERIODIC_SKIP);
+  periodic_wait(&p);
+  periodic_stats_t stats;
+  periodic_get_stats(&p, &stats);
+  expect(stats.woken == 0, "wake before init ignored");
+
+  // Woken a period into a wait of fifty, the grid restarts from the wake
+  periodic_set_period(&p, CHECK_PERIOD_MS * 50);
+  pthread_t waker;
+  int64_t start = esp_timer_get_time();
+  pthread_create(&waker, NULL, waker_main, &p);
+  periodic_wait(&p);
+  int64_t woken = esp_timer_get_time();
+  pthread_join(waker, NULL);
+  periodic_set_period(&p, CHECK_PERIOD_MS);
+  periodic_wait(&p);
+  int64_t next = esp_timer_get_time();
+
+  periodic_get_stats(&p, &stats);
+  printf("Wake        : wait ended after %.1f ms, next instant %.1f ms "
+         "later\n",
+         (double)(woken - start) / 1000.0, (double)(next - woken) / 1000.0);
+  expect(stats.woken == 1, "wake counted");
+  expect(woken - start < CHECK_PERIOD_MS * 1000 + CHECK_TOLERANCE_US,
+         "wake ends the wait");
+  expect(llabs(next - woken - CHECK_PERIOD_MS * 1000) < CHECK_TOLERANCE_US,
+         "grid restarts at the wake");
+
+  // A wake during the work ends the next wait at once
+  periodic_wake(&p);
+  start = esp_timer_get_time();
+  periodic_wait(&p);
+  expect(esp_timer_get_time() - start < CHECK_TOLERANCE_US,
+         "pending wake ends the next wait");
+}
+
+int main(int argc, char **argv) {
+  int cycles = CHECK_CYCLES_DEFAULT;
+  if (argc > 1) {
+    cycles = atoi(argv[1]);
+  }
+  if (cycles < 2 || cycles > CHECK_CYCLES_MAX) {
+    fprintf(stderr, "Usage: %s [cycles 2..%d]\n", argv[0], CHECK_CYCLES_MAX);
+    return 2;
+  }
+
+  check_grid(cycles);
+  check_overrun(PERIODIC_SKIP);
+  check_overrun(PERIODIC_CATCH_UP);
+  check_set_period();
+  check_wake();
+
+  printf("%s\n", failures == 0 ? "Schedule holds" : "SCHEDULE DRIFTS");
+  return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,194 @@
+/**
+ * @file rate_ctl_check.c
+ * @brief Host check of the sampling rate controller's hysteresis
+ *
+ * Drives the controller with scripted readings, each taken one interval of
+ * the mode in effect after the last as on the device, and checks the mode
+ * it picks: normal until calibrated, slow only after the settled time,
+ * burst on an event and for the hold time after it, no flapping when the
+ * air hovers around a threshold, and an override that sets the interval
+ * as soon as it is made. Time spent per mode must add up to the run.
+ *
+ * Usage: rate_ctl_check
+ */
+
+#include "rate_ctl.h"
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdio.h>
+
+static int failures;
+
+static void expect(bool ok, const char *what) {
+  if (!ok) {
+    fprintf(stderr, "FAILED: %s\n", what);
+    failures++;
+  }
+}
+
+typedef struct {
+  rate_ctl_t ctl;
+  rate_ctl_config_t config;
+  uint32_t now_ms;
+  uint32_t start_ms;
+} sim_t;
+
+static void sim_init(sim_t *sim) {
+  rate_ctl_get_default_config(&sim->config);
+  sim->now_ms = 1000;
+  sim->start_ms = sim->now_ms;
+  rate_ctl_init(&sim->ctl, &sim->config, sim->now_ms);
+}
+
+/**
+ * @brief Take readings of the same air for duration_ms
+ * @return Mode after the last reading
+ */
+static rate_mode_t air(sim_t *sim, uint32_t duration_ms, bool calibrated,
+                       iaq_level_t level, float slope) {
+  rate_ctl_input_t in = {
+      .calibrated = calibrated, .level = level, .slope = slope};
+  rate_mode_t mode = sim->ctl.mode;
+  for (uint32_t t = 0; t < duration_ms;) {
+    uint32_t step = rate_ctl_get_interval_ms(&sim->ctl);
+    sim->now_ms += step;
+    t += step;
+    mode = rate_ctl_update(&sim->ctl, &in, sim->now_ms);
+  }
+  return mode;
+}
+
+static rate_mode_t clean(sim_t *sim, uint32_t duration_ms) {
+  return air(sim, duration_ms, true, IAQ_LEVEL_GOOD, 0.0f);
+}
+
+static void check_calibration(void) {
+  sim_t sim;
+  sim_init(&sim);
+  expect(rate_ctl_get_interval_ms(&sim.ctl) == 10000, "starts at 10 s");
+  expect(air(&sim, 3600000, false, IAQ_LEVEL_HEAVILY_POLLUTED, 50.0f) ==
+             RATE_MODE_NORMAL,
+         "normal while calibrating, whatever the air");
+  expect(air(&sim, 3600000, false, IAQ_LEVEL_EXCELLENT, 0.0f) ==
+             RATE_MODE_NORMAL,
+         "not slow while calibrating");
+  expect(sim.ctl.switches == 0, "no switches while calibrating");
+}
+
+static void check_slow(void) {
+  sim_t sim;
+  sim_init(&sim);
+  // Settled time runs from the first clean reading
+  uint32_t after = sim.config.slow_after_ms;
+  clean(&sim, 10000);
+  expect(clean(&sim, after - 10000) == RATE_MODE_NORMAL,
+         "normal before the settled time");
+  expect(clean(&sim, 10000) == RATE_MODE_SLOW, "slow once settled");
+
+  // A slope inside the settled band keeps it slow, one past it does not
+  expect(air(&sim, 600000, true, IAQ_LEVEL_GOOD, 0.9f) == RATE_MODE_SLOW,
+         "slow with a settled slope");
+  expect(air(&sim, 30000, true, IAQ_LEVEL_GOOD, 2.0f) == RATE_MODE_NORMAL,
+         "unsettled air leaves slow");
+  clean(&sim, 10000);
+  expect(clean(&sim, after - 10000) == RATE_MODE_NORMAL,
+         "settled time restarts after unsettled air");
+  expect(clean(&sim, 10000) == RATE_MODE_SLOW, "slow again once settled");
+  expect(air(&sim, 30000, true, IAQ_LEVEL_LIGHTLY_POLLUTED, 0.0f) ==
+             RATE_MODE_NORMAL,
+         "lightly polluted air leaves slow");
+}
+
+static void check_burst(void) {
+  sim_t sim;
+  sim_init(&sim);
+  clean(&sim, 60000);
+  expect(air(&sim, 4000, true, IAQ_LEVEL_GOOD, 4.9f) == RATE_MODE_NORMAL,
+         "slope under the burst threshold");
+  expect(air(&sim, 10000, true, IAQ_LEVEL_GOOD, 5.0f) == RATE_MODE_BURST,
+         "slope at the burst threshold");
+
+  // The burst holds after the slope has gone, then drops to normal
+  uint32_t hold = sim.config.burst_hold_ms;
+  expect(clean(&sim, hold - 2000) == RATE_MODE_BURST, "burst holds");
+  expect(clean(&sim, 2000) == RATE_MODE_NORMAL, "burst ends after the hold");
+
+  rate_ctl_input_t alert = {
+      .calibrated = true, .level = IAQ_LEVEL_GOOD, .alert = true};
+  expect(rate_ctl_update(&sim.ctl, &alert, sim.now_ms += 10000) ==
+             RATE_MODE_BURST,
+         "forecast crossing starts a burst");
+
+  // Polluted air coming and going within the hold is one long burst
+  sim_init(&sim);
+  clean(&sim, 60000);
+  uint32_t switches = sim.ctl.switches;
+  for (int i = 0; i < 20; i++) {
+    air(&sim, 5000, true, IAQ_LEVEL_MODERATELY_POLLUTED, 0.0f);
+    expect(clean(&sim, hold / 2) == RATE_MODE_BURST, "burst through gaps");
+  }
+  printf("Flapping air: %" PRIu32 " switches in %" PRIu32 " s\n",
+         sim.ctl.switches - switches, (sim.now_ms - sim.start_ms) / 1000);
+  expect(sim.ctl.switches - switches == 1, "no flapping");
+}
+
+static void check_override(void) {
+  sim_t sim;
+  sim_init(&sim);
+  clean(&sim, 60000);
+
+  // The interval follows at once, the stats at the next update
+  rate_ctl_set_override(&sim.ctl, RATE_MODE_BURST);
+  expect(rate_ctl_get_interval_ms(&sim.ctl) == 1000,
+         "override sets the interval at once");
+  rate_ctl_stats_t stats;
+  rate_ctl_get_stats(&sim.ctl, &stats);
+  expect(stats.override && stats.mode == RATE_MODE_NORMAL,
+         "stats keep the mode until the update");
+  expect(clean(&sim, sim.config.slow_after_ms * 2) == RATE_MODE_BURST,
+         "override holds against the air");
+
+  // Handed back, the interval is the controller's, which kept tracking
+  rate_ctl_set_override(&sim.ctl, RATE_MODE_COUNT);
+  expect(rate_ctl_get_interval_ms(&sim.ctl) == 30000,
+         "auto restores the controller's interval at once");
+  expect(clean(&sim, 30000) == RATE_MODE_SLOW, "auto resumes slow");
+  rate_mode_t unknown = (rate_mode_t)(RATE_MODE_COUNT + 1);
+  expect(rate_ctl_set_override(&sim.ctl, unknown) == ESP_ERR_INVALID_ARG,
+         "unknown override rejected");
+
+  rate_ctl_get_stats(&sim.ctl, &stats);
+  uint32_t total_s = 0;
+  for (int i = 0; i < RATE_MODE_COUNT; i++) {
+    total_s += stats.time_in_mode_s[i];
+  }
+  expect(total_s == (sim.now_ms - sim.start_ms) / 1000,
+         "time per mode adds up");
+}
+
+static void check_parse(void) {
+  rate_mode_t mode;
+  expect(rate_ctl_parse_mode("burst", 5, &mode) == ESP_OK &&
+             mode == RATE_MODE_BURST,
+         "parse burst");
+  expect(rate_ctl_parse_mode("auto", 4, &mode) == ESP_OK &&
+             mode == RATE_MODE_COUNT,
+         "parse auto");
+  expect(rate_ctl_parse_mode("slower", 4, &mode) == ESP_OK &&
+             mode == RATE_MODE_SLOW,
+         "parse an unterminated name");
+  expect(rate_ctl_parse_mode("bur", 3, &mode) == ESP_ERR_NOT_FOUND,
+         "reject a prefix");
+}
+
+int main(void) {
+  check_calibration();
+  check_slow();
+  check_burst();
+  check_override();
+  check_parse();
+
+  printf("%s\n",
+         failures == 0 ? "Controller behaves" : "CONTROLLER MISBEHAVES");
+  return failures == 0 ? 0 : 1;
+}
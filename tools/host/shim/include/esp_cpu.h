@@ -0,0 +1,24 @@
+/**
+ * @file esp_cpu.h
+ * @brief Host shim for the CPU cycle counter
+ *
+ * There is no portable cycle counter on the host, so "cycles" are
+ * nanoseconds of the monotonic clock.
+ */
+
+#ifndef HOST_SHIM_ESP_CPU_H
+#define HOST_SHIM_ESP_CPU_H
+
+#include <stdint.h>
+#include <time.h>
+
+typedef uint32_t esp_cpu_cycle_count_t;
+
+static inline esp_cpu_cycle_count_t esp_cpu_get_cycle_count(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (esp_cpu_cycle_count_t)((uint64_t)ts.tv_sec * 1000000000ULL +
+                                 (uint64_t)ts.tv_nsec);
+}
+
+#endif // HOST_SHIM_ESP_CPU_H
@@ -0,0 +1,62 @@
+/**
+ * @file esp_log.h
+ * @brief Host shim for ESP-IDF logging, printing to stderr
+ */
+
+#ifndef HOST_SHIM_ESP_LOG_H
+#define HOST_SHIM_ESP_LOG_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+typedef enum {
+  ESP_LOG_NONE,
+  ESP_LOG_ERROR,
+  ESP_LOG_WARN,
+  ESP_LOG_INFO,
+  ESP_LOG_DEBUG,
+  ESP_LOG_VERBOSE
+} esp_log_level_t;
+
+extern esp_log_level_t esp_log_host_level;
+
+#ifndef LOG_LOCAL_LEVEL
+#define LOG_LOCAL_LEVEL ESP_LOG_VERBOSE
+#endif
+
+/**
+ * @brief Runtime level; every tag shares esp_log_host_level
+ */
+static inline esp_log_level_t esp_log_level_get(const char *tag) {
+  (void)tag;
+  return esp_log_host_level;
+}
+
+/**
+ * @brief Milliseconds since the process started
+ */
+uint32_t esp_log_timestamp(void);
+
+/**
+ * @brief Print a preformatted line if level passes esp_log_host_level
+ */
+void esp_log_write(esp_log_level_t level, const char *tag, const char *format,
+                   ...);
+
+#define ESP_LOG_HOST(level, letter, tag, format, ...)                          \
+  do {                                                                         \
+    if (esp_log_host_level >= (level)) {                                       \
+      fprintf(stderr, letter " (%s) " format "\n", tag, ##__VA_ARGS__);        \
+    }                                                                          \
+  } while (0)
+
+#define ESP_LOGE(tag, format, ...)                                             \
+  ESP_LOG_HOST(ESP_LOG_ERROR, "E", tag, format, ##__VA_ARGS__)
+#define ESP_LOGW(tag, format, ...)                                             \
+  ESP_LOG_HOST(ESP_LOG_WARN, "W", tag, format, ##__VA_ARGS__)
+#define ESP_LOGI(tag, format, ...)                                             \
+  ESP_LOG_HOST(ESP_LOG_INFO, "I", tag, format, ##__VA_ARGS__)
+#define ESP_LOGD(tag, format, ...)                                             \
+  ESP_LOG_HOST(ESP_LOG_DEBUG, "D", tag, format, ##__VA_ARGS__)
+
+#endif // HOST_SHIM_ESP_LOG_H
@@ -0,0 +1,16 @@
+/**
+ * @file esp_rom_crc.h
+ * @brief Host shim for the ROM CRC routines
+ */
+
+#ifndef HOST_SHIM_ESP_ROM_CRC_H
+#define HOST_SHIM_ESP_ROM_CRC_H
+
+#include <stdint.h>
+
+/**
+ * @brief CRC32 (IEEE 802.3, reflected), same convention as zlib's crc32()
+ */
+uint32_t esp_rom_crc32_le(uint32_t crc, const uint8_t *buf, uint32_t len);
+
+#endif // HOST_SHIM_ESP_ROM_CRC_H
@@ -0,0 +1,30 @@
+/**
+ * @file queue.h
+ * @brief Host shim for FreeRTOS queues, backed by pthreads
+ */
+
+#ifndef HOST_SHIM_QUEUE_H
+#define HOST_SHIM_QUEUE_H
+
+#include "freertos/FreeRTOS.h"
+#include <pthread.h>
+
+typedef struct {
+  pthread_mutex_t lock;
+  pthread_cond_t cond;
+  uint8_t *storage;
+  UBaseType_t length;
+  UBaseType_t item_size;
+  UBaseType_t head;
+  UBaseType_t count;
+} StaticQueue_t;
+
+typedef StaticQueue_t *QueueHandle_t;
+
+QueueHandle_t xQueueCreateStatic(UBaseType_t length, UBaseType_t item_size,
+                                 uint8_t *storage, StaticQueue_t *buffer);
+BaseType_t xQueueSend(QueueHandle_t queue, const void *item, TickType_t ticks);
+BaseType_t xQueueReceive(QueueHandle_t queue, void *item, TickType_t ticks);
+UBaseType_t uxQueueMessagesWaiting(QueueHandle_t queue);
+
+#endif // HOST_SHIM_QUEUE_H
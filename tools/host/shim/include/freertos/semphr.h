@@ -0,0 +1,31 @@
+/**
+ * @file semphr.h
+ * @brief Host shim for FreeRTOS mutexes and binary semaphores, backed by
+ *        pthreads
+ *
+ * Both are a count of 0 or 1 under a condition variable; a mutex starts
+ * given. Priority inheritance and ownership are not modelled.
+ */
+
+#ifndef HOST_SHIM_SEMPHR_H
+#define HOST_SHIM_SEMPHR_H
+
+#include "freertos/FreeRTOS.h"
+#include <pthread.h>
+
+typedef struct {
+  pthread_mutex_t lock;
+  pthread_cond_t cond;
+  int count;
+} StaticSemaphore_t;
+
+typedef StaticSemaphore_t *SemaphoreHandle_t;
+
+SemaphoreHandle_t xSemaphoreCreateMutex(void);
+SemaphoreHandle_t xSemaphoreCreateMutexStatic(StaticSemaphore_t *buffer);
+SemaphoreHandle_t xSemaphoreCreateBinaryStatic(StaticSemaphore_t *buffer);
+BaseType_t xSemaphoreTake(SemaphoreHandle_t sem, TickType_t ticks);
+BaseType_t xSemaphoreGive(SemaphoreHandle_t sem);
+void vSemaphoreDelete(SemaphoreHandle_t sem);
+
+#endif // HOST_SHIM_SEMPHR_H
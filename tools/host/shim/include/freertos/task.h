@@ -0,0 +1,44 @@
+/**
+ * @file task.h
+ * @brief Host shim for the FreeRTOS task API used by the components
+ */
+
+#ifndef HOST_SHIM_TASK_H
+#define HOST_SHIM_TASK_H
+
+#include "freertos/FreeRTOS.h"
+#include <pthread.h>
+
+typedef void (*TaskFunction_t)(void *);
+typedef uint8_t StackType_t;
+
+typedef struct {
+  pthread_t thread;
+  TaskFunction_t fn;
+  void *arg;
+  pthread_mutex_t lock;
+  pthread_cond_t cond;
+  uint32_t notified;
+} StaticTask_t;
+
+typedef StaticTask_t *TaskHandle_t;
+
+TickType_t xTaskGetTickCount(void);
+void vTaskDelay(TickType_t ticks);
+
+/**
+ * @brief Run a task on its own thread; stack size and priority are ignored
+ */
+TaskHandle_t xTaskCreateStatic(TaskFunction_t fn, const char *name,
+                               uint32_t stack_depth, void *arg,
+                               UBaseType_t priority, StackType_t *stack,
+                               StaticTask_t *tcb);
+
+/**
+ * @brief Take the calling task's notification count; a task made by
+ *        xTaskCreateStatic only
+ */
+uint32_t ulTaskNotifyTake(BaseType_t clear, TickType_t ticks);
+BaseType_t xTaskNotifyGive(TaskHandle_t task);
+
+#endif // HOST_SHIM_TASK_H
@@ -0,0 +1,13 @@
+/**
+ * @file nvs_flash.h
+ * @brief Host shim for nvs_flash.h
+ */
+
+#ifndef HOST_SHIM_NVS_FLASH_H
+#define HOST_SHIM_NVS_FLASH_H
+
+#include "nvs.h"
+
+esp_err_t nvs_flash_init(void);
+
+#endif // HOST_SHIM_NVS_FLASH_H
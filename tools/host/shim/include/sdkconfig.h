@@ -0,0 +1,12 @@
+/**
+ * @file sdkconfig.h
+ * @brief Host shim for the generated project configuration
+ *
+ * Component options are passed as compile definitions by tools/host
+ * CMakeLists.txt instead.
+ */
+
+#ifndef HOST_SHIM_SDKCONFIG_H
+#define HOST_SHIM_SDKCONFIG_H
+
+#endif // HOST_SHIM_SDKCONFIG_H
@@ -0,0 +1,289 @@
+/**
+ * @file shim_freertos.c
+ * @brief Host shim for the FreeRTOS primitives used by the components
+ */
+
+#include "esp_err.h"
+#include "esp_log.h"
+#include "esp_rom_crc.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+esp_log_level_t esp_log_host_level = ESP_LOG_WARN;
+
+uint32_t esp_log_timestamp(void) {
+  static struct timespec start;
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  if (start.tv_sec == 0 && start.tv_nsec == 0) {
+    start = ts;
+  }
+  return (uint32_t)((ts.tv_sec - start.tv_sec) * 1000 +
+                    (ts.tv_nsec - start.tv_nsec) / 1000000);
+}
+
+void esp_log_write(esp_log_level_t level, const char *tag, const char *format,
+                   ...) {
+  (void)tag;
+  if (esp_log_host_level < level) {
+    return;
+  }
+  va_list ap;
+  va_start(ap, format);
+  vfprintf(stderr, format, ap);
+  va_end(ap);
+}
+
+const char *esp_err_to_name(esp_err_t code) {
+  switch (code) {
+  case ESP_OK:
+    return "ESP_OK";
+  case ESP_FAIL:
+    return "ESP_FAIL";
+  case ESP_ERR_NO_MEM:
+    return "ESP_ERR_NO_MEM";
+  case ESP_ERR_INVALID_ARG:
+    return "ESP_ERR_INVALID_ARG";
+  case ESP_ERR_INVALID_STATE:
+    return "ESP_ERR_INVALID_STATE";
+  case ESP_ERR_INVALID_SIZE:
+    return "ESP_ERR_INVALID_SIZE";
+  case ESP_ERR_NOT_FOUND:
+    return "ESP_ERR_NOT_FOUND";
+  case ESP_ERR_TIMEOUT:
+    return "ESP_ERR_TIMEOUT";
+  case ESP_ERR_INVALID_CRC:
+    return "ESP_ERR_INVALID_CRC";
+  case ESP_ERR_INVALID_VERSION:
+    return "ESP_ERR_INVALID_VERSION";
+  default:
+    return "UNKNOWN ERROR";
+  }
+}
+
+SemaphoreHandle_t xSemaphoreCreateMutex(void) {
+  StaticSemaphore_t *sem = malloc(sizeof(StaticSemaphore_t));
+  if (sem == NULL) {
+    return NULL;
+  }
+  return xSemaphoreCreateMutexStatic(sem);
+}
+
+SemaphoreHandle_t xSemaphoreCreateMutexStatic(StaticSemaphore_t *buffer) {
+  xSemaphoreCreateBinaryStatic(buffer);
+  buffer->count = 1;
+  return buffer;
+}
+
+SemaphoreHandle_t xSemaphoreCreateBinaryStatic(StaticSemaphore_t *buffer) {
+  pthread_mutex_init(&buffer->lock, NULL);
+  pthread_cond_init(&buffer->cond, NULL);
+  buffer->count = 0;
+  return buffer;
+}
+
+/**
+ * @brief Absolute CLOCK_REALTIME deadline ticks from now
+ */
+static struct timespec deadline_after(TickType_t ticks) {
+  struct timespec ts;
+  clock_gettime(CLOCK_REALTIME, &ts);
+  uint64_t ns = (uint64_t)ts.tv_nsec +
+                (uint64_t)ticks * (1000000000ULL / configTICK_RATE_HZ);
+  ts.tv_sec += (time_t)(ns / 1000000000ULL);
+  ts.tv_nsec = (long)(ns % 1000000000ULL);
+  return ts;
+}
+
+BaseType_t xSemaphoreTake(SemaphoreHandle_t sem, TickType_t ticks) {
+  struct timespec deadline = deadline_after(ticks);
+  pthread_mutex_lock(&sem->lock);
+  while (sem->count == 0) {
+    int err = 0;
+    if (ticks == 0) {
+      err = 1;
+    } else if (ticks == portMAX_DELAY) {
+      pthread_cond_wait(&sem->cond, &sem->lock);
+    } else {
+      err = pthread_cond_timedwait(&sem->cond, &sem->lock, &deadline);
+    }
+    if (err != 0 && sem->count == 0) {
+      pthread_mutex_unlock(&sem->lock);
+      return pdFALSE;
+    }
+  }
+  sem->count = 0;
+  pthread_mutex_unlock(&sem->lock);
+  return pdTRUE;
+}
+
+BaseType_t xSemaphoreGive(SemaphoreHandle_t sem) {
+  pthread_mutex_lock(&sem->lock);
+  BaseType_t given = sem->count == 0 ? pdTRUE : pdFALSE;
+  sem->count = 1;
+  pthread_cond_signal(&sem->cond);
+  pthread_mutex_unlock(&sem->lock);
+  return given;
+}
+
+void vSemaphoreDelete(SemaphoreHandle_t sem) {
+  pthread_cond_destroy(&sem->cond);
+  pthread_mutex_destroy(&sem->lock);
+}
+
+TickType_t xTaskGetTickCount(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (TickType_t)(ts.tv_sec * configTICK_RATE_HZ +
+                      ts.tv_nsec / (1000000000L / configTICK_RATE_HZ));
+}
+
+void vTaskDelay(TickType_t ticks) {
+  struct timespec ts = {
+      .tv_sec = ticks / configTICK_RATE_HZ,
+      .tv_nsec = (long)(ticks % configTICK_RATE_HZ) *
+                 (1000000000L / configTICK_RATE_HZ),
+  };
+  nanosleep(&ts, NULL);
+}
+
+static __thread StaticTask_t *s_current_task;
+
+static void *task_trampoline(void *arg) {
+  StaticTask_t *task = arg;
+  s_current_task = task;
+  task->fn(task->arg);
+  return NULL;
+}
+
+TaskHandle_t xTaskCreateStatic(TaskFunction_t fn, const char *name,
+                               uint32_t stack_depth, void *arg,
+                               UBaseType_t priority, StackType_t *stack,
+                               StaticTask_t *tcb) {
+  (void)name;
+  (void)stack_depth;
+  (void)priority;
+  (void)stack;
+  tcb->fn = fn;
+  tcb->arg = arg;
+  pthread_mutex_init(&tcb->lock, NULL);
+  pthread_cond_init(&tcb->cond, NULL);
+  tcb->notified = 0;
+  if (pthread_create(&tcb->thread, NULL, task_trampoline, tcb) != 0) {
+    return NULL;
+  }
+  pthread_detach(tcb->thread);
+  return tcb;
+}
+
+uint32_t ulTaskNotifyTake(BaseType_t clear, TickType_t ticks) {
+  StaticTask_t *task = s_current_task;
+  struct timespec deadline = deadline_after(ticks);
+  pthread_mutex_lock(&task->lock);
+  while (task->notified == 0 && ticks != 0) {
+    if (ticks == portMAX_DELAY) {
+      pthread_cond_wait(&task->cond, &task->lock);
+    } else if (pthread_cond_timedwait(&task->cond, &task->lock,
+                                      &deadline) != 0) {
+      break;
+    }
+  }
+  uint32_t count = task->notified;
+  if (count > 0) {
+    task->notified = clear ? 0 : count - 1;
+  }
+  pthread_mutex_unlock(&task->lock);
+  return count;
+}
+
+BaseType_t xTaskNotifyGive(TaskHandle_t task) {
+  pthread_mutex_lock(&task->lock);
+  task->notified++;
+  pthread_cond_signal(&task->cond);
+  pthread_mutex_unlock(&task->lock);
+  return pdTRUE;
+}
+
+QueueHandle_t xQueueCreateStatic(UBaseType_t length, UBaseType_t item_size,
+                                 uint8_t *storage, StaticQueue_t *buffer) {
+  memset(buffer, 0, sizeof(*buffer));
+  pthread_mutex_init(&buffer->lock, NULL);
+  pthread_cond_init(&buffer->cond, NULL);
+  buffer->storage = storage;
+  buffer->length = length;
+  buffer->item_size = item_size;
+  return buffer;
+}
+
+/**
+ * @brief Wait on the queue condition; returns 0 once the timeout expired
+ */
+static int queue_wait(QueueHandle_t queue, TickType_t ticks) {
+  if (ticks == 0) {
+    return 0;
+  }
+  if (ticks == portMAX_DELAY) {
+    pthread_cond_wait(&queue->cond, &queue->lock);
+    return 1;
+  }
+  struct timespec ts = deadline_after(ticks);
+  return pthread_cond_timedwait(&queue->cond, &queue->lock, &ts) == 0;
+}
+
+BaseType_t xQueueSend(QueueHandle_t queue, const void *item,
+                      TickType_t ticks) {
+  pthread_mutex_lock(&queue->lock);
+  while (queue->count == queue->length) {
+    if (!queue_wait(queue, ticks)) {
+      pthread_mutex_unlock(&queue->lock);
+      return pdFALSE;
+    }
+  }
+  UBaseType_t tail = (queue->head + queue->count) % queue->length;
+  memcpy(queue->storage + tail * queue->item_size, item, queue->item_size);
+  queue->count++;
+  pthread_cond_broadcast(&queue->cond);
+  pthread_mutex_unlock(&queue->lock);
+  return pdTRUE;
+}
+
+BaseType_t xQueueReceive(QueueHandle_t queue, void *item, TickType_t ticks) {
+  pthread_mutex_lock(&queue->lock);
+  while (queue->count == 0) {
+    if (!queue_wait(queue, ticks)) {
+      pthread_mutex_unlock(&queue->lock);
+      return pdFALSE;
+    }
+  }
+  memcpy(item, queue->storage + queue->head * queue->item_size,
+         queue->item_size);
+  queue->head = (queue->head + 1) % queue->length;
+  queue->count--;
+  pthread_cond_broadcast(&queue->cond);
+  pthread_mutex_unlock(&queue->lock);
+  return pdTRUE;
+}
+
+UBaseType_t uxQueueMessagesWaiting(QueueHandle_t queue) {
+  pthread_mutex_lock(&queue->lock);
+  UBaseType_t count = queue->count;
+  pthread_mutex_unlock(&queue->lock);
+  return count;
+}
+
+uint32_t esp_rom_crc32_le(uint32_t crc, const uint8_t *buf, uint32_t len) {
+  crc = ~crc;
+  for (uint32_t i = 0; i < len; i++) {
+    crc ^= buf[i];
+    for (int b = 0; b < 8; b++) {
+      crc = (crc >> 1) ^ (0xEDB88320u & (0u - (crc & 1u)));
+    }
+  }
+  return ~crc;
+}
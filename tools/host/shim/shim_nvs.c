@@ -0,0 +1,191 @@
+/**
+ * @file shim_nvs.c
+ * @brief Host shim for NVS, backed by an in-memory key/value table
+ */
+
+#include "nvs.h"
+#include "nvs_flash.h"
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define NVS_HOST_MAX_ENTRIES 64
+#define NVS_HOST_MAX_HANDLES 16
+#define NVS_HOST_NAME_LEN 16
+
+typedef struct {
+  char ns[NVS_HOST_NAME_LEN];
+  char key[NVS_HOST_NAME_LEN];
+  void *data;
+  size_t length;
+} nvs_host_entry_t;
+
+static nvs_host_entry_t s_entries[NVS_HOST_MAX_ENTRIES];
+static char s_handles[NVS_HOST_MAX_HANDLES][NVS_HOST_NAME_LEN];
+static pthread_mutex_t s_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static nvs_host_entry_t *find_entry(const char *ns, const char *key,
+                                    int create) {
+  nvs_host_entry_t *free_slot = NULL;
+  for (int i = 0; i < NVS_HOST_MAX_ENTRIES; i++) {
+    nvs_host_entry_t *e = &s_entries[i];
+    if (e->data == NULL) {
+      if (free_slot == NULL) {
+        free_slot = e;
+      }
+      continue;
+    }
+    if (strcmp(e->ns, ns) == 0 && strcmp(e->key, key) == 0) {
+      return e;
+    }
+  }
+  if (!create || free_slot == NULL) {
+    return NULL;
+  }
+  strncpy(free_slot->ns, ns, NVS_HOST_NAME_LEN - 1);
+  strncpy(free_slot->key, key, NVS_HOST_NAME_LEN - 1);
+  return free_slot;
+}
+
+static const char *handle_ns(nvs_handle_t handle) {
+  if (handle == 0 || handle > NVS_HOST_MAX_HANDLES) {
+    return NULL;
+  }
+  return s_handles[handle - 1][0] ? s_handles[handle - 1] : NULL;
+}
+
+esp_err_t nvs_flash_init(void) { return ESP_OK; }
+
+esp_err_t nvs_open(const char *name, nvs_open_mode_t open_mode,
+                   nvs_handle_t *out_handle) {
+  if (name == NULL || out_handle == NULL ||
+      strlen(name) >= NVS_HOST_NAME_LEN) {
+    return ESP_ERR_INVALID_ARG;
+  }
+
+  pthread_mutex_lock(&s_lock);
+  if (open_mode == NVS_READONLY) {
+    int found = 0;
+    for (int i = 0; i < NVS_HOST_MAX_ENTRIES && !found; i++) {
+      found = s_entries[i].data != NULL && strcmp(s_entries[i].ns, name) == 0;
+    }
+    if (!found) {
+      pthread_mutex_unlock(&s_lock);
+      return ESP_ERR_NVS_NOT_FOUND;
+    }
+  }
+  for (int i = 0; i < NVS_HOST_MAX_HANDLES; i++) {
+    if (s_handles[i][0] == '\0') {
+      strcpy(s_handles[i], name);
+      *out_handle = (nvs_handle_t)(i + 1);
+      pthread_mutex_unlock(&s_lock);
+      return ESP_OK;
+    }
+  }
+  pthread_mutex_unlock(&s_lock);
+  return ESP_ERR_NO_MEM;
+}
+
+void nvs_close(nvs_handle_t handle) {
+  pthread_mutex_lock(&s_lock);
+  if (handle_ns(handle) != NULL) {
+    s_handles[handle - 1][0] = '\0';
+  }
+  pthread_mutex_unlock(&s_lock);
+}
+
+esp_err_t nvs_commit(nvs_handle_t handle) {
+  return handle_ns(handle) != NULL ? ESP_OK : ESP_ERR_INVALID_ARG;
+}
+
+esp_err_t nvs_set_blob(nvs_handle_t handle, const char *key, const void *value,
+                       size_t length) {
+  const char *ns = handle_ns(handle);
+  if (ns == NULL || key == NULL || strlen(key) >= NVS_HOST_NAME_LEN) {
+    return ESP_ERR_INVALID_ARG;
+  }
+
+  void *copy = malloc(length ? length : 1);
+  if (copy == NULL) {
+    return ESP_ERR_NO_MEM;
+  }
+  memcpy(copy, value, length);
+
+  pthread_mutex_lock(&s_lock);
+  nvs_host_entry_t *e = find_entry(ns, key, 1);
+  if (e == NULL) {
+    pthread_mutex_unlock(&s_lock);
+    free(copy);
+    return ESP_ERR_NVS_NOT_ENOUGH_SPACE;
+  }
+  free(e->data);
+  e->data = copy;
+  e->length = length;
+  pthread_mutex_unlock(&s_lock);
+  return ESP_OK;
+}
+
+esp_err_t nvs_get_blob(nvs_handle_t handle, const char *key, void *out_value,
+                       size_t *length) {
+  const char *ns = handle_ns(handle);
+  if (ns == NULL || key == NULL || length == NULL) {
+    return ESP_ERR_INVALID_ARG;
+  }
+
+  pthread_mutex_lock(&s_lock);
+  nvs_host_entry_t *e = find_entry(ns, key, 0);
+  if (e == NULL) {
+    pthread_mutex_unlock(&s_lock);
+    return ESP_ERR_NVS_NOT_FOUND;
+  }
+  if (out_value == NULL) {
+    *length = e->length;
+    pthread_mutex_unlock(&s_lock);
+    return ESP_OK;
+  }
+  if (*length < e->length) {
+    pthread_mutex_unlock(&s_lock);
+    return ESP_ERR_NVS_INVALID_LENGTH;
+  }
+  memcpy(out_value, e->data, e->length);
+  *length = e->length;
+  pthread_mutex_unlock(&s_lock);
+  return ESP_OK;
+}
+
+esp_err_t nvs_set_u32(nvs_handle_t handle, const char *key, uint32_t value) {
+  return nvs_set_blob(handle, key, &value, sizeof(value));
+}
+
+esp_err_t nvs_get_u32(nvs_handle_t handle, const char *key,
+                      uint32_t *out_value) {
+  size_t length = sizeof(*out_value);
+  return nvs_get_blob(handle, key, out_value, &length);
+}
+
+esp_err_t nvs_erase_key(nvs_handle_t handle, const char *key) {
+  const char *ns = handle_ns(handle);
+  if (ns == NULL || key == NULL) {
+    return ESP_ERR_INVALID_ARG;
+  }
+
+  pthread_mutex_lock(&s_lock);
+  nvs_host_entry_t *e = find_entry(ns, key, 0);
+  if (e == NULL) {
+    pthread_mutex_unlock(&s_lock);
+    return ESP_ERR_NVS_NOT_FOUND;
+  }
+  free(e->data);
+  memset(e, 0, sizeof(*e));
+  pthread_mutex_unlock(&s_lock);
+  return ESP_OK;
+}
+
+void nvs_host_clear(void) {
+  pthread_mutex_lock(&s_lock);
+  for (int i = 0; i < NVS_HOST_MAX_ENTRIES; i++) {
+    free(s_entries[i].data);
+    memset(&s_entries[i], 0, sizeof(s_entries[i]));
+  }
+  pthread_mutex_unlock(&s_lock);
+}
@@ -0,0 +1,273 @@
+/**
+ * @file sink_registry_check.c
+ * @brief Host check of the sink registry's fan-out and overflow policies
+ *
+ * Publishes numbered records to sinks of each policy, each on its own task
+ * as on the device. A free-running sink of every policy must see every
+ * record once and in order. With the handlers held, drop-oldest must keep
+ * the newest records, drop-newest the oldest, and a blocking sink must
+ * hold the publisher for its block_ms and then drop. Released mid-wait, a
+ * blocking sink must let the publisher go as soon as its handler frees a
+ * slot, well inside block_ms. Every record published must be delivered or
+ * counted as dropped.
+ *
+ * Usage: sink_registry_check [records]
+ */
+
+#include "esp_timer.h"
+#include "freertos/task.h"
+#include "sink_registry.h"
+#include <inttypes.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#define CHECK_RECORDS_DEFAULT 20000u
+#define CHECK_CAPACITY 8
+#define CHECK_BLOCK_MS 200
+#define CHECK_STACK_SIZE 1024
+// Wait latency allowed on a loaded host; polling by ticks stays inside it,
+// so only the long waits tell a wake from a timeout
+#define CHECK_TOLERANCE_MS 50
+// Longest wait for a sink to drain before giving up
+#define DRAIN_TIMEOUT_MS 5000
+
+typedef struct {
+  bool hold; /**< Handler waits while set */
+  uint32_t last;
+  uint32_t handled;
+  uint32_t out_of_order;
+} consumer_t;
+
+typedef struct {
+  sink_t sink;
+  consumer_t consumer;
+  uint32_t storage[CHECK_CAPACITY + 1];
+  StackType_t stack[CHECK_STACK_SIZE];
+} check_sink_t;
+
+static int failures;
+
+static void expect(bool ok, const char *what) {
+  if (!ok) {
+    fprintf(stderr, "FAILED: %s\n", what);
+    failures++;
+  }
+}
+
+static void handler(const void *record, void *arg) {
+  consumer_t *c = arg;
+  while (__atomic_load_n(&c->hold, __ATOMIC_ACQUIRE)) {
+    vTaskDelay(1);
+  }
+  uint32_t seq = *(const uint32_t *)record;
+  c->out_of_order += seq <= c->last;
+  c->last = seq;
+  __atomic_store_n(&c->handled, c->handled + 1, __ATOMIC_RELEASE);
+}
+
+static void start(sink_registry_t *registry, check_sink_t *s,
+                  const char *name, sink_policy_t policy, bool hold) {
+  s->consumer = (consumer_t){.hold = hold};
+  const sink_config_t config = {
+      .name = name,
+      .handler = handler,
+      .arg = &s->consumer,
+      .policy = policy,
+      .block_ms = CHECK_BLOCK_MS,
+      .storage = s->storage,
+      .capacity = CHECK_CAPACITY,
+      .stack = s->stack,
+      .stack_size = sizeof(s->stack),
+  };
+  expect(sink_register(registry, &s->sink, &config) == ESP_OK,
+         "sink registered");
+}
+
+static void release(check_sink_t *s) {
+  __atomic_store_n(&s->consumer.hold, false, __ATOMIC_RELEASE);
+}
+
+/**
+ * @brief Wait until a sink has handled or dropped every record published
+ */
+static void drain(check_sink_t *s, uint32_t records) {
+  sink_stats_t stats;
+  for (int ms = 0; ms < DRAIN_TIMEOUT_MS; ms++) {
+    sink_get_stats(&s->sink, &stats);
+    if (stats.delivered + stats.dropped == records) {
+      return;
+    }
+    vTaskDelay(1);
+  }
+}
+
+static uint32_t s_seq;
+
+static esp_err_t publish(sink_registry_t *registry) {
+  s_seq++;
+  return sink_registry_publish(registry, &s_seq);
+}
+
+static void check_fan_out(uint32_t records) {
+  static check_sink_t sinks[3];
+  static const char *const names[] = {"oldest", "newest", "block"};
+  sink_registry_t registry;
+  sink_registry_init(&registry, sizeof(uint32_t));
+  for (int i = 0; i < 3; i++) {
+    start(&registry, &sinks[i], names[i], (sink_policy_t)i, false);
+  }
+
+  uint32_t first = s_seq + 1;
+  for (uint32_t i = 0; i < records; i++) {
+    publish(&registry);
+  }
+  for (int i = 0; i < 3; i++) {
+    drain(&sinks[i], records);
+    sink_stats_t stats;
+    sink_get_stats(&sinks[i].sink, &stats);
+    printf("Fan-out %-6s: %" PRIu32 " delivered, %" PRIu32 " dropped, "
+           "%" PRIu32 " ms blocked, high water %" PRIu32 "\n",
+           names[i], stats.delivered, stats.dropped, stats.blocked_ms,
+           stats.high_water);
+    expect(sinks[i].consumer.out_of_order == 0, "records in order, none twice");
+    expect(stats.delivered + stats.dropped == records,
+           "every record delivered or dropped");
+    expect(sinks[i].consumer.handled == stats.delivered, "delivered counted");
+    expect(i != SINK_BLOCK || stats.dropped == 0,
+           "blocking sink dropped nothing");
+  }
+  expect(sinks[2].consumer.last == first + records - 1,
+         "blocking sink saw the last record");
+}
+
+static void check_held(sink_policy_t policy) {
+  static check_sink_t s;
+  sink_registry_t registry;
+  sink_registry_init(&registry, sizeof(uint32_t));
+  start(&registry, &s, "held", policy, true);
+
+  // One record goes to the held handler, capacity more fill the queue
+  uint32_t first = s_seq + 1;
+  const uint32_t records = CHECK_CAPACITY + 1 + 3;
+  esp_err_t last = ESP_OK;
+  int64_t blocked_us = 0;
+  for (uint32_t i = 0; i < records; i++) {
+    int64_t t = esp_timer_get_time();
+    last = publish(&registry);
+    blocked_us += esp_timer_get_time() - t;
+    if (i == 0) {
+      vTaskDelay(10); // Let the task take the first record
+    }
+  }
+  release(&s);
+  drain(&s, records);
+
+  sink_stats_t stats;
+  sink_get_stats(&s.sink, &stats);
+  const char *name = policy == SINK_DROP_OLDEST   ? "oldest"
+                     : policy == SINK_DROP_NEWEST ? "newest"
+                                                  : "block";
+  printf("Held %-9s: %" PRIu32 " delivered, %" PRIu32 " dropped, last %" PRIu32
+         ", publishing took %.0f ms\n",
+         name, stats.delivered, stats.dropped, s.consumer.last - first + 1,
+         (double)blocked_us / 1000.0);
+  expect(last == ESP_ERR_NO_MEM, "overflow reported");
+  expect(stats.dropped == 3 && stats.delivered == records - 3,
+         "three records dropped");
+  expect(s.consumer.last ==
+             (policy == SINK_DROP_OLDEST ? first + records - 1
+                                         : first + CHECK_CAPACITY),
+         "policy keeps the right records");
+  if (policy == SINK_BLOCK) {
+    expect(blocked_us >= 3 * (CHECK_BLOCK_MS - 1) * 1000 &&
+               blocked_us < 3 * (CHECK_BLOCK_MS + CHECK_TOLERANCE_MS) * 1000,
+           "each drop waited block_ms");
+    expect(stats.blocked_ms >= 3 * (CHECK_BLOCK_MS - 1), "waiting counted");
+  } else {
+    expect(blocked_us < CHECK_TOLERANCE_MS * 1000, "dropping does not wait");
+  }
+}
+
+static void *release_main(void *arg) {
+  vTaskDelay(CHECK_BLOCK_MS / 4);
+  release(arg);
+  return NULL;
+}
+
+static void check_wake(void) {
+  static check_sink_t s;
+  sink_registry_t registry;
+  sink_registry_init(&registry, sizeof(uint32_t));
+  start(&registry, &s, "wake", SINK_BLOCK, true);
+  for (uint32_t i = 0; i < CHECK_CAPACITY + 1; i++) {
+    publish(&registry);
+    if (i == 0) {
+      vTaskDelay(10);
+    }
+  }
+
+  // Full; the handler is released a quarter of block_ms into the wait
+  pthread_t releaser;
+  pthread_create(&releaser, NULL, release_main, &s);
+  int64_t t = esp_timer_get_time();
+  esp_err_t err = publish(&registry);
+  int64_t waited_us = esp_timer_get_time() - t;
+  pthread_join(releaser, NULL);
+  drain(&s, CHECK_CAPACITY + 2);
+
+  sink_stats_t stats;
+  sink_get_stats(&s.sink, &stats);
+  printf("Wake         : publisher let go after %.1f ms of %d\n",
+         (double)waited_us / 1000.0, CHECK_BLOCK_MS);
+  expect(err == ESP_OK && stats.dropped == 0, "record taken after the wait");
+  expect(waited_us < (CHECK_BLOCK_MS / 4 + CHECK_TOLERANCE_MS) * 1000,
+         "freed slot ends the wait");
+}
+
+static void check_register(void) {
+  static check_sink_t s[SINK_REGISTRY_MAX_SINKS + 1];
+  sink_registry_t registry;
+  sink_registry_init(&registry, sizeof(uint32_t));
+  const sink_config_t bad = {
+      .name = "bad",
+      .handler = handler,
+      .arg = &s[0].consumer,
+      .policy = (sink_policy_t)(SINK_BLOCK + 1),
+      .storage = s[0].storage,
+      .capacity = CHECK_CAPACITY,
+      .stack = s[0].stack,
+      .stack_size = sizeof(s[0].stack),
+  };
+  expect(sink_register(&registry, &s[0].sink, &bad) == ESP_ERR_INVALID_ARG,
+         "unknown policy rejected");
+  for (int i = 0; i < SINK_REGISTRY_MAX_SINKS; i++) {
+    start(&registry, &s[i], "full", SINK_DROP_NEWEST, false);
+  }
+  check_sink_t *extra = &s[SINK_REGISTRY_MAX_SINKS];
+  sink_config_t config = bad;
+  config.policy = SINK_DROP_NEWEST;
+  config.arg = &extra->consumer;
+  config.storage = extra->storage;
+  config.stack = extra->stack;
+  expect(sink_register(&registry, &extra->sink, &config) == ESP_ERR_NO_MEM,
+         "full registry rejected");
+}
+
+int main(int argc, char **argv) {
+  uint32_t records = CHECK_RECORDS_DEFAULT;
+  if (argc > 1) {
+    records = (uint32_t)strtoul(argv[1], NULL, 0);
+  }
+
+  check_fan_out(records);
+  check_held(SINK_DROP_OLDEST);
+  check_held(SINK_DROP_NEWEST);
+  check_held(SINK_BLOCK);
+  check_wake();
+  check_register();
+
+  printf("%s\n", failures == 0 ? "Sinks behave" : "SINKS MISBEHAVE");
+  return failures == 0 ? 0 : 1;
+}
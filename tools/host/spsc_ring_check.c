@@ -0,0 +1,163 @@
+/**
+ * @file spsc_ring_check.c
+ * @brief Host check of the SPSC ring's overflow policies
+ *
+ * First pushes past capacity on one thread and checks which records each
+ * policy keeps and what the counters say. Then runs a producer and a
+ * consumer thread against a small ring under both policies. Every record
+ * is a sequence number repeated across its payload, so the consumer can
+ * tell a torn copy, a record seen twice or out of order, and at the end
+ * every record pushed must have been either popped or counted as dropped.
+ *
+ * Usage: spsc_ring_check [records]
+ */
+
+#include "spsc_ring.h"
+#include <inttypes.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#define CHECK_RECORDS_DEFAULT 4000000u
+#define RECORD_WORDS 16
+#define STRESS_CAPACITY 8
+
+typedef struct {
+  uint32_t word[RECORD_WORDS];
+} record_t;
+
+typedef struct {
+  spsc_ring_t ring;
+  bool done;
+  uint32_t popped;
+  uint32_t torn;
+  uint32_t out_of_order;
+} stress_t;
+
+static int failures;
+
+static void expect(bool ok, const char *what) {
+  if (!ok) {
+    fprintf(stderr, "FAILED: %s\n", what);
+    failures++;
+  }
+}
+
+static void fill(record_t *r, uint32_t seq) {
+  for (int i = 0; i < RECORD_WORDS; i++) {
+    r->word[i] = seq;
+  }
+}
+
+static void check_overflow(spsc_ring_policy_t policy) {
+  record_t storage[4];
+  spsc_ring_t ring;
+  spsc_ring_init(&ring, storage, sizeof(record_t), 4, policy);
+
+  uint32_t rejected = 0;
+  for (uint32_t seq = 1; seq <= 10; seq++) {
+    record_t r;
+    fill(&r, seq);
+    rejected += spsc_ring_push(&ring, &r) == ESP_ERR_NO_MEM;
+  }
+
+  spsc_ring_stats_t stats;
+  spsc_ring_get_stats(&ring, &stats);
+  expect(stats.pushed == 10 - rejected && stats.dropped == 6 &&
+             stats.depth == 4 && stats.high_water == 4,
+         "counters after overflow");
+
+  // Drop-oldest keeps the last four records, drop-newest the first four
+  uint32_t first = policy == SPSC_RING_DROP_OLDEST ? 7 : 1;
+  expect(rejected == (policy == SPSC_RING_DROP_OLDEST ? 0 : 6),
+         "pushes rejected");
+  for (uint32_t seq = first; seq < first + 4; seq++) {
+    record_t r;
+    expect(spsc_ring_pop(&ring, &r) && r.word[0] == seq &&
+               r.word[RECORD_WORDS - 1] == seq,
+           "records kept");
+  }
+  record_t r;
+  expect(!spsc_ring_pop(&ring, &r), "ring empty after draining");
+  spsc_ring_get_stats(&ring, &stats);
+  expect(stats.depth == 0, "depth after draining");
+}
+
+static void *consumer_main(void *arg) {
+  stress_t *s = arg;
+  uint32_t last = 0;
+  for (;;) {
+    bool done = __atomic_load_n(&s->done, __ATOMIC_ACQUIRE);
+    record_t r;
+    while (spsc_ring_pop(&s->ring, &r)) {
+      s->popped++;
+      for (int i = 1; i < RECORD_WORDS; i++) {
+        if (r.word[i] != r.word[0]) {
+          s->torn++;
+          break;
+        }
+      }
+      s->out_of_order += r.word[0] <= last;
+      last = r.word[0];
+    }
+    if (done) {
+      return NULL; // Drained after the producer finished
+    }
+    sched_yield();
+  }
+}
+
+static void check_threads(spsc_ring_policy_t policy, uint32_t records) {
+  static record_t storage[STRESS_CAPACITY];
+  static stress_t s;
+  s = (stress_t){0};
+  spsc_ring_init(&s.ring, storage, sizeof(record_t), STRESS_CAPACITY, policy);
+
+  pthread_t consumer;
+  pthread_create(&consumer, NULL, consumer_main, &s);
+  uint32_t rejected = 0;
+  for (uint32_t seq = 1; seq <= records; seq++) {
+    record_t r;
+    fill(&r, seq);
+    rejected += spsc_ring_push(&s.ring, &r) == ESP_ERR_NO_MEM;
+    // Bursts of varying length, so the ring both overflows and drains
+    if (seq % (1 + (seq >> 4) % 13) == 0) {
+      sched_yield();
+    }
+  }
+  __atomic_store_n(&s.done, true, __ATOMIC_RELEASE);
+  pthread_join(consumer, NULL);
+
+  spsc_ring_stats_t stats;
+  spsc_ring_get_stats(&s.ring, &stats);
+  const char *name =
+      policy == SPSC_RING_DROP_OLDEST ? "drop-oldest" : "drop-newest";
+  printf("%-11s : %" PRIu32 " pushed, %" PRIu32 " popped, %" PRIu32
+         " dropped, %" PRIu32 " torn, %" PRIu32 " out of order\n",
+         name, records, s.popped, stats.dropped, s.torn, s.out_of_order);
+
+  expect(s.torn == 0, "no torn records");
+  expect(s.out_of_order == 0, "records in order, none twice");
+  expect(s.popped + stats.dropped == records, "every record accounted for");
+  expect(stats.pushed == records - rejected, "pushed counter");
+  expect(policy == SPSC_RING_DROP_OLDEST ? rejected == 0
+                                         : rejected == stats.dropped,
+         "rejections match the policy");
+}
+
+int main(int argc, char **argv) {
+  uint32_t records = CHECK_RECORDS_DEFAULT;
+  if (argc > 1) {
+    records = (uint32_t)strtoul(argv[1], NULL, 0);
+  }
+
+  check_overflow(SPSC_RING_DROP_OLDEST);
+  check_overflow(SPSC_RING_DROP_NEWEST);
+  check_threads(SPSC_RING_DROP_OLDEST, records);
+  check_threads(SPSC_RING_DROP_NEWEST, records);
+
+  printf("%s\n", failures == 0 ? "Ring behaves" : "RING MISBEHAVES");
+  return failures == 0 ? 0 : 1;
+}